@@ -0,0 +1,44 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include "error_handler.h"
+
+#include <stdint.h>
+
+// Clock Discipline: Every SYNC_TIME pairs the OBC's time at the CS falling edge of the frame with
+// the kernel's CLOCK_MONOTONIC timestamp of that edge. OBC time is fitted against CLOCK_MONOTONIC_RAW
+// (never adjusted) by least squares over the recent samples, the slope is the oscillator's drift and
+// is applied as the kernel frequency correction, the remaining offset is slewed out with adjtimex.
+// Only a large offset (first sync after boot) steps CLOCK_REALTIME.
+#define CLOCK_SYNC_MAX_SAMPLES      16
+#define CLOCK_SYNC_MAX_AGE_S        (6 * 3600)      // Older samples are dropped so the drift follows temperature
+#define CLOCK_SYNC_MIN_SPAN_S       30              // Samples must span this long before the drift is trusted
+#define CLOCK_SYNC_STEP_NS          500000000LL     // Offsets above this are stepped, slewing takes ~1000 s at 500 ppm
+#define CLOCK_SYNC_OUTLIER_NS       2000000LL       // Residuals above max(this, 4 x rms) are rejected as outliers
+#define CLOCK_SYNC_MAX_REJECTS      3               // Consecutive outliers that restart the fit (OBC clock changed)
+#define CLOCK_SYNC_MAX_DRIFT_PPB    500000          // Kernel frequency correction limit (500 ppm)
+#define CLOCK_SYNC_LOST_S           (24 * 3600)     // Sync is reported as lost this long after the last sample
+
+typedef enum CLOCK_SYNC_STATE{
+    CLOCK_SYNC_UNSYNCED,    // No sample since start
+    CLOCK_SYNC_STEPPED,     // Clock was set from one sample, drift unknown
+    CLOCK_SYNC_TRACKING,    // Offset slewed and drift corrected from the fit
+    CLOCK_SYNC_LOST         // No sample for CLOCK_SYNC_LOST_S, clock is free running on the last drift
+}CLOCK_SYNC_STATE;
+
+typedef struct {
+    uint8_t state;              // CLOCK_SYNC_STATE
+    uint8_t numSamples;         // Samples in the fit
+    uint16_t numRejected;       // Samples rejected as outliers since start
+    int64_t offsetNs;           // OBC time - Iris time at the last accepted sample, before correction
+    int32_t driftPpb;           // Estimated oscillator drift, applied as the kernel frequency correction
+    uint32_t rmsNs;             // RMS residual of the fit, the expected timestamp error
+    uint64_t lastSyncMs;        // CLOCK_MONOTONIC time of the last accepted sample, 0 if none
+} clock_sync_status_t;
+
+void clock_sync_edge(uint64_t edgeNs);
+uint64_t clock_sync_edge_get(void);
+enum IRIS_ERROR clock_sync_sample(uint64_t edgeNs, uint64_t obcNs);
+void clock_sync_status(clock_sync_status_t *status);
+
+#endif //CLOCK_SYNC_H
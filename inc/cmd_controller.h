@@ -2,6 +2,7 @@
 #define CMD_CTRL_H
 
 #include <gpiod.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 typedef enum IRIS_CMD{
@@ -38,16 +39,160 @@ typedef enum IRIS_CMD{
 	SYNC_TIME,
 	CHECKSUM,
 
+	TELEMETRY_BLOCK,
+	CMD_STATS,
+	CMD_BATCH,
+	JOB_STATUS,
+	JOB_RESULT,
+	JOB_CANCEL,
+	LOG_EXPORT,
+	FLIGHT_DUMP,
+	TRACE_EXPORT,
+	TELEMETRY_HISTORY,
+	SPI_TRAIN,
+
 }IRIS_CMD;
 
 #define RETURN_CMD_SIZE 8
+#define CMD_TABLE_SIZE 256
+#define CMD_RESPONSE_MAX_LEN 255
+#define CMD_STATS_RESPONSE_SIZE 18
+
+// Batched Frames
+//  Request: [CMD_BATCH, count, {len, cmd, args[len - 1]} x count]
+//  Reply:   [CMD_RETURN, status, count, {len, error, data[len - 1]} x count]
+//  Commands execute in order, 'count' in the reply is the number that were executed.
+//  CMD_FLAG_DIRECT_IO commands cannot be batched and answer CMD_UNSUPPORTED_ERROR.
+#define CMD_BATCH_HEADER_SIZE 2
+#define CMD_BATCH_REPLY_HEADER_SIZE 3
+#define CMD_BATCH_MAX_CMDS 32
+#define CMD_BATCH_REPLY_MAX_LEN 1024
+
+// Command Flags
+#define CMD_FLAG_SYNC       (1 << 0)  // Response is built and returned within the OBC transaction
+#define CMD_FLAG_ASYNC      (1 << 1)  // Long running, queued on the job engine and polled with JOB_* commands
+#define CMD_FLAG_CACHEABLE  (1 << 2)  // May be answered from the sensor snapshot cache
+#define CMD_FLAG_DIRECT_IO  (1 << 3)  // Handler writes its own frames to the SPI bus
+#define CMD_FLAG_I2C_BUS    (1 << 4)  // Handler accesses the sensor I2C bus directly, runs under 'i2c_bus_lock'
+#define CMD_FLAG_BULK       (1 << 5)  // Response may be followed by a bulk transfer (See 'cmd_bulk_attach'), cannot be batched
+
+// Log Export
+//  Request: [LOG_EXPORT, flags, start u32, end u32]   Times in Unix seconds MSB first and optional, end 0 = no limit
+//  Reply:   [CMD_RETURN, status, numSegments, raw size u32, compressed size u32, numRemaining]
+//  Unless LOG_EXPORT_FLAG_SIZE_ONLY is set the reply is followed by a bulk transfer of the gzip
+//  export, [FILE_TRANSFER, 64-bit length] then the data (See 'log_export.h' and 'spi_fd_write')
+//  At most LOG_EXPORT_MAX_RAW_MB is exported per request, 'numRemaining' segments of the range are
+//  left for a following request starting at the last exported segment.
+#define LOG_EXPORT_ARGS_SIZE 9
+#define LOG_EXPORT_RESPONSE_SIZE 12
+
+// Time Sync
+//  Request: [SYNC_TIME, seconds u32, nanoseconds u32]   OBC time at the CS falling edge of this frame, optional
+//  Reply:   [CMD_RETURN, status, state, numSamples, offset i32 (us), drift i32 (ppb), rms u32 (ns)]
+//  Every request is one sync pulse for the clock discipline (See 'clock_sync.h'), without arguments
+//  only the sync quality is reported. Offset is OBC - Iris time before this pulse was applied.
+#define SYNC_TIME_ARGS_SIZE 8
+#define SYNC_TIME_RESPONSE_SIZE 16
+
+// Flight Recorder Dump
+//  Request: [FLIGHT_DUMP, flags]   FLIGHT_DUMP_FLAG_* (See 'flight_recorder.h'), optional
+//  Reply:   [CMD_RETURN, status, size u32]
+//  Unless FLIGHT_DUMP_FLAG_SIZE_ONLY is set the reply is followed by a bulk transfer of the
+//  recorder file, decode with 'flight_decode'
+#define FLIGHT_DUMP_RESPONSE_SIZE 6
+
+// Trace Export (Builds with TRACE=1, See 'trace.h')
+//  Request: [TRACE_EXPORT, flags]   TRACE_EXPORT_FLAG_*, optional
+//  Reply:   [CMD_RETURN, status, numSpans u32, size u32]
+//  Unless TRACE_EXPORT_FLAG_SIZE_ONLY is set the reply is followed by a bulk transfer of the
+//  Chrome / Perfetto trace JSON of the service that executes commands
+#define TRACE_EXPORT_RESPONSE_SIZE 10
+
+// Telemetry History
+//  Request: [TELEMETRY_HISTORY, flags]   TELEM_HISTORY_FLAG_* (See 'telemetry_block.h'), optional
+//  Reply:   [CMD_RETURN, status, numSamples u32, size u32]
+//  Unless TELEM_HISTORY_FLAG_SIZE_ONLY is set the reply is followed by a bulk transfer of the
+//  packed history of every sensor channel, decode with 'telemetry_unpack'. With TELEM_HISTORY_FLAG_CLEAR
+//  the exported readings are only dropped once the transfer reached the OBC.
+#define TELEM_HISTORY_RESPONSE_SIZE 10
+
+// SPI Link Training (See 'spi_train.h')
+//  Request: [SPI_TRAIN, mode]   SPI_TRAIN_MODE_*, optional
+//  Reply:   [CMD_RETURN, status, pending, speed u32 (Hz)]
+//  SPI_TRAIN_MODE_QUERY only reports whether Iris wants the link trained and the rate in use. With
+//  SPI_TRAIN_MODE_RUN the OBC enters training, it echoes every SPI_TEST_CMD frame until the reply
+//  arrives, sent at the newly selected rate. Only accepted while no other command is outstanding.
+#define SPI_TRAIN_MODE_QUERY 0
+#define SPI_TRAIN_MODE_RUN 1
+#define SPI_TRAIN_RESPONSE_SIZE 7
+
+// Optional second argument of sensor read commands, bypasses the sensor snapshot cache
+#define CMD_ARG_FORCE_LIVE 0x01
+
+// Argument Schema: How args[0] is validated before the handler is called
+typedef enum CMD_ARG_SCHEMA{
+    CMD_ARGS_NONE,          // No required arguments
+    CMD_ARGS_CURR_SENSOR,   // args[0] = Current Sensor Index (1 - 3)
+    CMD_ARGS_TEMP_SENSOR    // args[0] = Temperature Sensor Index (1 - 4)
+}CMD_ARG_SCHEMA;
+
+typedef struct {
+    uint8_t cmd;                                    // Command byte being serviced
+    const uint8_t *args;                            // Command arguments
+    int nargs;                                      // Index of the last argument (As returned by 'cmd_extracter')
+    uint8_t addr;                                   // Sensor I2C address decoded by the argument schema
+    uint8_t param;                                  // Per-command parameter from the table entry
+    int spi_dev;                                    // SPI device, only valid for CMD_FLAG_DIRECT_IO handlers
+    struct gpiod_line_request **spi_cs_request;     // SPI chip select, only valid for CMD_FLAG_DIRECT_IO handlers
+} cmd_request_t;
+
+// Handlers fill 'response' (response[0] = CMD_RETURN is set by the dispatcher) and set 'responseLen'.
+// Returns the error code of the operation, used for the per-command error counter.
+typedef enum IRIS_ERROR (*cmd_handler_t)(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen);
+
+typedef struct {
+    cmd_handler_t handler;          // NULL if the command is not registered
+    enum CMD_ARG_SCHEMA schema;     // Validation applied to args[0]
+    uint8_t param;                  // Passed to the handler, lets one handler serve several commands
+    uint8_t flags;                  // CMD_FLAG_*
+    uint16_t maxResponse;           // Max number of response bytes, must be <= CMD_RESPONSE_MAX_LEN
+} cmd_entry_t;
+
+// Called once with the outcome of a bulk transfer, true only if every byte reached the OBC
+typedef void (*cmd_bulk_done_t)(bool delivered);
+
+typedef struct {
+    int fd;                         // File streamed after the response, -1 if none
+    uint64_t len;                   // Number of bytes to stream from the start of the file
+    cmd_bulk_done_t done;           // Delivery callback, NULL if the handler does not need it
+} cmd_bulk_t;
+
+typedef struct {
+    uint32_t count;                 // Number of times the command was dispatched
+    uint32_t errors;                // Number of times the handler returned an error
+    uint64_t totalNs;               // Total handler execution time
+    uint64_t maxNs;                 // Longest handler execution time
+} cmd_stats_t;
 
 uint8_t cmd_to_current_addr(uint8_t arg);
 uint8_t cmd_to_temp_addr(uint8_t arg);
 enum IRIS_ERROR current_val_error_16bit_to_8bit(enum IRIS_ERROR error);
+bool cmd_force_live(const uint8_t *args, int nargs);
 
 enum IRIS_ERROR cmd_return(int spi_dev, struct gpiod_line_request **spi_cs_request, uint8_t *buffer, uint8_t numWrites);
 
+void cmd_controller_init(struct gpiod_line_request *gpio_request);
+enum IRIS_ERROR cmd_register(uint8_t cmd, const cmd_entry_t *entry);
+const cmd_entry_t *cmd_lookup(uint8_t cmd);
+void cmd_stats_get(uint8_t cmd, cmd_stats_t *stats);
+void cmd_bulk_attach(int fd, uint64_t len);
+void cmd_bulk_on_done(cmd_bulk_done_t done);
+bool cmd_bulk_take(cmd_bulk_t *bulk);
+
+enum IRIS_ERROR cmd_execute(uint8_t cmd, const uint8_t *args, int nargs, int spi_dev, struct gpiod_line_request **spi_cs_request, uint8_t *response, uint16_t *responseLen);
+enum IRIS_ERROR cmd_dispatch(uint8_t cmd, const uint8_t *args, int nargs, int spi_dev, struct gpiod_line_request **spi_cs_request, uint8_t *response, uint16_t *responseLen);
+enum IRIS_ERROR cmd_batch_execute(const uint8_t *frame, uint16_t frameLen, uint8_t *reply, uint16_t *replyLen);
+enum IRIS_ERROR cmd_batch_center(const uint8_t *frame, uint16_t frameLen, int spi_dev, struct gpiod_line_request **spi_cs_request);
 enum IRIS_ERROR cmd_center(uint8_t cmd, uint8_t *args, int nargs, int spi_dev, struct gpiod_line_request **spi_cs_request);
 int cmd_extracter(uint8_t *cmd, uint8_t *arg, const uint8_t *rx_buffer, uint8_t rx_len);
 
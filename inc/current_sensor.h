@@ -194,7 +194,8 @@ uint16_t read_current(uint8_t currAddr);
 uint16_t read_power(uint8_t currAddr);
 uint16_t read_bus_voltage(uint8_t currAddr);
 uint16_t read_pk_power(uint8_t currAddr);
-void current_limit(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount);
+void current_limit(enum IRIS_ERROR *limitErrors, uint8_t *numLimitErrors);
+void current_limit_check(const uint16_t *current, enum IRIS_ERROR *limitErrors, uint8_t *numLimitErrors);
 
 
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef ERROR_HANDLER_H
 #define ERROR_HANDLER_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -21,7 +22,30 @@
 // #define TMP_CFG2_ERROR_FLG    2
 // #define TMP_DIODE_ERROR_FLG   3
 
-#define ERROR_BUFFER_SIZE 256
+// Error Aggregation: Every error is counted against its code instead of being queued once per
+// occurrence, so a fault repeating every housekeeping cycle holds one table slot. Counts are only
+// removed once the OBC has received them (See 'error_summary_ack').
+#define ERROR_TABLE_SIZE            256     // Slots (power of 2), more than the number of IRIS_ERROR codes
+#define ERROR_SUMMARY_MAX_ENTRIES   64      // Codes per summary, the remaining codes follow in the next summary
+
+// Error Summary (ERROR_TRANSFER frame, multi-byte fields MSB first)
+//  Frame: [ERROR_TRANSFER, numEntries, dropped u16, {code u16, count u16, first u32, last u32} x numEntries]
+//  'count' saturates at 0xFFFF, the rest is reported in a later summary. 'first' / 'last' are the Unix
+//  seconds of the oldest and newest unreported occurrence. 'dropped' counts occurrences of codes that
+//  found the table full.
+#define ERROR_SUMMARY_HEADER_SIZE   4
+#define ERROR_SUMMARY_ENTRY_SIZE    12
+#define ERROR_SUMMARY_MAX_LEN       (ERROR_SUMMARY_HEADER_SIZE + (ERROR_SUMMARY_MAX_ENTRIES * ERROR_SUMMARY_ENTRY_SIZE))
+
+// Error History: <LOG_DIRECTORY>/Iris_Errors.tbl, the table is written to a MAP_SHARED file after
+// every change so unreported errors survive a crash, restart or watchdog reset. The file holds two
+// copies, an update overwrites the older copy and stamps it with the next sequence number and a
+// CRC-32, so a write torn by a crash leaves the other copy intact. On start the valid copy with the
+// highest sequence number is restored.
+#define ERROR_HISTORY_FILENAME      "Iris_Errors.tbl"
+#define ERROR_HISTORY_MAGIC         0x52455249      // "IRER"
+#define ERROR_HISTORY_VERSION       1
+#define ERROR_HISTORY_NUM_COPIES    2
 
 typedef enum IRIS_ERROR{
     NO_ERROR,
@@ -90,10 +114,80 @@ typedef enum IRIS_ERROR{
 
     LINUX_CLI_ERROR,
     IPC_ERROR,
-    ERROR_TRANSFER_FAIL
+    ERROR_TRANSFER_FAIL,
+
+    TELEM_PACK_ERROR,
+    TELEM_UNPACK_ERROR,
+
+    CMD_UNSUPPORTED_ERROR,
+    CMD_BATCH_OVERFLOW_ERROR,
+
+    JOB_ENGINE_ERROR,
+    JOB_QUEUE_FULL_ERROR,
+    JOB_ID_ERROR,
+    JOB_PENDING_ERROR,
+    JOB_CANCELLED_ERROR,
+
+    IPC_RING_FULL_ERROR,
+    IPC_BUSY_ERROR,
+    IPC_FD_ERROR,
+
+    LOG_EXPORT_ERROR,
+
+    FLIGHT_RECORDER_ERROR,
+
+    CLOCK_SYNC_ERROR,
+
+    TRACE_ERROR,
+
+    METRICS_ERROR,
+
+    ERROR_HISTORY_ERROR,
+
+    RT_PROFILE_ERROR
         
 } IRIS_ERROR;
 
-//enum IRIS_ERROR iris_error_transfer(int spi_dev, struct gpiod_line_request *spi_cs_request, const enum IRIS_ERROR *errorBuffer, uint8_t *errorCount);
+typedef struct {
+    uint16_t code;          // IRIS_ERROR, NO_ERROR if the slot is unused
+    uint16_t reserved;
+    uint32_t count;         // Occurrences not yet received by the OBC
+    uint32_t firstS;        // Unix seconds of the oldest unreported occurrence
+    uint32_t lastS;         // Unix seconds of the newest occurrence
+} error_entry_t;
+
+typedef struct {
+    uint32_t dropped;                           // Occurrences of codes that found the table full, not yet reported
+    uint32_t summaryStart;                      // Slot the next summary starts from, so every code gets its turn
+    error_entry_t entries[ERROR_TABLE_SIZE];
+} error_table_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t tableSize;         // ERROR_TABLE_SIZE
+    uint32_t seq;               // Incremented on every update, written to copy (seq % ERROR_HISTORY_NUM_COPIES)
+    uint32_t crc;               // CRC-32 of the fields above and 'table'
+    error_table_t table;
+} error_history_copy_t;
+
+// Counts carried by a summary, subtracted from the table once the OBC has received it
+typedef struct {
+    uint8_t numEntries;
+    uint16_t dropped;
+    uint16_t codes[ERROR_SUMMARY_MAX_ENTRIES];
+    uint16_t counts[ERROR_SUMMARY_MAX_ENTRIES];
+} error_summary_t;
+
+struct gpiod_line_request;
+
+void error_record(enum IRIS_ERROR error);
+uint16_t error_summary(uint8_t *frame, error_summary_t *summary);
+void error_summary_ack(const error_summary_t *summary);
+enum IRIS_ERROR error_history_init(void);
+void error_history_sync(void);
+
+enum IRIS_ERROR iris_error_transfer(int spi_dev, struct gpiod_line_request *spi_cs_request, const uint8_t *frame, uint16_t frameLen, bool *sent);
+enum IRIS_ERROR iris_error_report(int spi_dev, struct gpiod_line_request *spi_cs_request);
 
 #endif //ERROR_HANDLER
\ No newline at end of file
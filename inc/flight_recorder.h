@@ -0,0 +1,72 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include "error_handler.h"
+
+#include <stdint.h>
+
+// Flight Recorder: <LOG_DIRECTORY>/<base>.rec, a fixed-size ring of binary events in a MAP_SHARED
+// file. Events live in the page cache as soon as they are written, so the ring survives a crash of
+// the service. On start the previous session's ring is kept as <base>_prev.rec for downlink
+// (FLIGHT_DUMP) and decoding on the ground ('flight_decode').
+#define FLIGHT_MAGIC            0x52465249      // "IRFR"
+#define FLIGHT_VERSION          1
+#define FLIGHT_NUM_ENTRIES      4096            // Must be a power of 2, 4096 x 32 bytes = 128kB ring
+#define FLIGHT_BASENAME         "Iris_Flight"
+#define FLIGHT_SPI_BASENAME     "Iris_Spi_Flight"
+#define FLIGHT_PREV_SUFFIX      "_prev"
+#define FLIGHT_MEMFD_NAME       "theia_flight_dump"
+#define FLIGHT_FILE_SIZE        (sizeof(flight_header_t) + (FLIGHT_NUM_ENTRIES * sizeof(flight_entry_t)))
+
+// FLIGHT_DUMP command flags (args[0])
+#define FLIGHT_DUMP_FLAG_PREVIOUS   (1 << 0)    // Dump the previous session's ring instead of the live ring
+#define FLIGHT_DUMP_FLAG_SPI        (1 << 1)    // Dump the SPI service's ring instead of the Main service's ring
+#define FLIGHT_DUMP_FLAG_SIZE_ONLY  (1 << 2)    // Report the size without transferring anything
+
+// Records the source file and line of a fatal error, call before exit(EXIT_FAILURE)
+#define FLIGHT_FATAL() flight_record_fatal(__FILE__, __LINE__)
+
+typedef enum FLIGHT_EVENT{
+    FLIGHT_EVENT_NONE,
+    FLIGHT_BOOT,            // code = FLIGHT_VERSION, args = {pid, session}
+    FLIGHT_EXIT,            // Normal exit through atexit
+    FLIGHT_FATAL,           // args = {first 12 characters of the source file name, line}
+    FLIGHT_SIGNAL,          // code = signal, args = {si_code, fault address low, fault address high}
+    FLIGHT_CMD_START,       // code = command, args = {nargs, args[0]}
+    FLIGHT_CMD_DONE,        // code = command, args = {error, duration us}
+    FLIGHT_SPI_READ,        // code = error, args = {length, ioctl return, duration ns, retries}
+    FLIGHT_SPI_WRITE,       // code = error, args = {length, ioctl return, duration ns, retries}
+    FLIGHT_I2C_ERROR,       // code = error, args = {operation, length, return, errno}
+    FLIGHT_SPI_RECOVER,     // code = error, args = {tier, recovery error, errno, duration us}
+    FLIGHT_SPI_TRAIN,       // code = error, args = {selected Hz, fastest passing Hz, bit errors at selected, duration ms}
+    FLIGHT_NUM_EVENTS
+}FLIGHT_EVENT;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entrySize;
+    uint32_t numEntries;
+    uint32_t session;           // Incremented every time the service starts
+    uint64_t bootRealtimeNs;    // CLOCK_REALTIME and CLOCK_MONOTONIC sampled together at start, converts
+    uint64_t bootMonotonicNs;   // entry timestamps to wall time on the ground
+    uint64_t writePos;          // Total number of entries claimed, the next entry is (writePos % numEntries)
+    uint32_t pid;
+    uint32_t reserved[5];
+} flight_header_t;
+
+typedef struct {
+    uint64_t timestampNs;       // CLOCK_MONOTONIC
+    uint32_t seq;               // Low 32 bits of (position + 1) once complete, 0 while being written
+    uint16_t event;             // FLIGHT_EVENT
+    uint16_t code;
+    uint32_t args[4];
+} flight_entry_t;
+
+enum IRIS_ERROR flight_recorder_init(const char *baseName);
+void flight_record(uint16_t event, uint16_t code, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+void flight_record_fatal(const char *file, int line);
+void flight_recorder_sync(void);
+enum IRIS_ERROR flight_recorder_dump(uint8_t flags, int *fd, uint32_t *size);
+
+#endif //FLIGHT_RECORDER_H
@@ -21,5 +21,7 @@ enum IRIS_ERROR i2c_write_reg16(int fileDesc, int writeNum, const uint8_t *reg,
 enum IRIS_ERROR i2c_read_reg16 (int fileDesc, int readNum, uint16_t *data);
 enum IRIS_ERROR i2c_reg16_write_read (int fileDesc, uint8_t *reg, int readNum, uint16_t *data);
 int i2c_close(int fileDesc);
+void i2c_bus_lock(void);
+void i2c_bus_unlock(void);
 
 #endif //I2C_H
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef IPC_FD_H
+#define IPC_FD_H
+
+#include "ipc_iris.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Bulk Data Side Channel: Main service hands open file descriptors to the SPI service over a
+// Unix domain socket (SCM_RIGHTS), the data itself never passes through the IPC ring
+#define IPC_FD_SOCKET_NAME      "theia_ipc_fd"      // Abstract namespace, no file left behind
+#define IPC_FD_MEMFD_NAME       "theia_bulk"
+#define IPC_FD_LEN_TO_END       UINT64_MAX          // Transfer from 'offset' to the end of the file
+
+// Doorbell: The SPI service sleeps in poll() on the CS line and a second socket, the Main service
+// sends one byte to it after queueing a record the SPI service is waiting for (See 'ipc_ring_wait_begin')
+#define IPC_FD_DOORBELL_NAME    "theia_ipc_doorbell" // Abstract namespace
+
+// Transfer descriptor sent alongside the file descriptor
+typedef struct {
+    uint32_t requestId;         // Request the data answers, IPC_REQUEST_ID_NONE if unsolicited
+    uint32_t flags;
+    uint64_t offset;            // First byte of the file to transfer
+    uint64_t len;               // Number of bytes to transfer, or IPC_FD_LEN_TO_END
+} ipc_fd_msg_t;
+
+typedef struct {
+    int fd;                     // Received file descriptor, owned by the receiver
+    ipc_fd_msg_t msg;
+} ipc_fd_transfer_t;
+
+enum IRIS_ERROR ipc_fd_open(ipc_link_t *link, enum IPC_SIDE side);
+void ipc_fd_close(ipc_link_t *link);
+
+enum IRIS_ERROR ipc_fd_send(ipc_link_t *link, uint32_t requestId, int fd, uint64_t offset, uint64_t len);
+enum IRIS_ERROR ipc_fd_send_file(ipc_link_t *link, uint32_t requestId, const char *file_path);
+enum IRIS_ERROR ipc_fd_send_buffer(ipc_link_t *link, uint32_t requestId, const uint8_t *data, uint64_t len);
+bool ipc_fd_receive(ipc_link_t *link, ipc_fd_transfer_t *transfer);
+void ipc_fd_doorbell_ring(ipc_link_t *link);
+void ipc_fd_doorbell_clear(ipc_link_t *link);
+
+#endif //IPC_FD_H
@@ -1,6 +1,10 @@
 #ifndef IPC_IRIS_H
 #define IPC_IRIS_H
 
+#include "ipc_ring.h"
+
+#include <stdbool.h>
+#include <stdint.h>
 #include <sys/ipc.h>
 #include <sys/msg.h>
 
@@ -14,7 +18,9 @@ typedef enum IPC_LABEL{
     ERROR_SPI_TO_MAIN = 2,
 
     CMD_MAIN_TO_SPI = 3,
-    CMD_SPI_TO_MAIN = 4
+    CMD_SPI_TO_MAIN = 4,
+
+    BULK_SPI_TO_MAIN = 5        // Outcome of a bulk transfer, payload [IRIS_ERROR]
 
 }IPC_LABEL;
 
@@ -24,7 +30,53 @@ struct msg_buffer {
     uint8_t msg_text[MSG_SIZE];
 };
 
-enum IRIS_ERROR iris_error_transfer_spi_service(int ipcMsgID, const enum IRIS_ERROR *errorBuffer, uint8_t *errorCount);
+// Request Tracking (SPI Service): Commands forwarded to the Main service that are waiting for a response
+#define IPC_MAX_IN_FLIGHT       16
+#define IPC_REQUEST_TIMEOUT_MS  10000   // Requests without a response after this time are dropped
+#define IPC_SETUP_RETRY_MS      1000    // Delay between attempts to set up a failed link
+#define IPC_MAX_BUSY_REPLIES    32      // Commands turned away that can wait for their IPC_BUSY_ERROR response
+
+typedef struct {
+    uint32_t requestId;         // IPC_REQUEST_ID_NONE if the slot is free
+    uint64_t sentMs;            // Monotonic time the request was forwarded
+} ipc_request_t;
+
+typedef enum IPC_SIDE{
+    IPC_SIDE_MAIN,
+    IPC_SIDE_SPI
+}IPC_SIDE;
+
+// Connection between the SPI and Main services over the shared memory rings
+typedef struct {
+    ipc_ring_region_t *region;
+    ipc_ring_t txRing;          // Records sent by this service
+    ipc_ring_t rxRing;          // Records received from the other service
+    int fdSocket;               // Unix domain socket used to pass bulk data file descriptors (See 'ipc_fd.h')
+    int doorbellSocket;         // SPI: Readable when the Main service queued a response, -1 on the Main side
+    uint32_t nextRequestId;     // Next request ID assigned by this service
+    ipc_request_t inFlight[IPC_MAX_IN_FLIGHT];  // SPI: Forwarded commands waiting for a response
+    uint8_t numInFlight;
+    uint32_t busyReplies[IPC_MAX_BUSY_REPLIES]; // SPI: Request IDs of commands turned away that still need an IPC_BUSY_ERROR response
+    uint8_t busyHead;           // SPI: Oldest entry of busyReplies
+    uint8_t numBusyReplies;
+    uint32_t bulkDoneId;        // Main: Request ID of the bulk transfer 'bulkDone' waits for
+    void (*bulkDone)(bool delivered);   // Main: Delivery callback of that transfer (See 'cmd_bulk_on_done'), NULL if none
+    uint32_t errorReportId;     // Main: Request ID of the error report waiting to be acknowledged
+    bool ackReceived;           // Main: Error transfer acknowledgement arrived
+    uint8_t ackStatus;          // Main: Error code of the acknowledged error transfer
+} ipc_link_t;
+
+enum IRIS_ERROR ipc_link_setup(ipc_link_t *link, enum IPC_SIDE side);
+uint32_t ipc_request_id_next(ipc_link_t *link);
+enum IRIS_ERROR ipc_request_track(ipc_link_t *link, uint32_t requestId);
+bool ipc_request_complete(ipc_link_t *link, uint32_t requestId);
+uint8_t ipc_request_expire(ipc_link_t *link);
+bool ipc_request_available(ipc_link_t *link);
+bool ipc_busy_reply_queue(ipc_link_t *link, uint32_t requestId);
+bool ipc_busy_reply_due(ipc_link_t *link);
+void ipc_busy_reply_pop(ipc_link_t *link);
+enum IRIS_ERROR ipc_main_service_commands(ipc_link_t *link);
+enum IRIS_ERROR iris_error_transfer_spi_service(ipc_link_t *link);
 enum IRIS_ERROR ipc_setup(key_t *key, int *msgid);
 
-#endif //IPC_IRIS_H
\ No newline at end of file
+#endif //IPC_IRIS_H
@@ -0,0 +1,77 @@
+#ifndef IPC_RING_H
+#define IPC_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define IPC_RING_SHM_NAME       "/theia_ipc_ring"
+#define IPC_RING_MAGIC          0x49524734  // "IRG4", bump when the shared layout changes
+#define IPC_RING_CACHE_LINE     64
+#define IPC_RING_DATA_SIZE      (256 * 1024)                // Must be a power of 2
+#define IPC_RING_DATA_MASK      (IPC_RING_DATA_SIZE - 1)
+#define IPC_RING_MAX_RECORD     (IPC_RING_DATA_SIZE / 2)    // Largest payload a single record can carry
+#define IPC_RING_RECORD_ALIGN   8
+#define IPC_RING_LABEL_PAD      0xFFFF                      // Fills the end of the ring when a record wraps
+#define IPC_REQUEST_ID_NONE     0
+#define IPC_RING_FLAG_BULK      (1 << 0)                    // Bulk data for the same request ID waits on the side channel (See 'ipc_fd.h')
+
+// Record Header, payload follows and the record is padded to IPC_RING_RECORD_ALIGN
+typedef struct {
+    uint32_t len;       // Payload length in bytes
+    uint16_t label;     // IPC_LABEL of the record
+    uint16_t flags;     // IPC_RING_FLAG_*
+    uint32_t requestId; // Correlates a response with its request, IPC_REQUEST_ID_NONE if unused
+    uint32_t reserved;
+    uint64_t timestampNs; // CLOCK_MONOTONIC time attached by the producer (CS edge of an OBC command), 0 if unused
+} ipc_ring_record_t;
+
+// Single Producer / Single Consumer ring, lives in shared memory.
+// 'head' and 'tail' are free running byte counters, each written by one side only and kept on
+// separate cache lines so the producer and consumer never share a line.
+// 'seq' is a futex word bumped on every commit, the producer only makes the wake syscall when
+// the consumer has registered itself in 'waiters'.
+typedef struct {
+    _Alignas(IPC_RING_CACHE_LINE) uint32_t head;    // Written by producer
+    uint32_t seq;                                   // Written by producer
+    _Alignas(IPC_RING_CACHE_LINE) uint32_t tail;    // Written by consumer
+    uint32_t waiters;                               // Written by consumer
+    _Alignas(IPC_RING_CACHE_LINE) uint8_t data[IPC_RING_DATA_SIZE];
+} ipc_ring_shm_t;
+
+// Shared region mapped by both services, one ring per direction
+typedef struct {
+    uint32_t magic;
+    ipc_ring_shm_t spiToMain;   // OBC commands, error transfer acknowledgements
+    ipc_ring_shm_t mainToSpi;   // Command responses, error reports
+} ipc_ring_region_t;
+
+// Process local handle of one side of a ring
+typedef struct {
+    ipc_ring_shm_t *shm;
+    ipc_ring_record_t *reserved;    // Producer: record returned by 'ipc_ring_reserve', NULL if none
+    uint32_t reserveHead;           // Producer: head position of the reserved record
+    uint32_t releaseTail;           // Consumer: tail position after the peeked record
+    const ipc_ring_record_t *peeked;// Consumer: record returned by 'ipc_ring_peek', NULL if none
+} ipc_ring_t;
+
+enum IRIS_ERROR ipc_ring_region_map(ipc_ring_region_t **region);
+void ipc_ring_region_unmap(ipc_ring_region_t *region);
+void ipc_ring_attach(ipc_ring_t *ring, ipc_ring_shm_t *shm);
+
+void *ipc_ring_reserve(ipc_ring_t *ring, uint16_t label, uint32_t requestId, uint32_t len);
+void ipc_ring_commit(ipc_ring_t *ring, uint32_t len);
+void ipc_ring_set_timestamp(ipc_ring_t *ring, uint64_t timestampNs);
+void ipc_ring_set_flags(ipc_ring_t *ring, uint16_t flags);
+const void *ipc_ring_peek(ipc_ring_t *ring, uint16_t *label, uint32_t *requestId, uint32_t *len);
+uint64_t ipc_ring_timestamp(const ipc_ring_t *ring);
+uint16_t ipc_ring_flags(const ipc_ring_t *ring);
+void ipc_ring_release(ipc_ring_t *ring);
+
+enum IRIS_ERROR ipc_ring_send(ipc_ring_t *ring, uint16_t label, uint32_t requestId, const void *data, uint32_t len);
+bool ipc_ring_empty(ipc_ring_t *ring);
+bool ipc_ring_wait(ipc_ring_t *ring, uint32_t timeoutMs);
+void ipc_ring_wait_begin(ipc_ring_t *ring);
+void ipc_ring_wait_end(ipc_ring_t *ring);
+bool ipc_ring_has_waiters(ipc_ring_t *ring);
+
+#endif //IPC_RING_H
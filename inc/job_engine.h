@@ -0,0 +1,54 @@
+#ifndef JOB_ENGINE_H
+#define JOB_ENGINE_H
+
+#include "cmd_controller.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Worker Pool / Queue Sizing
+#define JOB_NUM_WORKERS         2
+#define JOB_QUEUE_DEPTH         8       // Max number of jobs waiting for a worker
+#define JOB_TABLE_SIZE          16      // Max number of jobs tracked (queued + running + finished results)
+#define JOB_MAX_ARGS            32
+#define JOB_ID_INVALID          0
+
+// Submit Reply: [CMD_RETURN, NO_ERROR, Job ID MSB, Job ID LSB]
+#define JOB_SUBMIT_RESPONSE_SIZE 4
+// Status Reply: [CMD_RETURN, error, state, progress (%)]
+#define JOB_STATUS_RESPONSE_SIZE 4
+
+typedef enum JOB_STATE{
+    JOB_FREE      = 0,
+    JOB_QUEUED    = 1,
+    JOB_RUNNING   = 2,
+    JOB_DONE      = 3,
+    JOB_CANCELLED = 4
+}JOB_STATE;
+
+typedef struct {
+    uint16_t id;
+    enum JOB_STATE state;
+    uint8_t cmd;
+    uint8_t args[JOB_MAX_ARGS];
+    int nargs;
+    uint8_t progress;                           // 0 - 100 %
+    bool cancelRequested;
+    uint8_t response[CMD_RESPONSE_MAX_LEN];     // Response frame of the command once finished
+    uint16_t responseLen;
+    uint64_t finishedMs;                        // Monotonic time the job finished, used to evict old results
+} job_t;
+
+enum IRIS_ERROR job_engine_init(void);
+void job_engine_shutdown(void);
+bool job_engine_running(void);
+
+enum IRIS_ERROR job_submit(uint8_t cmd, const uint8_t *args, int nargs, uint16_t *jobId);
+enum IRIS_ERROR job_status(uint16_t jobId, enum JOB_STATE *state, uint8_t *progress);
+enum IRIS_ERROR job_result(uint16_t jobId, uint8_t *response, uint16_t *responseLen);
+enum IRIS_ERROR job_cancel(uint16_t jobId);
+
+void job_progress(uint8_t percent);
+bool job_cancel_requested(void);
+
+#endif //JOB_ENGINE_H
@@ -0,0 +1,100 @@
+#ifndef LOG_CATALOG_H
+#define LOG_CATALOG_H
+
+#include "logger.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary Log Message Catalog
+//  Every LOG_RECORD call site refers to a message in this table, the log only stores the message
+//  ID, timestamp and raw argument values. Text is produced from the format when a human reads the
+//  log (See 'tools/log_decode.c').
+//  - Append new messages at the end, never reorder or reuse an ID (old logs decode by ID)
+//  - Formats may only use int sized conversions (%d, %u, %x, %c), up to LOG_RECORD_MAX_ARGS
+//  - LOGID_TEXT carries free-form 'log_write' messages in the binary log
+#define LOG_CATALOG(X) \
+    X(LOGID_TEXT,                    LOG_INFO,    "%s")                                                                                              \
+    X(LOGID_CURR_SETUP_BEGIN,        LOG_INFO,    "CURRENT-SENSOR-SETUP: Begin functional verification of Current Sensor 0x%02x")                    \
+    X(LOGID_CURR_I2C_OPEN_FAIL,      LOG_ERROR,   "Current Sensor 0x%02x - I2C Bus Failed to Open")                                                  \
+    X(LOGID_CURR_I2C_WRITE_FAIL,     LOG_ERROR,   "Current Sensor 0x%02x - I2C Reg 0x%02x Write Failed")                                             \
+    X(LOGID_CURR_SETUP_DONE,         LOG_INFO,    "CURRENT-SENSOR-SETUP: Completed attempt for setup of Current Monitor Sensor 0x%02x")              \
+    X(LOGID_CURR_VALIDATE_BEGIN,     LOG_INFO,    "CURRENT-FUNC-VALIDATE: Begin functional verification of Current Sensor 0x%02x")                   \
+    X(LOGID_CURR_I2C_READ_FAIL,      LOG_ERROR,   "Current Sensor 0x%02x - I2C Reg 0x%02x Read Failed")                                              \
+    X(LOGID_CURR_REG_MISMATCH,       LOG_ERROR,   "Current Sensor 0x%02x - I2C Reg 0x%02x Value Incorrect 0x%02x")                                   \
+    X(LOGID_CURR_VALIDATE_DONE,      LOG_INFO,    "CURRENT-FUNC-VALIDATE: Completed attempt for functional verification of Current Sensor 0x%02x")   \
+    X(LOGID_CURR_RESET_TRIG_BEGIN,   LOG_INFO,    "CURRENT-SENSOR-RESET-TRIG: Begin triggering reset of Current Sensor 0x%02x")                      \
+    X(LOGID_CURR_RESET_TRIG_DONE,    LOG_INFO,    "CURRENT-SENSOR-RESET-TRIG: Successfully triggered reset of Current Sensor 0x%02x")                \
+    X(LOGID_CURR_RESET_BEGIN,        LOG_INFO,    "CURRENT-SENSOR-RESET: Begin reset of Current Sensor 0x%02x")                                      \
+    X(LOGID_CURR_RESET_DONE,         LOG_INFO,    "CURRENT-SENSOR-RESET: Finished reset attempt of Current Sensor 0x%02x")                           \
+    X(LOGID_CURR_READ_CURRENT,       LOG_INFO,    "BUS-CURR: Measured a Current of %umA from Sensor 0x%02x")                                         \
+    X(LOGID_CURR_READ_POWER,         LOG_INFO,    "BUS-PWR: Measured a Power of %umW from Sensor 0x%02x")                                            \
+    X(LOGID_CURR_READ_PK_POWER,      LOG_INFO,    "BUS-PK-PWR: Measured a Peak Power of %umW from Sensor 0x%02x")                                    \
+    X(LOGID_CURR_READ_VOLTAGE,       LOG_INFO,    "BUS-VOLT: Measured a Bus Voltage of %umV from Sensor 0x%02x")                                     \
+    X(LOGID_CURR_LIMIT_3V3,          LOG_WARNING, "CURR-LIMIT: 3V3 Current Limit Reached - Measured %umA")                                           \
+    X(LOGID_CURR_LIMIT_5V,           LOG_WARNING, "CURR-LIMIT: CM4 Current Limit Reached - Measured %umA")                                           \
+    X(LOGID_CURR_LIMIT_CAM,          LOG_WARNING, "CURR-LIMIT: Camera Current Limit Reached - Measured %umA")                                        \
+    X(LOGID_TEMP_SETUP_BEGIN,        LOG_INFO,    "TEMP-SETUP: Begin setup of Temperature Sensor 0x%02x")                                            \
+    X(LOGID_TEMP_I2C_OPEN_FAIL,      LOG_ERROR,   "Temp Sensor 0x%02x - I2C Bus Failed to Open")                                                     \
+    X(LOGID_TEMP_I2C_WRITE_FAIL,     LOG_ERROR,   "Temp Sensor 0x%02x - I2C Reg 0x%02x Write Failed")                                                \
+    X(LOGID_TEMP_SETUP_DONE,         LOG_INFO,    "TEMP-SETUP: Completed attempt for setup of Temperature Sensor 0x%02x")                            \
+    X(LOGID_TEMP_VALIDATE_BEGIN,     LOG_INFO,    "TEMP-FUNC-VALIDATE: Begin functional verification of Temperature Sensor 0x%02x")                  \
+    X(LOGID_TEMP_I2C_READ_FAIL,      LOG_ERROR,   "Temp Sensor 0x%02x - I2C Reg 0x%02x Read Failed")                                                 \
+    X(LOGID_TEMP_REG_MISMATCH,       LOG_ERROR,   "Temp Sensor 0x%02x - I2C Reg 0x%02x Value Incorrect 0x%02x")                                      \
+    X(LOGID_TEMP_OPEN_CIRCUIT,       LOG_ERROR,   "Temp Sensor 0x%02x - Open Circuit Flag Asserted in Reg 0x%02x")                                   \
+    X(LOGID_TEMP_LOW_SUPPLY,         LOG_ERROR,   "Temp Sensor 0x%02x - Low Supply Voltage Flag Asserted in Reg 0x%02x")                             \
+    X(LOGID_TEMP_VALIDATE_DONE,      LOG_INFO,    "TEMP-FUNC-VALIDATE: Completed attempt for functional verification of Temperature Sensor 0x%02x")  \
+    X(LOGID_TEMP_RESET_TRIG_BEGIN,   LOG_INFO,    "TEMP-RESET-TRIG: Begin trigger reset of Temperature Sensor 0x%02x")                               \
+    X(LOGID_TEMP_RESET_TRIG_DONE,    LOG_INFO,    "TEMP-RESET-TRIG: Successfully triggered reset trigger of Temperature Sensor 0x%02x")              \
+    X(LOGID_TEMP_RESET_BEGIN,        LOG_INFO,    "TEMP-SENSOR-RESET: Begin reset of Temperature Sensor 0x%02x")                                     \
+    X(LOGID_TEMP_RESET_DONE,         LOG_INFO,    "TEMP-SENSOR-RESET: Finished reset attempt of Temperature Sensor 0x%02x")                          \
+    X(LOGID_TEMP_LIMIT,              LOG_WARNING, "TEMP-LIMIT: Temperature %u Limit Reached - Measured %dC")                                         \
+    X(LOGID_TEMP_I2C_TEMP_READ_FAIL, LOG_ERROR,   "Temp Sensor 0x%02x - I2C Temperature Reg 0x%02x Read Failed")                                     \
+    X(LOGID_TEMP_READ,               LOG_INFO,    "TEMP-READ: Read Temperature of %dC from Sensor 0x%02x")                                           \
+    X(LOGID_USB_SETUP_BEGIN,         LOG_INFO,    "USB-HUB-SETUP: Begin setup of USB Hub 0x%02x")                                                    \
+    X(LOGID_USB_I2C_OPEN_FAIL,       LOG_ERROR,   "USB Hub 0x%02x - I2C Bus Failed to Open")                                                         \
+    X(LOGID_USB_I2C_WRITE_FAIL,      LOG_ERROR,   "USB Hub 0x%02x - I2C Reg 0x%02x Write Failed")                                                    \
+    X(LOGID_USB_SETUP_DONE,          LOG_INFO,    "USB-HUB-SETUP: Completed attempt for setup of USB Hub 0x%02x")                                    \
+    X(LOGID_USB_VALIDATE_BEGIN,      LOG_INFO,    "USB-HUB-FUNC-VALIDATE: Begin functional verification of USB Hub 0x%02x")                          \
+    X(LOGID_USB_I2C_READ_FAIL,       LOG_ERROR,   "USB Hub 0x%02x - I2C Reg 0x%02x Read Failed")                                                     \
+    X(LOGID_USB_REG_MISMATCH,        LOG_ERROR,   "USB Hub 0x%02x - I2C Reg 0x%02x Value Incorrect 0x%02x")                                          \
+    X(LOGID_USB_VALIDATE_DONE,       LOG_INFO,    "USB-HUB-FUNC-VALIDATE: Completed attempt for functional verification of USB Hub 0x%02x")          \
+    X(LOGID_USB_RESET_BEGIN,         LOG_INFO,    "USB-HUB-RESET: Begin reset of USB Hub 0x%02x")                                                    \
+    X(LOGID_USB_RESET_DONE,          LOG_INFO,    "USB-HUB-RESET: Successful reset trigger of USB Hub 0x%02x")
+
+typedef enum LOG_MSG_ID{
+#define LOG_CATALOG_ID(id, logLev, format) id,
+    LOG_CATALOG(LOG_CATALOG_ID)
+#undef LOG_CATALOG_ID
+    LOG_MSG_COUNT
+}LOG_MSG_ID;
+
+// Level of every message as a constant, '<id>_LEVEL', so LOG_RECORD can compile out disabled levels
+enum LOG_MSG_LEVEL{
+#define LOG_CATALOG_LEVEL(id, logLev, format) id##_LEVEL = logLev,
+    LOG_CATALOG(LOG_CATALOG_LEVEL)
+#undef LOG_CATALOG_LEVEL
+};
+
+typedef struct {
+    enum LOG_LEVEL logLev;
+    const char *name;
+    const char *format;
+} log_catalog_entry_t;
+
+extern const log_catalog_entry_t logCatalog[LOG_MSG_COUNT];
+
+// Logs a catalog message with up to LOG_RECORD_MAX_ARGS integer arguments, e.g.
+//  LOG_RECORD(LOGID_CURR_READ_CURRENT, current, currAddr);
+// Messages below LOG_COMPILE_LEVEL generate no code, 'msgId' must be a LOGID_ name.
+#define LOG_RECORD(msgId, ...) do { \
+    if (LOG_LEVEL_ENABLED(msgId##_LEVEL)){ \
+        log_record((msgId), (const uint32_t[]){__VA_ARGS__}, sizeof((const uint32_t[]){__VA_ARGS__}) / sizeof(uint32_t)); \
+    } \
+} while (0)
+
+void log_record(enum LOG_MSG_ID msgId, const uint32_t *args, size_t numArgs);
+int log_catalog_format(char *buffer, size_t bufferLen, uint16_t msgId, const uint32_t *args, uint8_t numArgs);
+uint32_t log_catalog_hash(void);
+
+#endif //LOG_CATALOG_H
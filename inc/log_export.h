@@ -0,0 +1,52 @@
+#ifndef LOG_EXPORT_H
+#define LOG_EXPORT_H
+
+#include "error_handler.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Log Export: The selected segments are packed as an export header followed by every segment
+// (segment header + raw file contents) and gzip compressed into a sealed memfd, so the compressed
+// size is known before the first byte is downlinked. Decode with 'log_decode export.gz'.
+#define LOG_EXPORT_MAGIC            0x454C5249      // "IRLE"
+#define LOG_EXPORT_VERSION          1
+#define LOG_EXPORT_COMPRESSION      6               // zlib level, text logs compress ~10x at this level
+#define LOG_EXPORT_CHUNK_SIZE       (16 * 1024)     // Bytes read / compressed per step
+#define LOG_EXPORT_MEMFD_NAME       "theia_log_export"
+
+// Export Bound: A request exports the oldest selected segments up to LOG_EXPORT_MAX_RAW_MB (at least
+// one segment), so building it stays well inside IPC_REQUEST_TIMEOUT_MS and the memfd stays small.
+// The number of segments left out is reported, the OBC continues from the last exported segment.
+#define LOG_EXPORT_MAX_RAW_MB       16
+
+// LOG_EXPORT command flags (args[0])
+#define LOG_EXPORT_FLAG_SIZE_ONLY   (1 << 0)        // Report the sizes without transferring anything
+#define LOG_EXPORT_FLAG_SPI_LOG     (1 << 1)        // Export the SPI service log instead of the Main service log
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t numSegments;
+    uint64_t startNs;           // Requested time range
+    uint64_t endNs;
+} log_export_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t segmentId;
+    uint32_t reserved;
+    uint64_t firstNs;
+    uint64_t lastNs;
+    uint64_t size;              // Number of segment bytes that follow
+} log_export_segment_t;
+
+typedef struct {
+    uint16_t numSegments;
+    uint16_t numRemaining;      // Segments in the time range left out by the export bound
+    uint64_t rawSize;           // Export size before compression
+    uint64_t compressedSize;
+} log_export_info_t;
+
+enum IRIS_ERROR log_export(uint64_t startNs, uint64_t endNs, uint8_t flags, int *fd, log_export_info_t *info);
+
+#endif //LOG_EXPORT_H
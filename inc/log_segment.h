@@ -0,0 +1,51 @@
+#ifndef LOG_SEGMENT_H
+#define LOG_SEGMENT_H
+
+#include "logger.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Segment Index: <LOG_DIRECTORY>/<base>.idx, one fixed slot per segment so updating or dropping a
+// segment only rewrites that slot. Segment 'id' lives in slot (id % LOG_MAX_SEGMENTS), starting a
+// segment deletes the segment LOG_MAX_SEGMENTS older that used the same slot.
+#define LOG_INDEX_MAGIC         0x584C5249      // "IRLX"
+#define LOG_INDEX_VERSION       1
+#define LOG_SEGMENT_ID_NONE     0
+#define LOG_SEGMENT_TIME_NONE   0               // Time range unknown (Segment found by directory scan)
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t numSlots;
+    uint32_t reserved[2];
+} log_index_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t segmentId;         // LOG_SEGMENT_ID_NONE if the slot is unused
+    uint32_t flags;
+    uint64_t firstNs;           // Realtime timestamp of the first message in the segment
+    uint64_t lastNs;            // Realtime timestamp of the last message flushed to the segment
+    uint64_t size;              // Bytes flushed to the segment
+} log_segment_t;
+
+typedef struct {
+    int fd;
+    char baseName[LOG_BASENAME_LEN];
+    log_segment_t slots[LOG_MAX_SEGMENTS];
+} log_index_t;
+
+void log_segment_path(const char *baseName, uint32_t segmentId, char *path, size_t pathLen);
+bool log_index_open(log_index_t *index, const char *baseName);
+void log_index_close(log_index_t *index);
+uint32_t log_index_newest(const log_index_t *index);
+const log_segment_t *log_index_get(const log_index_t *index, uint32_t segmentId);
+void log_index_begin(log_index_t *index, uint32_t segmentId, uint64_t firstNs);
+void log_index_update(log_index_t *index, uint32_t segmentId, uint64_t lastNs, uint64_t size);
+int log_index_find(const log_index_t *index, uint64_t startNs, uint64_t endNs, log_segment_t *segments, int maxSegments);
+
+// Logger's own index (See 'logger.c')
+int log_segment_find(uint64_t startNs, uint64_t endNs, log_segment_t *segments, int maxSegments);
+
+#endif //LOG_SEGMENT_H
@@ -2,6 +2,7 @@
 #define LOGGER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -30,15 +31,120 @@ typedef enum LOG_STATES{
     LOG_TO_FILE  = 1,
 }LOG_STATES;
 
-#define LOG_DIRECTORY "/home/iris/ex3_iris_cm4_firmware"
-#define LOG_FILENAME  "Iris_Log.txt"
+// Binary Log Records: With LOG_BINARY set segments store binary records (.bin) instead of text and
+// catalog messages are only formatted by 'log_decode' (See 'log_catalog.h'). Text and error messages
+// are still echoed to the terminal, LOG_BIN_ECHO echoes every message. Selected per build with
+// 'make LOG_BINARY=0' or 'make LOG_BIN_ECHO=1'
+#ifndef LOG_BINARY
+#define LOG_BINARY          1
+#endif
+
+#ifndef LOG_BIN_ECHO
+#define LOG_BIN_ECHO        0
+#endif
+
+// Compile-time Log Level: messages below LOG_COMPILE_LEVEL are removed from the build, their
+// arguments are never evaluated or formatted. Selected per build with 'make LOG_LEVEL=...'
+#define LOG_LEVEL_DEBUG     0
+#define LOG_LEVEL_INFO      1
+#define LOG_LEVEL_WARNING   2
+#define LOG_LEVEL_ERROR     3
+#define LOG_LEVEL_NONE      4
+
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL   LOG_LEVEL_DEBUG
+#endif
+
+// Verbosity of a LOG_LEVEL (DEBUG is the most verbose, unlike the enum order)
+#define LOG_LEVEL_RANK(logLev) \
+    (((int)(logLev) == (int)LOG_DEBUG) ? LOG_LEVEL_DEBUG : ((int)(logLev) == (int)LOG_INFO) ? LOG_LEVEL_INFO : (int)(logLev))
+#define LOG_LEVEL_ENABLED(logLev) (LOG_LEVEL_RANK(logLev) >= LOG_COMPILE_LEVEL)
+
+// Level specific logging with printf style formatting, e.g. LOG_ERRORF("I2C: Bus %d failed", bus);
+// A disabled level keeps its format checking but generates no code.
+#define LOG_DISCARD(logLev, ...)    do { if (0) { log_printf((logLev), __VA_ARGS__); } } while (0)
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUGF(...)     log_printf(LOG_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUGF(...)     LOG_DISCARD(LOG_DEBUG, __VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFOF(...)      log_printf(LOG_INFO, __VA_ARGS__)
+#else
+#define LOG_INFOF(...)      LOG_DISCARD(LOG_INFO, __VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNINGF(...)   log_printf(LOG_WARNING, __VA_ARGS__)
+#else
+#define LOG_WARNINGF(...)   LOG_DISCARD(LOG_WARNING, __VA_ARGS__)
+#endif
 
-#define MAX_FILE_SIZE_MB 2000
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERRORF(...)     log_printf(LOG_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERRORF(...)     LOG_DISCARD(LOG_ERROR, __VA_ARGS__)
+#endif
+
+#define LOG_DIRECTORY "/home/iris/ex3_iris_cm4_firmware"
 #define LOG_BUFFER_SIZE  255
 #define LOG_FILE_PATH_LEN 512
 
+// Segmented Log Files: <LOG_DIRECTORY>/<base>_<id>.<txt|bin>, a new segment is started once the
+// current one reaches LOG_SEGMENT_SIZE_MB and the oldest is deleted once LOG_MAX_SEGMENTS exist.
+// Each service logs under its own base name (See 'log_set_basename' and 'log_segment.h')
+#define LOG_BASENAME            "Iris_Log"
+#define LOG_SPI_BASENAME        "Iris_Spi_Log"
+#define LOG_BASENAME_LEN        32
+#define LOG_SEGMENT_SIZE_MB     8
+#define LOG_TOTAL_SIZE_MB       512             // Flash used by all segments of one log
+#define LOG_MAX_SEGMENTS        (LOG_TOTAL_SIZE_MB / LOG_SEGMENT_SIZE_MB)
+
+// Asynchronous Writer: Messages are queued in a ring and written by a background thread
+#define LOG_RING_SLOTS          1024            // Must be a power of 2
+#define LOG_FILE_BUFFER_SIZE    (64 * 1024)     // stdio buffer of the persistent file handle
+#define LOG_FLUSH_TIMEOUT_MS    2000            // Max time 'log_flush' waits for the writer
+
+// Default Flush Policy (See 'log_set_policy')
+#define LOG_FLUSH_INTERVAL_MS   1000            // Buffered lines reach the file at least this often
+#define LOG_FSYNC_INTERVAL_MS   10000           // File is synced to storage at least this often (0 = Never)
+#define LOG_FLUSH_LEVEL         LOG_ERROR       // Messages at or above this level are flushed and synced immediately
+
+// Binary Log File: Header followed by records, each record is 'log_bin_record_t' followed by
+// 'numArgs' 32-bit arguments. LOGID_TEXT records are followed by a 16-bit length and the text instead.
+#define LOG_BIN_MAGIC           0x424C5249      // "IRLB"
+#define LOG_BIN_VERSION         1
+#define LOG_RECORD_MAX_ARGS     6
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t catalogHash;       // 'log_catalog_hash' of the firmware that wrote the file
+    uint32_t reserved;
+} log_bin_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint64_t timestampNs;       // Realtime clock
+    uint16_t msgId;             // LOG_MSG_ID
+    uint8_t logLev;
+    uint8_t numArgs;
+} log_bin_record_t;
+
+typedef struct {
+    uint32_t flushIntervalMs;
+    uint32_t fsyncIntervalMs;
+    enum LOG_LEVEL flushLevel;
+} log_policy_t;
+
 void log_file_init(void);
 bool check_log_file_size(FILE *filePtr);
 void log_write(enum LOG_LEVEL logLev, const char *msg);
+void log_printf(enum LOG_LEVEL logLev, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void log_flush(void);
+void log_set_policy(const log_policy_t *policy);
+void log_set_basename(const char *baseName);
 
 #endif /* LOGGER_H */
\ No newline at end of file
@@ -0,0 +1,143 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "error_handler.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Metrics Registry: Counters, gauges and latency histograms in a shared memory segment mapped by
+// both services. Updates are single relaxed atomics on the segment, nothing is locked or logged,
+// and a service that failed to map the segment just skips them. 'iris-stat' (tools/iris_stat.c)
+// maps the segment read-only and prints it live. Values persist across service restarts until the
+// segment is removed (reboot or 'rm /dev/shm/theia_metrics').
+#define METRICS_SHM_NAME        "/theia_metrics"
+#define METRICS_MAGIC           0x494D5434  // "IMT4", bump when the shared layout changes
+#define METRICS_HIST_BUCKETS    24          // Bucket 0 is < 1 us, bucket N is [2^(N-1), 2^N) us, the last is everything above
+#define METRICS_NUM_CMDS        256         // One dispatch counter per command byte
+
+typedef enum METRIC_TYPE{
+    METRIC_COUNTER,     // Only increases
+    METRIC_GAUGE        // Last value set
+}METRIC_TYPE;
+
+// Counters and Gauges: Append new metrics at the end and bump METRICS_MAGIC
+#define METRICS_CATALOG(X) \
+    X(METRIC_SPI_READS,         METRIC_COUNTER, "spi.reads",            "SPI read transfers")                           \
+    X(METRIC_SPI_READ_ERRORS,   METRIC_COUNTER, "spi.read_errors",      "SPI reads that returned a short count")        \
+    X(METRIC_SPI_WRITES,        METRIC_COUNTER, "spi.writes",           "SPI write transfers")                          \
+    X(METRIC_SPI_WRITE_ERRORS,  METRIC_COUNTER, "spi.write_errors",     "SPI writes that returned a short count")       \
+    X(METRIC_SPI_BYTES,         METRIC_COUNTER, "spi.bytes",            "Bytes moved over SPI in either direction")     \
+    X(METRIC_I2C_XFERS,         METRIC_COUNTER, "i2c.xfers",            "I2C reads and writes")                         \
+    X(METRIC_I2C_ERRORS,        METRIC_COUNTER, "i2c.errors",           "I2C reads and writes that failed")             \
+    X(METRIC_CMDS,              METRIC_COUNTER, "cmd.count",            "Commands run by the command controller")       \
+    X(METRIC_CMD_ERRORS,        METRIC_COUNTER, "cmd.errors",           "Commands that returned an error")              \
+    X(METRIC_JOBS_SUBMITTED,    METRIC_COUNTER, "job.submitted",        "Commands queued on the job engine")            \
+    X(METRIC_JOBS_REJECTED,     METRIC_COUNTER, "job.rejected",         "Job submissions refused, queue full")          \
+    X(METRIC_JOB_QUEUE_DEPTH,   METRIC_GAUGE,   "job.queue_depth",      "Jobs waiting for a worker")                    \
+    X(METRIC_IPC_IN_FLIGHT,     METRIC_GAUGE,   "ipc.in_flight",        "Commands forwarded to Main awaiting a response") \
+    X(METRIC_IPC_BUSY,          METRIC_COUNTER, "ipc.busy",             "Commands refused, in flight limit reached")    \
+    X(METRIC_IPC_EXPIRED,       METRIC_COUNTER, "ipc.expired",          "Forwarded commands that never got a response") \
+    X(METRIC_LOG_MESSAGES,      METRIC_COUNTER, "log.messages",         "Messages queued to the log writer")            \
+    X(METRIC_LOG_DROPPED,       METRIC_COUNTER, "log.dropped",          "Messages lost because the log ring was full")  \
+    X(METRIC_SPI_RETRIES,       METRIC_COUNTER, "spi.retries",          "Unsubmitted SPI transfers retried (Recovery Tier 1)") \
+    X(METRIC_SPI_RECONFIGS,     METRIC_COUNTER, "spi.reconfigs",        "spidev settings reapplied (Recovery Tier 2)")  \
+    X(METRIC_SPI_REBUILDS,      METRIC_COUNTER, "spi.rebuilds",         "SPI interface rebuilt (Recovery Tier 3)")      \
+    X(METRIC_SPI_TRAININGS,     METRIC_COUNTER, "spi.trainings",        "SPI clock link trainings run")                 \
+    X(METRIC_SPI_CLOCK_HZ,      METRIC_GAUGE,   "spi.clock_hz",         "SPI clock rate configured")
+
+// Latency Histograms: Append new histograms at the end and bump METRICS_MAGIC
+#define METRICS_HIST_CATALOG(X) \
+    X(METRIC_HIST_SPI_XFER,     "spi.xfer_us",          "SPI transfer time, CS assert to release")      \
+    X(METRIC_HIST_I2C_XFER,     "i2c.xfer_us",          "I2C read / write time")                        \
+    X(METRIC_HIST_CMD,          "cmd.run_us",           "Command handler execution time")               \
+    X(METRIC_HIST_CS_WAKE,      "spi.cs_wake_us",       "CS edge timestamp to the SPI thread handling it")
+
+#define METRICS_ENUM(id, ...) id,
+typedef enum METRIC_ID{
+    METRICS_CATALOG(METRICS_ENUM)
+    METRIC_NUM
+}METRIC_ID;
+
+typedef enum METRIC_HIST_ID{
+    METRICS_HIST_CATALOG(METRICS_ENUM)
+    METRIC_HIST_NUM
+}METRIC_HIST_ID;
+#undef METRICS_ENUM
+
+typedef struct {
+    uint64_t count;
+    uint64_t sumUs;
+    uint64_t maxUs;
+    uint64_t buckets[METRICS_HIST_BUCKETS];
+} metrics_hist_t;
+
+// Shared segment, every field is only accessed with atomics
+typedef struct {
+    uint32_t magic;
+    uint32_t numMetrics;            // METRIC_NUM of the build that created the segment
+    uint32_t numHists;              // METRIC_HIST_NUM of the build that created the segment
+    uint32_t reserved;
+    uint64_t createdRealtimeS;      // Wall clock time the segment was created
+    uint64_t values[METRIC_NUM];
+    metrics_hist_t hists[METRIC_HIST_NUM];
+    uint64_t cmdCounts[METRICS_NUM_CMDS];
+} metrics_region_t;
+
+extern metrics_region_t *metricsRegion;
+
+enum IRIS_ERROR metrics_init(void);
+
+/**
+ * @brief Adds to a counter
+ *
+ * @param id METRIC_ID of a METRIC_COUNTER
+ * @param value Amount to add
+ */
+static inline void metric_add(enum METRIC_ID id, uint64_t value){
+    if (metricsRegion != NULL){
+        __atomic_fetch_add(&metricsRegion->values[id], value, __ATOMIC_RELAXED);
+    }
+}
+
+static inline void metric_inc(enum METRIC_ID id){
+    metric_add(id, 1);
+}
+
+/**
+ * @brief Sets a gauge
+ *
+ * @param id METRIC_ID of a METRIC_GAUGE
+ * @param value New value
+ */
+static inline void metric_set(enum METRIC_ID id, uint64_t value){
+    if (metricsRegion != NULL){
+        __atomic_store_n(&metricsRegion->values[id], value, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Counts a dispatch of a command
+ *
+ * @param cmd Command byte
+ */
+static inline void metric_cmd(uint8_t cmd){
+    if (metricsRegion != NULL){
+        __atomic_fetch_add(&metricsRegion->cmdCounts[cmd], 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Histogram bucket of a duration
+ *
+ * @param us Duration in micro-seconds
+ * @return Bucket index, 0 to METRICS_HIST_BUCKETS - 1
+ */
+static inline uint32_t metrics_hist_bucket(uint64_t us){
+    uint32_t bucket = (us == 0) ? 0 : (64 - (uint32_t)__builtin_clzll(us));
+    return (bucket < METRICS_HIST_BUCKETS) ? bucket : (METRICS_HIST_BUCKETS - 1);
+}
+
+void metric_observe_ns(enum METRIC_HIST_ID id, uint64_t elapsedNs);
+
+#endif //METRICS_H
@@ -0,0 +1,43 @@
+#ifndef RT_PROFILE_H
+#define RT_PROFILE_H
+
+#include "error_handler.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Real-Time Profile: Applied to the SPI service's main loop once it is set up, so CS to response
+// latency does not depend on logging, housekeeping or compression running on the CM4. ONE_SERVICE
+// is left on SCHED_OTHER, its main loop also runs housekeeping and would starve the pinned core.
+// Every step is configured at run time from the service's environment (e.g.
+// 'Environment=IRIS_RT_CPU=3' in its systemd unit), a step that fails is logged and the remaining
+// steps are still applied.
+//  IRIS_RT_PRIORITY    SCHED_FIFO priority (1 - 99), 0 leaves the thread on SCHED_OTHER
+//  IRIS_RT_CPU         Core the thread is pinned to, -1 to run on any core. The core should be
+//                      isolated from the scheduler ('isolcpus=3' on the kernel command line)
+//  IRIS_RT_MLOCK       1 to lock every current and future page of the service in memory (mlockall)
+//  IRIS_RT_PREFAULT_KB Stack and heap touched up front so the loop never takes a page fault
+#define RT_PROFILE_ENV_PRIORITY     "IRIS_RT_PRIORITY"
+#define RT_PROFILE_ENV_CPU          "IRIS_RT_CPU"
+#define RT_PROFILE_ENV_MLOCK        "IRIS_RT_MLOCK"
+#define RT_PROFILE_ENV_PREFAULT_KB  "IRIS_RT_PREFAULT_KB"
+
+// Below the kernel's threaded IRQ handlers and SPI message pump (SCHED_FIFO 50), the transfer the
+// thread is waiting on must still be able to preempt it
+#define RT_PROFILE_DEF_PRIORITY     40
+#define RT_PROFILE_DEF_CPU          3       // Last of the CM4's 4 cores
+#define RT_PROFILE_DEF_MLOCK        1
+#define RT_PROFILE_DEF_PREFAULT_KB  256     // Covers 'spi_file_write' (3 x SPI_FILE_BUFFER_LEN on the stack)
+#define RT_PROFILE_MAX_PREFAULT_KB  4096    // Main thread stack limit is 8 MB
+
+typedef struct {
+    int priority;
+    int cpu;
+    bool mlock;
+    uint32_t prefaultKb;
+} rt_profile_t;
+
+void rt_profile_load(rt_profile_t *profile);
+enum IRIS_ERROR rt_profile_apply(const rt_profile_t *profile);
+
+#endif //RT_PROFILE_H
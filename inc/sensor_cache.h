@@ -0,0 +1,57 @@
+#ifndef SENSOR_CACHE_H
+#define SENSOR_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Type of measurement stored in a cache channel
+typedef enum SENSOR_KIND{
+    SENSOR_CURRENT  = 0,
+    SENSOR_VOLTAGE  = 1,
+    SENSOR_POWER    = 2,
+    SENSOR_PK_POWER = 3,
+    SENSOR_TEMP     = 4
+}SENSOR_KIND;
+
+// Cache Channel Layout
+//  Channel [0:11]  = Current Sensor Kind * SENSOR_NUM_RAILS + Rail (3V3, 5V, CAM)
+//  Channel [12:15] = Temperature Sensor 1 - 4
+#define SENSOR_NUM_RAILS            3
+#define SENSOR_NUM_RAIL_KINDS       4
+#define SENSOR_NUM_TEMPS            4
+#define SENSOR_TEMP_CHANNEL_START   (SENSOR_NUM_RAILS * SENSOR_NUM_RAIL_KINDS)
+#define SENSOR_CACHE_NUM_CHANNELS   (SENSOR_TEMP_CHANNEL_START + SENSOR_NUM_TEMPS)
+#define SENSOR_CHANNEL_INVALID      0xFF
+
+// Freshness Policy: Max age (ms) of a cached reading before a command falls back to a live I2C read.
+// Background sampler runs every HOUSE_KEEPING_DELAY_S, so these must be larger than that period.
+#define CACHE_MAX_AGE_CURRENT_MS    15000
+#define CACHE_MAX_AGE_VOLTAGE_MS    15000
+#define CACHE_MAX_AGE_POWER_MS      15000
+#define CACHE_MAX_AGE_PK_POWER_MS   15000
+#define CACHE_MAX_AGE_TEMP_MS       30000
+#define CACHE_MAX_AGE_LIVE_MS       0
+
+// Sample History: Every valid reading is also kept in a per-channel ring, downlinked packed with
+// TELEMETRY_HISTORY (See 'telemetry_block.h'). Sampled once per housekeeping sweep (10 s), so the
+// ring holds the last ~42 minutes of each channel.
+#define SENSOR_HISTORY_LEN          256
+
+typedef struct {
+    uint16_t value;          // Last value read (mA, mV, mW or C as returned by the sensor driver)
+    enum IRIS_ERROR error;   // Error code of the last read, NO_ERROR if 'value' is valid
+    uint64_t timestampMs;    // Monotonic time of the last read, 0 if the channel was never sampled
+} sensor_snapshot_t;
+
+uint8_t sensor_channel(enum SENSOR_KIND kind, uint8_t addr);
+uint32_t sensor_cache_max_age_ms(uint8_t cmd);
+
+void sensor_cache_update(uint8_t channel, uint16_t value, enum IRIS_ERROR error);
+void sensor_cache_snapshot(uint8_t channel, sensor_snapshot_t *snapshot);
+enum IRIS_ERROR sensor_cache_live_read(uint8_t channel, uint16_t *value);
+enum IRIS_ERROR sensor_cache_read(uint8_t channel, uint32_t maxAgeMs, bool forceLive, uint16_t *value);
+uint16_t sensor_cache_history(uint8_t channel, uint64_t *timestampMs, int32_t *value, uint16_t maxSamples);
+void sensor_cache_history_drop(const uint64_t *untilMs);
+void sensor_sampler_sweep(void);
+
+#endif //SENSOR_CACHE_H
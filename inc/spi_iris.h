@@ -17,7 +17,7 @@ typedef struct {
 } spi_config_t;
 
 #define SPI_MODE_TYP_0 0
-#define SPI_SPEED 1000000
+#define SPI_SPEED 1000000 // Until the link is trained (See 'spi_train.h')
 #define SPI_DELAY 100
 #define SPI_BITS_PER_WORD 8
 #define SPI_DEVICE "/dev/spidev0.0"
@@ -27,27 +27,45 @@ typedef struct {
 #define SPI_TEST_TIMEOUT 0.5 //0.5s Timeout
 #define SPI_TEST_CMD 0x6A //! This command is determined at a later date
 #define SPI_BUFFER_LEN 512
+#define SPI_FD_HEADER_SIZE 9 // FILE_TRANSFER + 64-bit Length
 
 #define END_SPI_CMD 0xFF
 #define SPI_ERROR_BUFFER_LEN 4096
 
-#define SPI_TEST_MSG {SPI_TEST_CMD, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE};
-#define SPI_TEST_MSG_SIZE 8
+// SPI Recovery: A transfer spidev never submitted (EAGAIN, EINTR) is retried on the spot (Tier 1),
+// one that may have clocked data out is not. Any other failure makes the loop call 'spi_recover',
+// which reapplies the spidev settings on the open fd (Tier 2) and only rebuilds the fd, CS request
+// and event buffer (Tier 3) if that fails or does not hold, so a transient glitch does not cost a
+// full re-initialization while the OBC waits. Tier counts are in the metrics registry.
+#define SPI_XFER_RETRIES            2       // Tier 1, retries of a transfer that was never submitted
+#define SPI_RECOVER_MAX_RECONFIGS   3       // Tier 2 recoveries within the window before escalating to Tier 3
+#define SPI_RECOVER_WINDOW_MS       1000
+
+enum SPI_RECOVER_TIER{
+    SPI_RECOVER_RETRY       = 1,
+    SPI_RECOVER_RECONFIGURE = 2,
+    SPI_RECOVER_REBUILD     = 3
+};
+
 
 int spi_open(const char *device, spi_config_t config);
+enum IRIS_ERROR spi_configure(int fileDesc, spi_config_t config);
+void spi_config_get(spi_config_t *config);
+void spi_speed_set(uint32_t speedHz);
 int spi_bus_setup(void);
 int spi_close(int fileDesc);
 struct gpiod_line_request *spi_cs_setup(void);
 
 enum IRIS_ERROR spi_init(int *spi_dev, struct gpiod_line_request **spi_cs_request, struct gpiod_edge_event_buffer **event_buffer);
 enum IRIS_ERROR spi_reinit(int *spi_dev, struct gpiod_line_request **spi_cs_request, struct gpiod_edge_event_buffer **event_buffer);
+enum IRIS_ERROR spi_recover(enum IRIS_ERROR error, int *spi_dev, struct gpiod_line_request **spi_cs_request, struct gpiod_edge_event_buffer **event_buffer);
 
 enum IRIS_ERROR spi_read(int fileDesc, uint8_t *rx_buffer, uint16_t rx_len, struct gpiod_line_request *cs_request);
 enum IRIS_ERROR spi_write(int fileDesc, const uint8_t *tx_buffer, uint16_t tx_len, struct gpiod_line_request *cs_request);
 
 enum IRIS_ERROR spi_file_read(int spi_dev, struct gpiod_line_request **spi_cs_request, struct gpiod_edge_event_buffer **event_buffer, const char *file_path);
+enum IRIS_ERROR spi_fd_write(int spi_dev, struct gpiod_line_request *spi_cs_request, int fd, uint64_t offset, uint64_t len);
 enum IRIS_ERROR spi_file_write(int spi_dev, struct gpiod_line_request **spi_cs_request, char *file_path, struct gpiod_edge_event_buffer **event_buffer);
 enum IRIS_ERROR spi_bus_test(int spi_dev, struct gpiod_line_request *spi_cs_request, struct gpiod_edge_event_buffer *event_buffer);
-enum IRIS_ERROR spi_bus_test_compare(const uint8_t *buffer);
 
 #endif //SPI_IRIS_H
\ No newline at end of file
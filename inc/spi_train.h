@@ -0,0 +1,62 @@
+#ifndef SPI_TRAIN_H
+#define SPI_TRAIN_H
+
+#include "error_handler.h"
+
+#include <gpiod.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// SPI Link Training: The bus clock is the downlink ceiling, so it is trained instead of fixed at
+// SPI_SPEED. Training is a state the OBC enters with SPI_TRAIN (See 'cmd_controller.h'), Iris never
+// starts it on its own since no other command is serviced while it runs. Candidate rates are tried
+// from slowest to fastest, at each one Iris writes SPI_TRAIN_FRAMES test frames of PRBS-15 data and
+// the OBC echoes every frame back on its next CS assertion. Bit errors in the echo (either direction)
+// give the rate's bit error rate, a rate passes with at most SPI_TRAIN_MAX_BIT_ERRORS. The rate
+// SPI_TRAIN_MARGIN_STEPS below the fastest passing rate is selected, so temperature and ageing do not
+// push the link over the edge.
+//  Test frame: [SPI_TEST_CMD, rate index, frame index, PRBS-15 x SPI_TRAIN_PAYLOAD_LEN]
+//  Echo:       The same frame as received by the OBC
+// An echo that is late or has the wrong header (e.g. an OBC command) counts as missed, not as bit
+// errors. A rate fails after SPI_TRAIN_MAX_MISSED missed echoes and training stops once it has run
+// for SPI_TRAIN_BUDGET_MS, so the OBC is never left unanswered for long.
+// The selected rate is kept in <LOG_DIRECTORY>/Iris_Spi_Rate.bin and used from then on. Training is
+// reported as pending when there is no valid record or after SPI_TRAIN_ERROR_LIMIT transfer failures
+// within SPI_TRAIN_ERROR_WINDOW_S. If the OBC does not echo, the current rate is kept.
+#define SPI_TRAIN_RATES             {500000, 1000000, 2000000, 4000000, 8000000, 12500000, 16000000, 20000000}
+#define SPI_TRAIN_NUM_RATES         8
+#define SPI_TRAIN_FRAMES            16
+#define SPI_TRAIN_HEADER_SIZE       3
+#define SPI_TRAIN_PAYLOAD_LEN       253         // 256 byte frames, 32384 payload bits per rate
+#define SPI_TRAIN_FRAME_LEN         (SPI_TRAIN_HEADER_SIZE + SPI_TRAIN_PAYLOAD_LEN)
+#define SPI_TRAIN_MAX_BIT_ERRORS    0
+#define SPI_TRAIN_MARGIN_STEPS      1
+#define SPI_TRAIN_RATE_CURRENT      0xFF        // Rate index of frames sent at the configured rate (bus test)
+#define SPI_TRAIN_MAX_MISSED        2
+#define SPI_TRAIN_BUDGET_MS         4000
+#define SPI_TRAIN_ERROR_LIMIT       8
+#define SPI_TRAIN_ERROR_WINDOW_S    60
+
+#define SPI_TRAIN_FILENAME          "Iris_Spi_Rate.bin"
+#define SPI_TRAIN_MAGIC             0x52535249  // "IRSR"
+#define SPI_TRAIN_VERSION           1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t speedHz;           // Selected rate
+    uint32_t fastestHz;         // Fastest rate that passed
+    uint32_t bitErrors;         // Bit errors measured at the selected rate
+    uint32_t trainedS;          // Unix seconds of the training
+    uint32_t crc;               // CRC-32 of everything above (with crc = 0)
+} spi_train_record_t;
+
+void spi_train_load(void);
+void spi_train_error(void);
+bool spi_train_pending(void);
+enum IRIS_ERROR spi_train_measure(int spi_dev, struct gpiod_line_request *spi_cs_request, struct gpiod_edge_event_buffer *event_buffer,
+                                  uint8_t rateIndex, uint16_t numFrames, uint64_t deadlineMs, uint32_t *bitErrors, uint32_t *numBits);
+enum IRIS_ERROR spi_train(int spi_dev, struct gpiod_line_request *spi_cs_request, struct gpiod_edge_event_buffer *event_buffer);
+
+#endif //SPI_TRAIN_H
@@ -0,0 +1,43 @@
+#ifndef TELEMETRY_BLOCK_H
+#define TELEMETRY_BLOCK_H
+
+#include "sensor_cache.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Telemetry Block Response Layout (Multi-byte fields are MSB first)
+//  [0]      CMD_RETURN
+//  [1]      Error Code
+//  [2]      TELEM_BLOCK_VERSION
+//  [3]      Number of Rails
+//  [4]      Number of Temperature Sensors
+//  [5:8]    Block Timestamp (Seconds)
+//  [9:10]   Health Flags (Bit N set = Cache Channel N failed its last read or was never sampled)
+//  Per Rail (3V3, 5V, CAM):
+//           Current (mA), Voltage (mV), Power (mW), Peak Power (mW)    4 x 2 bytes
+//           Age of each value (TELEM_BLOCK_AGE_LSB_MS / LSB)            4 x 2 bytes
+//  Per Temperature Sensor (1 - 4):
+//           Temperature (C, signed)                                    1 byte
+//           Age of value (TELEM_BLOCK_AGE_LSB_MS / LSB)                 2 bytes
+
+#define TELEM_BLOCK_VERSION       1
+#define TELEM_BLOCK_HEADER_SIZE   11
+#define TELEM_BLOCK_RAIL_SIZE     16
+#define TELEM_BLOCK_TEMP_SIZE     3
+#define TELEM_BLOCK_SIZE          (TELEM_BLOCK_HEADER_SIZE + (SENSOR_NUM_RAILS * TELEM_BLOCK_RAIL_SIZE) + (SENSOR_NUM_TEMPS * TELEM_BLOCK_TEMP_SIZE))
+#define TELEM_BLOCK_AGE_LSB_MS    100
+#define TELEM_BLOCK_AGE_MAX       0xFFFF
+
+// Telemetry History: The sensor cache history of every channel packed into one frame (See
+// 'telemetry_pack.h'), series channel IDs are cache channels (See 'sensor_cache.h') and timestamps
+// are Unix milli-seconds
+#define TELEM_HISTORY_MEMFD_NAME        "theia_telemetry_history"
+#define TELEM_HISTORY_FLAG_SIZE_ONLY    (1 << 0)    // Report the size without transferring anything
+#define TELEM_HISTORY_FLAG_CLEAR        (1 << 1)    // Drop the exported readings once the OBC received them, ignored with SIZE_ONLY
+
+enum IRIS_ERROR telemetry_block_build(uint8_t *buffer, uint16_t bufferLen, bool forceLive, uint16_t *blockLen);
+enum IRIS_ERROR telemetry_history_export(uint8_t flags, int *fd, uint32_t *size, uint32_t *numSamples);
+void telemetry_history_delivered(bool delivered);
+
+#endif //TELEMETRY_BLOCK_H
@@ -0,0 +1,43 @@
+#ifndef TELEMETRY_PACK_H
+#define TELEMETRY_PACK_H
+
+#include "error_handler.h"
+
+#include <stdint.h>
+
+// Packed Telemetry Frame Layout
+//  [0]  TELEM_PACK_VERSION
+//  [1]  Number of Channels in the frame
+//  Per Channel:
+//       Channel ID         (1 byte)
+//       Number of Samples  (varint)
+//       First Timestamp    (varint, milli-seconds)
+//       First Delta        (zigzag varint)
+//       Delta-of-Delta     (zigzag varint) x (Number of Samples - 2)
+//       First Value        (zigzag varint)
+//       Value Delta        (zigzag varint) x (Number of Samples - 1)
+
+#define TELEM_PACK_VERSION      1
+#define TELEM_PACK_HEADER_SIZE  2
+#define TELEM_MAX_CHANNELS      32
+#define TELEM_MAX_SAMPLES       4096
+#define TELEM_VARINT_MAX_LEN    10
+
+typedef struct {
+    uint8_t   channel;      // Telemetry Channel ID
+    uint16_t  numSamples;   // Number of valid samples stored in the series
+    uint16_t  maxSamples;   // Capacity of 'timestamp' and 'value' arrays (Only used when unpacking)
+    uint64_t *timestamp;    // Sample timestamps in milli-seconds, must be non-decreasing
+    int32_t  *value;        // Raw sample values
+} telemetry_series_t;
+
+uint64_t zigzag_encode(int64_t value);
+int64_t zigzag_decode(uint64_t value);
+uint8_t varint_encode(uint64_t value, uint8_t *buffer);
+uint8_t varint_decode(const uint8_t *buffer, uint32_t bufferLen, uint64_t *value);
+
+uint32_t telemetry_pack_bound(const telemetry_series_t *series, uint8_t numSeries);
+enum IRIS_ERROR telemetry_pack(const telemetry_series_t *series, uint8_t numSeries, uint8_t *buffer, uint32_t bufferLen, uint32_t *packedLen);
+enum IRIS_ERROR telemetry_unpack(const uint8_t *buffer, uint32_t packedLen, telemetry_series_t *series, uint8_t maxSeries, uint8_t *numSeries);
+
+#endif //TELEMETRY_PACK_H
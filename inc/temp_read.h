@@ -74,7 +74,8 @@ enum IRIS_ERROR temp_func_validate(uint8_t tempAddr);
 enum IRIS_ERROR temp_reset_trig(uint8_t tempAddr);
 enum IRIS_ERROR temp_reset(uint8_t tempAddr);
 
-void temperature_limit(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount);
+void temperature_limit(enum IRIS_ERROR *limitErrors, uint8_t *numLimitErrors);
+void temperature_limit_check(const int8_t *temp, enum IRIS_ERROR *limitErrors, uint8_t *numLimitErrors);
 int8_t convert_temp_read(uint8_t HighByte);
 int8_t read_temperature(uint8_t tempAddr);
 
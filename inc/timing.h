@@ -1,12 +1,13 @@
 #ifndef TIMING_H
 #define TIMING_H_H
 
-#define TIME_SYNC_DELAY_NS 2000000000 // 2Sec
-#define TIME_SYNC_LOOP_MAX 1000
+#include <stdint.h>
 
+// CLOCK_REALTIME is disciplined to the OBC by SYNC_TIME (See 'clock_sync.h'), it may be slewed or
+// stepped at any time so intervals and timeouts are measured on the monotonic clock
 
 int get_time_seconds(void);
-void set_time_seconds(double setTime);
-uint64_t time_sync(struct gpiod_line_request *request, struct gpiod_edge_event_buffer *event_buffer);
+uint64_t get_time_monotonic_ns(void);
+uint64_t get_time_monotonic_ms(void);
 
-#endif //TIMING_H_H
\ No newline at end of file
+#endif //TIMING_H_H
@@ -0,0 +1,60 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "error_handler.h"
+#include "timing.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Compile-time switch for trace spans, set by the makefile (TRACE=1, on in the debug targets).
+// With 0 every TRACE_* macro is removed from the build.
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+
+// Trace Spans: Every thread records completed spans into its own ring of TRACE_RING_SIZE entries,
+// the oldest spans are overwritten. 'trace_export' formats every ring as Chrome / Perfetto trace
+// JSON ("X" complete events on CLOCK_MONOTONIC), load it at ui.perfetto.dev or chrome://tracing.
+#define TRACE_RING_SIZE         4096            // Spans per thread, must be a power of 2
+#define TRACE_MAX_THREADS       32
+#define TRACE_ARG_NONE          UINT32_MAX
+#define TRACE_MEMFD_NAME        "theia_trace_export"
+#define TRACE_SPI_FILENAME      "Iris_Spi_Trace.json"   // Written by the SPI service on SIGUSR1
+
+// TRACE_EXPORT command flags (args[0])
+#define TRACE_EXPORT_FLAG_SIZE_ONLY (1 << 0)    // Report the size without transferring anything
+#define TRACE_EXPORT_FLAG_CLEAR     (1 << 1)    // Empty every ring once exported
+
+typedef struct {
+    const char *name;           // Must point to a string literal, only the pointer is stored
+    uint32_t arg;               // Shown as args.arg in the trace, TRACE_ARG_NONE if unused
+    uint64_t startNs;           // CLOCK_MONOTONIC
+} trace_span_t;
+
+static inline trace_span_t trace_begin(const char *name, uint32_t arg){
+    trace_span_t span = {name, arg, get_time_monotonic_ns()};
+    return span;
+}
+
+void trace_end(trace_span_t *span);
+enum IRIS_ERROR trace_export(uint8_t flags, int *fd, uint32_t *size, uint32_t *numSpans);
+enum IRIS_ERROR trace_export_file(const char *path);
+void trace_signal_setup(int signum);
+bool trace_signal_pending(void);
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+// TRACE_SCOPE("name") records a span from this line to the end of the enclosing block
+#if TRACE_ENABLED
+#define TRACE_SCOPE(name) \
+    trace_span_t TRACE_CONCAT(traceSpan, __LINE__) __attribute__((cleanup(trace_end))) = trace_begin(name, TRACE_ARG_NONE)
+#define TRACE_SCOPE_ARG(name, arg) \
+    trace_span_t TRACE_CONCAT(traceSpan, __LINE__) __attribute__((cleanup(trace_end))) = trace_begin(name, (uint32_t)(arg))
+#else
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_SCOPE_ARG(name, arg) do { if (0) { (void)(arg); } } while (0)
+#endif
+
+#endif //TRACE_H
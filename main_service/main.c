@@ -17,16 +17,23 @@
 
  //---- Headers -----//
 #include "gpio.h"
+#include "i2c.h"
 #include "spi_iris.h"
 #include "main.h"
 #include "logger.h"
+#include "clock_sync.h"
 #include "cmd_controller.h"
 #include "temp_read.h"
 #include "error_handler.h"
 #include "current_sensor.h"
+#include "flight_recorder.h"
+#include "metrics.h"
 #include "usb_hub.h"
 #include "timing.h"
 #include "ipc_iris.h"
+#include "job_engine.h"
+#include "sensor_cache.h"
+#include "trace.h"
 
 #include <gpiod.h>
 #include <stdbool.h>
@@ -37,12 +44,12 @@
 #include <sys/ipc.h>
 #include <unistd.h>
 
-void usb_hub_init(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount, struct gpiod_line_request *gpio_request){
+void usb_hub_init(struct gpiod_line_request *gpio_request){
 
     enum IRIS_ERROR errorCheck = NO_ERROR;
     int loopCounter = 0;
 
-    log_write(LOG_INFO, "USB-HUB-INIT: Started USB Hub Initialization");
+    LOG_INFOF("USB-HUB-INIT: Started USB Hub Initialization");
         
     do{
         errorCheck = usb_hub_setup();
@@ -53,11 +60,11 @@ void usb_hub_init(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount, struct gpio
     }while((errorCheck != NO_ERROR) && (loopCounter < MAX_USBHUB_INIT_ATTEMPTS));
 
     if(errorCheck != NO_ERROR){
-        errorBuffer[(*errorCount)++] = errorCheck;
+        error_record(errorCheck);
     }
 }
 
-void current_monitor_init(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount){
+void current_monitor_init(void){
 
     enum IRIS_ERROR errorCheck = NO_ERROR;
     int loopCounter = 0;
@@ -65,7 +72,7 @@ void current_monitor_init(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount){
                            CURRENT_SENSOR_ADDR_5V,
                            CURRENT_SENSOR_ADDR_CAM};
 
-    log_write(LOG_INFO, "CURRENT-MONITOR-INIT: Started Current Monitor Initialization");
+    LOG_INFOF("CURRENT-MONITOR-INIT: Started Current Monitor Initialization");
 
     for (int x = 0; x < sizeof(currAddr); x++){
 
@@ -79,20 +86,20 @@ void current_monitor_init(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount){
         
         loopCounter = 0;
         if(errorCheck != NO_ERROR){
-            errorBuffer[(*errorCount)++] = errorCheck;
+            error_record(errorCheck);
         }
     }
 
 }
 
-void temp_sensor_init(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount){
+void temp_sensor_init(void){
 
     enum IRIS_ERROR errorCheck = NO_ERROR;
     int loopCounter = 0;
     uint8_t tempAddr[4] = {TEMP_SENSOR_1_ADDR, TEMP_SENSOR_2_ADDR,
                            TEMP_SENSOR_3_ADDR, TEMP_SENSOR_4_ADDR};
 
-    log_write(LOG_INFO, "TEMP-SENSOR-INIT: Started Temperature Sensor Initialization");
+    LOG_INFOF("TEMP-SENSOR-INIT: Started Temperature Sensor Initialization");
 
     for (int x = 0; x < sizeof(tempAddr); x++){
 
@@ -106,22 +113,22 @@ void temp_sensor_init(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount){
         
         loopCounter = 0;
         if(errorCheck != NO_ERROR){
-            errorBuffer[(*errorCount)++] = errorCheck;
+            error_record(errorCheck);
         }
     }
 
 }
 
 //! LOOK INTO A DIFFERENT SOLUTIONS FOR ADDING THE DELAY AFTER TEMP_SENSOR RESET
-void temp_sensor_house_keeping(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount){
+void temp_sensor_house_keeping(void){
 
     enum IRIS_ERROR errorCheck = NO_ERROR;
     int loopCounter = 0;
     uint8_t tempAddr[4] = {TEMP_SENSOR_1_ADDR, TEMP_SENSOR_2_ADDR,
                            TEMP_SENSOR_3_ADDR, TEMP_SENSOR_4_ADDR};
 
-    log_write(LOG_INFO, "TEMP-SENSOR-HOUSE-KEEPING: Started Temperature Sensor Housekeeping");
-    log_write(LOG_INFO, "TEMP-SENSOR-HOUSE-KEEPING: Started Temperature Sensor Verification");
+    LOG_INFOF("TEMP-SENSOR-HOUSE-KEEPING: Started Temperature Sensor Housekeeping");
+    LOG_INFOF("TEMP-SENSOR-HOUSE-KEEPING: Started Temperature Sensor Verification");
 
     for (int x = 0; x < sizeof(tempAddr); x++){
 
@@ -142,28 +149,25 @@ void temp_sensor_house_keeping(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount
         
         loopCounter = 0;
         if(errorCheck != NO_ERROR){
-            errorBuffer[(*errorCount)++] = errorCheck;
+            error_record(errorCheck);
         }
     }
 
-    log_write(LOG_INFO, "TEMP-SENSOR-HOUSE-KEEPING: Finished Temperature Sensor Verification");
-
-    temperature_limit(errorBuffer, errorCount);
-
-    log_write(LOG_INFO, "TEMP-SENSOR-HOUSE-KEEPING: Finished Temperature Sensor Housekeeping");
+    LOG_INFOF("TEMP-SENSOR-HOUSE-KEEPING: Finished Temperature Sensor Verification");
+    LOG_INFOF("TEMP-SENSOR-HOUSE-KEEPING: Finished Temperature Sensor Housekeeping");
 
 }
 
 
-void curr_sensor_house_keeping(enum IRIS_ERROR *errorBuffer, uint8_t* errorCount){
+void curr_sensor_house_keeping(void){
 
     enum IRIS_ERROR errorCheck = NO_ERROR;
     int loopCounter = 0;
     uint8_t currAddr[3] = {CURRENT_SENSOR_ADDR_3V3, CURRENT_SENSOR_ADDR_5V,
                            CURRENT_SENSOR_ADDR_CAM};
 
-    log_write(LOG_INFO, "CURR-SENSOR-HOUSE-KEEPING: Started Current Sensor Housekeeping");
-    log_write(LOG_INFO, "CURR-SENSOR-HOUSE-KEEPING: Started Current Sensor Verification");
+    LOG_INFOF("CURR-SENSOR-HOUSE-KEEPING: Started Current Sensor Housekeeping");
+    LOG_INFOF("CURR-SENSOR-HOUSE-KEEPING: Started Current Sensor Verification");
 
     for (int x = 0; x < sizeof(currAddr); x++){
 
@@ -183,25 +187,54 @@ void curr_sensor_house_keeping(enum IRIS_ERROR *errorBuffer, uint8_t* errorCount
         
         loopCounter = 0;
         if(errorCheck != NO_ERROR){
-            errorBuffer[(*errorCount)++] = errorCheck;
+            error_record(errorCheck);
         }
     }
 
-    log_write(LOG_INFO, "CURR-SENSOR-HOUSE-KEEPING: Finished Current Sensor Verification");
+    LOG_INFOF("CURR-SENSOR-HOUSE-KEEPING: Finished Current Sensor Verification");
+    LOG_INFOF("CURR-SENSOR-HOUSE-KEEPING: Finished Current Sensor Housekeeping");
 
-    current_limit(errorBuffer, errorCount);
+}
 
-    log_write(LOG_INFO, "CURR-SENSOR-HOUSE-KEEPING: Finished Current Sensor Housekeeping");
+// Limit checks are made on the readings the sampler sweep just stored, the sensors are not read again
+void sensor_limit_house_keeping(void){
+
+    enum IRIS_ERROR limitErrors[SENSOR_NUM_TEMPS] = {NO_ERROR};
+    uint8_t numLimitErrors = 0;
+    sensor_snapshot_t snapshot;
+    int8_t temp[SENSOR_NUM_TEMPS] = {0};
+    uint16_t current[SENSOR_NUM_RAILS] = {0};
+    uint8_t currAddr[SENSOR_NUM_RAILS] = {CURRENT_SENSOR_ADDR_3V3, CURRENT_SENSOR_ADDR_5V,
+                                          CURRENT_SENSOR_ADDR_CAM};
+
+    // A failed read stores the driver's error value, which the checks report as a read error
+    for (uint8_t index = 0; index < SENSOR_NUM_TEMPS; index++){
+        sensor_cache_snapshot(SENSOR_TEMP_CHANNEL_START + index, &snapshot);
+        temp[index] = (int8_t)snapshot.value;
+    }
+    temperature_limit_check(temp, limitErrors, &numLimitErrors);
+    for (int index = 0; index < numLimitErrors; index++){
+        error_record(limitErrors[index]);
+    }
 
+    numLimitErrors = 0;
+    for (uint8_t rail = 0; rail < SENSOR_NUM_RAILS; rail++){
+        sensor_cache_snapshot(sensor_channel(SENSOR_CURRENT, currAddr[rail]), &snapshot);
+        current[rail] = snapshot.value;
+    }
+    current_limit_check(current, limitErrors, &numLimitErrors);
+    for (int index = 0; index < numLimitErrors; index++){
+        error_record(limitErrors[index]);
+    }
 }
 
 
-struct gpiod_line_request *gpio_init(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount) {
+struct gpiod_line_request *gpio_init(void) {
 
     struct gpiod_line_request *request = NULL;
     char *gpioDev = GPIOCHIP;
 
-    log_write(LOG_INFO, "GPIO-INIT: Start setup of GPIO interface");
+    LOG_INFOF("GPIO-INIT: Start setup of GPIO interface");
 
     int loopCounter = 0;
 
@@ -218,23 +251,23 @@ struct gpiod_line_request *gpio_init(enum IRIS_ERROR *errorBuffer, uint8_t *erro
     }while((request == NULL) && (loopCounter < MAX_GPIO_INIT_ATTEMPTS));
 
     if(request == NULL){
-        errorBuffer[(*errorCount)++] = GPIO_SETUP_ERROR;
+        error_record(GPIO_SETUP_ERROR);
     }
 
-    log_write(LOG_INFO, "GPIO-INIT: Completed setup attempt of GPIO interface");
+    LOG_INFOF("GPIO-INIT: Completed setup attempt of GPIO interface");
     return request;
 }
 
-void system_init(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount, struct gpiod_line_request *gpio_request) {
+void system_init(struct gpiod_line_request *gpio_request) {
 
-    log_write(LOG_INFO, "SYSTEM-INIT: Start System intialization process");
+    LOG_INFOF("SYSTEM-INIT: Start System intialization process");
 
-    temp_sensor_init(errorBuffer, errorCount);
-    current_monitor_init(errorBuffer, errorCount);
-    //usb_hub_init(errorBuffer, gpio_request);
+    temp_sensor_init();
+    current_monitor_init();
+    //usb_hub_init(gpio_request);
     //watchdog_setup();
 
-    log_write(LOG_INFO, "SYSTEM-INIT: Finished System intialization process");
+    LOG_INFOF("SYSTEM-INIT: Finished System intialization process");
 
 }
 
@@ -242,6 +275,7 @@ bool signal_edge_detect(struct gpiod_line_request *request, struct gpiod_edge_ev
     
     bool event = false;
     int event_amt = EDGE_EVENT_BUFF_SIZE;
+    uint64_t edgeNs = 0;
 
     // Check for signal event
     event = gpiod_line_request_wait_edge_events(request, 0); 
@@ -256,8 +290,18 @@ bool signal_edge_detect(struct gpiod_line_request *request, struct gpiod_edge_ev
     //! IF THE NUMBER OF EVENTS EQUALS THE BUFFER SIZE (EDGE_EVENT_BUFF_SIZE) THAN ON NEXT gpiod_lione_request_read_edge_events IT WILL GET STUCK
     for(int index = 0; (index < MAX_ITERATIONS) && (event_amt >= EDGE_EVENT_BUFF_SIZE); index++){
         event_amt = gpiod_line_request_read_edge_events(request, event_buffer, EDGE_EVENT_BUFF_SIZE);
+        if (event_amt > 0){
+            edgeNs = gpiod_edge_event_get_timestamp_ns(gpiod_edge_event_buffer_get_event(event_buffer, event_amt - 1));
+        }
     }
 
+    // Latest edge started the transaction about to be read, SYNC_TIME pairs it with the OBC time
+    clock_sync_edge(edgeNs);
+
+    // Edge to here is the main loop's wake latency, it shares the thread with housekeeping
+    if (edgeNs != 0){
+        metric_observe_ns(METRIC_HIST_CS_WAKE, get_time_monotonic_ns() - edgeNs);
+    }
     return true;
 }
 
@@ -276,10 +320,15 @@ IRIS_ERROR spi_cmd_loop(int spi_dev,
         cs_edge = signal_edge_detect(spi_cs_request, event_buffer);
 
         if (cs_edge == true){
+            TRACE_SCOPE("spi_cmd");
+
             error = spi_read(spi_dev, rx_buffer, SPI_RX_LEN, spi_cs_request);
             if(error != NO_ERROR){
                 return error;
             }
+            if (rx_buffer[0] == CMD_BATCH){
+                return cmd_batch_center(rx_buffer, SPI_RX_LEN, spi_dev, &spi_cs_request);
+            }
             narg = cmd_extracter(&cmd, arg, rx_buffer, SPI_RX_LEN);
             error = cmd_center(cmd, arg, narg, spi_dev, &spi_cs_request);
             return error;
@@ -288,20 +337,37 @@ IRIS_ERROR spi_cmd_loop(int spi_dev,
     return error;
 }
 
-void system_house_keeping(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount, struct gpiod_line_request *gpio_request){
+void system_house_keeping(struct gpiod_line_request *gpio_request){
+
+    TRACE_SCOPE("house_keeping");
+
+    // Sensor bus is shared with the job workers and CMD_FLAG_I2C_BUS commands
+    i2c_bus_lock();
 
     // Temperature Sensor 
-    temp_sensor_house_keeping(errorBuffer, errorCount);
+    temp_sensor_house_keeping();
 
     // Current Sensor 
-    curr_sensor_house_keeping(errorBuffer, errorCount);
+    curr_sensor_house_keeping();
+
+    // Refresh Sensor Snapshot Cache used to answer OBC telemetry commands, one read of every channel
+    sensor_sampler_sweep();
+
+    i2c_bus_unlock();
+
+    // Temperature and Current Limits
+    sensor_limit_house_keeping();
 
     // USB Hub House Keeping
-    //usb_hub_func_validate(errorBuffer, errorCount, gpio_request);
+    //usb_hub_func_validate(gpio_request);
 
     // GPIO House Keeping
     // errorCode = gpio_config_validate();
 
+    // Flight Recorder and Error History, bounds what a power loss can lose to one housekeeping period
+    flight_recorder_sync();
+    error_history_sync();
+
 }
 
 void led_toggle(uint8_t *led_status, struct gpiod_line_request *gpio_request){
@@ -334,22 +400,27 @@ int main(void){
     enum IRIS_ERROR spiInitError = NO_ERROR;
     enum IRIS_ERROR spiError = NO_ERROR;
 
-    uint8_t errorCount = 0;
-    enum IRIS_ERROR errorBuffer[ERROR_BUFFER_SIZE] = {NO_ERROR};
-    
     uint8_t led_status = 1;
     int spi_dev = 0;
-    int current_time = get_time_seconds();
+    uint64_t houseKeepingMs = get_time_monotonic_ms();
 
     atexit(clean_up);
 
     log_file_init();
+    flight_recorder_init(FLIGHT_BASENAME);
+    metrics_init();
+    error_history_init();
 
     spiInitError = spi_init(&spi_dev, &spi_cs_request, &event_buffer);
-    gpio_request = gpio_init(errorBuffer, &errorCount);
+    gpio_request = gpio_init();
+    cmd_controller_init(gpio_request);
+    job_engine_init();
 
     // System Init
-    system_init(errorBuffer, &errorCount, gpio_request);
+    system_init(gpio_request);
+
+    // Stays on SCHED_OTHER, the real-time profile is only for the dedicated SPI service. This loop
+    // also runs housekeeping, I2C sweeps and polls CS, at SCHED_FIFO it would starve its core.
 
     while(true){
 
@@ -357,17 +428,17 @@ int main(void){
             spiInitError = spi_init(&spi_dev, &spi_cs_request, &event_buffer);
         }else if(spiError != NO_ERROR){
 
-            spiInitError = spi_reinit(&spi_dev, &spi_cs_request, &event_buffer);
+            spiInitError = spi_recover(spiError, &spi_dev, &spi_cs_request, &event_buffer);
             spiError = NO_ERROR;
         }else{
 
             spiError = spi_cmd_loop(spi_dev, spi_cs_request, event_buffer);
 
-            if (get_time_seconds() > current_time + HOUSE_KEEPING_DELAY_S){
-                current_time = get_time_seconds();
+            if ((get_time_monotonic_ms() - houseKeepingMs) > (HOUSE_KEEPING_DELAY_S * 1000ULL)){
+                houseKeepingMs = get_time_monotonic_ms();
                 led_toggle(&led_status, gpio_request);
-                system_house_keeping(errorBuffer, &errorCount, gpio_request);
-                spiError = iris_error_transfer(spi_dev, spi_cs_request, errorBuffer, &errorCount);
+                system_house_keeping(gpio_request);
+                spiError = iris_error_report(spi_dev, spi_cs_request);
             }
 
         }
@@ -382,25 +453,26 @@ int main(void){
 int main(void){
     struct gpiod_line_request *gpio_request = NULL;
 
-    uint8_t errorCount = 0;
-    enum IRIS_ERROR errorBuffer[ERROR_BUFFER_SIZE] = {NO_ERROR};
-
     uint8_t led_status = 1;
 
-    key_t IPCKey = 0;
-    int ipcMsgID = 0;
+    ipc_link_t ipcLink;
     enum IRIS_ERROR ipcInitError = NO_ERROR;
 
-    int current_time = get_time_seconds();
+    uint64_t houseKeepingMs = get_time_monotonic_ms();
 
     log_file_init();
+    flight_recorder_init(FLIGHT_BASENAME);
+    metrics_init();
+    error_history_init();
 
-    gpio_request = gpio_init(errorBuffer, &errorCount);
+    gpio_request = gpio_init();
+    cmd_controller_init(gpio_request);
+    job_engine_init();
 
     // System Init
-    system_init(errorBuffer, &errorCount, gpio_request);
+    system_init(gpio_request);
     
-    ipcInitError = ipc_setup(&IPCKey, &ipcMsgID);
+    ipcInitError = ipc_link_setup(&ipcLink, IPC_SIDE_MAIN);
 
 
     // while (1) {
@@ -421,14 +493,19 @@ int main(void){
     while(true){
 
         if (ipcInitError != NO_ERROR) {
-            ipcInitError = ipc_setup(&IPCKey, &ipcMsgID);
+            usleep(IPC_SETUP_RETRY_MS * 1000);
+            ipcInitError = ipc_link_setup(&ipcLink, IPC_SIDE_MAIN);
         }else{
 
-            if (get_time_seconds() > current_time + HOUSE_KEEPING_DELAY_S){
-                current_time = get_time_seconds();
+            // Sleep until the SPI service forwards an OBC command or housekeeping is due
+            ipc_ring_wait(&ipcLink.rxRing, IPC_WAIT_MS);
+            ipc_main_service_commands(&ipcLink);
+
+            if ((get_time_monotonic_ms() - houseKeepingMs) > (HOUSE_KEEPING_DELAY_S * 1000ULL)){
+                houseKeepingMs = get_time_monotonic_ms();
                 led_toggle(&led_status, gpio_request);
-                system_house_keeping(errorBuffer, &errorCount, gpio_request);
-                iris_error_transfer_spi_service(ipcMsgID, errorBuffer, &errorCount);
+                system_house_keeping(gpio_request);
+                iris_error_transfer_spi_service(&ipcLink);
 
             }
         }
@@ -480,7 +557,7 @@ int main(void){
 //     struct msg_buffer message;
 
 //         //spiInitError = spi_init(&spi_dev, &spi_cs_request, &event_buffer);
-//         //gpio_request = gpio_init(errorBuffer, &errorCount);
+//         //gpio_request = gpio_init();
 
 //     // errorCheck = gpiod_line_request_set_value(gpio_request, PWR_5V_CAM_EN, GPIOD_LINE_VALUE_ACTIVE);
 //     // if (errorCheck == -1){
@@ -491,7 +568,7 @@ int main(void){
 //     IRIS_ERROR temp = 0;
 //     // System Init
 //     //usb_hub_func_TESTING(gpio_request);
-//         //system_init(errorBuffer, &errorCount, gpio_request);
+//         //system_init(gpio_request);
 
 //     //usb_hub_func_TESTING(gpio_request);
 //     //! MAYBE ADD RESET FOR COLD + HOT
@@ -35,6 +35,7 @@
 #define SPI_ERROR_TRANSFER_CMD 100
 #define HOUSE_KEEPING_DELAY_S 10
 #define ERROR_TRANSFER_TIMEOUT_S 10
+#define IPC_WAIT_MS 1000
 int main(void);
 enum IRIS_ERROR spi_cmd_loop(int spi_dev, 
                   struct gpiod_line_request *spi_cs_request, 
@@ -1,14 +1,20 @@
 
 #include "spi_iris.h"
 #include "logger.h"
+#include "clock_sync.h"
 #include "cmd_controller.h"
 
 #include "error_handler.h"
+#include "flight_recorder.h"
+#include "metrics.h"
+#include "rt_profile.h"
 
 
 #include "watchdog.h"
 #include "timing.h"
 #include "spi_service.h"
+#include "trace.h"
+#include "ipc_fd.h"
 #include "ipc_iris.h"
 #include "gpio.h"
 
@@ -16,10 +22,13 @@
 #include <stdint.h>
 #include <string.h>
 #include <gpiod.h>
+#include <signal.h>
 
 #include <stdbool.h>
 
 #include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
 
 #include <sys/ipc.h>
 #include <sys/msg.h>
@@ -45,12 +54,25 @@
 
 
 bool signal_edge_detect(struct gpiod_line_request *request, struct gpiod_edge_event_buffer *event_buffer){
+    return signal_edge_wait(request, event_buffer, 0);
+}
+
+/**
+ * @brief Waits for an edge on the CS line, clearing the event buffer if one occurred
+ *
+ * @param request CS line request
+ * @param event_buffer Edge event buffer of the CS line
+ * @param timeout_ns Max time to block waiting for an edge, 0 to return immediately
+ * @return True if an edge was detected
+ */
+bool signal_edge_wait(struct gpiod_line_request *request, struct gpiod_edge_event_buffer *event_buffer, int64_t timeout_ns){
     
     bool event = false;
     int event_amt = EDGE_EVENT_BUFF_SIZE;
+    uint64_t edgeNs = 0;
 
-    // Check for signal event
-    event = gpiod_line_request_wait_edge_events(request, 0); 
+    // Check for signal event, blocks for up to timeout_ns
+    event = gpiod_line_request_wait_edge_events(request, timeout_ns); 
     
     // Dont need to clear event buffer since no event occured
     if(event == false){
@@ -62,96 +84,207 @@ bool signal_edge_detect(struct gpiod_line_request *request, struct gpiod_edge_ev
     //! IF THE NUMBER OF EVENTS EQUALS THE BUFFER SIZE (EDGE_EVENT_BUFF_SIZE) THAN ON NEXT gpiod_lione_request_read_edge_events IT WILL GET STUCK
     for(int index = 0; (index < MAX_ITERATIONS) && (event_amt >= EDGE_EVENT_BUFF_SIZE); index++){
         event_amt = gpiod_line_request_read_edge_events(request, event_buffer, EDGE_EVENT_BUFF_SIZE);
+        if (event_amt > 0){
+            edgeNs = gpiod_edge_event_get_timestamp_ns(gpiod_edge_event_buffer_get_event(event_buffer, event_amt - 1));
+        }
     }
 
+    // Latest edge started the transaction about to be read, SYNC_TIME pairs it with the OBC time
+    clock_sync_edge(edgeNs);
+
+    // Edge to here is the SPI thread's wake latency, reduced by the real-time profile (See 'rt_profile.h')
+    if (edgeNs != 0){
+        metric_observe_ns(METRIC_HIST_CS_WAKE, get_time_monotonic_ns() - edgeNs);
+    }
     return true;
 }
 
-enum IRIS_ERROR ipc_spi_cmd_main(int ipcMsgID, uint8_t *rx_buffer, uint8_t rx_count){
+/**
+ * @brief Sends an error report queued by the Main service to the OBC and acknowledges the result
+ *
+ * @param link Pointer to IPC link
+ * @param spi_dev SPI device
+ * @param spi_cs_request SPI chip select
+ * @param payload Pointer to error summary frame in the ring (See 'error_summary')
+ * @param len Frame length in bytes
+ * @return Iris error code of the SPI transfer
+ */
+enum IRIS_ERROR ipc_error_report_spi(ipc_link_t *link, int spi_dev, struct gpiod_line_request *spi_cs_request, uint32_t requestId, const uint8_t *payload, uint32_t len){
+
+    uint8_t ackStatus = NO_ERROR;
+    IRIS_ERROR error = NO_ERROR;
+    bool sent = false;
+
+    error = iris_error_transfer(spi_dev, spi_cs_request, payload, (uint16_t)len, &sent);
 
-    struct msg_buffer ipc_message;
-    ipc_message.msg_type    = CMD_SPI_TO_MAIN;
-    ipc_message.msg_type_rx = CMD_MAIN_TO_SPI;
+    // Error counts are only cleared once the OBC received the summary
+    ackStatus = ((error != NO_ERROR) || !sent) ? ERROR_TRANSFER_FAIL : NO_ERROR;
+    ipc_ring_send(&link->txRing, ERROR_SPI_TO_MAIN, requestId, &ackStatus, sizeof(ackStatus));
+    return error;
+}
 
-    //Transfer RX_SPI Buffer content to MSG Structure
-    for (int index = 0; index < rx_count; index ++){
-        ipc_message.msg_text[index] = rx_buffer[index];
+/**
+ * @brief Waits for an edge on the CS line or for the Main service to queue a response, whichever
+ *        comes first. The Main service rings the doorbell after its commit (See 'ipc_fd_doorbell_ring'),
+ *        so a response is written as soon as it is ready instead of after the CS wait times out.
+ *
+ * @param link Pointer to IPC link
+ * @param request CS line request
+ * @param event_buffer Edge event buffer of the CS line
+ * @param timeout_ns Max time to block
+ * @return True if an edge was detected
+ */
+bool spi_cs_ring_wait(ipc_link_t *link, struct gpiod_line_request *request, struct gpiod_edge_event_buffer *event_buffer, int64_t timeout_ns){
+
+    struct pollfd fds[2] = {
+        {.fd = gpiod_line_request_get_fd(request), .events = POLLIN},
+        {.fd = link->doorbellSocket, .events = POLLIN},
+    };
+
+    // Registered before the ring is checked again, a response committed after the check rings the doorbell
+    ipc_ring_wait_begin(&link->rxRing);
+    if (ipc_ring_empty(&link->rxRing)){
+        poll(fds, 2, (int)(timeout_ns / 1000000));
     }
+    ipc_ring_wait_end(&link->rxRing);
+    ipc_fd_doorbell_clear(link);
+
+    return signal_edge_wait(request, event_buffer, 0);
+}
 
-    //Send data to CMD IPC Queue
-    if(msgsnd(ipcMsgID, &ipc_message, sizeof(ipc_message.msg_text), IPC_NOWAIT) == -1){
-        //! If fails that means Queue is full, therefore leave and try again later
-        //! NEED TO DETERMINE WHAT TO DO IF THIS OCCURS
-        //! MAYBE JUST HAVE IT CONTINUE
-        return NO_ERROR; 
+/**
+ * @brief Streams the bulk data the Main service passed for a response (IPC_RING_FLAG_BULK), called
+ *        right after the response so no later response can overtake it. Transfers left behind by
+ *        dropped responses are discarded on the way.
+ *
+ * @param link Pointer to IPC link
+ * @param spi_dev SPI device
+ * @param spi_cs_request SPI chip select
+ * @param requestId Request ID of the response the data follows
+ * @param stream False to only discard the transfer (Response was dropped or failed)
+ * @return Iris error code of the SPI transfer
+ */
+IRIS_ERROR spi_bulk_write(ipc_link_t *link, int spi_dev, struct gpiod_line_request *spi_cs_request, uint32_t requestId, bool stream){
+
+    ipc_fd_transfer_t transfer;
+    IRIS_ERROR error = NO_ERROR;
+
+    // Passed before its response was queued, so it is already waiting on the socket
+    while (ipc_fd_receive(link, &transfer)){
+        if (transfer.msg.requestId == requestId){
+            if (stream){
+                error = spi_fd_write(spi_dev, spi_cs_request, transfer.fd, transfer.msg.offset, transfer.msg.len);
+            }
+            close(transfer.fd);
+            return error;
+        }
+        LOG_WARNINGF("SPI-SERVICE: Dropped bulk transfer for IPC request %u", transfer.msg.requestId);
+        close(transfer.fd);
     }
-    return NO_ERROR;
-    // int start_time = get_time_seconds();
-    // //log_write(LOG_INFO, "SPI-BUS-TEST: Begin SPI bus test read from OBC");
-
-    // // Wait for a Period of Time to get reply from OBC
-    // do{
-        // if(msgrcv(ipcMsgID, &ipc_message, sizeof(ipc_message.msg_text), ipc_message.msg_type_rx, IPC_NOWAIT) != -1){
-        //     *count = ipc_message.msg_text[0];
-        //     for (int index = 0; index < *count; index ++){
-        //         rx_buffer[index] = ipc_message.msg_text[index + 1];
-        //     }
-        //     return NO_ERROR;
-        // }
-    // }while((get_time_seconds() - start_time) < CMD_TRANSFER_TIMEOUT_S);
-
-    // return NO_ERROR;
+    LOG_WARNINGF("SPI-SERVICE: Bulk transfer for IPC request %u is missing", requestId);
+    return error;
 }
 
-enum IRIS_ERROR ipc_main_cmd_spi(int ipcMsgID, uint8_t *tx_buffer, uint8_t *tx_count){
+/**
+ * @brief Services SPI_TRAIN in the SPI service, the only one with the bus. Training writes its own
+ *        frames, so it is only entered while the OBC has no other command outstanding, otherwise it
+ *        is answered IPC_BUSY_ERROR in order with the other responses and the OBC retries.
+ *
+ * @param link Pointer to IPC link
+ * @param spi_dev SPI device
+ * @param spi_cs_request SPI chip select
+ * @param requestId Request ID assigned to the command
+ * @param frame Pointer to received frame
+ * @param len Frame length in bytes
+ * @return Iris error code of the SPI transfer
+ */
+IRIS_ERROR spi_train_center(ipc_link_t *link, int spi_dev, struct gpiod_line_request *spi_cs_request, uint32_t requestId, const uint8_t *frame, uint8_t len){
 
-    struct msg_buffer ipc_message;
-    ipc_message.msg_type    = CMD_SPI_TO_MAIN;
-    ipc_message.msg_type_rx = CMD_MAIN_TO_SPI;
+    uint8_t cmd = 0;
+    uint8_t arg[SPI_RX_LEN] = {0};
+    int narg = 0;
 
-    if(msgrcv(ipcMsgID, &ipc_message, sizeof(ipc_message.msg_text), ipc_message.msg_type_rx, IPC_NOWAIT) != -1){
-        *tx_count = ipc_message.msg_text[0];
-        for (int index = 0; index < *tx_count; index ++){
-            tx_buffer[index] = ipc_message.msg_text[index + 1];
+    if ((link->numInFlight != 0) || (link->numBusyReplies != 0) || !ipc_ring_empty(&link->rxRing)){
+        if (!ipc_busy_reply_queue(link, requestId)){
+            LOG_WARNINGF("SPI-SERVICE: Busy reply queue full, IPC request %u is not answered", requestId);
         }
         return NO_ERROR;
     }
-    *tx_count = 0;
-    return NO_ERROR;
-}
 
+    narg = cmd_extracter(&cmd, arg, frame, len - 1);
+    return cmd_center(cmd, arg, narg, spi_dev, &spi_cs_request);
+}
 
 //! NEED TO DEAL WITH IPC FAIL
-IRIS_ERROR spi_read_loop(int ipcMsgID, int spi_dev, struct gpiod_line_request *spi_cs_request, struct gpiod_edge_event_buffer *event_buffer) {
+IRIS_ERROR spi_read_loop(ipc_link_t *link, int spi_dev, struct gpiod_line_request *spi_cs_request, struct gpiod_edge_event_buffer *event_buffer) {
 
     bool cs_edge = false;
     uint8_t rx_count = SPI_RX_LEN;
     uint8_t rx_buffer[SPI_RX_LEN] = {0};
+    uint8_t *payload = NULL;
+    uint32_t requestId = IPC_REQUEST_ID_NONE;
+    uint8_t numExpired = 0;
 
     IRIS_ERROR error = NO_ERROR;
 
-    for(int index = 0; (index < SPI_MAX_LOOP_AMT) && (cs_edge == false); index++){
-        cs_edge = signal_edge_detect(spi_cs_request, event_buffer);
+    // Requests the Main service never answered no longer count against the in flight limit
+    numExpired = ipc_request_expire(link);
+    if (numExpired != 0){
+        LOG_WARNINGF("SPI-SERVICE: %u IPC requests expired without a response", numExpired);
+    }
 
-        if (cs_edge == true){
-            error = spi_read(spi_dev, rx_buffer, rx_count, spi_cs_request);
-            if(error != NO_ERROR){
-                return error;
-            }
-            error = ipc_spi_cmd_main(ipcMsgID, rx_buffer, rx_count);
-            return error;
-        } 
+    // Sleep on the CS line and the doorbell instead of spinning, only poll when responses are waiting to be written
+    if (ipc_ring_empty(&link->rxRing) && !ipc_busy_reply_due(link)){
+        cs_edge = spi_cs_ring_wait(link, spi_cs_request, event_buffer, SPI_EDGE_WAIT_NS);
+    }else{
+        cs_edge = signal_edge_wait(spi_cs_request, event_buffer, 0);
+    }
+    if (cs_edge == false){
+        return error;
     }
+    TRACE_SCOPE("spi_rx_cmd");
+
+    // Command is read straight into the ring, no copy on the way to the Main service
+    requestId = ipc_request_id_next(link);
+    payload = ipc_request_available(link) ? ipc_ring_reserve(&link->txRing, CMD_SPI_TO_MAIN, requestId, rx_count) : NULL;
+
+    // Too many commands in flight, the command is read and the OBC is told to retry
+    if (payload == NULL){
+        error = spi_read(spi_dev, rx_buffer, rx_count, spi_cs_request);
+        if ((error == NO_ERROR) && !ipc_busy_reply_queue(link, requestId)){
+            LOG_WARNINGF("SPI-SERVICE: Busy reply queue full, IPC request %u is not answered", requestId);
+        }
+        return error;
+    }
+
+    // An uncommitted reservation is simply reused by the next command
+    error = spi_read(spi_dev, payload, rx_count, spi_cs_request);
+    if(error != NO_ERROR){
+        return error;
+    }
+
+    // Link training needs the bus, it is serviced here instead of being forwarded (See 'spi_train.h')
+    if (payload[0] == SPI_TRAIN){
+        return spi_train_center(link, spi_dev, spi_cs_request, requestId, payload, rx_count);
+    }
+    ipc_request_track(link, requestId);
+    ipc_ring_set_timestamp(&link->txRing, clock_sync_edge_get());
+    ipc_ring_commit(&link->txRing, rx_count);
     return error;
 }
 
-//! NEED TO BE ABLE TO DETERMINE WHAT TO DO IF THE BUFFER IS FULL
 //! NEED TO DETERMINE WHAT TO DO IF SPI FAILS EVEN WITH DATA
 
-IRIS_ERROR spi_write_loop(int ipcMsgID, int spi_dev, struct gpiod_line_request *spi_cs_request, struct gpiod_edge_event_buffer *event_buffer) {
+IRIS_ERROR spi_write_loop(ipc_link_t *link, int spi_dev, struct gpiod_line_request *spi_cs_request, struct gpiod_edge_event_buffer *event_buffer) {
 
-    uint8_t tx_count = 0;
-    uint8_t tx_buffer[SPI_BUFFER_LEN] = {};
+    const uint8_t *payload = NULL;
+    uint16_t label = 0;
+    uint32_t requestId = IPC_REQUEST_ID_NONE;
+    uint32_t len = 0;
+    uint8_t busyReply[2] = {CMD_RETURN, IPC_BUSY_ERROR};
+    bool complete = false;
+    IRIS_ERROR bulkError = NO_ERROR;
+    uint8_t bulkStatus = NO_ERROR;
 
     enum gpiod_line_value csVal = GPIOD_LINE_VALUE_INACTIVE;
     IRIS_ERROR error = NO_ERROR;
@@ -161,15 +294,47 @@ IRIS_ERROR spi_write_loop(int ipcMsgID, int spi_dev, struct gpiod_line_request *
     // Only Proceed with transfer if CS Line is inactive
     if (csVal == GPIOD_LINE_VALUE_ACTIVE){
 
-        error = ipc_main_cmd_spi(ipcMsgID, tx_buffer, &tx_count);
+        // Commands turned away never reached the Main service, they are answered once every
+        // command the OBC sent before them has been answered
+        if (ipc_busy_reply_due(link)){
+            ipc_busy_reply_pop(link);
+            return spi_write(spi_dev, busyReply, sizeof(busyReply), spi_cs_request);
+        }
 
-        if (tx_count != 0){
-            error = spi_write(spi_dev, tx_buffer, tx_count, spi_cs_request);
-            if(error != NO_ERROR){
-                return error;
-            }
+        payload = ipc_ring_peek(&link->rxRing, &label, &requestId, &len);
+        if (payload == NULL){
             return error;
-        } 
+        }
+
+        // Responses are written to the bus straight from the ring
+        TRACE_SCOPE_ARG("spi_tx_response", label);
+        switch (label){
+            case CMD_MAIN_TO_SPI:
+                // Responses to expired or unknown requests are stale, the OBC has moved on
+                complete = ipc_request_complete(link, requestId);
+                if (!complete){
+                    LOG_WARNINGF("SPI-SERVICE: Dropped response to unknown IPC request %u", requestId);
+                }else if (len != 0){
+                    error = spi_write(spi_dev, payload, len, spi_cs_request);
+                }
+
+                // Bulk data is never in the ring, it is streamed from the file passed by the Main service
+                if (ipc_ring_flags(&link->rxRing) & IPC_RING_FLAG_BULK){
+                    bulkError = spi_bulk_write(link, spi_dev, spi_cs_request, requestId, complete && (error == NO_ERROR));
+                    error = (error == NO_ERROR) ? bulkError : error;
+
+                    // The Main service only discards exported data once it reached the OBC
+                    bulkStatus = (complete && (error == NO_ERROR)) ? NO_ERROR : SPI_FILE_WRITE_ERROR;
+                    ipc_ring_send(&link->txRing, BULK_SPI_TO_MAIN, requestId, &bulkStatus, sizeof(bulkStatus));
+                }
+                break;
+            case ERROR_MAIN_TO_SPI:
+                error = ipc_error_report_spi(link, spi_dev, spi_cs_request, requestId, payload, len);
+                break;
+            default:
+                break;
+        }
+        ipc_ring_release(&link->rxRing);
     }
     return error;
 }
@@ -185,28 +350,30 @@ int main(void){
     enum IRIS_ERROR spiError = NO_ERROR;
     enum IRIS_ERROR ipcInitError = NO_ERROR;
 
-    uint8_t errorCount = 0;
-    enum IRIS_ERROR errorBuffer[ERROR_BUFFER_SIZE] = {NO_ERROR};
-
-    key_t IPCKey = 0;
-    int ipcMsgID = 0;
+    ipc_link_t ipcLink;
+    rt_profile_t rtProfile;
 
     int spi_dev = 0;
 
+    // Main service owns LOG_BASENAME, keep the SPI service's messages in their own segments
+    log_set_basename(LOG_SPI_BASENAME);
+    flight_recorder_init(FLIGHT_SPI_BASENAME);
+    metrics_init();
+
+    // SPI service does not serve commands, 'kill -USR1' writes its trace spans to TRACE_SPI_FILENAME
+    trace_signal_setup(SIGUSR1);
+
     spiInitError = spi_init(&spi_dev, &spi_cs_request, &event_buffer);
 
-    ipcInitError = ipc_setup(&IPCKey, &ipcMsgID);
+    ipcInitError = ipc_link_setup(&ipcLink, IPC_SIDE_SPI);
+
+    // Failures are logged, the Main service's error table does not cover this service
+    rt_profile_load(&rtProfile);
+    rt_profile_apply(&rtProfile);
 
     //! MAYBE ADD RESET FOR COLD + HOT
     //! MAYBE ADD AN ERROR STATE WHICH WAIT X AMOUNT OF TIME UNTIL A COMMAND IS RECEIVED FROM OC BEFORE DOING A RESTARBT
     //! ADD WATCHDOG
-    struct msg_buffer ipc_message_error;
-    ipc_message_error.msg_type    = ERROR_SPI_TO_MAIN;
-    ipc_message_error.msg_type_rx = ERROR_MAIN_TO_SPI;
-    
-    struct msg_buffer ipc_message_cmd;
-    ipc_message_cmd.msg_type    = CMD_SPI_TO_MAIN;
-    ipc_message_cmd.msg_type_rx = CMD_MAIN_TO_SPI;
 
     while(true){
 
@@ -214,24 +381,23 @@ int main(void){
             spiInitError = spi_init(&spi_dev, &spi_cs_request, &event_buffer);
         }else if(spiError != NO_ERROR){
 
-            spiInitError = spi_reinit(&spi_dev, &spi_cs_request, &event_buffer);
+            spiInitError = spi_recover(spiError, &spi_dev, &spi_cs_request, &event_buffer);
             spiError = NO_ERROR;
 
+        }else if(ipcInitError != NO_ERROR){
+            usleep(IPC_SETUP_RETRY_MS * 1000);
+            ipcInitError = ipc_link_setup(&ipcLink, IPC_SIDE_SPI);
         }else{
 
-            //spiError = spi_cmd_loop(spi_dev, spi_cs_request, event_buffer);
-
-
-        // snprintf(message_error.msg_text, sizeof(message_error.msg_text), "Service 2 Sending %d and %d\n", x--, y++);
-
-        // if (msgrcv(ipcMsgID, &message_cmd, sizeof(message_cmd.msg_text), 1, IPC_NOWAIT) != -1) {
-        //     printf("Service 2 received: %s\n", message_cmd.msg_text);
-        // }
-
-        // if(msgsnd(ipcMsgID, &message_error, sizeof(message_error.msg_text), 0) != -1){
-        //     printf("Service 2 sent: %s\n", message_error.msg_text);
+            // Forward OBC commands to the Main service, then return any queued responses
+            spiError = spi_read_loop(&ipcLink, spi_dev, spi_cs_request, event_buffer);
+            if (spiError == NO_ERROR){
+                spiError = spi_write_loop(&ipcLink, spi_dev, spi_cs_request, event_buffer);
+            }
         }
 
-        
+        if (trace_signal_pending()){
+            trace_export_file(LOG_DIRECTORY "/" TRACE_SPI_FILENAME);
+        }
     }
 }
@@ -22,8 +22,8 @@
 
 #define MAX_ITERATIONS 100
 #define EDGE_EVENT_BUFF_SIZE 255
-#define SPI_MAX_LOOP_AMT 65535
 #define SPI_RX_LEN 255
+#define SPI_EDGE_WAIT_NS 100000000 // Max time the SPI service sleeps waiting for CS when idle (100ms)
 
 #define MAX_TEMP_INIT_ATTEMPTS 5
 #define MAX_CURR_INIT_ATTEMPTS 5
@@ -41,6 +41,7 @@ enum IRIS_ERROR spi_cmd_loop(int spi_dev,
                   struct gpiod_line_request *spi_cs_request, 
                   struct gpiod_edge_event_buffer *event_buffer);
 bool signal_edge_detect(struct gpiod_line_request *request, struct gpiod_edge_event_buffer *event_buffer);
+bool signal_edge_wait(struct gpiod_line_request *request, struct gpiod_edge_event_buffer *event_buffer, int64_t timeout_ns);
 struct gpiod_line_request *gpio_setup(enum IRIS_ERROR *errorBuffer);
 //void system_house_keeping(void);
 #endif //SPI_SERVICE_H
@@ -0,0 +1,310 @@
+/**
+ * @file clock_sync.c
+ * @author agent
+ * @brief Clock Discipline for Theia CM4
+ *        Provides functions to...
+ *         - Record the kernel timestamp of the CS edge that started the current command
+ *         - Fit OBC time against the raw oscillator over the recent sync pulses (offset + drift)
+ *         - Reject outlier pulses and restart the fit if the OBC clock changes
+ *         - Slew CLOCK_REALTIME with adjtimex and correct its frequency, stepping only large offsets
+ *         - Report the sync quality (state, offset, drift, fit residual)
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "clock_sync.h"
+#include "error_handler.h"
+#include "logger.h"
+#include "timing.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timex.h>
+#include <time.h>
+
+typedef struct {
+    uint64_t rawNs;             // CLOCK_MONOTONIC_RAW time of the edge
+    int64_t deltaNs;            // OBC time - rawNs
+} clock_sync_point_t;
+
+typedef struct {
+    int64_t interceptNs;        // OBC time - raw time at the newest point
+    double slope;               // d(OBC - raw) / d(raw), drift as a fraction
+    double rmsNs;
+    bool driftFitted;           // False if the slope is the prior
+} clock_sync_fit_t;
+
+static clock_sync_point_t clockSyncPoints[CLOCK_SYNC_MAX_SAMPLES];
+static uint8_t numClockSyncPoints = 0;
+static uint8_t numConsecutiveRejects = 0;
+static clock_sync_status_t clockSyncStatus = {CLOCK_SYNC_UNSYNCED, 0, 0, 0, 0, 0, 0};
+static pthread_mutex_t clockSyncLock = PTHREAD_MUTEX_INITIALIZER;
+
+// CS edge of the command being executed by this thread
+static __thread uint64_t clockSyncEdgeNs = 0;
+
+
+static uint64_t clock_sync_read(clockid_t clock){
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Stores the CLOCK_MONOTONIC timestamp of the CS edge that started the command about to be
+ *        executed on this thread, read back by the SYNC_TIME handler
+ *
+ * @param edgeNs Edge timestamp in nano-seconds, 0 if unknown
+ */
+void clock_sync_edge(uint64_t edgeNs){
+    clockSyncEdgeNs = edgeNs;
+}
+
+/**
+ * @brief Returns the CS edge timestamp stored by 'clock_sync_edge' on this thread
+ *
+ * @return Edge timestamp in nano-seconds, 0 if unknown
+ */
+uint64_t clock_sync_edge_get(void){
+    return clockSyncEdgeNs;
+}
+
+/**
+ * @brief Least squares fit of (OBC - raw) against raw time over the stored points. With too short a
+ *        span the drift is not observable and 'prior' is used as the slope.
+ *
+ * @param fit Pointer to structure that will store the fit
+ * @param prior Slope used when the points span less than CLOCK_SYNC_MIN_SPAN_S
+ */
+static void clock_sync_fit(clock_sync_fit_t *fit, double prior){
+
+    const clock_sync_point_t *newest = &clockSyncPoints[numClockSyncPoints - 1];
+    double x[CLOCK_SYNC_MAX_SAMPLES];
+    double y[CLOCK_SYNC_MAX_SAMPLES];
+    double xMean = 0;
+    double yMean = 0;
+    double sxx = 0;
+    double sxy = 0;
+    double sumSq = 0;
+    double residual = 0;
+    double intercept = 0;
+
+    // Relative to the newest point so the doubles keep nano-second resolution
+    for (uint8_t index = 0; index < numClockSyncPoints; index++){
+        x[index] = (double)(int64_t)(clockSyncPoints[index].rawNs - newest->rawNs);
+        y[index] = (double)(clockSyncPoints[index].deltaNs - newest->deltaNs);
+        xMean += x[index];
+        yMean += y[index];
+    }
+    xMean /= numClockSyncPoints;
+    yMean /= numClockSyncPoints;
+
+    for (uint8_t index = 0; index < numClockSyncPoints; index++){
+        sxx += (x[index] - xMean) * (x[index] - xMean);
+        sxy += (x[index] - xMean) * (y[index] - yMean);
+    }
+
+    fit->slope = prior;
+    fit->driftFitted = (numClockSyncPoints >= 2) && (-x[0] >= (CLOCK_SYNC_MIN_SPAN_S * 1e9)) && (sxx > 0);
+    if (fit->driftFitted){
+        fit->slope = sxy / sxx;
+    }
+    intercept = yMean - (fit->slope * xMean);
+
+    for (uint8_t index = 0; index < numClockSyncPoints; index++){
+        residual = y[index] - (intercept + (fit->slope * x[index]));
+        sumSq += residual * residual;
+    }
+    fit->rmsNs = (numClockSyncPoints >= 3) ? sqrt(sumSq / (numClockSyncPoints - 2)) : 0;
+    fit->interceptNs = newest->deltaNs + (int64_t)llround(intercept);
+}
+
+/**
+ * @brief OBC time predicted by the fit at a raw time
+ *
+ * @param fit Pointer to fit
+ * @param rawNs CLOCK_MONOTONIC_RAW time in nano-seconds
+ * @return Predicted OBC time in nano-seconds
+ */
+static uint64_t clock_sync_predict(const clock_sync_fit_t *fit, uint64_t rawNs){
+    int64_t dx = (int64_t)(rawNs - clockSyncPoints[numClockSyncPoints - 1].rawNs);
+    return rawNs + (uint64_t)(fit->interceptNs + (int64_t)llround(fit->slope * (double)dx));
+}
+
+/**
+ * @brief Applies the fit to the kernel clock, sets the frequency correction, then steps or slews
+ *        CLOCK_REALTIME onto the predicted OBC time
+ *
+ * @param fit Pointer to fit
+ * @return Iris error code indicating the success or failure of function
+ */
+static enum IRIS_ERROR clock_sync_apply(const clock_sync_fit_t *fit){
+
+    struct timex tx;
+    struct timespec ts;
+    int64_t offsetNs = 0;
+    uint64_t targetNs = 0;
+    uint64_t rawNs = 0;
+    uint64_t realNs = 0;
+
+    memset(&tx, 0, sizeof(tx));
+    if (fit->driftFitted){
+        // 'freq' is in ppm with a 16 bit fraction
+        tx.modes = ADJ_FREQUENCY;
+        tx.freq = (long)llround(fit->slope * 1e6 * 65536.0);
+        if (adjtimex(&tx) < 0){
+            LOG_ERRORF("CLOCK-SYNC: Failed to set frequency correction");
+            return CLOCK_SYNC_ERROR;
+        }
+    }
+
+    rawNs = clock_sync_read(CLOCK_MONOTONIC_RAW);
+    realNs = clock_sync_read(CLOCK_REALTIME);
+    targetNs = clock_sync_predict(fit, rawNs);
+    offsetNs = (int64_t)(targetNs - realNs);
+
+    if (llabs(offsetNs) > CLOCK_SYNC_STEP_NS){
+        ts.tv_sec = (time_t)(targetNs / 1000000000ULL);
+        ts.tv_nsec = (long)(targetNs % 1000000000ULL);
+        if (clock_settime(CLOCK_REALTIME, &ts) != 0){
+            LOG_ERRORF("CLOCK-SYNC: Failed to step clock by %lld ns", (long long)offsetNs);
+            return CLOCK_SYNC_ERROR;
+        }
+        LOG_INFOF("CLOCK-SYNC: Stepped clock by %lld ms", (long long)(offsetNs / 1000000LL));
+    }else{
+        // Replaces any slew still in progress, the kernel slews at up to 500 ppm
+        memset(&tx, 0, sizeof(tx));
+        tx.modes = ADJ_OFFSET_SINGLESHOT;
+        tx.offset = (long)(offsetNs / 1000LL);
+        if (adjtimex(&tx) < 0){
+            LOG_ERRORF("CLOCK-SYNC: Failed to slew clock by %lld us", (long long)(offsetNs / 1000LL));
+            return CLOCK_SYNC_ERROR;
+        }
+    }
+
+    // Mark the kernel clock as synchronised with the fit residual as its estimated error
+    memset(&tx, 0, sizeof(tx));
+    if (adjtimex(&tx) >= 0){
+        tx.modes = ADJ_STATUS | ADJ_ESTERROR | ADJ_MAXERROR;
+        tx.status &= ~STA_UNSYNC;
+        tx.esterror = (long)(fit->rmsNs / 1000.0);
+        tx.maxerror = tx.esterror + (long)(llabs(offsetNs) / 1000LL);
+        adjtimex(&tx);
+    }
+    return NO_ERROR;
+}
+
+/**
+ * @brief Adds a sync pulse to the fit and disciplines CLOCK_REALTIME
+ *
+ * @param edgeNs CLOCK_MONOTONIC timestamp of the pulse edge (See 'clock_sync_edge')
+ * @param obcNs OBC realtime at the pulse edge in nano-seconds
+ * @return Iris error code indicating the success or failure of function, CLOCK_SYNC_ERROR if the
+ *         edge is unknown, the sample was rejected as an outlier or the clock could not be adjusted
+ */
+enum IRIS_ERROR clock_sync_sample(uint64_t edgeNs, uint64_t obcNs){
+
+    clock_sync_fit_t fit;
+    clock_sync_point_t point;
+    clock_sync_status_t status;
+    enum IRIS_ERROR error = NO_ERROR;
+    uint64_t monoNs = clock_sync_read(CLOCK_MONOTONIC);
+    uint64_t rawNs = clock_sync_read(CLOCK_MONOTONIC_RAW);
+    uint64_t realNs = clock_sync_read(CLOCK_REALTIME);
+    uint8_t numExpired = 0;
+    double limitNs = 0;
+    double prior = 0;
+    int64_t residualNs = 0;
+
+    if ((edgeNs == 0) || (edgeNs > monoNs) || (obcNs == 0)){
+        LOG_WARNINGF("CLOCK-SYNC: Sync pulse without a valid edge timestamp");
+        return CLOCK_SYNC_ERROR;
+    }
+
+    // Edge time on the raw and realtime clocks, both sampled against the same 'now'
+    point.rawNs = rawNs - (monoNs - edgeNs);
+    point.deltaNs = (int64_t)(obcNs - point.rawNs);
+
+    pthread_mutex_lock(&clockSyncLock);
+    prior = (double)clockSyncStatus.driftPpb / 1e9;
+
+    while ((numExpired < numClockSyncPoints) &&
+           ((point.rawNs - clockSyncPoints[numExpired].rawNs) > ((uint64_t)CLOCK_SYNC_MAX_AGE_S * 1000000000ULL))){
+        numExpired++;
+    }
+    if (numExpired != 0){
+        numClockSyncPoints -= numExpired;
+        memmove(clockSyncPoints, &clockSyncPoints[numExpired], numClockSyncPoints * sizeof(clock_sync_point_t));
+    }
+
+    // Outlier check against the existing fit, repeated outliers mean the OBC clock itself moved
+    if (numClockSyncPoints >= 4){
+        clock_sync_fit(&fit, prior);
+        residualNs = (int64_t)(obcNs - clock_sync_predict(&fit, point.rawNs));
+        limitNs = fmax((double)CLOCK_SYNC_OUTLIER_NS, 4.0 * fit.rmsNs);
+        if (fabs((double)residualNs) > limitNs){
+            clockSyncStatus.numRejected++;
+            if (++numConsecutiveRejects < CLOCK_SYNC_MAX_REJECTS){
+                pthread_mutex_unlock(&clockSyncLock);
+                LOG_WARNINGF("CLOCK-SYNC: Rejected sync pulse, residual %lld us", (long long)(residualNs / 1000LL));
+                return CLOCK_SYNC_ERROR;
+            }
+            LOG_WARNINGF("CLOCK-SYNC: %u consecutive outliers, restarting fit", numConsecutiveRejects);
+            numClockSyncPoints = 0;
+        }
+    }
+    numConsecutiveRejects = 0;
+
+    if (numClockSyncPoints == CLOCK_SYNC_MAX_SAMPLES){
+        numClockSyncPoints--;
+        memmove(clockSyncPoints, &clockSyncPoints[1], numClockSyncPoints * sizeof(clock_sync_point_t));
+    }
+    clockSyncPoints[numClockSyncPoints++] = point;
+
+    clock_sync_fit(&fit, prior);
+    if (fabs(fit.slope) > (CLOCK_SYNC_MAX_DRIFT_PPB / 1e9)){
+        fit.slope = (fit.slope > 0) ? (CLOCK_SYNC_MAX_DRIFT_PPB / 1e9) : -(CLOCK_SYNC_MAX_DRIFT_PPB / 1e9);
+    }
+
+    clockSyncStatus.offsetNs = (int64_t)(obcNs - (realNs - (monoNs - edgeNs)));
+    clockSyncStatus.driftPpb = (int32_t)llround(fit.slope * 1e9);
+    clockSyncStatus.rmsNs = (fit.rmsNs > UINT32_MAX) ? UINT32_MAX : (uint32_t)fit.rmsNs;
+    clockSyncStatus.numSamples = numClockSyncPoints;
+    clockSyncStatus.lastSyncMs = monoNs / 1000000ULL;
+
+    status = clockSyncStatus;
+
+    error = clock_sync_apply(&fit);
+    if (error == NO_ERROR){
+        clockSyncStatus.state = (numClockSyncPoints >= 2) ? CLOCK_SYNC_TRACKING : CLOCK_SYNC_STEPPED;
+    }
+    pthread_mutex_unlock(&clockSyncLock);
+
+    LOG_DEBUGF("CLOCK-SYNC: Offset %lld us, drift %d ppb, rms %u ns over %u samples",
+               (long long)(status.offsetNs / 1000LL), status.driftPpb, status.rmsNs, status.numSamples);
+    return error;
+}
+
+/**
+ * @brief Copies out the sync quality
+ *
+ * @param status Pointer to structure that will store the status
+ */
+void clock_sync_status(clock_sync_status_t *status){
+
+    pthread_mutex_lock(&clockSyncLock);
+    *status = clockSyncStatus;
+    pthread_mutex_unlock(&clockSyncLock);
+
+    if ((status->lastSyncMs != 0) && ((get_time_monotonic_ms() - status->lastSyncMs) > (CLOCK_SYNC_LOST_S * 1000ULL))){
+        status->state = CLOCK_SYNC_LOST;
+    }
+}
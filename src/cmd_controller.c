@@ -1,15 +1,36 @@
 
+#include "clock_sync.h"
 #include "cmd_controller.h"
 #include "current_sensor.h"
 #include "error_handler.h"
+#include "flight_recorder.h"
+#include "i2c.h"
+#include "job_engine.h"
+#include "log_export.h"
+#include "logger.h"
+#include "main.h"
+#include "metrics.h"
+#include "sensor_cache.h"
 #include "spi_iris.h"
+#include "spi_train.h"
+#include "telemetry_block.h"
 #include "temp_read.h"
+#include "timing.h"
+#include "trace.h"
+#include "usb_hub.h"
 
 #include <gpiod.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+static struct gpiod_line_request *cmdGpioRequest = NULL;
+
+// Bulk transfer attached by the command being serviced on this thread
+static __thread cmd_bulk_t cmdBulk = {-1, 0, NULL};
 
 uint8_t cmd_to_current_addr(uint8_t arg){
 
@@ -56,255 +77,922 @@ IRIS_ERROR current_val_error_16bit_to_8bit(IRIS_ERROR error){
 
 }
 
+/**
+ * @brief Checks if the OBC requested a live sensor read instead of a cached snapshot.
+ *        Set by sending CMD_ARG_FORCE_LIVE as the second argument of a sensor read command.
+ *
+ * @param args Pointer to array of command arguments
+ * @param nargs Index of the last argument (As returned by 'cmd_extracter')
+ * @return True if a live read is required
+ */
+bool cmd_force_live(const uint8_t *args, int nargs){
+    return (nargs >= 1) && (args[1] == CMD_ARG_FORCE_LIVE);
+}
+
 IRIS_ERROR cmd_return(int spi_dev, struct gpiod_line_request **spi_cs_request, uint8_t *buffer, uint8_t numWrites){
     return spi_write(spi_dev, buffer, numWrites, *spi_cs_request);
 }
 
-IRIS_ERROR cmd_center(uint8_t cmd, uint8_t *args, int nargs, int spi_dev, struct gpiod_line_request **spi_cs_request){
+//////////////////////////////////////// Command Handlers ////////////////////////////////////////
+
+static enum IRIS_ERROR cmd_handle_unsupported(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+    (void)request;
+    response[1] = CMD_UNSUPPORTED_ERROR;
+    *responseLen = 2;
+    return CMD_UNSUPPORTED_ERROR;
+}
+
+static enum IRIS_ERROR cmd_handle_curr_setup(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+    response[1] = current_setup(request->addr);
+    *responseLen = 2;
+    return response[1];
+}
+
+static enum IRIS_ERROR cmd_handle_curr_validate(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+    response[1] = current_func_validate(request->addr);
+    *responseLen = 2;
+    return response[1];
+}
+
+static enum IRIS_ERROR cmd_handle_curr_reset(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+    response[1] = current_monitor_reset(request->addr);
+    *responseLen = 2;
+    return response[1];
+}
+
+// Serves Current / Voltage / Power / Peak Power reads, 'param' holds the SENSOR_KIND
+static enum IRIS_ERROR cmd_handle_curr_read(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+
+    uint16_t dataBuf = 0;
+
+    sensor_cache_read(sensor_channel(request->param, request->addr), sensor_cache_max_age_ms(request->cmd), cmd_force_live(request->args, request->nargs), &dataBuf);
+
+    if ((dataBuf == CURR1_VAL_READ_ERROR_16BIT) ||
+        (dataBuf == CURR2_VAL_READ_ERROR_16BIT) ||
+        (dataBuf == CURR3_VAL_READ_ERROR_16BIT)){
+
+        response[1] = current_val_error_16bit_to_8bit(dataBuf);
+        *responseLen = 2;
+        return response[1];
+    }
+    response[1] = NO_ERROR;
+    response[2] = (dataBuf >> 8) & 0xFF;  // MSB
+    response[3] =  dataBuf & 0xFF;        // LSB
+    *responseLen = 4;
+    return NO_ERROR;
+}
+
+static enum IRIS_ERROR cmd_handle_curr_limit(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+
+    uint8_t numLimitErrors = 0;
+    enum IRIS_ERROR limitErrors[RETURN_CMD_SIZE] = {NO_ERROR};
+
+    (void)request;
+    current_limit(limitErrors, &numLimitErrors);
+
+    if(numLimitErrors == 0){
+        response[1] = NO_ERROR;
+        numLimitErrors = 1;
+    }else{
+        for(int index = 0; index < numLimitErrors; index++){
+            response[index+1] = limitErrors[index];
+        }
+    }
+    *responseLen = 1 + numLimitErrors;
+    return limitErrors[0];
+}
+
+static enum IRIS_ERROR cmd_handle_temp_setup(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+    response[1] = temp_setup(request->addr);
+    *responseLen = 2;
+    return response[1];
+}
+
+static enum IRIS_ERROR cmd_handle_temp_validate(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+    response[1] = temp_func_validate(request->addr);
+    *responseLen = 2;
+    return response[1];
+}
+
+static enum IRIS_ERROR cmd_handle_temp_reset(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+    response[1] = temp_reset(request->addr);
+    *responseLen = 2;
+    return response[1];
+}
+
+static enum IRIS_ERROR cmd_handle_temp_read(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
 
-    int ncmdArg = 0;
-    uint8_t addr = 0;
     uint16_t dataBuf = 0;
+
+    sensor_cache_read(sensor_channel(SENSOR_TEMP, request->addr), sensor_cache_max_age_ms(request->cmd), cmd_force_live(request->args, request->nargs), &dataBuf);
+    response[2] = (uint8_t)dataBuf;
+
+    if ((response[2] == TEMP1_TEMP_READ_ERROR) ||
+        (response[2] == TEMP2_TEMP_READ_ERROR) ||
+        (response[2] == TEMP3_TEMP_READ_ERROR) ||
+        (response[2] == TEMP4_TEMP_READ_ERROR)){
+
+        response[1] = response[2];
+        *responseLen = 2;
+        return response[1];
+    }
+
+    response[1] = NO_ERROR;
+    *responseLen = 3;
+    return NO_ERROR;
+}
+
+static enum IRIS_ERROR cmd_handle_temp_limit(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+
+    uint8_t numLimitErrors = 0;
+    enum IRIS_ERROR limitErrors[RETURN_CMD_SIZE] = {NO_ERROR};
+
+    (void)request;
+    temperature_limit(limitErrors, &numLimitErrors);
+
+    for(int index = 0; index < numLimitErrors; index++){
+        response[index+1] = limitErrors[index];
+    }
+    *responseLen = 1 + numLimitErrors;
+    return limitErrors[0];
+}
+
+static enum IRIS_ERROR cmd_handle_usb_hub_setup(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+    (void)request;
+    response[1] = usb_hub_setup();
+    *responseLen = 2;
+    return response[1];
+}
+
+static enum IRIS_ERROR cmd_handle_usb_hub_validate(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+    (void)request;
+    response[1] = (cmdGpioRequest == NULL) ? USB_HUB_VERIFICATION_ERROR : usb_hub_func_validate(cmdGpioRequest);
+    *responseLen = 2;
+    return response[1];
+}
+
+static enum IRIS_ERROR cmd_handle_usb_hub_reset(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+    (void)request;
+    response[1] = (cmdGpioRequest == NULL) ? USB_HUB_RESET_ERROR : usb_hub_reset_trig(cmdGpioRequest);
+    *responseLen = 2;
+    return response[1];
+}
+
+// Writes the error summary frame to the SPI bus itself (See 'error_summary'), no response is returned through the dispatcher
+static enum IRIS_ERROR cmd_handle_error_transfer(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+
+    (void)response;
+    *responseLen = 0;
+    return iris_error_report(request->spi_dev, *request->spi_cs_request);
+}
+
+static enum IRIS_ERROR cmd_handle_telemetry_block(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+
+    // Optional first argument forces a live read of every channel
+    bool forceLive = (request->nargs >= 0) && (request->args[0] == CMD_ARG_FORCE_LIVE);
+
+    if (telemetry_block_build(response, TELEM_BLOCK_SIZE, forceLive, responseLen) != NO_ERROR){
+        response[0] = CMD_RETURN;
+        response[1] = CMD_FORMAT_ERROR;
+        *responseLen = 2;
+        return CMD_FORMAT_ERROR;
+    }
+    return NO_ERROR;
+}
+
+// args[0] = Command byte, returns [count u32, errors u32, average latency us u32, max latency us u32]
+static enum IRIS_ERROR cmd_handle_cmd_stats(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+
+    cmd_stats_t stats;
+    uint32_t fields[4] = {0};
+
+    if (request->nargs < 0){
+        response[1] = CMD_FORMAT_ERROR;
+        *responseLen = 2;
+        return CMD_FORMAT_ERROR;
+    }
+
+    cmd_stats_get(request->args[0], &stats);
+    fields[0] = stats.count;
+    fields[1] = stats.errors;
+    fields[2] = (stats.count == 0) ? 0 : (uint32_t)((stats.totalNs / stats.count) / 1000);
+    fields[3] = (uint32_t)(stats.maxNs / 1000);
+
+    response[1] = NO_ERROR;
+    for (int index = 0; index < 4; index++){
+        response[2 + (4 * index)] = (fields[index] >> 24) & 0xFF;
+        response[3 + (4 * index)] = (fields[index] >> 16) & 0xFF;
+        response[4 + (4 * index)] = (fields[index] >> 8) & 0xFF;
+        response[5 + (4 * index)] =  fields[index] & 0xFF;
+    }
+    *responseLen = CMD_STATS_RESPONSE_SIZE;
+    return NO_ERROR;
+}
+
+// args[0:1] = Job ID, returns [state, progress]
+static enum IRIS_ERROR cmd_handle_job_status(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+
+    enum JOB_STATE state = JOB_FREE;
+    uint8_t progress = 0;
+
+    *responseLen = 2;
+    if (request->nargs < 1){
+        response[1] = CMD_FORMAT_ERROR;
+        return CMD_FORMAT_ERROR;
+    }
+    response[1] = job_status((request->args[0] << 8) | request->args[1], &state, &progress);
+    if (response[1] != NO_ERROR){
+        return response[1];
+    }
+    response[2] = state;
+    response[3] = progress;
+    *responseLen = JOB_STATUS_RESPONSE_SIZE;
+    return NO_ERROR;
+}
+
+// args[0:1] = Job ID, returns the response frame of the finished command
+static enum IRIS_ERROR cmd_handle_job_result(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+
     enum IRIS_ERROR error = NO_ERROR;
 
-    uint8_t cmdReturn[RETURN_CMD_SIZE] = {NO_ERROR};
-    cmdReturn[0] = CMD_RETURN;
+    *responseLen = 2;
+    if (request->nargs < 1){
+        response[1] = CMD_FORMAT_ERROR;
+        return CMD_FORMAT_ERROR;
+    }
+    error = job_result((request->args[0] << 8) | request->args[1], response, responseLen);
+    if (error != NO_ERROR){
+        response[0] = CMD_RETURN;
+        response[1] = error;
+        *responseLen = 2;
+    }
+    return error;
+}
 
-    uint8_t errorCount = 0;
-    enum IRIS_ERROR errorBuffer[RETURN_CMD_SIZE] = {NO_ERROR};
+// args[0:1] = Job ID
+static enum IRIS_ERROR cmd_handle_job_cancel(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
 
-    switch(cmd){
+    *responseLen = 2;
+    if (request->nargs < 1){
+        response[1] = CMD_FORMAT_ERROR;
+        return CMD_FORMAT_ERROR;
+    }
+    response[1] = job_cancel((request->args[0] << 8) | request->args[1]);
+    return response[1];
+}
 
-        case CURR_SENSOR_SETUP:
-            addr = cmd_to_current_addr(args[0]);
-            if (addr == CMD_FORMAT_ERROR){
-                cmdReturn[1] = CMD_FORMAT_ERROR;
-                error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                break;
-            }
-            cmdReturn[1] = current_setup(addr);
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-            break;
+// args = [flags, start u32, end u32], returns [numSegments, raw size u32, compressed size u32, numRemaining] and
+// attaches the compressed export as a bulk transfer (See LOG_EXPORT frame layout in cmd_controller.h)
+static enum IRIS_ERROR cmd_handle_log_export(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
 
-        case CURR_SENSOR_VALIDATE:
-            addr = cmd_to_current_addr(args[0]);
-            if (addr == CMD_FORMAT_ERROR){
-                cmdReturn[1] = CMD_FORMAT_ERROR;
-                error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                break;
-            }
-            cmdReturn[1] = current_func_validate(addr);
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-            break;
+    log_export_info_t info;
+    enum IRIS_ERROR error = NO_ERROR;
+    uint8_t flags = (request->nargs >= 0) ? request->args[0] : 0;
+    uint64_t startNs = 0;
+    uint64_t endNs = UINT64_MAX;
+    uint32_t startS = 0;
+    uint32_t endS = 0;
+    uint32_t fields[2] = {0};
+    int fd = -1;
+
+    *responseLen = 2;
+    if ((request->nargs > 0) && (request->nargs != (LOG_EXPORT_ARGS_SIZE - 1))){
+        response[1] = CMD_FORMAT_ERROR;
+        return CMD_FORMAT_ERROR;
+    }
+    if (request->nargs > 0){
+        startS = ((uint32_t)request->args[1] << 24) | ((uint32_t)request->args[2] << 16) | ((uint32_t)request->args[3] << 8) | request->args[4];
+        endS   = ((uint32_t)request->args[5] << 24) | ((uint32_t)request->args[6] << 16) | ((uint32_t)request->args[7] << 8) | request->args[8];
+        startNs = (uint64_t)startS * 1000000000ULL;
+        if (endS != 0){
+            endNs = ((uint64_t)endS * 1000000000ULL) + 999999999ULL;
+        }
+    }
 
-        case CURR_SENSOR_STATUS:
-            //ADD CODE
-        case CURR_SENSOR_RESET:
-            addr = cmd_to_current_addr(args[0]);
-            if (addr == CMD_FORMAT_ERROR){
-                cmdReturn[1] = CMD_FORMAT_ERROR;
-                error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                break;
-            }
-            cmdReturn[1] = current_monitor_reset(addr);
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-            break;
+    error = log_export(startNs, endNs, flags, &fd, &info);
+    response[1] = error;
+    if (error != NO_ERROR){
+        return error;
+    }
+    if (fd >= 0){
+        cmd_bulk_attach(fd, info.compressedSize);
+    }
 
-        case CURR_SENSOR_READ_CURRENT:
-            addr = cmd_to_current_addr(args[0]);
-            if (addr == CMD_FORMAT_ERROR){
-                cmdReturn[1] = CMD_FORMAT_ERROR;
-                error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                break;
-            }
-            dataBuf = read_current(addr);
-
-            if ((dataBuf == CURR1_VAL_READ_ERROR_16BIT) ||
-                (dataBuf == CURR2_VAL_READ_ERROR_16BIT) ||
-                (dataBuf == CURR3_VAL_READ_ERROR_16BIT)){
-
-                    cmdReturn[1] = current_val_error_16bit_to_8bit(dataBuf);
-                    error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                    break;
-                }
-            cmdReturn[1] = NO_ERROR;
-            cmdReturn[2] = (dataBuf >> 8) & 0xFF;  // MSB
-            cmdReturn[3] =  dataBuf & 0xFF;        // LSB
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 4);
-            break;
+    fields[0] = (uint32_t)info.rawSize;
+    fields[1] = (uint32_t)info.compressedSize;
+    response[2] = (uint8_t)info.numSegments;
+    for (int index = 0; index < 2; index++){
+        response[3 + (4 * index)] = (fields[index] >> 24) & 0xFF;
+        response[4 + (4 * index)] = (fields[index] >> 16) & 0xFF;
+        response[5 + (4 * index)] = (fields[index] >> 8) & 0xFF;
+        response[6 + (4 * index)] =  fields[index] & 0xFF;
+    }
+    response[11] = (info.numRemaining > UINT8_MAX) ? UINT8_MAX : (uint8_t)info.numRemaining;
+    *responseLen = LOG_EXPORT_RESPONSE_SIZE;
+    return NO_ERROR;
+}
 
-        case CURR_SENSOR_READ_VOLTAGE:
-            addr = cmd_to_current_addr(args[0]);
-            if (addr == CMD_FORMAT_ERROR){
-                cmdReturn[1] = CMD_FORMAT_ERROR;
-                error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                break;
-            }
-            dataBuf = read_bus_voltage(addr);
-
-            if ((dataBuf == CURR1_VAL_READ_ERROR_16BIT) ||
-                (dataBuf == CURR2_VAL_READ_ERROR_16BIT) ||
-                (dataBuf == CURR3_VAL_READ_ERROR_16BIT)){
-
-                    cmdReturn[1] = current_val_error_16bit_to_8bit(dataBuf);
-                    error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                    break;
-                }
-            cmdReturn[1] = NO_ERROR;
-            cmdReturn[2] = (dataBuf >> 8) & 0xFF;  // MSB
-            cmdReturn[3] =  dataBuf & 0xFF;        // LSB
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 4);
-            break;
+static enum IRIS_ERROR cmd_handle_sync_time(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
 
-        case CURR_SENSOR_READ_POWER:
-            addr = cmd_to_current_addr(args[0]);
-            if (addr == CMD_FORMAT_ERROR){
-                cmdReturn[1] = CMD_FORMAT_ERROR;
-                error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                break;
-            }
-            dataBuf = read_power(addr);
-
-            if ((dataBuf == CURR1_VAL_READ_ERROR_16BIT) ||
-                (dataBuf == CURR2_VAL_READ_ERROR_16BIT) ||
-                (dataBuf == CURR3_VAL_READ_ERROR_16BIT)){
-
-                    cmdReturn[1] = current_val_error_16bit_to_8bit(dataBuf);
-                    error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                    break;
-                }
-            cmdReturn[1] = NO_ERROR;
-            cmdReturn[2] = (dataBuf >> 8) & 0xFF;  // MSB
-            cmdReturn[3] =  dataBuf & 0xFF;        // LSB
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 4);
-            break;
+    clock_sync_status_t status;
+    enum IRIS_ERROR error = NO_ERROR;
+    uint64_t obcNs = 0;
+    int64_t offsetUs = 0;
+    uint32_t fields[3] = {0};
+
+    *responseLen = 2;
+    if ((request->nargs >= 0) && (request->nargs != (SYNC_TIME_ARGS_SIZE - 1))){
+        response[1] = CMD_FORMAT_ERROR;
+        return CMD_FORMAT_ERROR;
+    }
 
-        case CURR_SENSOR_READ_PK_POWER:
-            addr = cmd_to_current_addr(args[0]);
-            if (addr == CMD_FORMAT_ERROR){
-                cmdReturn[1] = CMD_FORMAT_ERROR;
-                error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                break;
-            }
-            dataBuf = read_pk_power(addr);
-
-            if ((dataBuf == CURR1_VAL_READ_ERROR_16BIT) ||
-                (dataBuf == CURR2_VAL_READ_ERROR_16BIT) ||
-                (dataBuf == CURR3_VAL_READ_ERROR_16BIT)){
-
-                    cmdReturn[1] = current_val_error_16bit_to_8bit(dataBuf);
-                    error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                    break;
-                }
-            cmdReturn[1] = NO_ERROR;
-            cmdReturn[2] = (dataBuf >> 8) & 0xFF;  // MSB
-            cmdReturn[3] =  dataBuf & 0xFF;        // LSB
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 4);
-            break;
+    // Without arguments only the sync quality is reported
+    if (request->nargs >= 0){
+        obcNs = (((uint64_t)request->args[0] << 24) | ((uint64_t)request->args[1] << 16) | ((uint64_t)request->args[2] << 8) | request->args[3]) * 1000000000ULL;
+        obcNs += ((uint32_t)request->args[4] << 24) | ((uint32_t)request->args[5] << 16) | ((uint32_t)request->args[6] << 8) | request->args[7];
+        error = clock_sync_sample(clock_sync_edge_get(), obcNs);
+    }
+    clock_sync_status(&status);
+
+    offsetUs = status.offsetNs / 1000LL;
+    offsetUs = (offsetUs > INT32_MAX) ? INT32_MAX : ((offsetUs < INT32_MIN) ? INT32_MIN : offsetUs);
+    fields[0] = (uint32_t)(int32_t)offsetUs;
+    fields[1] = (uint32_t)status.driftPpb;
+    fields[2] = status.rmsNs;
+
+    response[1] = error;
+    response[2] = status.state;
+    response[3] = status.numSamples;
+    for (int index = 0; index < 3; index++){
+        response[4 + (4 * index)] = (fields[index] >> 24) & 0xFF;
+        response[5 + (4 * index)] = (fields[index] >> 16) & 0xFF;
+        response[6 + (4 * index)] = (fields[index] >> 8) & 0xFF;
+        response[7 + (4 * index)] =  fields[index] & 0xFF;
+    }
+    *responseLen = SYNC_TIME_RESPONSE_SIZE;
+    return error;
+}
 
-        case CURR_SENSOR_READ_LIMIT:
+static enum IRIS_ERROR cmd_handle_flight_dump(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
 
-            current_limit(errorBuffer, &errorCount);
+    enum IRIS_ERROR error = NO_ERROR;
+    uint8_t flags = (request->nargs >= 0) ? request->args[0] : 0;
+    uint32_t size = 0;
+    int fd = -1;
+
+    *responseLen = 2;
+    error = flight_recorder_dump(flags, &fd, &size);
+    response[1] = error;
+    if (error != NO_ERROR){
+        return error;
+    }
+    if (fd >= 0){
+        cmd_bulk_attach(fd, size);
+    }
 
-            if(errorCount == 0){
-                cmdReturn[2] = NO_ERROR;
-                errorCount = 1;
-            }else{
-                for(int index = 0; index < errorCount; index++){
-                    cmdReturn[index+1] = errorBuffer[index];
-                }
-            }
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 1 + errorCount);
-            break;
+    response[2] = (size >> 24) & 0xFF;
+    response[3] = (size >> 16) & 0xFF;
+    response[4] = (size >> 8) & 0xFF;
+    response[5] =  size & 0xFF;
+    *responseLen = FLIGHT_DUMP_RESPONSE_SIZE;
+    return NO_ERROR;
+}
 
-        case TEMP_SENSOR_SETUP:
-            addr = cmd_to_temp_addr(args[0]);
-            if (addr == CMD_FORMAT_ERROR){
-                cmdReturn[1] = CMD_FORMAT_ERROR;
-                error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                break;
-            }
-            cmdReturn[1] = temp_setup(addr);
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-            break;
+static enum IRIS_ERROR cmd_handle_trace_export(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
 
-        case TEMP_SENSOR_VALIDATE:
-            addr = cmd_to_temp_addr(args[0]);
-            if (addr == CMD_FORMAT_ERROR){
-                cmdReturn[1] = CMD_FORMAT_ERROR;
-                error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                break;
-            }
-            cmdReturn[1] = temp_func_validate(addr);
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-            break;
+    enum IRIS_ERROR error = NO_ERROR;
+    uint8_t flags = (request->nargs >= 0) ? request->args[0] : 0;
+    uint32_t fields[2] = {0};
+    int fd = -1;
+
+    *responseLen = 2;
+    error = trace_export(flags, &fd, &fields[1], &fields[0]);
+    response[1] = error;
+    if (error != NO_ERROR){
+        return error;
+    }
+    if (fd >= 0){
+        cmd_bulk_attach(fd, fields[1]);
+    }
 
-        case TEMP_SENSOR_RESET:
-            addr = cmd_to_temp_addr(args[0]);
-            if (addr == CMD_FORMAT_ERROR){
-                cmdReturn[1] = CMD_FORMAT_ERROR;
-                error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                break;
-            }
-            cmdReturn[1] = temp_reset(addr);
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-            break;
+    for (int index = 0; index < 2; index++){
+        response[2 + (4 * index)] = (fields[index] >> 24) & 0xFF;
+        response[3 + (4 * index)] = (fields[index] >> 16) & 0xFF;
+        response[4 + (4 * index)] = (fields[index] >> 8) & 0xFF;
+        response[5 + (4 * index)] =  fields[index] & 0xFF;
+    }
+    *responseLen = TRACE_EXPORT_RESPONSE_SIZE;
+    return NO_ERROR;
+}
+
+static enum IRIS_ERROR cmd_handle_telem_history(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+
+    enum IRIS_ERROR error = NO_ERROR;
+    uint8_t flags = (request->nargs >= 0) ? request->args[0] : 0;
+    uint32_t fields[2] = {0};
+    int fd = -1;
+
+    *responseLen = 2;
+    error = telemetry_history_export(flags, &fd, &fields[1], &fields[0]);
+    response[1] = error;
+    if (error != NO_ERROR){
+        return error;
+    }
+    if (fd >= 0){
+        cmd_bulk_attach(fd, fields[1]);
+
+        // History is only cleared once the OBC has it (See 'telemetry_history_delivered')
+        if (flags & TELEM_HISTORY_FLAG_CLEAR){
+            cmd_bulk_on_done(telemetry_history_delivered);
+        }
+    }
+
+    for (int index = 0; index < 2; index++){
+        response[2 + (4 * index)] = (fields[index] >> 24) & 0xFF;
+        response[3 + (4 * index)] = (fields[index] >> 16) & 0xFF;
+        response[4 + (4 * index)] = (fields[index] >> 8) & 0xFF;
+        response[5 + (4 * index)] =  fields[index] & 0xFF;
+    }
+    *responseLen = TELEM_HISTORY_RESPONSE_SIZE;
+    return NO_ERROR;
+}
+
+// Link training writes its own test frames, the reply is returned through the dispatcher afterwards
+static enum IRIS_ERROR cmd_handle_spi_train(const cmd_request_t *request, uint8_t *response, uint16_t *responseLen){
+
+    uint8_t mode = (request->nargs >= 0) ? request->args[0] : SPI_TRAIN_MODE_QUERY;
+    struct gpiod_edge_event_buffer *eventBuffer = NULL;
+    enum IRIS_ERROR error = NO_ERROR;
+    spi_config_t config;
+
+    if (mode == SPI_TRAIN_MODE_RUN){
+        eventBuffer = gpiod_edge_event_buffer_new(EDGE_EVENT_BUFF_SIZE);
+        if (eventBuffer == NULL){
+            error = SPI_TEST_ERROR;
+        }else{
+            error = spi_train(request->spi_dev, *request->spi_cs_request, eventBuffer);
+            gpiod_edge_event_buffer_free(eventBuffer);
+        }
+    }else if (mode != SPI_TRAIN_MODE_QUERY){
+        error = CMD_FORMAT_ERROR;
+    }
+
+    spi_config_get(&config);
+    response[1] = error;
+    response[2] = spi_train_pending() ? 1 : 0;
+    response[3] = (config.speed >> 24) & 0xFF;
+    response[4] = (config.speed >> 16) & 0xFF;
+    response[5] = (config.speed >> 8) & 0xFF;
+    response[6] =  config.speed & 0xFF;
+    *responseLen = SPI_TRAIN_RESPONSE_SIZE;
+    return error;
+}
+
+//////////////////////////////////////// Command Table ////////////////////////////////////////
+
+// Registration table indexed by command byte, unregistered commands have a NULL handler
+static cmd_entry_t cmdTable[CMD_TABLE_SIZE] = {
+
+    [CURR_SENSOR_SETUP]         = {cmd_handle_curr_setup,       CMD_ARGS_CURR_SENSOR, 0,               CMD_FLAG_SYNC | CMD_FLAG_I2C_BUS,   2},
+    [CURR_SENSOR_VALIDATE]      = {cmd_handle_curr_validate,    CMD_ARGS_CURR_SENSOR, 0,               CMD_FLAG_SYNC | CMD_FLAG_I2C_BUS,   2},
+    [CURR_SENSOR_STATUS]        = {cmd_handle_unsupported,      CMD_ARGS_CURR_SENSOR, 0,               CMD_FLAG_SYNC,                      2},
+    [CURR_SENSOR_RESET]         = {cmd_handle_curr_reset,       CMD_ARGS_CURR_SENSOR, 0,               CMD_FLAG_ASYNC | CMD_FLAG_I2C_BUS,  2},
+    [CURR_SENSOR_READ_CURRENT]  = {cmd_handle_curr_read,        CMD_ARGS_CURR_SENSOR, SENSOR_CURRENT,  CMD_FLAG_SYNC | CMD_FLAG_CACHEABLE, 4},
+    [CURR_SENSOR_READ_VOLTAGE]  = {cmd_handle_curr_read,        CMD_ARGS_CURR_SENSOR, SENSOR_VOLTAGE,  CMD_FLAG_SYNC | CMD_FLAG_CACHEABLE, 4},
+    [CURR_SENSOR_READ_POWER]    = {cmd_handle_curr_read,        CMD_ARGS_CURR_SENSOR, SENSOR_POWER,    CMD_FLAG_SYNC | CMD_FLAG_CACHEABLE, 4},
+    [CURR_SENSOR_READ_PK_POWER] = {cmd_handle_curr_read,        CMD_ARGS_CURR_SENSOR, SENSOR_PK_POWER, CMD_FLAG_SYNC | CMD_FLAG_CACHEABLE, 4},
+    [CURR_SENSOR_READ_LIMIT]    = {cmd_handle_curr_limit,       CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC | CMD_FLAG_I2C_BUS,   RETURN_CMD_SIZE},
+
+    [TEMP_SENSOR_SETUP]         = {cmd_handle_temp_setup,       CMD_ARGS_TEMP_SENSOR, 0,               CMD_FLAG_SYNC | CMD_FLAG_I2C_BUS,   2},
+    [TEMP_SENSOR_VALIDATE]      = {cmd_handle_temp_validate,    CMD_ARGS_TEMP_SENSOR, 0,               CMD_FLAG_SYNC | CMD_FLAG_I2C_BUS,   2},
+    [TEMP_SENSOR_STATUS]        = {cmd_handle_unsupported,      CMD_ARGS_TEMP_SENSOR, 0,               CMD_FLAG_SYNC,                      2},
+    [TEMP_SENSOR_RESET]         = {cmd_handle_temp_reset,       CMD_ARGS_TEMP_SENSOR, 0,               CMD_FLAG_ASYNC | CMD_FLAG_I2C_BUS,  2},
+    [TEMP_SENSOR_READ]          = {cmd_handle_temp_read,        CMD_ARGS_TEMP_SENSOR, SENSOR_TEMP,     CMD_FLAG_SYNC | CMD_FLAG_CACHEABLE, 3},
+    [TEMP_SENSOR_READ_LIMIT]    = {cmd_handle_temp_limit,       CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC | CMD_FLAG_I2C_BUS,   RETURN_CMD_SIZE},
+
+    [USB_HUB_SETUP]             = {cmd_handle_usb_hub_setup,    CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC | CMD_FLAG_I2C_BUS,   2},
+    [USB_HUB_VALIDATE]          = {cmd_handle_usb_hub_validate, CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC | CMD_FLAG_I2C_BUS,   2},
+    [USB_HUB_RESET]             = {cmd_handle_usb_hub_reset,    CMD_ARGS_NONE,        0,               CMD_FLAG_ASYNC | CMD_FLAG_I2C_BUS,  2},
+
+    [ERROR_TRANSFER]            = {cmd_handle_error_transfer,   CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC | CMD_FLAG_DIRECT_IO, 0},
+
+    [IMAGE_CONFIG]              = {cmd_handle_unsupported,      CMD_ARGS_NONE,        0,               CMD_FLAG_ASYNC,                     2},
+    [IMAGE_CAPTURE]             = {cmd_handle_unsupported,      CMD_ARGS_NONE,        0,               CMD_FLAG_ASYNC,                     2},
+    [FILE_TRANSFER]             = {cmd_handle_unsupported,      CMD_ARGS_NONE,        0,               CMD_FLAG_ASYNC,                     2},
+    [SYNC_TIME]                 = {cmd_handle_sync_time,        CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC,                      SYNC_TIME_RESPONSE_SIZE},
+    [CHECKSUM]                  = {cmd_handle_unsupported,      CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC,                      2},
+
+    [TELEMETRY_BLOCK]           = {cmd_handle_telemetry_block,  CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC | CMD_FLAG_CACHEABLE, TELEM_BLOCK_SIZE},
+    [JOB_STATUS]                = {cmd_handle_job_status,       CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC,                      JOB_STATUS_RESPONSE_SIZE},
+    [JOB_RESULT]                = {cmd_handle_job_result,       CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC,                      CMD_RESPONSE_MAX_LEN},
+    [JOB_CANCEL]                = {cmd_handle_job_cancel,       CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC,                      2},
+    [CMD_STATS]                 = {cmd_handle_cmd_stats,        CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC,                      CMD_STATS_RESPONSE_SIZE},
+    [LOG_EXPORT]                = {cmd_handle_log_export,       CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC | CMD_FLAG_BULK,      LOG_EXPORT_RESPONSE_SIZE},
+    [FLIGHT_DUMP]               = {cmd_handle_flight_dump,      CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC | CMD_FLAG_BULK,      FLIGHT_DUMP_RESPONSE_SIZE},
+    [TRACE_EXPORT]              = {cmd_handle_trace_export,     CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC | CMD_FLAG_BULK,      TRACE_EXPORT_RESPONSE_SIZE},
+    [TELEMETRY_HISTORY]         = {cmd_handle_telem_history,    CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC | CMD_FLAG_BULK,      TELEM_HISTORY_RESPONSE_SIZE},
+    [SPI_TRAIN]                 = {cmd_handle_spi_train,        CMD_ARGS_NONE,        0,               CMD_FLAG_SYNC | CMD_FLAG_DIRECT_IO, SPI_TRAIN_RESPONSE_SIZE},
+};
+
+static cmd_stats_t cmdStats[CMD_TABLE_SIZE];
+
+/**
+ * @brief Stores the GPIO line request used by handlers that drive board GPIOs (USB Hub).
+ *        Must be called once after 'gpio_init' before commands are serviced.
+ *
+ * @param gpio_request GPIO line request returned by 'gpio_init'
+ */
+void cmd_controller_init(struct gpiod_line_request *gpio_request){
+    cmdGpioRequest = gpio_request;
+}
+
+/**
+ * @brief Adds or replaces a command in the registration table
+ *
+ * @param cmd Command byte
+ * @param entry Pointer to table entry for the command
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR cmd_register(uint8_t cmd, const cmd_entry_t *entry){
+
+
+    if ((entry == NULL) || (entry->handler == NULL) || (entry->maxResponse > CMD_RESPONSE_MAX_LEN)){
+        LOG_ERRORF("CMD-CONTROLLER: Invalid table entry for command %u", cmd);
+        return CMD_FORMAT_ERROR;
+    }
+    cmdTable[cmd] = *entry;
+    return NO_ERROR;
+}
+
+/**
+ * @brief Returns the table entry of a command
+ *
+ * @param cmd Command byte
+ * @return Pointer to table entry, NULL if the command is not registered
+ */
+const cmd_entry_t *cmd_lookup(uint8_t cmd){
 
-        case TEMP_SENSOR_READ:
-            addr = cmd_to_temp_addr(args[0]);
-            if (addr == CMD_FORMAT_ERROR){
-                cmdReturn[1] = CMD_FORMAT_ERROR;
-                error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                break;
-            }
+    if (cmdTable[cmd].handler == NULL){
+        return NULL;
+    }
+    return &cmdTable[cmd];
+}
 
-            cmdReturn[2] = read_temperature(addr);
+/**
+ * @brief Copies out the dispatch counters of a command
+ *
+ * @param cmd Command byte
+ * @param stats Pointer to structure that will store the counters
+ */
+void cmd_stats_get(uint8_t cmd, cmd_stats_t *stats){
+
+    stats->count   = __atomic_load_n(&cmdStats[cmd].count, __ATOMIC_RELAXED);
+    stats->errors  = __atomic_load_n(&cmdStats[cmd].errors, __ATOMIC_RELAXED);
+    stats->totalNs = __atomic_load_n(&cmdStats[cmd].totalNs, __ATOMIC_RELAXED);
+    stats->maxNs   = __atomic_load_n(&cmdStats[cmd].maxNs, __ATOMIC_RELAXED);
+}
 
-            if ((cmdReturn[2] == TEMP1_TEMP_READ_ERROR) ||
-                (cmdReturn[2] == TEMP2_TEMP_READ_ERROR) ||
-                (cmdReturn[2] == TEMP3_TEMP_READ_ERROR) ||
-                (cmdReturn[2] == TEMP4_TEMP_READ_ERROR)){
+/**
+ * @brief Attaches a file to the response of the command being serviced, it is streamed to the OBC
+ *        after the response (Directly in ONE_SERVICE, passed to the SPI service in TWO_SERVICE).
+ *        Only for CMD_FLAG_BULK handlers, the controller takes ownership of 'fd'.
+ *
+ * @param fd File to stream
+ * @param len Number of bytes to stream from the start of the file
+ */
+void cmd_bulk_attach(int fd, uint64_t len){
+
+    if (cmdBulk.fd >= 0){
+        close(cmdBulk.fd);
+    }
+    if (cmdBulk.done != NULL){
+        cmdBulk.done(false);
+    }
+    cmdBulk.fd = fd;
+    cmdBulk.len = len;
+    cmdBulk.done = NULL;
+}
 
-                cmdReturn[1] = cmdReturn[2];
-                error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
-                break;
-            }
+/**
+ * @brief Asks to be told whether the attached bulk transfer reached the OBC, for handlers that may
+ *        only discard data once it was delivered. Must follow 'cmd_bulk_attach'.
+ *
+ * @param done Called once with the outcome, also if the transfer is dropped before it is sent
+ */
+void cmd_bulk_on_done(cmd_bulk_done_t done){
 
-            cmdReturn[1] = NO_ERROR;
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 3);
+    if (cmdBulk.fd >= 0){
+        cmdBulk.done = done;
+    }
+}
+
+/**
+ * @brief Takes the bulk transfer attached by the last command serviced on this thread
+ *
+ * @param bulk Pointer to structure that will store the transfer, the caller must close 'bulk->fd'
+ *             and report the outcome to 'bulk->done' if set
+ * @return True if a bulk transfer is pending
+ */
+bool cmd_bulk_take(cmd_bulk_t *bulk){
+
+    *bulk = cmdBulk;
+    cmdBulk.fd = -1;
+    cmdBulk.len = 0;
+    cmdBulk.done = NULL;
+    return bulk->fd >= 0;
+}
+
+/**
+ * @brief Updates the dispatch counters of a command, safe to call from multiple threads
+ *
+ * @param cmd Command byte
+ * @param error Error code returned by the handler
+ * @param elapsedNs Handler execution time in nano-seconds
+ */
+static void cmd_stats_record(uint8_t cmd, enum IRIS_ERROR error, uint64_t elapsedNs){
+
+    uint64_t maxNs = __atomic_load_n(&cmdStats[cmd].maxNs, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&cmdStats[cmd].count, 1, __ATOMIC_RELAXED);
+    metric_inc(METRIC_CMDS);
+    metric_cmd(cmd);
+    metric_observe_ns(METRIC_HIST_CMD, elapsedNs);
+    if (error != NO_ERROR){
+        __atomic_fetch_add(&cmdStats[cmd].errors, 1, __ATOMIC_RELAXED);
+        metric_inc(METRIC_CMD_ERRORS);
+    }
+    __atomic_fetch_add(&cmdStats[cmd].totalNs, elapsedNs, __ATOMIC_RELAXED);
+    while ((elapsedNs > maxNs) &&
+           !__atomic_compare_exchange_n(&cmdStats[cmd].maxNs, &maxNs, elapsedNs, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+    }
+}
+
+/**
+ * @brief Runs a command through the registration table and builds its response frame.
+ *        Argument validation is applied from the command's schema before the handler is called.
+ *
+ * @param cmd Command byte
+ * @param args Pointer to array of command arguments
+ * @param nargs Index of the last argument (As returned by 'cmd_extracter')
+ * @param spi_dev SPI device, used by CMD_FLAG_DIRECT_IO handlers only
+ * @param spi_cs_request SPI chip select, used by CMD_FLAG_DIRECT_IO handlers only (NULL if unavailable)
+ * @param response Pointer to array of CMD_RESPONSE_MAX_LEN bytes that will store the response frame
+ * @param responseLen Pointer to variable that will store the response length, 0 if the handler wrote to the bus itself
+ * @param allowAsync True to hand CMD_FLAG_ASYNC commands to the job engine instead of running them
+ * @return Iris error code returned by the handler
+ */
+static enum IRIS_ERROR cmd_run(uint8_t cmd, const uint8_t *args, int nargs, int spi_dev, struct gpiod_line_request **spi_cs_request, uint8_t *response, uint16_t *responseLen, bool allowAsync){
+
+    const cmd_entry_t *entry = &cmdTable[cmd];
+    cmd_request_t request;
+    enum IRIS_ERROR error = NO_ERROR;
+    uint64_t startNs = 0;
+    uint64_t elapsedNs = 0;
+    uint16_t jobId = JOB_ID_INVALID;
+    TRACE_SCOPE_ARG("cmd_run", cmd);
+
+    response[0] = CMD_RETURN;
+    response[1] = CMD_FORMAT_ERROR;
+    *responseLen = 2;
+
+    // A transfer attached by an earlier command that was never delivered is dropped
+    cmd_bulk_attach(-1, 0);
+
+    if (entry->handler == NULL){
+        return CMD_FORMAT_ERROR;
+    }
+
+    request.cmd = cmd;
+    request.args = args;
+    request.nargs = nargs;
+    request.addr = 0;
+    request.param = entry->param;
+    request.spi_dev = spi_dev;
+    request.spi_cs_request = spi_cs_request;
+
+    switch (entry->schema){
+        case CMD_ARGS_CURR_SENSOR:
+            request.addr = (nargs >= 0) ? cmd_to_current_addr(args[0]) : CMD_FORMAT_ERROR;
+            break;
+        case CMD_ARGS_TEMP_SENSOR:
+            request.addr = (nargs >= 0) ? cmd_to_temp_addr(args[0]) : CMD_FORMAT_ERROR;
+            break;
+        default:
             break;
+    }
+
+    if (request.addr == CMD_FORMAT_ERROR){
+        cmd_stats_record(cmd, CMD_FORMAT_ERROR, 0);
+        return CMD_FORMAT_ERROR;
+    }
+    if ((entry->flags & CMD_FLAG_DIRECT_IO) && ((spi_cs_request == NULL) || (*spi_cs_request == NULL))){
+        response[1] = CMD_UNSUPPORTED_ERROR;
+        cmd_stats_record(cmd, CMD_UNSUPPORTED_ERROR, 0);
+        return CMD_UNSUPPORTED_ERROR;
+    }
+
+    // Long running commands are handed to the worker pool, the OBC polls the returned job ID
+    if (allowAsync && (entry->flags & CMD_FLAG_ASYNC) && job_engine_running()){
+        error = job_submit(cmd, args, nargs, &jobId);
+        response[1] = error;
+        if (error == NO_ERROR){
+            response[2] = (jobId >> 8) & 0xFF;  // MSB
+            response[3] =  jobId & 0xFF;        // LSB
+            *responseLen = JOB_SUBMIT_RESPONSE_SIZE;
+        }
+        return error;
+    }
 
-        case TEMP_SENSOR_READ_LIMIT:
-            temperature_limit(errorBuffer, &errorCount);
+    startNs = get_time_monotonic_ns();
+    if (entry->flags & CMD_FLAG_I2C_BUS){
+        i2c_bus_lock();
+    }
+    flight_record(FLIGHT_CMD_START, cmd, (uint32_t)nargs, (nargs >= 0) ? args[0] : 0, 0, 0);
+    error = entry->handler(&request, response, responseLen);
+    if (entry->flags & CMD_FLAG_I2C_BUS){
+        i2c_bus_unlock();
+    }
+    elapsedNs = get_time_monotonic_ns() - startNs;
+    cmd_stats_record(cmd, error, elapsedNs);
+    flight_record(FLIGHT_CMD_DONE, cmd, error, (uint32_t)(elapsedNs / 1000), 0, 0);
+
+    if (*responseLen > entry->maxResponse){
+        LOG_ERRORF("CMD-CONTROLLER: Command %u response of %u bytes exceeds table limit of %u", cmd, *responseLen, entry->maxResponse);
+        response[0] = CMD_RETURN;
+        response[1] = CMD_FORMAT_ERROR;
+        *responseLen = 2;
+        return CMD_FORMAT_ERROR;
+    }
+    return error;
+}
+
+/**
+ * @brief Executes a command received from the OBC and builds its response frame.
+ *        CMD_FLAG_ASYNC commands are queued on the job engine and answer with a job ID.
+ *
+ * @param cmd Command byte
+ * @param args Pointer to array of command arguments
+ * @param nargs Index of the last argument (As returned by 'cmd_extracter')
+ * @param spi_dev SPI device, used by CMD_FLAG_DIRECT_IO handlers only
+ * @param spi_cs_request SPI chip select, used by CMD_FLAG_DIRECT_IO handlers only (NULL if unavailable)
+ * @param response Pointer to array of CMD_RESPONSE_MAX_LEN bytes that will store the response frame
+ * @param responseLen Pointer to variable that will store the response length, 0 if the handler wrote to the bus itself
+ * @return Iris error code returned by the handler
+ */
+enum IRIS_ERROR cmd_execute(uint8_t cmd, const uint8_t *args, int nargs, int spi_dev, struct gpiod_line_request **spi_cs_request, uint8_t *response, uint16_t *responseLen){
+    return cmd_run(cmd, args, nargs, spi_dev, spi_cs_request, response, responseLen, true);
+}
+
+/**
+ * @brief Runs a command's handler on the calling thread regardless of CMD_FLAG_ASYNC (Used by job workers)
+ *
+ * @param cmd Command byte
+ * @param args Pointer to array of command arguments
+ * @param nargs Index of the last argument (As returned by 'cmd_extracter')
+ * @param spi_dev SPI device, used by CMD_FLAG_DIRECT_IO handlers only
+ * @param spi_cs_request SPI chip select, used by CMD_FLAG_DIRECT_IO handlers only (NULL if unavailable)
+ * @param response Pointer to array of CMD_RESPONSE_MAX_LEN bytes that will store the response frame
+ * @param responseLen Pointer to variable that will store the response length
+ * @return Iris error code returned by the handler
+ */
+enum IRIS_ERROR cmd_dispatch(uint8_t cmd, const uint8_t *args, int nargs, int spi_dev, struct gpiod_line_request **spi_cs_request, uint8_t *response, uint16_t *responseLen){
+    return cmd_run(cmd, args, nargs, spi_dev, spi_cs_request, response, responseLen, false);
+}
+
+/**
+ * @brief Services a command received from the OBC and returns the response over the SPI bus
+ *
+ * @param cmd Command byte
+ * @param args Pointer to array of command arguments
+ * @param nargs Index of the last argument (As returned by 'cmd_extracter')
+ * @param spi_dev SPI device
+ * @param spi_cs_request SPI chip select
+ * @return Iris error code of the SPI transfer
+ */
+IRIS_ERROR cmd_center(uint8_t cmd, uint8_t *args, int nargs, int spi_dev, struct gpiod_line_request **spi_cs_request){
+
+    uint8_t response[CMD_RESPONSE_MAX_LEN];
+    uint16_t responseLen = 0;
+    enum IRIS_ERROR error = NO_ERROR;
+    cmd_bulk_t bulk;
+    TRACE_SCOPE_ARG("cmd_center", cmd);
+
+    error = cmd_execute(cmd, args, nargs, spi_dev, spi_cs_request, response, &responseLen);
+
+    // CMD_FLAG_DIRECT_IO handlers already completed their transfer
+    if (responseLen != 0){
+        error = cmd_return(spi_dev, spi_cs_request, response, (uint8_t)responseLen);
+    }
 
-            for(int x = 0; x < errorCount; x++){
-                cmdReturn[x+1] = errorBuffer[x];
-            }
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 1 + errorCount);
+    // CMD_FLAG_BULK data follows the response that announced its size
+    if (cmd_bulk_take(&bulk)){
+        if (error == NO_ERROR){
+            error = spi_fd_write(spi_dev, *spi_cs_request, bulk.fd, 0, bulk.len);
+        }
+        close(bulk.fd);
+        if (bulk.done != NULL){
+            bulk.done(error == NO_ERROR);
+        }
+    }
+    return error;
+}
+
+/**
+ * @brief Executes a batched frame of length-prefixed commands in order and coalesces every
+ *        response into one reply frame (See CMD_BATCH frame layout in cmd_controller.h).
+ *        Execution stops at the first malformed entry or when the next response may not fit.
+ *
+ * @param frame Pointer to received frame, frame[0] = CMD_BATCH
+ * @param frameLen Number of bytes in frame
+ * @param reply Pointer to array of CMD_BATCH_REPLY_MAX_LEN bytes that will store the reply frame
+ * @param replyLen Pointer to variable that will store the reply length
+ * @return Iris error code of the batch, also returned as the reply status
+ */
+enum IRIS_ERROR cmd_batch_execute(const uint8_t *frame, uint16_t frameLen, uint8_t *reply, uint16_t *replyLen){
+
+    uint8_t response[CMD_RESPONSE_MAX_LEN];
+    uint16_t responseLen = 0;
+    uint16_t offset = CMD_BATCH_HEADER_SIZE;
+    uint16_t replyOffset = CMD_BATCH_REPLY_HEADER_SIZE;
+    uint8_t numCmds = 0;
+    uint8_t executed = 0;
+    uint8_t entryLen = 0;
+    uint16_t reserve = 0;
+    const cmd_entry_t *entry = NULL;
+    enum IRIS_ERROR error = NO_ERROR;
+    uint64_t startNs = get_time_monotonic_ns();
+
+    if ((frameLen < CMD_BATCH_HEADER_SIZE) || (frame[1] == 0) || (frame[1] > CMD_BATCH_MAX_CMDS)){
+        error = CMD_FORMAT_ERROR;
+    }else{
+        numCmds = frame[1];
+    }
+
+    for (executed = 0; (executed < numCmds) && (error == NO_ERROR); executed++){
+
+        if (offset >= frameLen){
+            error = CMD_FORMAT_ERROR;
+            break;
+        }
+        entryLen = frame[offset];
+        if ((entryLen == 0) || ((offset + 1 + entryLen) > frameLen)){
+            error = CMD_FORMAT_ERROR;
             break;
+        }
 
-        case USB_HUB_SETUP:
-            //ADD CODE
-        case USB_HUB_VALIDATE:
-            //ADD CODE
-        case USB_HUB_RESET:
-            //ADD CODE
-        case ERROR_TRANSFER:
-            error = iris_error_transfer(spi_dev, spi_cs_request, errorBuffer, errorCount);
+        // Reserve space for the worst case response before running the command
+        entry = cmd_lookup(frame[offset + 1]);
+        if ((entry != NULL) && (entry->flags & CMD_FLAG_BULK)){
+            error = CMD_UNSUPPORTED_ERROR;
             break;
-        case IMAGE_CONFIG:
-            //ADD CODE
-        case IMAGE_CAPTURE:
-            //ADD CODE
-        case FILE_TRANSFER:
-            //ADD CODE
-        default:
-            cmdReturn[1] = CMD_FORMAT_ERROR;
-            error = cmd_return(spi_dev, spi_cs_request, cmdReturn, 2);
+        }
+        reserve = (entry == NULL) ? 2 : entry->maxResponse;
+        if ((entry != NULL) && (entry->flags & CMD_FLAG_ASYNC) && (reserve < JOB_SUBMIT_RESPONSE_SIZE)){
+            reserve = JOB_SUBMIT_RESPONSE_SIZE;
+        }
+        if ((replyOffset + 1 + reserve) > CMD_BATCH_REPLY_MAX_LEN){
+            error = CMD_BATCH_OVERFLOW_ERROR;
+            break;
+        }
+
+        // Arguments follow the command byte, 'nargs' is the index of the last argument
+        cmd_execute(frame[offset + 1], &frame[offset + 2], entryLen - 2, 0, NULL, response, &responseLen);
+
+        // Drop the per-command CMD_RETURN, the reply frame carries a single one
+        reply[replyOffset++] = (uint8_t)(responseLen - 1);
+        memcpy(&reply[replyOffset], &response[1], responseLen - 1);
+        replyOffset += responseLen - 1;
+
+        offset += 1 + entryLen;
     }
+
+    reply[0] = CMD_RETURN;
+    reply[1] = error;
+    reply[2] = executed;
+    *replyLen = replyOffset;
+
+    cmd_stats_record(CMD_BATCH, error, get_time_monotonic_ns() - startNs);
     return error;
 }
 
+/**
+ * @brief Services a batched frame received from the OBC and returns the coalesced reply in one SPI write
+ *
+ * @param frame Pointer to received frame, frame[0] = CMD_BATCH
+ * @param frameLen Number of bytes in frame
+ * @param spi_dev SPI device
+ * @param spi_cs_request SPI chip select
+ * @return Iris error code of the SPI transfer
+ */
+IRIS_ERROR cmd_batch_center(const uint8_t *frame, uint16_t frameLen, int spi_dev, struct gpiod_line_request **spi_cs_request){
+
+    uint8_t reply[CMD_BATCH_REPLY_MAX_LEN];
+    uint16_t replyLen = 0;
+
+    cmd_batch_execute(frame, frameLen, reply, &replyLen);
+    return spi_write(spi_dev, reply, replyLen, *spi_cs_request);
+}
+
 //! ISSUES WITH ARG DECODING
 int cmd_extracter(uint8_t *cmd, uint8_t *arg, const uint8_t *rx_buffer, uint8_t rx_len){
 
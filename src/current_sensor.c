@@ -2,8 +2,10 @@
 #include "i2c.h"
 #include "main.h"
 #include "gpio.h"
+#include "log_catalog.h"
 #include "logger.h"
 #include "error_handler.h"
+#include "flight_recorder.h"
 
 #include <stdint.h>
 #include <stdio.h>
@@ -48,7 +50,8 @@ enum IRIS_ERROR current_error_code(uint8_t currAddr, enum IRIS_ERROR errorType){
                     return CURR3_SETUP_ERROR;
                 default:
                     // This will only happen if there is a coding error when using this function
-                    log_write(LOG_ERROR, "Invalid Current Sensor ERROR");
+                    LOG_ERRORF("Invalid Current Sensor ERROR");
+                    FLIGHT_FATAL();
                     exit(EXIT_FAILURE);
             }
 
@@ -62,7 +65,8 @@ enum IRIS_ERROR current_error_code(uint8_t currAddr, enum IRIS_ERROR errorType){
                     return CURR3_VERIFICATION_ERROR;
                 default:
                     // This will only happen if there is a coding error when using this function
-                    log_write(LOG_ERROR, "Invalid Current Sensor ERROR");
+                    LOG_ERRORF("Invalid Current Sensor ERROR");
+                    FLIGHT_FATAL();
                     exit(EXIT_FAILURE);
             }
         
@@ -76,7 +80,8 @@ enum IRIS_ERROR current_error_code(uint8_t currAddr, enum IRIS_ERROR errorType){
                     return CURR3_RESET_ERROR;
                 default:
                     // This will only happen if there is a coding error when using this function
-                    log_write(LOG_ERROR, "Invalid Current Sensor ERROR");
+                    LOG_ERRORF("Invalid Current Sensor ERROR");
+                    FLIGHT_FATAL();
                     exit(EXIT_FAILURE);
             }
 
@@ -90,7 +95,8 @@ enum IRIS_ERROR current_error_code(uint8_t currAddr, enum IRIS_ERROR errorType){
                     return CURR3_VAL_READ_ERROR_16BIT;
                 default:
                     // This will only happen if there is a coding error when using this function
-                    log_write(LOG_ERROR, "Invalid Current Sensor ERROR");
+                    LOG_ERRORF("Invalid Current Sensor ERROR");
+                    FLIGHT_FATAL();
                     exit(EXIT_FAILURE);
             }
 
@@ -104,13 +110,15 @@ enum IRIS_ERROR current_error_code(uint8_t currAddr, enum IRIS_ERROR errorType){
                     return CURR3_LIMIT_ERROR;
                 default:
                     // This will only happen if there is a coding error when using this function
-                    log_write(LOG_ERROR, "Invalid Current Sensor ERROR");
+                    LOG_ERRORF("Invalid Current Sensor ERROR");
+                    FLIGHT_FATAL();
                     exit(EXIT_FAILURE);
             }
 
         default:
             // This will only happen if there is a coding error when using this function
-            log_write(LOG_ERROR, "Invalid Current Sensor ERROR");
+            LOG_ERRORF("Invalid Current Sensor ERROR");
+            FLIGHT_FATAL();
             exit(EXIT_FAILURE);
 
     }
@@ -130,7 +138,6 @@ enum IRIS_ERROR current_setup(uint8_t currAddr){
     int bus = 0; 
     int tempErrorCheck = 0;
     enum IRIS_ERROR error = NO_ERROR;
-    char logBuffer[LOG_BUFFER_SIZE];
 
     uint16_t regConfig[13] = {0};
     uint8_t regAddr[13] = { CURR_REG_CFG,
@@ -148,8 +155,7 @@ enum IRIS_ERROR current_setup(uint8_t currAddr){
                             CURR_REG_FLAG_CFG
                           };
 
-    snprintf(logBuffer, sizeof(logBuffer), "CURRENT-SENSOR-SETUP: Begin functional verification of Current Sensor 0x%02x", currAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_CURR_SETUP_BEGIN, currAddr);
 
     //Sets up what configuration settings to use on Current Sensor
     if (currAddr == CURRENT_SENSOR_ADDR_3V3){
@@ -171,15 +177,15 @@ enum IRIS_ERROR current_setup(uint8_t currAddr){
         }
     }else{
         // This will only happen if there is a coding error when using this function
-        log_write(LOG_ERROR, "Invalid Current Sensor Address");
+        LOG_ERRORF("Invalid Current Sensor Address");
+        FLIGHT_FATAL();
         exit(EXIT_FAILURE);
     }
 
     //Setup I2C Interface with Temp Sensor
     bus = i2c_setup(I2C_BUS_INDEX, currAddr);
     if (bus == I2C_SETUP_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Bus Failed to Open", currAddr);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_CURR_I2C_OPEN_FAIL, currAddr);
         return current_error_code(currAddr, CURR1_SETUP_ERROR);
     }
 
@@ -187,14 +193,12 @@ enum IRIS_ERROR current_setup(uint8_t currAddr){
     for(int index = 0; index < sizeof(regAddr); index++){
         tempErrorCheck = i2c_write_reg16(bus, 2, (regAddr + index), (regConfig + index));
         if (tempErrorCheck == I2C_WR_R_ERROR){
-            snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Reg 0x%02x Write Failed", currAddr, regAddr[index]);
-            log_write(LOG_ERROR, logBuffer);
+            LOG_RECORD(LOGID_CURR_I2C_WRITE_FAIL, currAddr, regAddr[index]);
             error = current_error_code(currAddr, CURR1_SETUP_ERROR);
         }
     }
 
-    snprintf(logBuffer, sizeof(logBuffer), "CURRENT-SENSOR-SETUP: Completed attempt for setup of Current Monitor Sensor 0x%02x", currAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_CURR_SETUP_DONE, currAddr);
 
     i2c_close(bus);
     return error;
@@ -216,7 +220,6 @@ enum IRIS_ERROR current_func_validate(uint8_t currAddr){
     int bus = 0; 
     int tempErrorCheck = 0;
     enum IRIS_ERROR error = NO_ERROR;
-    char logBuffer[LOG_BUFFER_SIZE];
 
     uint16_t regData[1] = {0};
     uint16_t regConfig[13] = {0};
@@ -235,8 +238,7 @@ enum IRIS_ERROR current_func_validate(uint8_t currAddr){
                             CURR_REG_FLAG_CFG
       };
     
-    snprintf(logBuffer, sizeof(logBuffer), "CURRENT-FUNC-VALIDATE: Begin functional verification of Current Sensor 0x%02x", currAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_CURR_VALIDATE_BEGIN, currAddr);
 
     //Sets up what configuration settings to use on Current Sensor
     if (currAddr == CURRENT_SENSOR_ADDR_3V3){
@@ -256,33 +258,30 @@ enum IRIS_ERROR current_func_validate(uint8_t currAddr){
         }
     }else{
         // This will only happen if there is a coding error when using this function
-        log_write(LOG_ERROR, "Invalid Current Sensor Address");
+        LOG_ERRORF("Invalid Current Sensor Address");
+        FLIGHT_FATAL();
         exit(EXIT_FAILURE);
     }
 
     bus = i2c_setup(I2C_BUS_INDEX, currAddr);
     if (bus == I2C_SETUP_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Bus Failed to Open", currAddr);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_CURR_I2C_OPEN_FAIL, currAddr);
         return current_error_code(currAddr, CURR1_VERIFICATION_ERROR);
     }
 
     for(int index = 0; index < sizeof(regAddr); index++){
         tempErrorCheck = i2c_reg16_write_read(bus, (regAddr + index), 1, regData);
         if (tempErrorCheck == I2C_WR_R_ERROR){
-            snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Reg 0x%02x Read Failed", currAddr, regAddr[index]);
-            log_write(LOG_ERROR, logBuffer);
+            LOG_RECORD(LOGID_CURR_I2C_READ_FAIL, currAddr, regAddr[index]);
             error = current_error_code(currAddr, CURR1_VERIFICATION_ERROR);
         }
         if (regData[0] != regConfig[index]){
-            snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Reg 0x%02x Value Incorrect 0x%02x", currAddr, regAddr[index], regData[0]);
-            log_write(LOG_ERROR, logBuffer);
+            LOG_RECORD(LOGID_CURR_REG_MISMATCH, currAddr, regAddr[index], regData[0]);
             error = current_error_code(currAddr, CURR1_VERIFICATION_ERROR);
         }
     }
 
-    snprintf(logBuffer, sizeof(logBuffer), "CURRENT-FUNC-VALIDATE: Completed attempt for functional verification of Current Sensor 0x%02x", currAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_CURR_VALIDATE_DONE, currAddr);
 
     i2c_close(bus);
     return error;
@@ -300,17 +299,14 @@ enum IRIS_ERROR current_monitor_reset_trig(uint8_t currAddr){
     IRIS_ERROR errorCheck = NO_ERROR;
     int bus = 0;
 
-    char logBuffer[LOG_BUFFER_SIZE];
     uint8_t reg = CURR_REG_CFG;
 
-    snprintf(logBuffer, sizeof(logBuffer), "CURRENT-SENSOR-RESET-TRIG: Begin triggering reset of Current Sensor 0x%02x", currAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_CURR_RESET_TRIG_BEGIN, currAddr);
 
     //Setup I2C Interface with Temp Sensor
     bus = i2c_setup(I2C_BUS_INDEX, currAddr);
     if (bus == I2C_SETUP_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Bus Failed to Open", currAddr);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_CURR_I2C_OPEN_FAIL, currAddr);
         return current_error_code(currAddr, CURR1_RESET_ERROR);
     }
 
@@ -318,14 +314,12 @@ enum IRIS_ERROR current_monitor_reset_trig(uint8_t currAddr){
     uint16_t resetReg = 0xB99F;
     errorCheck = i2c_write_reg16(bus, 1, &reg, &resetReg);
     if (errorCheck == I2C_WR_R_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Reg 0x%02x Write Failed", currAddr, 0xB99F);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_CURR_I2C_WRITE_FAIL, currAddr, 0xB99F);
         i2c_close(bus);
         return current_error_code(currAddr, CURR1_RESET_ERROR);
     }
 
-    snprintf(logBuffer, sizeof(logBuffer), "CURRENT-SENSOR-RESET-TRIG: Successfully triggered reset of Current Sensor 0x%02x", currAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_CURR_RESET_TRIG_DONE, currAddr);
 
     i2c_close(bus);
     return NO_ERROR;
@@ -344,10 +338,8 @@ enum IRIS_ERROR current_monitor_reset(uint8_t currAddr){
 
     enum IRIS_ERROR errorCheck = 0;
     int loopCounter = 0;
-    char logBuffer[LOG_BUFFER_SIZE];
 
-    snprintf(logBuffer, sizeof(logBuffer), "CURRENT-SENSOR-RESET: Begin reset of Current Sensor 0x%02x", currAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_CURR_RESET_BEGIN, currAddr);
 
     errorCheck = NO_ERROR;
 
@@ -372,8 +364,7 @@ enum IRIS_ERROR current_monitor_reset(uint8_t currAddr){
     }while((errorCheck != NO_ERROR) && (loopCounter < MAX_CURR_INIT_ATTEMPTS));
 
 
-    snprintf(logBuffer, sizeof(logBuffer), "CURRENT-SENSOR-RESET: Finished reset attempt of Current Sensor 0x%02x", currAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_CURR_RESET_DONE, currAddr);
 
     return errorCheck;
 
@@ -422,20 +413,17 @@ uint16_t read_current(uint8_t currAddr){
     uint16_t currReg = 0;
     uint16_t currBuf = 0;
 
-    char logBuffer[LOG_BUFFER_SIZE];
     uint8_t reg = CURR_REG_CURRENT;
 
     bus = i2c_setup(I2C_BUS_INDEX, currAddr);
     if (bus == I2C_SETUP_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Bus Failed to Open", currAddr);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_CURR_I2C_OPEN_FAIL, currAddr);
         return current_error_code(currAddr, CURR1_VAL_READ_ERROR_16BIT);
     }
 
     errorCheck = i2c_reg16_write_read(bus, &reg, 1, &currReg);
     if (errorCheck == I2C_WR_R_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Reg 0x%02x Read Failed", currAddr, reg);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_CURR_I2C_READ_FAIL, currAddr, reg);
         return current_error_code(currAddr, CURR1_VAL_READ_ERROR_16BIT);
     }
 
@@ -454,12 +442,12 @@ uint16_t read_current(uint8_t currAddr){
             break;
         default:
             // This will only happen if there is a coding error when using this function
-            log_write(LOG_ERROR, "Invalid Current Sensor Address");
+            LOG_ERRORF("Invalid Current Sensor Address");
+            FLIGHT_FATAL();
             exit(EXIT_FAILURE);
     }
 
-    snprintf(logBuffer, sizeof(logBuffer), "BUS-CURR: Measured a Current of %umA from Sensor 0x%02x", (uint16_t)currBuf, currAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_CURR_READ_CURRENT, (uint16_t)currBuf, currAddr);
     return currBuf;
 }
 
@@ -478,20 +466,17 @@ uint16_t read_power(uint8_t currAddr){
     uint16_t pwrReg = 0;
     uint16_t powerBuf = 0;
 
-    char logBuffer[LOG_BUFFER_SIZE];
     uint8_t reg = CURR_REG_POWER;
 
     bus = i2c_setup(I2C_BUS_INDEX, currAddr);
     if (bus == I2C_SETUP_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Bus Failed to Open", currAddr);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_CURR_I2C_OPEN_FAIL, currAddr);
         return current_error_code(currAddr, CURR1_VAL_READ_ERROR_16BIT);
     }
 
     errorCheck = i2c_reg16_write_read(bus, &reg, 1, &pwrReg);
     if (errorCheck == I2C_WR_R_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Reg 0x%02x Read Failed", currAddr, reg);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_CURR_I2C_READ_FAIL, currAddr, reg);
         return current_error_code(currAddr, CURR1_VAL_READ_ERROR_16BIT);
     }
 
@@ -510,12 +495,12 @@ uint16_t read_power(uint8_t currAddr){
             break;
         default:
             // This will only happen if there is a coding error when using this function
-            log_write(LOG_ERROR, "Invalid Current Sensor Address");
+            LOG_ERRORF("Invalid Current Sensor Address");
+            FLIGHT_FATAL();
             exit(EXIT_FAILURE);
     }
 
-    snprintf(logBuffer, sizeof(logBuffer), "BUS-PWR: Measured a Power of %umW from Sensor 0x%02x", (uint16_t)powerBuf, currAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_CURR_READ_POWER, (uint16_t)powerBuf, currAddr);
     return powerBuf;
 
 }
@@ -535,20 +520,17 @@ uint16_t read_pk_power(uint8_t currAddr){
     uint16_t pwrReg = 0;
     uint16_t powerBuf = 0;
 
-    char logBuffer[LOG_BUFFER_SIZE];
     uint8_t reg = CURR_REG_POWER_PK;
 
     bus = i2c_setup(I2C_BUS_INDEX, currAddr);
     if (bus == I2C_SETUP_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Bus Failed to Open", currAddr);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_CURR_I2C_OPEN_FAIL, currAddr);
         return current_error_code(currAddr, CURR1_VAL_READ_ERROR_16BIT);
     }
 
     errorCheck = i2c_reg16_write_read(bus, &reg, 1, &pwrReg);
     if (errorCheck == I2C_WR_R_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Reg 0x%02x Read Failed", currAddr, reg);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_CURR_I2C_READ_FAIL, currAddr, reg);
         return current_error_code(currAddr, CURR1_VAL_READ_ERROR_16BIT);
     }
 
@@ -567,12 +549,12 @@ uint16_t read_pk_power(uint8_t currAddr){
             break;
         default:
             // This will only happen if there is a coding error when using this function
-            log_write(LOG_ERROR, "Invalid Current Sensor Address");
+            LOG_ERRORF("Invalid Current Sensor Address");
+            FLIGHT_FATAL();
             exit(EXIT_FAILURE);
     }
 
-    snprintf(logBuffer, sizeof(logBuffer), "BUS-PK-PWR: Measured a Peak Power of %umW from Sensor 0x%02x", (uint16_t)powerBuf, currAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_CURR_READ_PK_POWER, (uint16_t)powerBuf, currAddr);
     return powerBuf;
 }
 
@@ -592,20 +574,17 @@ uint16_t read_bus_voltage(uint8_t currAddr){
     uint16_t voltReg = 0;
     uint16_t voltBuf = 0;
 
-    char logBuffer[LOG_BUFFER_SIZE];
     uint8_t reg = CURR_REG_BUS_VOLT;
 
     bus = i2c_setup(I2C_BUS_INDEX, currAddr);
     if (bus == I2C_SETUP_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Bus Failed to Open", currAddr);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_CURR_I2C_OPEN_FAIL, currAddr);
         return current_error_code(currAddr, CURR1_VAL_READ_ERROR_16BIT);
     }
 
     errorCheck = i2c_reg16_write_read(bus, &reg, 1, &voltReg);
     if (errorCheck == I2C_WR_R_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Current Sensor 0x%02x - I2C Reg 0x%02x Read Failed", currAddr, reg);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_CURR_I2C_READ_FAIL, currAddr, reg);
         return current_error_code(currAddr, CURR1_VAL_READ_ERROR_16BIT);
     }
 
@@ -613,8 +592,7 @@ uint16_t read_bus_voltage(uint8_t currAddr){
 
     // Convert to mV
     voltBuf = (uint16_t)(1000 * (voltReg >> 3) * 0.004); // LSB = 10uV
-    snprintf(logBuffer, sizeof(logBuffer), "BUS-VOLT: Measured a Bus Voltage of %umV from Sensor 0x%02x", (uint16_t)voltBuf, currAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_CURR_READ_VOLTAGE, (uint16_t)voltBuf, currAddr);
 
     return voltBuf;
 
@@ -624,52 +602,62 @@ uint16_t read_bus_voltage(uint8_t currAddr){
  * @brief Checks if current limit is reached on any of the sensors. This limit is a warning, since the 
  *        actual limit is programmed into the Current Sensors where it will disable the PSU if reached.
  * 
- * @param errorBuffer Pointer to Buffer containing any errors that occur during operation
+ * @param limitErrors Pointer to array of one entry per sensor that will store the errors found
+ * @param numLimitErrors Pointer to variable that will store the number of errors found
  */
-void current_limit(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount){
+void current_limit(enum IRIS_ERROR *limitErrors, uint8_t *numLimitErrors){
 
-    uint16_t curr3v3 = 0;
-    uint16_t curr5v = 0;
-    uint16_t currcam = 0;
+    uint16_t current[3] = {0};
 
-    char logBuffer[LOG_BUFFER_SIZE];
+    current[0] = read_current(CURRENT_SENSOR_ADDR_3V3);
+    current[1] = read_current(CURRENT_SENSOR_ADDR_5V);
+    current[2] = read_current(CURRENT_SENSOR_ADDR_CAM);
 
-    curr3v3 = read_current(CURRENT_SENSOR_ADDR_3V3);
-    curr5v = read_current(CURRENT_SENSOR_ADDR_5V);
-    currcam = read_current(CURRENT_SENSOR_ADDR_CAM);
+    current_limit_check(current, limitErrors, numLimitErrors);
+}
+
+/**
+ * @brief Checks currents that were already read against the limit of each rail
+ * 
+ * @param current Pointer to array of the 3V3, 5V and Camera rail currents as returned by 'read_current'
+ * @param limitErrors Pointer to array of one entry per sensor that will store the errors found
+ * @param numLimitErrors Pointer to variable that will store the number of errors found
+ */
+void current_limit_check(const uint16_t *current, enum IRIS_ERROR *limitErrors, uint8_t *numLimitErrors){
+
+    uint16_t curr3v3 = current[0];
+    uint16_t curr5v = current[1];
+    uint16_t currcam = current[2];
 
     //DETERMINE IF CURRENT LIMIT REACHED
     if(curr3v3 != CURR1_VAL_READ_ERROR_16BIT){
         if(curr3v3 > CURR_3V3_MAX){
-            errorBuffer[(*errorCount)++] = CURR1_LIMIT_ERROR;
-            snprintf(logBuffer, sizeof(logBuffer), "CURR-LIMIT: 3V3 Current Limit Reached - Measured %umA", curr3v3);
-            log_write(LOG_WARNING, logBuffer);
+            limitErrors[(*numLimitErrors)++] = CURR1_LIMIT_ERROR;
+            LOG_RECORD(LOGID_CURR_LIMIT_3V3, curr3v3);
         }
     }else{
-        errorBuffer[(*errorCount)++] = CURR1_VAL_READ_ERROR_16BIT;
-        log_write(LOG_WARNING, "3V3 Current Sensor - Failed to Read Current");
+        limitErrors[(*numLimitErrors)++] = CURR1_VAL_READ_ERROR_16BIT;
+        LOG_WARNINGF("3V3 Current Sensor - Failed to Read Current");
     }
     
     if(curr5v != CURR2_VAL_READ_ERROR_16BIT){
         if(curr5v > CURR_5V_MAX){
-            errorBuffer[(*errorCount)++] = CURR2_LIMIT_ERROR;
-            snprintf(logBuffer, sizeof(logBuffer), "CURR-LIMIT: CM4 Current Limit Reached - Measured %umA", curr5v);
-            log_write(LOG_WARNING, logBuffer);
+            limitErrors[(*numLimitErrors)++] = CURR2_LIMIT_ERROR;
+            LOG_RECORD(LOGID_CURR_LIMIT_5V, curr5v);
         }
     }else{
-        errorBuffer[(*errorCount)++] = CURR2_VAL_READ_ERROR_16BIT;
-        log_write(LOG_WARNING, "CM4 Current Sensor - Failed to Read Current");
+        limitErrors[(*numLimitErrors)++] = CURR2_VAL_READ_ERROR_16BIT;
+        LOG_WARNINGF("CM4 Current Sensor - Failed to Read Current");
     }
     
     if(currcam != CURR3_VAL_READ_ERROR_16BIT){
         if(currcam > CURR_CAM_MAX){
-            errorBuffer[(*errorCount)++] = CURR3_LIMIT_ERROR;
-            snprintf(logBuffer, sizeof(logBuffer), "CURR-LIMIT: Camera Current Limit Reached - Measured %umA", currcam);
-            log_write(LOG_WARNING, logBuffer);
+            limitErrors[(*numLimitErrors)++] = CURR3_LIMIT_ERROR;
+            LOG_RECORD(LOGID_CURR_LIMIT_CAM, currcam);
         }
     }else{
-        errorBuffer[(*errorCount)++] = CURR3_VAL_READ_ERROR_16BIT;
-        log_write(LOG_WARNING, "Camera Current Sensor - Failed to Read Current");
+        limitErrors[(*numLimitErrors)++] = CURR3_VAL_READ_ERROR_16BIT;
+        LOG_WARNINGF("Camera Current Sensor - Failed to Read Current");
     }
 
 }
\ No newline at end of file
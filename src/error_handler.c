@@ -2,45 +2,335 @@
 #include "cmd_controller.h"
 #include "error_handler.h"
 #include "gpio.h"
+#include "logger.h"
 #include "spi_iris.h"
+#include "timing.h"
 
 
+#include <errno.h>
+#include <fcntl.h>
 #include <gpiod.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
 
-//! ADD ERROR DETECTIONS FOR SPI WHERE IT ONLY RESET ERROR COUNTER IF THE TRANSFER WAS SUCCESSFUL
-//! NEED TO MAKE IT SO IT CONVERTS ANY 16-BIT ERRORS TO 8-BIT REPRESENTATIVE
-//! NEED TO FIGURE OUT HOW TO AVOID RACE CONDITION
-    //! COULD HAVE SITUATION WHERE WE LOOK AT csVal AND ITS HIGH BUT ONCE
-    //! WE GET TO TRANSFERING DATA THE OBC HAS PULLED LINE LOW
-    //! MAYBE HAVE IT SO DIRECTLY BEFORE TRANSFER WE CHECK CSVAL
-enum IRIS_ERROR iris_error_transfer(int spi_dev, struct gpiod_line_request *spi_cs_request, const enum IRIS_ERROR *errorBuffer, uint8_t *errorCount){
+#define ERROR_HISTORY_FILE_SIZE (ERROR_HISTORY_NUM_COPIES * sizeof(error_history_copy_t))
+
+static error_table_t errorTable;
+static pthread_mutex_t errorLock = PTHREAD_MUTEX_INITIALIZER;
+static error_history_copy_t *errorHistory = NULL;      // Mapped history file, NULL if not persisted
+static uint32_t errorHistorySeq = 0;                   // Sequence number of the newest copy
+
+
+/**
+ * @brief CRC-32 of a history copy, covers the header fields in front of 'crc' and the table
+ *
+ * @param copy Pointer to copy
+ * @return CRC-32
+ */
+static uint32_t error_history_crc(const error_history_copy_t *copy){
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+
+    crc = crc32(crc, (const Bytef *)copy, offsetof(error_history_copy_t, crc));
+    crc = crc32(crc, (const Bytef *)&copy->table, sizeof(copy->table));
+    return (uint32_t)crc;
+}
+
+/**
+ * @brief Writes the table over the older copy of the history file, must hold 'errorLock'.
+ *        The copy only validates once its CRC is written, a torn write falls back to the other copy.
+ */
+static void error_history_write(void){
+
+    error_history_copy_t *copy = NULL;
+    uint32_t seq = errorHistorySeq + 1;
+
+    if (errorHistory == NULL){
+        return;
+    }
+    copy = &errorHistory[seq % ERROR_HISTORY_NUM_COPIES];
+    copy->magic = ERROR_HISTORY_MAGIC;
+    copy->version = ERROR_HISTORY_VERSION;
+    copy->tableSize = ERROR_TABLE_SIZE;
+    copy->seq = seq;
+    memcpy(&copy->table, &errorTable, sizeof(errorTable));
+    copy->crc = error_history_crc(copy);
+    errorHistorySeq = seq;
+}
+
+/**
+ * @brief Maps the error history file and restores the newest valid copy into the table. Call once
+ *        at start before anything records an error (before sensor init), so unreported errors from
+ *        before a crash or reset are in the first summary sent to the OBC.
+ *
+ * @return Iris error code indicating the success or failure of function, the table still works
+ *         (without persistence) on failure
+ */
+enum IRIS_ERROR error_history_init(void){
+
+    char path[LOG_FILE_PATH_LEN];
+    const error_history_copy_t *copy = NULL;
+    const error_history_copy_t *newest = NULL;
+    error_history_copy_t *map = NULL;
+    uint32_t numCodes = 0;
+    uint64_t numErrors = 0;
+    int fd = -1;
+
+    if (errorHistory != NULL){
+        return NO_ERROR;
+    }
+    snprintf(path, sizeof(path), "%s/%s", LOG_DIRECTORY, ERROR_HISTORY_FILENAME);
+
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0){
+        LOG_ERRORF("ERROR-HISTORY: Failed to open %s (%s)", path, strerror(errno));
+        return ERROR_HISTORY_ERROR;
+    }
+    if (ftruncate(fd, ERROR_HISTORY_FILE_SIZE) != 0){
+        LOG_ERRORF("ERROR-HISTORY: Failed to size %s (%s)", path, strerror(errno));
+        close(fd);
+        return ERROR_HISTORY_ERROR;
+    }
+    map = mmap(NULL, ERROR_HISTORY_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED){
+        LOG_ERRORF("ERROR-HISTORY: Failed to map %s (%s)", path, strerror(errno));
+        return ERROR_HISTORY_ERROR;
+    }
+
+    // Newest copy whose layout and CRC check out, sequence numbers are compared across a wrap
+    for (int index = 0; index < ERROR_HISTORY_NUM_COPIES; index++){
+        copy = &map[index];
+        if ((copy->magic != ERROR_HISTORY_MAGIC) || (copy->version != ERROR_HISTORY_VERSION) ||
+            (copy->tableSize != ERROR_TABLE_SIZE) || (copy->crc != error_history_crc(copy))){
+            continue;
+        }
+        if ((newest == NULL) || ((int32_t)(copy->seq - newest->seq) > 0)){
+            newest = copy;
+        }
+    }
+
+    pthread_mutex_lock(&errorLock);
+    if (newest != NULL){
+        memcpy(&errorTable, &newest->table, sizeof(errorTable));
+        errorHistorySeq = newest->seq;
+    }
+    errorHistory = map;
+    for (int index = 0; index < ERROR_TABLE_SIZE; index++){
+        if (errorTable.entries[index].count != 0){
+            numCodes++;
+            numErrors += errorTable.entries[index].count;
+        }
+    }
+    pthread_mutex_unlock(&errorLock);
+
+    if (newest == NULL){
+        LOG_INFOF("ERROR-HISTORY: No valid error history in %s, starting empty", path);
+    }else{
+        LOG_INFOF("ERROR-HISTORY: Restored %u unreported error codes (%llu occurrences) from %s", numCodes, (unsigned long long)numErrors, path);
+    }
+    return NO_ERROR;
+}
+
+/**
+ * @brief Writes the error history back to storage, protects it against a power loss
+ */
+void error_history_sync(void){
+
+    if (errorHistory != NULL){
+        msync(errorHistory, ERROR_HISTORY_FILE_SIZE, MS_SYNC);
+    }
+}
+
+/**
+ * @brief Finds the slot of an error code, open addressing with linear probing. Codes are never
+ *        removed from the table, a slot whose count was reported keeps its code.
+ *
+ * @param code IRIS_ERROR code (Not NO_ERROR)
+ * @param create True to claim a free slot if the code is not in the table
+ * @return Pointer to slot, NULL if the code is not in the table (or the table is full)
+ */
+static error_entry_t *error_slot(uint16_t code, bool create){
+
+    uint32_t slot = ((uint32_t)code * 2654435761U) >> 24;   // Fibonacci hash to 8 bits
+    error_entry_t *entry = NULL;
+
+    for (uint32_t probe = 0; probe < ERROR_TABLE_SIZE; probe++){
+        entry = &errorTable.entries[(slot + probe) & (ERROR_TABLE_SIZE - 1)];
+        if (entry->code == code){
+            return entry;
+        }
+        if (entry->code == NO_ERROR){
+            if (!create){
+                return NULL;
+            }
+            entry->code = code;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Counts an occurrence of an error, reported to the OBC in the next error summary
+ *
+ * @param error Iris error code, NO_ERROR is ignored
+ */
+void error_record(enum IRIS_ERROR error){
+
+    error_entry_t *entry = NULL;
+    uint32_t now = (uint32_t)get_time_seconds();
+
+    if (error == NO_ERROR){
+        return;
+    }
+
+    pthread_mutex_lock(&errorLock);
+    entry = error_slot((uint16_t)error, true);
+    if (entry == NULL){
+        errorTable.dropped++;
+    }else{
+        if (entry->count == 0){
+            entry->firstS = now;
+        }
+        entry->count++;
+        entry->lastS = now;
+    }
+    error_history_write();
+    pthread_mutex_unlock(&errorLock);
+}
+
+/**
+ * @brief Builds an ERROR_TRANSFER frame from the unreported counts. The counts stay in the table
+ *        until 'error_summary_ack' is called with 'summary' once the OBC has received the frame.
+ *
+ * @param frame Pointer to array of ERROR_SUMMARY_MAX_LEN bytes that will store the frame
+ * @param summary Pointer to structure that will store the counts carried by the frame
+ * @return Frame length in bytes
+ */
+uint16_t error_summary(uint8_t *frame, error_summary_t *summary){
+
+    const error_entry_t *entry = NULL;
+    uint8_t *field = frame + ERROR_SUMMARY_HEADER_SIZE;
+    uint32_t start = 0;
+    uint32_t slot = 0;
+
+    pthread_mutex_lock(&errorLock);
+    start = errorTable.summaryStart;
+    summary->numEntries = 0;
+    summary->dropped = (errorTable.dropped > UINT16_MAX) ? UINT16_MAX : (uint16_t)errorTable.dropped;
+
+    for (uint32_t index = 0; (index < ERROR_TABLE_SIZE) && (summary->numEntries < ERROR_SUMMARY_MAX_ENTRIES); index++){
+        slot = (start + index) & (ERROR_TABLE_SIZE - 1);
+        entry = &errorTable.entries[slot];
+        if (entry->count == 0){
+            continue;
+        }
+        summary->codes[summary->numEntries] = entry->code;
+        summary->counts[summary->numEntries] = (entry->count > UINT16_MAX) ? UINT16_MAX : (uint16_t)entry->count;
+
+        field[0]  = (entry->code >> 8) & 0xFF;     // MSB
+        field[1]  =  entry->code & 0xFF;           // LSB
+        field[2]  = (summary->counts[summary->numEntries] >> 8) & 0xFF;
+        field[3]  =  summary->counts[summary->numEntries] & 0xFF;
+        for (int byte = 0; byte < 4; byte++){
+            field[4 + byte] = (entry->firstS >> (24 - (8 * byte))) & 0xFF;
+            field[8 + byte] = (entry->lastS >> (24 - (8 * byte))) & 0xFF;
+        }
+        field += ERROR_SUMMARY_ENTRY_SIZE;
+        summary->numEntries++;
+        errorTable.summaryStart = slot + 1;
+    }
+    pthread_mutex_unlock(&errorLock);
+
+    frame[0] = ERROR_TRANSFER;
+    frame[1] = summary->numEntries;
+    frame[2] = (summary->dropped >> 8) & 0xFF;
+    frame[3] =  summary->dropped & 0xFF;
+    return ERROR_SUMMARY_HEADER_SIZE + (summary->numEntries * ERROR_SUMMARY_ENTRY_SIZE);
+}
+
+/**
+ * @brief Removes the counts carried by a summary the OBC has received, occurrences recorded after
+ *        the summary was built stay in the table
+ *
+ * @param summary Pointer to structure filled by 'error_summary'
+ */
+void error_summary_ack(const error_summary_t *summary){
+
+    error_entry_t *entry = NULL;
+
+    pthread_mutex_lock(&errorLock);
+    errorTable.dropped -= (summary->dropped < errorTable.dropped) ? summary->dropped : errorTable.dropped;
+    for (int index = 0; index < summary->numEntries; index++){
+        entry = error_slot(summary->codes[index], false);
+        if (entry == NULL){
+            continue;
+        }
+        entry->count -= (summary->counts[index] < entry->count) ? summary->counts[index] : entry->count;
+    }
+    error_history_write();
+    pthread_mutex_unlock(&errorLock);
+}
+
+/**
+ * @brief Writes an error summary frame to the OBC, only while the CS line is inactive
+ *
+ * @param spi_dev Configured SPI bus instance
+ * @param spi_cs_request SPI chip select
+ * @param frame Pointer to frame built by 'error_summary'
+ * @param frameLen Frame length in bytes
+ * @param sent Pointer to variable that will store true if the OBC received the frame
+ * @return Iris error code of the SPI transfer
+ */
+enum IRIS_ERROR iris_error_transfer(int spi_dev, struct gpiod_line_request *spi_cs_request, const uint8_t *frame, uint16_t frameLen, bool *sent){
 
     IRIS_ERROR spiError = NO_ERROR;
-    uint8_t dataBuffer[ERROR_BUFFER_SIZE + 2] = {0};
     enum gpiod_line_value csVal = GPIOD_LINE_VALUE_INACTIVE;
 
+    //! NEED TO FIGURE OUT HOW TO AVOID RACE CONDITION
+        //! COULD HAVE SITUATION WHERE WE LOOK AT csVal AND ITS HIGH BUT ONCE
+        //! WE GET TO TRANSFERING DATA THE OBC HAS PULLED LINE LOW
+        //! MAYBE HAVE IT SO DIRECTLY BEFORE TRANSFER WE CHECK CSVAL
+    *sent = false;
     csVal = gpiod_line_request_get_value(spi_cs_request, SPI_CE_N);
 
     // Only Proceed with transfer if CS Line is inactive
     if (csVal == GPIOD_LINE_VALUE_ACTIVE){
 
-        // Number of Error Packets to Send
-        dataBuffer[0] = ERROR_TRANSFER;
-        dataBuffer[1] = *errorCount;
-
-        for (int index = 0; index < *errorCount; index++){
-            dataBuffer[index + 2] = errorBuffer[index];
-        }
-
-        spiError = spi_write(spi_dev, dataBuffer, *errorCount + 2, spi_cs_request);
+        spiError = spi_write(spi_dev, frame, frameLen, spi_cs_request);
 
         // Checks if the Error Transfer was SUCCESSFUL
-        if (spiError == NO_ERROR){
-            *errorCount = 0;
-            return spiError;
-        }
+        *sent = (spiError == NO_ERROR);
         return spiError;
     }
     return NO_ERROR;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Sends the error summary to the OBC and removes the reported counts once it is received
+ *
+ * @param spi_dev Configured SPI bus instance
+ * @param spi_cs_request SPI chip select
+ * @return Iris error code of the SPI transfer
+ */
+enum IRIS_ERROR iris_error_report(int spi_dev, struct gpiod_line_request *spi_cs_request){
+
+    uint8_t frame[ERROR_SUMMARY_MAX_LEN];
+    error_summary_t summary;
+    uint16_t frameLen = error_summary(frame, &summary);
+    IRIS_ERROR spiError = NO_ERROR;
+    bool sent = false;
+
+    spiError = iris_error_transfer(spi_dev, spi_cs_request, frame, frameLen, &sent);
+    if (sent){
+        error_summary_ack(&summary);
+    }
+    return spiError;
+}
@@ -0,0 +1,340 @@
+/**
+ * @file flight_recorder.c
+ * @author agent
+ * @brief Crash Flight Recorder for Theia CM4
+ *        Provides functions to...
+ *         - Map a fixed-size ring of binary events into a file that outlives the service
+ *         - Record commands, SPI transfers, I2C errors and fatal errors with a few stores per event
+ *         - Record fatal signals before the service terminates
+ *         - Keep the previous session's ring and summarise it in the log on start
+ *         - Snapshot a ring into a sealed memfd for downlink (FLIGHT_DUMP)
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include "error_handler.h"
+#include "flight_recorder.h"
+#include "logger.h"
+#include "timing.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static flight_header_t *flightHeader = NULL;
+static flight_entry_t *flightEntries = NULL;
+static char flightBaseName[LOG_BASENAME_LEN] = FLIGHT_BASENAME;
+static volatile bool flightFatal = false;    // Set by 'flight_record_fatal', the exit that follows is not a normal one
+
+static const int flightSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+
+/**
+ * @brief Builds the path of a flight recorder file, <LOG_DIRECTORY>/<base>[_prev].rec
+ *
+ * @param baseName Flight recorder base name
+ * @param previous True for the previous session's file
+ * @param path Pointer to array that will store the path
+ * @param pathLen Size of path
+ */
+static void flight_recorder_path(const char *baseName, bool previous, char *path, size_t pathLen){
+    snprintf(path, pathLen, "%s/%s%s.rec", LOG_DIRECTORY, baseName, previous ? FLIGHT_PREV_SUFFIX : "");
+}
+
+/**
+ * @brief Logs a summary of the previous session's ring, the last event shows how the session ended
+ *
+ * @param path Path of the previous session's file
+ * @param session Pointer to variable that will store the previous session number, unchanged if
+ *                the file is missing or corrupt
+ */
+static void flight_recorder_previous(const char *path, uint32_t *session){
+
+    flight_header_t header;
+    flight_entry_t entry;
+    flight_entry_t last;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0){
+        return;
+    }
+    if ((pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) || (header.magic != FLIGHT_MAGIC) ||
+        (header.entrySize != sizeof(flight_entry_t)) || (header.numEntries == 0)){
+        close(fd);
+        return;
+    }
+    *session = header.session;
+
+    memset(&last, 0, sizeof(last));
+    for (uint32_t index = 0; index < header.numEntries; index++){
+        if (pread(fd, &entry, sizeof(entry), sizeof(header) + ((off_t)index * sizeof(entry))) != (ssize_t)sizeof(entry)){
+            break;
+        }
+        if ((entry.seq != 0) && ((last.seq == 0) || ((int32_t)(entry.seq - last.seq) > 0))){
+            last = entry;
+        }
+    }
+    close(fd);
+
+    if ((last.event == FLIGHT_FATAL) || (last.event == FLIGHT_SIGNAL)){
+        LOG_WARNINGF("FLIGHT-RECORDER: Previous session %u ended abnormally after %llu events, last event %u (code %u)",
+                     header.session, (unsigned long long)header.writePos, last.event, last.code);
+    }else{
+        LOG_INFOF("FLIGHT-RECORDER: Previous session %u recorded %llu events, last event %u (code %u)",
+                  header.session, (unsigned long long)header.writePos, last.event, last.code);
+    }
+}
+
+/**
+ * @brief Records a fatal signal then lets the default action terminate the service
+ *
+ * @param signum Signal number
+ * @param info Pointer to signal information
+ * @param context Unused
+ */
+static void flight_recorder_signal(int signum, siginfo_t *info, void *context){
+
+    uintptr_t addr = (uintptr_t)info->si_addr;
+    (void)context;
+
+    flight_record(FLIGHT_SIGNAL, (uint16_t)signum, (uint32_t)info->si_code, (uint32_t)addr, (uint32_t)((uint64_t)addr >> 32), 0);
+    flight_recorder_sync();
+
+    // SA_RESETHAND restored the default action, delivered once the handler returns
+    raise(signum);
+}
+
+/**
+ * @brief atexit handler, marks a normal exit so it can be told apart from a crash. Nothing is
+ *        recorded after a fatal error so FLIGHT_FATAL stays the last event of the session.
+ */
+static void flight_recorder_exit(void){
+    if (flightFatal){
+        return;
+    }
+    flight_record(FLIGHT_EXIT, 0, 0, 0, 0, 0);
+    flight_recorder_sync();
+}
+
+/**
+ * @brief Keeps the previous session's ring, maps a new ring and installs the crash handlers.
+ *        Call once at start after 'log_file_init', events recorded before this are dropped.
+ *
+ * @param baseName FLIGHT_BASENAME (Main service) or FLIGHT_SPI_BASENAME (SPI service)
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR flight_recorder_init(const char *baseName){
+
+    char path[LOG_FILE_PATH_LEN];
+    char prevPath[LOG_FILE_PATH_LEN];
+    struct sigaction action;
+    struct timespec realtime;
+    struct timespec monotonic;
+    uint32_t session = 0;
+    void *map = NULL;
+    int fd = -1;
+
+    if ((baseName == NULL) || (strlen(baseName) >= sizeof(flightBaseName)) || (flightHeader != NULL)){
+        return FLIGHT_RECORDER_ERROR;
+    }
+    strcpy(flightBaseName, baseName);
+    flight_recorder_path(flightBaseName, false, path, sizeof(path));
+    flight_recorder_path(flightBaseName, true, prevPath, sizeof(prevPath));
+
+    if (rename(path, prevPath) == 0){
+        flight_recorder_previous(prevPath, &session);
+    }
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0){
+        LOG_ERRORF("FLIGHT-RECORDER: Failed to create %s (%s)", path, strerror(errno));
+        return FLIGHT_RECORDER_ERROR;
+    }
+    if (ftruncate(fd, FLIGHT_FILE_SIZE) != 0){
+        LOG_ERRORF("FLIGHT-RECORDER: Failed to size %s (%s)", path, strerror(errno));
+        close(fd);
+        return FLIGHT_RECORDER_ERROR;
+    }
+    map = mmap(NULL, FLIGHT_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED){
+        LOG_ERRORF("FLIGHT-RECORDER: Failed to map %s (%s)", path, strerror(errno));
+        return FLIGHT_RECORDER_ERROR;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    clock_gettime(CLOCK_MONOTONIC, &monotonic);
+
+    // File is freshly truncated so every entry starts incomplete (seq = 0)
+    flightEntries = (flight_entry_t *)((uint8_t *)map + sizeof(flight_header_t));
+    flightHeader = (flight_header_t *)map;
+    flightHeader->version = FLIGHT_VERSION;
+    flightHeader->entrySize = sizeof(flight_entry_t);
+    flightHeader->numEntries = FLIGHT_NUM_ENTRIES;
+    flightHeader->session = session + 1;
+    flightHeader->bootRealtimeNs = ((uint64_t)realtime.tv_sec * 1000000000ULL) + (uint64_t)realtime.tv_nsec;
+    flightHeader->bootMonotonicNs = ((uint64_t)monotonic.tv_sec * 1000000000ULL) + (uint64_t)monotonic.tv_nsec;
+    flightHeader->writePos = 0;
+    flightHeader->pid = (uint32_t)getpid();
+    __atomic_store_n(&flightHeader->magic, FLIGHT_MAGIC, __ATOMIC_RELEASE);
+
+    flight_record(FLIGHT_BOOT, FLIGHT_VERSION, flightHeader->pid, flightHeader->session, 0, 0);
+
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = flight_recorder_signal;
+    action.sa_flags = SA_SIGINFO | SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    for (size_t index = 0; index < (sizeof(flightSignals) / sizeof(flightSignals[0])); index++){
+        sigaction(flightSignals[index], &action, NULL);
+    }
+    atexit(flight_recorder_exit);
+
+    LOG_INFOF("FLIGHT-RECORDER: Session %u recording to %s", flightHeader->session, path);
+    return NO_ERROR;
+}
+
+/**
+ * @brief Records an event in the ring, overwriting the oldest entry once the ring is full.
+ *        Lock free and safe to call from any thread or a signal handler, does nothing before
+ *        'flight_recorder_init'.
+ *
+ * @param event FLIGHT_EVENT
+ * @param code Event specific code (See 'flight_recorder.h')
+ * @param arg0 Event specific argument
+ * @param arg1 Event specific argument
+ * @param arg2 Event specific argument
+ * @param arg3 Event specific argument
+ */
+void flight_record(uint16_t event, uint16_t code, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3){
+
+    flight_entry_t *entry = NULL;
+    uint64_t pos = 0;
+
+    if (flightHeader == NULL){
+        return;
+    }
+
+    pos = __atomic_fetch_add(&flightHeader->writePos, 1, __ATOMIC_RELAXED);
+    entry = &flightEntries[pos & (FLIGHT_NUM_ENTRIES - 1)];
+
+    // Readers skip the entry until seq is published again
+    __atomic_store_n(&entry->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    entry->timestampNs = get_time_monotonic_ns();
+    entry->event = event;
+    entry->code = code;
+    entry->args[0] = arg0;
+    entry->args[1] = arg1;
+    entry->args[2] = arg2;
+    entry->args[3] = arg3;
+    __atomic_store_n(&entry->seq, (uint32_t)(pos + 1), __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Records a fatal error with its source location and flushes the ring (See 'FLIGHT_FATAL')
+ *
+ * @param file Source file name (__FILE__)
+ * @param line Source line (__LINE__)
+ */
+void flight_record_fatal(const char *file, int line){
+
+    uint32_t name[3] = {0};
+    const char *baseName = strrchr(file, '/');
+
+    baseName = (baseName != NULL) ? (baseName + 1) : file;
+    strncpy((char *)name, baseName, sizeof(name));
+
+    flightFatal = true;
+    flight_record(FLIGHT_FATAL, 0, name[0], name[1], name[2], (uint32_t)line);
+    flight_recorder_sync();
+}
+
+/**
+ * @brief Writes the ring back to storage, protects the recorded events against a power loss
+ */
+void flight_recorder_sync(void){
+
+    if (flightHeader != NULL){
+        msync(flightHeader, FLIGHT_FILE_SIZE, MS_SYNC);
+    }
+}
+
+/**
+ * @brief Copies a flight recorder file into a sealed memfd for a bulk SPI transfer. Entries being
+ *        written during the copy have seq = 0 and are skipped by the decoder.
+ *
+ * @param flags FLIGHT_DUMP_FLAG_*, with FLIGHT_DUMP_FLAG_SIZE_ONLY the file is only measured
+ * @param fd Pointer to variable that will store the sealed memfd (-1 if size only or on failure),
+ *           the caller must close it
+ * @param size Pointer to variable that will store the size of the dump in bytes
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR flight_recorder_dump(uint8_t flags, int *fd, uint32_t *size){
+
+    char path[LOG_FILE_PATH_LEN];
+    uint8_t buffer[4096];
+    struct stat fileStat;
+    ssize_t readLen = 0;
+    int fileFd = -1;
+    int dumpFd = -1;
+
+    *fd = -1;
+    *size = 0;
+    flight_recorder_path((flags & FLIGHT_DUMP_FLAG_SPI) ? FLIGHT_SPI_BASENAME : FLIGHT_BASENAME,
+                         (flags & FLIGHT_DUMP_FLAG_PREVIOUS) != 0, path, sizeof(path));
+
+    fileFd = open(path, O_RDONLY | O_CLOEXEC);
+    if ((fileFd < 0) || (fstat(fileFd, &fileStat) != 0)){
+        LOG_WARNINGF("FLIGHT-RECORDER: No flight recorder file %s", path);
+        if (fileFd >= 0){
+            close(fileFd);
+        }
+        return FLIGHT_RECORDER_ERROR;
+    }
+    if ((flags & FLIGHT_DUMP_FLAG_SIZE_ONLY) || (fileStat.st_size == 0)){
+        *size = (uint32_t)fileStat.st_size;
+        close(fileFd);
+        return NO_ERROR;
+    }
+
+    dumpFd = memfd_create(FLIGHT_MEMFD_NAME, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (dumpFd < 0){
+        LOG_ERRORF("FLIGHT-RECORDER: Failed to create memfd for flight recorder dump");
+        close(fileFd);
+        return FLIGHT_RECORDER_ERROR;
+    }
+    while ((readLen = read(fileFd, buffer, sizeof(buffer))) > 0){
+        if (write(dumpFd, buffer, (size_t)readLen) != readLen){
+            readLen = -1;
+            break;
+        }
+        *size += (uint32_t)readLen;
+    }
+    close(fileFd);
+    if (readLen < 0){
+        LOG_ERRORF("FLIGHT-RECORDER: Failed to copy %s", path);
+        close(dumpFd);
+        *size = 0;
+        return FLIGHT_RECORDER_ERROR;
+    }
+
+    fcntl(dumpFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+    *fd = dumpFd;
+    return NO_ERROR;
+}
@@ -7,6 +7,7 @@
  *         - Configure a I2C Interface on the CM4
  *         - Write 8-bit and 16-bit data packets to I2C Peripherals
  *         - Read 8-bit and 16-bit data packets from I2C Peripherals
+ *         - Serialise multi-transaction sensor accesses between threads (Bus Lock)
  * 
  * @version 0.1
  * @date 2024-11-09
@@ -18,12 +19,17 @@
 //---- Headers -----//
 
 #include "error_handler.h"
+#include "flight_recorder.h"
 #include "i2c.h"
 #include "logger.h"
+#include "metrics.h"
+#include "timing.h"
+#include "trace.h"
 
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/i2c-dev.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,6 +37,37 @@
 #include <sys/ioctl.h>
 #include <unistd.h>
 
+static pthread_mutex_t i2cBusLock;
+static pthread_once_t i2cBusLockOnce = PTHREAD_ONCE_INIT;
+
+static void i2c_bus_lock_init(void){
+
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&i2cBusLock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+/**
+ * @brief Takes ownership of the sensor I2C bus. Sensor driver calls are a sequence of
+ *        register pointer writes and reads, so threads sharing the bus (SPI command thread,
+ *        job workers, housekeeping) must hold the lock for the whole driver call.
+ *        Lock is recursive, nested calls from the same thread are allowed.
+ */
+void i2c_bus_lock(void){
+    pthread_once(&i2cBusLockOnce, i2c_bus_lock_init);
+    pthread_mutex_lock(&i2cBusLock);
+}
+
+/**
+ * @brief Releases the sensor I2C bus taken by 'i2c_bus_lock'
+ */
+void i2c_bus_unlock(void){
+    pthread_mutex_unlock(&i2cBusLock);
+}
+
 /**
  * @brief Configures the selected I2C interface to communicate with inputed I2C address
  * 
@@ -41,20 +78,17 @@
 int i2c_setup_interface(char *i2cBus, uint8_t devID) {
 
     int fileDesc = 0;
-    char logBuffer[LOG_BUFFER_SIZE];
 
     //Open I2C bus linux interface
     fileDesc = open(i2cBus, O_RDWR);
     if (fileDesc < 0){
-        snprintf(logBuffer, sizeof(logBuffer), "Unable to open I2C Bus: %s", strerror(errno));
-        log_write(LOG_ERROR, logBuffer);
+        LOG_ERRORF("Unable to open I2C Bus: %s", strerror(errno));
         return I2C_SETUP_ERROR;
     }
 
     //Configure Bus Slave Addr
     if (ioctl(fileDesc, I2C_SLAVE, devID) < 0){
-        snprintf(logBuffer, sizeof(logBuffer), "Unable to configure peripheral I2C Address: %s", strerror(errno));
-        log_write(LOG_ERROR, logBuffer);
+        LOG_ERRORF("Unable to configure peripheral I2C Address: %s", strerror(errno));
         return I2C_SETUP_ERROR;
     }
     return fileDesc;
@@ -85,7 +119,8 @@ int i2c_setup(int i2cBus, uint8_t devID){
             break;
         default:
             // This will only happen if there is a coding error when using this function
-            log_write(LOG_ERROR, "Invalid I2C Interface ID");
+            LOG_ERRORF("Invalid I2C Interface ID");
+            FLIGHT_FATAL();
             exit(EXIT_FAILURE);
     }
     return i2c_setup_interface(device, devID); 
@@ -103,22 +138,31 @@ int i2c_setup(int i2cBus, uint8_t devID){
 enum IRIS_ERROR i2c_interface(int fileDesc, enum I2C_OPERATION rwType, int sizeByte, uint8_t *data){
     
     int error = 0;
+    uint64_t startNs = get_time_monotonic_ns();
+    TRACE_SCOPE_ARG("i2c_xfer", sizeByte);
+
     if (rwType == I2C_READ){
         error = read(fileDesc, data, sizeByte);
     }else if (rwType == I2C_WRITE){
         error = write(fileDesc, data, sizeByte);
     }else{
         // This will only happen if there is a coding error when using this function
-        log_write(LOG_ERROR, "Invalid I2C Interface Operation (R/W)");
+        LOG_ERRORF("Invalid I2C Interface Operation (R/W)");
+        FLIGHT_FATAL();
         exit(EXIT_FAILURE);
     }
 
+    metric_inc(METRIC_I2C_XFERS);
+    metric_observe_ns(METRIC_HIST_I2C_XFER, get_time_monotonic_ns() - startNs);
+
     //Check if I2C operation was successful
     if (error == sizeByte){
         return 0;
     }
 
-    log_write(LOG_ERROR, "Failed I2C Interface Operation (R/W)");
+    metric_inc(METRIC_I2C_ERRORS);
+    flight_record(FLIGHT_I2C_ERROR, (rwType == I2C_READ) ? I2C_READ_ERROR : I2C_WRITE_ERROR, rwType, (uint32_t)sizeByte, (uint32_t)error, (uint32_t)errno);
+    LOG_ERRORF("Failed I2C Interface Operation (R/W)");
     switch (rwType){
         case I2C_READ:
             return I2C_READ_ERROR;
@@ -141,7 +185,8 @@ enum IRIS_ERROR i2c_write_reg8 (int fileDesc, int writeNum, uint8_t *data){
 
     if (writeNum > I2C_MAX_WRITE){
         // This will only happen if there is a coding error when using this function
-        log_write(LOG_ERROR, "I2C Command Fail: To many write requests");
+        LOG_ERRORF("I2C Command Fail: To many write requests");
+        FLIGHT_FATAL();
         exit(EXIT_FAILURE);
     }
 
@@ -164,7 +209,8 @@ enum IRIS_ERROR i2c_write_reg16(int fileDesc, int writeNum, const uint8_t *reg,
     uint8_t tempData[I2C_MAX_WRITE];
     if ((2*writeNum - 1) > I2C_MAX_WRITE){
         // This will only happen if there is a coding error when using this function
-        log_write(LOG_ERROR, "I2C Command Fail: Too many write requests");
+        LOG_ERRORF("I2C Command Fail: Too many write requests");
+        FLIGHT_FATAL();
         exit(EXIT_FAILURE);
     }
 
@@ -190,7 +236,8 @@ enum IRIS_ERROR i2c_read_reg8 (int fileDesc, int readNum, uint8_t *data){
 
     if (readNum > I2C_MAX_READ){
         // This will only happen if there is a coding error when using this function
-        log_write(LOG_ERROR, "I2C Command Fail: Too many read requests");
+        LOG_ERRORF("I2C Command Fail: Too many read requests");
+        FLIGHT_FATAL();
         exit(EXIT_FAILURE);
     }
 
@@ -213,7 +260,8 @@ enum IRIS_ERROR i2c_read_reg16 (int fileDesc, int readNum, uint16_t *data){
     uint8_t tempData[I2C_MAX_READ];
     if ((2*readNum) > I2C_MAX_READ){
         // This will only happen if there is a coding error when using this function
-        log_write(LOG_ERROR, "I2C Command Fail: Too many read requests");
+        LOG_ERRORF("I2C Command Fail: Too many read requests");
+        FLIGHT_FATAL();
         exit(EXIT_FAILURE);
     }
     errorCheck = i2c_interface(fileDesc, I2C_READ, (2*readNum), tempData);
@@ -0,0 +1,311 @@
+/**
+ * @file ipc_fd.c
+ * @author agent
+ * @brief Bulk Data Side Channel for Theia CM4
+ *        Provides functions to...
+ *         - Open the Unix domain socket shared by the Main and SPI services
+ *         - Pass open files or in memory buffers (memfd) from the Main service with SCM_RIGHTS
+ *         - Receive the file descriptors in the SPI service so bulk data can be streamed to the
+ *           OBC straight from the file, without being copied through the IPC ring
+ *         - Wake the SPI service from its CS line wait when a response is queued (Doorbell)
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include "error_handler.h"
+#include "ipc_fd.h"
+#include "ipc_iris.h"
+#include "logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+/**
+ * @brief Fills in an abstract socket address the SPI service listens on
+ *
+ * @param addr Pointer to address structure
+ * @param name IPC_FD_SOCKET_NAME or IPC_FD_DOORBELL_NAME
+ * @return Length of the address
+ */
+static socklen_t ipc_fd_address(struct sockaddr_un *addr, const char *name){
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+
+    // Leading NUL selects the abstract namespace
+    memcpy(addr->sun_path + 1, name, strlen(name));
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + strlen(name));
+}
+
+/**
+ * @brief Opens this service's end of the bulk data side channel. The SPI service binds the
+ *        socket address and receives, the Main service only sends.
+ *
+ * @param link Pointer to link structure, stores the socket
+ * @param side Service opening the channel (Main or SPI)
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR ipc_fd_open(ipc_link_t *link, enum IPC_SIDE side){
+
+    struct sockaddr_un addr;
+    socklen_t addrLen = ipc_fd_address(&addr, IPC_FD_SOCKET_NAME);
+
+    link->doorbellSocket = -1;
+    link->fdSocket = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (link->fdSocket < 0){
+        LOG_ERRORF("IPC-FD: Failed to create bulk data socket (%s)", strerror(errno));
+        return IPC_FD_ERROR;
+    }
+    if (side == IPC_SIDE_MAIN){
+        return NO_ERROR;
+    }
+
+    if (bind(link->fdSocket, (struct sockaddr *)&addr, addrLen) != 0){
+        LOG_ERRORF("IPC-FD: Failed to bind bulk data socket (%s)", strerror(errno));
+        ipc_fd_close(link);
+        return IPC_FD_ERROR;
+    }
+
+    // Main service sends the doorbell from its bulk data socket, no socket of its own is needed
+    link->doorbellSocket = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    addrLen = ipc_fd_address(&addr, IPC_FD_DOORBELL_NAME);
+    if ((link->doorbellSocket < 0) || (bind(link->doorbellSocket, (struct sockaddr *)&addr, addrLen) != 0)){
+        LOG_ERRORF("IPC-FD: Failed to bind doorbell socket (%s)", strerror(errno));
+        ipc_fd_close(link);
+        return IPC_FD_ERROR;
+    }
+    return NO_ERROR;
+}
+
+/**
+ * @brief Closes this service's end of the bulk data side channel and doorbell
+ *
+ * @param link Pointer to link structure
+ */
+void ipc_fd_close(ipc_link_t *link){
+
+    if (link->fdSocket >= 0){
+        close(link->fdSocket);
+        link->fdSocket = -1;
+    }
+    if (link->doorbellSocket >= 0){
+        close(link->doorbellSocket);
+        link->doorbellSocket = -1;
+    }
+}
+
+/**
+ * @brief Main Service: Passes an open file descriptor to the SPI service. The caller keeps
+ *        its own descriptor and may close it as soon as this returns.
+ *
+ * @param link Pointer to link structure
+ * @param requestId Request the data answers, IPC_REQUEST_ID_NONE if unsolicited
+ * @param fd File descriptor to pass, must be readable and support mmap or pread
+ * @param offset First byte of the file to transfer
+ * @param len Number of bytes to transfer, IPC_FD_LEN_TO_END for the rest of the file
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR ipc_fd_send(ipc_link_t *link, uint32_t requestId, int fd, uint64_t offset, uint64_t len){
+
+    struct sockaddr_un addr;
+    ipc_fd_msg_t fdMsg = {.requestId = requestId, .flags = 0, .offset = offset, .len = len};
+    struct iovec iov = {.iov_base = &fdMsg, .iov_len = sizeof(fdMsg)};
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = {0};
+    struct cmsghdr *cmsg = NULL;
+
+    if ((link->fdSocket < 0) || (fd < 0)){
+        return IPC_FD_ERROR;
+    }
+
+    memset(&control, 0, sizeof(control));
+    msg.msg_name = &addr;
+    msg.msg_namelen = ipc_fd_address(&addr, IPC_FD_SOCKET_NAME);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    if (sendmsg(link->fdSocket, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(fdMsg)){
+        LOG_ERRORF("IPC-FD: Failed to pass file descriptor for request %u (%s)", requestId, strerror(errno));
+        return IPC_FD_ERROR;
+    }
+    return NO_ERROR;
+}
+
+/**
+ * @brief Main Service: Opens a file and passes it to the SPI service to be streamed to the OBC
+ *
+ * @param link Pointer to link structure
+ * @param requestId Request the data answers, IPC_REQUEST_ID_NONE if unsolicited
+ * @param file_path Pointer to character array with path to file that will be transferred
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR ipc_fd_send_file(ipc_link_t *link, uint32_t requestId, const char *file_path){
+
+    enum IRIS_ERROR error = NO_ERROR;
+
+    int fd = open(file_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0){
+        LOG_ERRORF("IPC-FD: Failed to open %s for bulk transfer", file_path);
+        return IPC_FD_ERROR;
+    }
+
+    error = ipc_fd_send(link, requestId, fd, 0, IPC_FD_LEN_TO_END);
+    close(fd);
+    return error;
+}
+
+/**
+ * @brief Main Service: Copies a buffer into a sealed memfd and passes it to the SPI service.
+ *        Used for bulk payloads built in memory (e.g. telemetry dumps) that have no backing file.
+ *
+ * @param link Pointer to link structure
+ * @param requestId Request the data answers, IPC_REQUEST_ID_NONE if unsolicited
+ * @param data Pointer to array containing the payload
+ * @param len Number of bytes in the payload
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR ipc_fd_send_buffer(ipc_link_t *link, uint32_t requestId, const uint8_t *data, uint64_t len){
+
+    enum IRIS_ERROR error = NO_ERROR;
+    uint64_t written = 0;
+    ssize_t numBytes = 0;
+
+    int fd = memfd_create(IPC_FD_MEMFD_NAME, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0){
+        LOG_ERRORF("IPC-FD: Failed to create memfd for bulk transfer");
+        return IPC_FD_ERROR;
+    }
+
+    while (written < len){
+        numBytes = write(fd, data + written, len - written);
+        if (numBytes <= 0){
+            LOG_ERRORF("IPC-FD: Failed to fill memfd for bulk transfer");
+            close(fd);
+            return IPC_FD_ERROR;
+        }
+        written += (uint64_t)numBytes;
+    }
+
+    // Sealed so the SPI service can map it without the contents changing underneath the transfer
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+
+    error = ipc_fd_send(link, requestId, fd, 0, len);
+    close(fd);
+    return error;
+}
+
+/**
+ * @brief SPI Service: Receives the next file descriptor passed by the Main service, never blocks
+ *
+ * @param link Pointer to link structure
+ * @param transfer Pointer to structure that will store the descriptor and transfer details.
+ *                 The caller owns 'transfer->fd' and must close it.
+ * @return True if a transfer was received
+ */
+bool ipc_fd_receive(ipc_link_t *link, ipc_fd_transfer_t *transfer){
+
+    struct iovec iov = {.iov_base = &transfer->msg, .iov_len = sizeof(transfer->msg)};
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = {0};
+    struct cmsghdr *cmsg = NULL;
+    ssize_t numBytes = 0;
+
+    transfer->fd = -1;
+    if (link->fdSocket < 0){
+        return false;
+    }
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    numBytes = recvmsg(link->fdSocket, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if (numBytes < 0){
+        return false;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+        if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS) &&
+            (cmsg->cmsg_len == CMSG_LEN(sizeof(int)))){
+            memcpy(&transfer->fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+
+    if ((numBytes != (ssize_t)sizeof(transfer->msg)) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || (transfer->fd < 0)){
+        LOG_WARNINGF("IPC-FD: Discarded malformed bulk transfer message");
+        if (transfer->fd >= 0){
+            close(transfer->fd);
+            transfer->fd = -1;
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Main Service: Wakes the SPI service if it is waiting for a record on the ring it reads.
+ *        Call after every commit to that ring, costs nothing when the SPI service is busy.
+ *
+ * @param link Pointer to link structure
+ */
+void ipc_fd_doorbell_ring(ipc_link_t *link){
+
+    struct sockaddr_un addr;
+    socklen_t addrLen = 0;
+    uint8_t bell = 0;
+
+    if ((link->fdSocket < 0) || !ipc_ring_has_waiters(&link->txRing)){
+        return;
+    }
+
+    // A full doorbell queue already wakes the SPI service, so a failed send is not an error
+    addrLen = ipc_fd_address(&addr, IPC_FD_DOORBELL_NAME);
+    sendto(link->fdSocket, &bell, sizeof(bell), MSG_DONTWAIT | MSG_NOSIGNAL, (struct sockaddr *)&addr, addrLen);
+}
+
+/**
+ * @brief SPI Service: Empties the doorbell once the SPI service is awake, never blocks
+ *
+ * @param link Pointer to link structure
+ */
+void ipc_fd_doorbell_clear(ipc_link_t *link){
+
+    uint8_t bells[64];
+
+    if (link->doorbellSocket < 0){
+        return;
+    }
+    while (recv(link->doorbellSocket, bells, sizeof(bells), MSG_DONTWAIT) > 0){
+    }
+}
@@ -1,72 +1,408 @@
 
-
+#include "clock_sync.h"
+#include "cmd_controller.h"
 #include "error_handler.h"
+#include "ipc_fd.h"
 #include "ipc_iris.h"
+#include "ipc_ring.h"
 #include "logger.h"
 #include "main.h"
+#include "metrics.h"
 #include "timing.h"
 
 #include <stdint.h>
 
 #include <sys/ipc.h>
 #include <sys/msg.h>
+#include <unistd.h>
+
+
+/**
+ * @brief Maps the shared memory rings, attaches this service to its side of each ring and opens
+ *        the bulk data side channel
+ *
+ * @param link Pointer to link structure
+ * @param side Service creating the link (Main or SPI)
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR ipc_link_setup(ipc_link_t *link, enum IPC_SIDE side){
+
+    enum IRIS_ERROR error = NO_ERROR;
+
+    LOG_INFOF("IPC-SETUP: Start IPC connection setup.");
+
+    error = ipc_ring_region_map(&link->region);
+    if (error != NO_ERROR){
+        LOG_ERRORF("IPC-SETUP: Failed to establish IPC Connection between SPI and Main Services");
+        return error;
+    }
+
+    if (side == IPC_SIDE_MAIN){
+        ipc_ring_attach(&link->txRing, &link->region->mainToSpi);
+        ipc_ring_attach(&link->rxRing, &link->region->spiToMain);
+    }else{
+        ipc_ring_attach(&link->txRing, &link->region->spiToMain);
+        ipc_ring_attach(&link->rxRing, &link->region->mainToSpi);
+    }
+
+    error = ipc_fd_open(link, side);
+    if (error != NO_ERROR){
+        LOG_ERRORF("IPC-SETUP: Failed to open bulk data channel between SPI and Main Services");
+        ipc_ring_region_unmap(link->region);
+        link->region = NULL;
+        return error;
+    }
+
+    link->nextRequestId = 1;
+    link->numInFlight = 0;
+    link->busyHead = 0;
+    link->numBusyReplies = 0;
+    for (int index = 0; index < IPC_MAX_IN_FLIGHT; index++){
+        link->inFlight[index].requestId = IPC_REQUEST_ID_NONE;
+    }
+    link->bulkDoneId = IPC_REQUEST_ID_NONE;
+    link->bulkDone = NULL;
+    link->errorReportId = IPC_REQUEST_ID_NONE;
+    if (side == IPC_SIDE_SPI){
+        metric_set(METRIC_IPC_IN_FLIGHT, 0);
+    }
+    link->ackReceived = false;
+    link->ackStatus = NO_ERROR;
+
+    LOG_INFOF("IPC-SETUP: Successfully completed setup of IPC connection");
+    return NO_ERROR;
+}
+
+/**
+ * @brief Assigns the next request ID of this service, never IPC_REQUEST_ID_NONE
+ *
+ * @param link Pointer to link structure
+ * @return Request ID
+ */
+uint32_t ipc_request_id_next(ipc_link_t *link){
+
+    uint32_t requestId = link->nextRequestId++;
+
+    if (link->nextRequestId == IPC_REQUEST_ID_NONE){
+        link->nextRequestId = 1;
+    }
+    return requestId;
+}
+
+/**
+ * @brief SPI Service: Records a forwarded command as in flight until its response arrives
+ *
+ * @param link Pointer to link structure
+ * @param requestId Request ID carried by the forwarded command
+ * @return Iris error code indicating the success or failure of function, IPC_BUSY_ERROR if
+ *         IPC_MAX_IN_FLIGHT commands are already waiting for a response
+ */
+enum IRIS_ERROR ipc_request_track(ipc_link_t *link, uint32_t requestId){
+
+    for (int index = 0; index < IPC_MAX_IN_FLIGHT; index++){
+        if (link->inFlight[index].requestId == IPC_REQUEST_ID_NONE){
+            link->inFlight[index].requestId = requestId;
+            link->inFlight[index].sentMs = get_time_monotonic_ms();
+            link->numInFlight++;
+            metric_set(METRIC_IPC_IN_FLIGHT, link->numInFlight);
+            return NO_ERROR;
+        }
+    }
+    metric_inc(METRIC_IPC_BUSY);
+    return IPC_BUSY_ERROR;
+}
+
+/**
+ * @brief SPI Service: Matches a response to its in flight request and frees the request slot
+ *
+ * @param link Pointer to link structure
+ * @param requestId Request ID carried by the response
+ * @return True if the response belongs to an in flight request, false if it is unknown or expired
+ */
+bool ipc_request_complete(ipc_link_t *link, uint32_t requestId){
+
+    if (requestId == IPC_REQUEST_ID_NONE){
+        return false;
+    }
+    for (int index = 0; index < IPC_MAX_IN_FLIGHT; index++){
+        if (link->inFlight[index].requestId == requestId){
+            link->inFlight[index].requestId = IPC_REQUEST_ID_NONE;
+            link->numInFlight--;
+            metric_set(METRIC_IPC_IN_FLIGHT, link->numInFlight);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief SPI Service: Frees requests that have waited longer than IPC_REQUEST_TIMEOUT_MS
+ *
+ * @param link Pointer to link structure
+ * @return Number of requests that expired
+ */
+uint8_t ipc_request_expire(ipc_link_t *link){
+
+    uint64_t now = get_time_monotonic_ms();
+    uint8_t numExpired = 0;
+
+    for (int index = 0; (index < IPC_MAX_IN_FLIGHT) && (link->numInFlight != 0); index++){
+        if ((link->inFlight[index].requestId != IPC_REQUEST_ID_NONE) &&
+            ((now - link->inFlight[index].sentMs) > IPC_REQUEST_TIMEOUT_MS)){
+            link->inFlight[index].requestId = IPC_REQUEST_ID_NONE;
+            link->numInFlight--;
+            numExpired++;
+        }
+    }
+    if (numExpired != 0){
+        metric_add(METRIC_IPC_EXPIRED, numExpired);
+        metric_set(METRIC_IPC_IN_FLIGHT, link->numInFlight);
+    }
+    return numExpired;
+}
 
+/**
+ * @brief SPI Service: Checks if another command can be forwarded without exceeding IPC_MAX_IN_FLIGHT
+ *
+ * @param link Pointer to link structure
+ * @return True if a request slot is free
+ */
+bool ipc_request_available(ipc_link_t *link){
+    return link->numInFlight < IPC_MAX_IN_FLIGHT;
+}
 
+/**
+ * @brief SPI Service: Queues the IPC_BUSY_ERROR response of a command that was turned away
+ *
+ * @param link Pointer to link structure
+ * @param requestId Request ID assigned to the command, orders the reply among the other responses
+ * @return True if queued, false if IPC_MAX_BUSY_REPLIES replies are already waiting
+ */
+bool ipc_busy_reply_queue(ipc_link_t *link, uint32_t requestId){
 
+    if (link->numBusyReplies >= IPC_MAX_BUSY_REPLIES){
+        return false;
+    }
+    link->busyReplies[(link->busyHead + link->numBusyReplies) % IPC_MAX_BUSY_REPLIES] = requestId;
+    link->numBusyReplies++;
+    return true;
+}
 
+/**
+ * @brief SPI Service: Checks if the oldest busy reply can be written. The OBC matches replies to
+ *        its commands in order, so the reply waits until every command forwarded before it has
+ *        been answered or has expired.
+ *
+ * @param link Pointer to link structure
+ * @return True if the oldest busy reply is next in order
+ */
+bool ipc_busy_reply_due(ipc_link_t *link){
 
-//! NEED TO MAKE IT SO IT CAN HANDLE LARGER NUMBER OF TOTAL ERROR CODES
-//! CURRENTLY ITS LIMITED TO MSG_SIZE
-//! MAKE IT SO IT CAN HANDLE 16-BIT ERROR CODES
-enum IRIS_ERROR iris_error_transfer_spi_service(int ipcMsgID, const enum IRIS_ERROR *errorBuffer, uint8_t *errorCount){
+    uint32_t busyId = link->busyReplies[link->busyHead];
 
-        struct msg_buffer ipc_message;
-        ipc_message.msg_type    = ERROR_MAIN_TO_SPI;
-        ipc_message.msg_type_rx = ERROR_SPI_TO_MAIN;
-        
-        for (int index = 0; index < *errorCount; index ++){
-            ipc_message.msg_text[index] = errorBuffer[index];
+    if (link->numBusyReplies == 0){
+        return false;
+    }
+    for (int index = 0; index < IPC_MAX_IN_FLIGHT; index++){
+        // Compared as a signed difference so the order holds when the IDs wrap around
+        if ((link->inFlight[index].requestId != IPC_REQUEST_ID_NONE) &&
+            ((int32_t)(link->inFlight[index].requestId - busyId) < 0)){
+            return false;
         }
+    }
+    return true;
+}
+
+/**
+ * @brief SPI Service: Removes the oldest busy reply once it has been written
+ *
+ * @param link Pointer to link structure
+ */
+void ipc_busy_reply_pop(ipc_link_t *link){
+
+    if (link->numBusyReplies == 0){
+        return;
+    }
+    link->busyHead = (link->busyHead + 1) % IPC_MAX_BUSY_REPLIES;
+    link->numBusyReplies--;
+}
+
+/**
+ * @brief Main Service: Waits for the SPI service to report the outcome of a bulk transfer
+ *        (BULK_SPI_TO_MAIN). One transfer is waited for at a time, an older one still waiting is
+ *        reported as not delivered. If the outcome never arrives the callback is never called.
+ *
+ * @param link Pointer to link structure
+ * @param requestId Request ID the transfer was passed with
+ * @param done Delivery callback, NULL if nobody waits for the outcome
+ */
+static void ipc_bulk_done_wait(ipc_link_t *link, uint32_t requestId, void (*done)(bool delivered)){
+
+    if (done == NULL){
+        return;
+    }
+    if (link->bulkDone != NULL){
+        link->bulkDone(false);
+    }
+    link->bulkDoneId = requestId;
+    link->bulkDone = done;
+}
+
+/**
+ * @brief Main Service: Executes every OBC command forwarded by the SPI service and queues the
+ *        responses, tagged with the request ID of their command. Responses are built directly in
+ *        the ring, a command is only removed once its response has been queued. Also collects
+ *        error transfer acknowledgements.
+ *
+ * @param link Pointer to link structure
+ * @return Iris error code indicating the success or failure of function, IPC_RING_FULL_ERROR if
+ *         the response ring is full (Remaining commands are serviced on the next call)
+ */
+enum IRIS_ERROR ipc_main_service_commands(ipc_link_t *link){
+
+    const uint8_t *payload = NULL;
+    uint8_t *response = NULL;
+    uint16_t responseLen = 0;
+    uint16_t label = 0;
+    uint32_t requestId = IPC_REQUEST_ID_NONE;
+    uint32_t len = 0;
+    uint8_t cmd = 0;
+    uint8_t arg[SPI_RX_LEN] = {0};
+    int narg = 0;
+    cmd_bulk_t bulk;
+
+    while ((payload = ipc_ring_peek(&link->rxRing, &label, &requestId, &len)) != NULL){
+
+        switch (label){
 
-        //Send data to Queue
-        if(msgsnd(ipcMsgID, &ipc_message, sizeof(ipc_message.msg_text), IPC_NOWAIT) == -1){
-            // If fails that means Queue is full, therefore leave and try again later
-            return NO_ERROR; 
+            case CMD_SPI_TO_MAIN:
+                if ((len == 0) || (len > SPI_RX_LEN)){
+                    break;
+                }
+                // CS edge the SPI service captured for the command (See 'clock_sync_edge')
+                clock_sync_edge(ipc_ring_timestamp(&link->rxRing));
+                if (payload[0] == CMD_BATCH){
+                    response = ipc_ring_reserve(&link->txRing, CMD_MAIN_TO_SPI, requestId, CMD_BATCH_REPLY_MAX_LEN);
+                    if (response == NULL){
+                        return IPC_RING_FULL_ERROR;
+                    }
+                    cmd_batch_execute(payload, len, response, &responseLen);
+                }else{
+                    response = ipc_ring_reserve(&link->txRing, CMD_MAIN_TO_SPI, requestId, CMD_RESPONSE_MAX_LEN);
+                    if (response == NULL){
+                        return IPC_RING_FULL_ERROR;
+                    }
+                    narg = cmd_extracter(&cmd, arg, payload, len - 1);
+                    cmd_execute(cmd, arg, narg, 0, NULL, response, &responseLen);
+                }
+
+                // Bulk data is passed before the response announcing it is queued, tagged with the
+                // same request ID. The SPI service streams it right after writing that response.
+                if (cmd_bulk_take(&bulk)){
+                    if (ipc_fd_send(link, requestId, bulk.fd, 0, bulk.len) == NO_ERROR){
+                        ipc_ring_set_flags(&link->txRing, IPC_RING_FLAG_BULK);
+                        ipc_bulk_done_wait(link, requestId, bulk.done);
+                    }else{
+                        if (responseLen > 1){
+                            response[1] = IPC_FD_ERROR;
+                        }
+                        if (bulk.done != NULL){
+                            bulk.done(false);
+                        }
+                    }
+                    close(bulk.fd);
+                }
+                ipc_ring_commit(&link->txRing, responseLen);
+                ipc_fd_doorbell_ring(link);
+                break;
+
+            case BULK_SPI_TO_MAIN:
+                // Outcomes of transfers nobody waits for are ignored
+                if ((requestId == link->bulkDoneId) && (link->bulkDone != NULL)){
+                    link->bulkDone((len > 0) && (payload[0] == NO_ERROR));
+                    link->bulkDone = NULL;
+                    link->bulkDoneId = IPC_REQUEST_ID_NONE;
+                }
+                break;
+
+            case ERROR_SPI_TO_MAIN:
+                // Late acknowledgements of an older report are ignored
+                if (requestId == link->errorReportId){
+                    link->ackStatus = (len > 0) ? payload[0] : NO_ERROR;
+                    link->ackReceived = true;
+                }
+                break;
+
+            default:
+                break;
         }
+        ipc_ring_release(&link->rxRing);
+    }
+    return NO_ERROR;
+}
+
+/**
+ * @brief Main Service: Queues the error summary for the SPI service to send to the OBC and waits
+ *        for the result, the reported counts are only removed once the OBC has received them
+ *
+ * @param link Pointer to link structure
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR iris_error_transfer_spi_service(ipc_link_t *link){
 
-        int start_time = get_time_seconds();
-        //log_write(LOG_INFO, "SPI-BUS-TEST: Begin SPI bus test read from OBC");
+        error_summary_t summary;
+        uint32_t requestId = ipc_request_id_next(link);
+        uint8_t *payload = ipc_ring_reserve(&link->txRing, ERROR_MAIN_TO_SPI, requestId, ERROR_SUMMARY_MAX_LEN);
+        uint16_t payloadLen = 0;
+
+        // If fails that means Ring is full, therefore leave and try again later
+        if (payload == NULL){
+            return NO_ERROR;
+        }
+        payloadLen = error_summary(payload, &summary);
+        link->errorReportId = requestId;
+        link->ackReceived = false;
+        ipc_ring_commit(&link->txRing, payloadLen);
+        ipc_fd_doorbell_ring(link);
 
-        // Wait for a Period of Time to get confirmation on Error Transfer to OBC
+        uint64_t start_time = get_time_monotonic_ms();
+        uint64_t elapsed = 0;
+
+        // Wait for a Period of Time to get confirmation on Error Transfer to OBC. Blocks on the
+        // ring until the SPI service replies, OBC commands keep being serviced while waiting
         do{
-            if(msgrcv(ipcMsgID, &ipc_message, sizeof(ipc_message.msg_text), ipc_message.msg_type_rx, IPC_NOWAIT) != -1){
-                
-                if(ipc_message.msg_text[0] == ERROR_TRANSFER_FAIL){
+            ipc_main_service_commands(link);
+            if (link->ackReceived){
+
+                if(link->ackStatus == ERROR_TRANSFER_FAIL){
                     return NO_ERROR;
                 }
-                *errorCount = 0;
+                error_summary_ack(&summary);
                 return NO_ERROR;
 
             }
-        }while((get_time_seconds() - start_time) < ERROR_TRANSFER_TIMEOUT_S);
+            elapsed = get_time_monotonic_ms() - start_time;
+            if (elapsed < (ERROR_TRANSFER_TIMEOUT_S * 1000)){
+                ipc_ring_wait(&link->rxRing, (ERROR_TRANSFER_TIMEOUT_S * 1000) - elapsed);
+            }
+        }while(elapsed < (ERROR_TRANSFER_TIMEOUT_S * 1000));
 
         return NO_ERROR;
 }
 
 
-
 enum IRIS_ERROR ipc_setup(key_t *key, int *msgid){
 
-    log_write(LOG_INFO, "IPC-SETUP: Start IPC connection setup.");
+    LOG_INFOF("IPC-SETUP: Start IPC connection setup.");
 
     *key = ftok(IPC_REF_FILE_PATH, IPC_REF_VAL); // Create a unique key
     *msgid = msgget(*key, 0660 | IPC_CREAT);      // Create message queue with restricted permissions
     
     if (*msgid == -1) {
-        log_write(LOG_ERROR, "IPC-SETUP: Failed to establish IPC Connection between SPI and Main Services");
+        LOG_ERRORF("IPC-SETUP: Failed to establish IPC Connection between SPI and Main Services");
         return IPC_ERROR;
     }
 
-    log_write(LOG_INFO, "IPC-SETUP: Successfully completed setup of IPC connection");
+    LOG_INFOF("IPC-SETUP: Successfully completed setup of IPC connection");
     return NO_ERROR;
 }
\ No newline at end of file
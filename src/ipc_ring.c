@@ -0,0 +1,379 @@
+/**
+ * @file ipc_ring.c
+ * @author agent
+ * @brief Shared Memory Ring IPC for Theia CM4
+ *        Provides functions to...
+ *         - Map the shared memory region used by the SPI and Main services
+ *         - Pass variable length records through a lock-free single producer / single consumer ring
+ *         - Reserve / commit records in place so producers can build payloads directly in the ring
+ *         - Peek / release records in place so consumers can use payloads without copying them out
+ *         - Block a consumer on the ring (futex) until the producer commits a record or a timeout expires
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "error_handler.h"
+#include "ipc_ring.h"
+#include "logger.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/**
+ * @brief Size of a record in the ring (Header + payload, rounded up to IPC_RING_RECORD_ALIGN)
+ *
+ * @param len Payload length in bytes
+ * @return Number of ring bytes used by the record
+ */
+static uint32_t ipc_ring_record_size(uint32_t len){
+    return (sizeof(ipc_ring_record_t) + len + (IPC_RING_RECORD_ALIGN - 1)) & ~(uint32_t)(IPC_RING_RECORD_ALIGN - 1);
+}
+
+/**
+ * @brief Maps the shared memory region holding both rings, creating it if this is the first service to start
+ *
+ * @param region Pointer to variable that will store the mapped region
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR ipc_ring_region_map(ipc_ring_region_t **region){
+
+    int fileDesc = 0;
+    uint32_t expected = 0;
+    void *mapping = NULL;
+
+    *region = NULL;
+
+    fileDesc = shm_open(IPC_RING_SHM_NAME, O_CREAT | O_RDWR, 0660);
+    if (fileDesc < 0){
+        LOG_ERRORF("IPC-RING: Unable to open shared memory %s", IPC_RING_SHM_NAME);
+        return IPC_ERROR;
+    }
+
+    // New shared memory is zero filled, which is a valid empty ring
+    if (ftruncate(fileDesc, sizeof(ipc_ring_region_t)) != 0){
+        LOG_ERRORF("IPC-RING: Unable to size shared memory region");
+        close(fileDesc);
+        return IPC_ERROR;
+    }
+
+    mapping = mmap(NULL, sizeof(ipc_ring_region_t), PROT_READ | PROT_WRITE, MAP_SHARED, fileDesc, 0);
+    close(fileDesc);
+    if (mapping == MAP_FAILED){
+        LOG_ERRORF("IPC-RING: Unable to map shared memory region");
+        return IPC_ERROR;
+    }
+
+    // First service to map the region stamps it, a region left by a different build is rejected
+    if (!__atomic_compare_exchange_n(&((ipc_ring_region_t *)mapping)->magic, &expected, IPC_RING_MAGIC, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) &&
+        (expected != IPC_RING_MAGIC)){
+        LOG_ERRORF("IPC-RING: Shared memory layout mismatch (0x%08X), remove /dev/shm%s", expected, IPC_RING_SHM_NAME);
+        munmap(mapping, sizeof(ipc_ring_region_t));
+        return IPC_ERROR;
+    }
+
+    *region = mapping;
+    LOG_INFOF("IPC-RING: Shared memory region mapped");
+    return NO_ERROR;
+}
+
+/**
+ * @brief Unmaps the shared memory region, the region itself persists for the other service
+ *
+ * @param region Region returned by 'ipc_ring_region_map'
+ */
+void ipc_ring_region_unmap(ipc_ring_region_t *region){
+    if (region != NULL){
+        munmap(region, sizeof(ipc_ring_region_t));
+    }
+}
+
+/**
+ * @brief Initializes a process local handle for one side of a ring
+ *
+ * @param ring Pointer to handle
+ * @param shm Pointer to ring inside the mapped region
+ */
+void ipc_ring_attach(ipc_ring_t *ring, ipc_ring_shm_t *shm){
+    ring->shm = shm;
+    ring->reserved = NULL;
+    ring->reserveHead = 0;
+    ring->releaseTail = 0;
+    ring->peeked = NULL;
+}
+
+/**
+ * @brief Producer: Reserves a contiguous record in the ring. The payload is written in place
+ *        and becomes visible to the consumer on 'ipc_ring_commit'.
+ *
+ * @param ring Pointer to producer handle
+ * @param label IPC_LABEL of the record
+ * @param requestId Request ID carried by the record, IPC_REQUEST_ID_NONE if unused
+ * @param len Max payload length in bytes
+ * @return Pointer to payload area, NULL if the ring does not have enough free space
+ */
+void *ipc_ring_reserve(ipc_ring_t *ring, uint16_t label, uint32_t requestId, uint32_t len){
+
+    ipc_ring_shm_t *shm = ring->shm;
+    uint32_t head = __atomic_load_n(&shm->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&shm->tail, __ATOMIC_ACQUIRE);
+    uint32_t size = ipc_ring_record_size(len);
+    uint32_t contiguous = IPC_RING_DATA_SIZE - (head & IPC_RING_DATA_MASK);
+    uint32_t pad = (size > contiguous) ? contiguous : 0;
+    ipc_ring_record_t *record = NULL;
+
+    if (len > IPC_RING_MAX_RECORD){
+        return NULL;
+    }
+    if (((head - tail) + pad + size) > IPC_RING_DATA_SIZE){
+        return NULL;
+    }
+
+    // Records never wrap, the rest of the ring is skipped with a pad record
+    if (pad != 0){
+        record = (ipc_ring_record_t *)&shm->data[head & IPC_RING_DATA_MASK];
+        record->len = 0;
+        record->label = IPC_RING_LABEL_PAD;
+        record->flags = 0;
+        head += pad;
+    }
+
+    record = (ipc_ring_record_t *)&shm->data[head & IPC_RING_DATA_MASK];
+    record->len = len;
+    record->label = label;
+    record->flags = 0;
+    record->requestId = requestId;
+    record->reserved = 0;
+    record->timestampNs = 0;
+
+    ring->reserved = record;
+    ring->reserveHead = head;
+    return record + 1;
+}
+
+/**
+ * @brief Producer: Publishes the record returned by 'ipc_ring_reserve'
+ *
+ * @param ring Pointer to producer handle
+ * @param len Actual payload length, must not exceed the reserved length
+ */
+void ipc_ring_commit(ipc_ring_t *ring, uint32_t len){
+
+    if (ring->reserved == NULL){
+        return;
+    }
+    if (len < ring->reserved->len){
+        ring->reserved->len = len;
+    }
+    __atomic_store_n(&ring->shm->head, ring->reserveHead + ipc_ring_record_size(ring->reserved->len), __ATOMIC_RELEASE);
+    ring->reserved = NULL;
+
+    // Wake the consumer only if it is blocked in 'ipc_ring_wait'
+    __atomic_fetch_add(&ring->shm->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->shm->waiters, __ATOMIC_SEQ_CST) != 0){
+        syscall(SYS_futex, &ring->shm->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+/**
+ * @brief Producer: Attaches a timestamp to the record returned by 'ipc_ring_reserve', must be
+ *        called before 'ipc_ring_commit'
+ *
+ * @param ring Pointer to producer handle
+ * @param timestampNs CLOCK_MONOTONIC time in nano-seconds
+ */
+void ipc_ring_set_timestamp(ipc_ring_t *ring, uint64_t timestampNs){
+
+    if (ring->reserved != NULL){
+        ring->reserved->timestampNs = timestampNs;
+    }
+}
+
+/**
+ * @brief Producer: Sets the IPC_RING_FLAG_* bits of the record returned by 'ipc_ring_reserve', must
+ *        be called before 'ipc_ring_commit'
+ *
+ * @param ring Pointer to producer handle
+ * @param flags IPC_RING_FLAG_* bits
+ */
+void ipc_ring_set_flags(ipc_ring_t *ring, uint16_t flags){
+
+    if (ring->reserved != NULL){
+        ring->reserved->flags = flags;
+    }
+}
+
+/**
+ * @brief Consumer: Returns the oldest record in the ring without removing it
+ *
+ * @param ring Pointer to consumer handle
+ * @param label Pointer to variable that will store the IPC_LABEL of the record
+ * @param requestId Pointer to variable that will store the request ID of the record
+ * @param len Pointer to variable that will store the payload length
+ * @return Pointer to payload, NULL if the ring is empty. Valid until 'ipc_ring_release'.
+ */
+const void *ipc_ring_peek(ipc_ring_t *ring, uint16_t *label, uint32_t *requestId, uint32_t *len){
+
+    ipc_ring_shm_t *shm = ring->shm;
+    uint32_t tail = __atomic_load_n(&shm->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&shm->head, __ATOMIC_ACQUIRE);
+    ipc_ring_record_t *record = NULL;
+
+    while (tail != head){
+
+        record = (ipc_ring_record_t *)&shm->data[tail & IPC_RING_DATA_MASK];
+        if (record->label == IPC_RING_LABEL_PAD){
+            tail += IPC_RING_DATA_SIZE - (tail & IPC_RING_DATA_MASK);
+            __atomic_store_n(&shm->tail, tail, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        *label = record->label;
+        *requestId = record->requestId;
+        *len = record->len;
+        ring->releaseTail = tail + ipc_ring_record_size(record->len);
+        ring->peeked = record;
+        return record + 1;
+    }
+    ring->peeked = NULL;
+    return NULL;
+}
+
+/**
+ * @brief Consumer: Returns the timestamp the producer attached to the record returned by 'ipc_ring_peek'
+ *
+ * @param ring Pointer to consumer handle
+ * @return CLOCK_MONOTONIC time in nano-seconds, 0 if none was attached
+ */
+uint64_t ipc_ring_timestamp(const ipc_ring_t *ring){
+    return (ring->peeked != NULL) ? ring->peeked->timestampNs : 0;
+}
+
+/**
+ * @brief Consumer: Returns the IPC_RING_FLAG_* bits of the record returned by 'ipc_ring_peek'
+ *
+ * @param ring Pointer to consumer handle
+ * @return IPC_RING_FLAG_* bits, 0 if no record is peeked
+ */
+uint16_t ipc_ring_flags(const ipc_ring_t *ring){
+    return (ring->peeked != NULL) ? ring->peeked->flags : 0;
+}
+
+/**
+ * @brief Consumer: Removes the record returned by 'ipc_ring_peek', freeing its space for the producer
+ *
+ * @param ring Pointer to consumer handle
+ */
+void ipc_ring_release(ipc_ring_t *ring){
+    __atomic_store_n(&ring->shm->tail, ring->releaseTail, __ATOMIC_RELEASE);
+    ring->peeked = NULL;
+}
+
+/**
+ * @brief Producer: Copies a payload into a new record and publishes it
+ *
+ * @param ring Pointer to producer handle
+ * @param label IPC_LABEL of the record
+ * @param requestId Request ID carried by the record, IPC_REQUEST_ID_NONE if unused
+ * @param data Pointer to payload
+ * @param len Payload length in bytes
+ * @return Iris error code indicating the success or failure of function, IPC_RING_FULL_ERROR if
+ *         the consumer has not freed enough space
+ */
+enum IRIS_ERROR ipc_ring_send(ipc_ring_t *ring, uint16_t label, uint32_t requestId, const void *data, uint32_t len){
+
+    void *payload = ipc_ring_reserve(ring, label, requestId, len);
+
+    if (payload == NULL){
+        return IPC_RING_FULL_ERROR;
+    }
+    memcpy(payload, data, len);
+    ipc_ring_commit(ring, len);
+    return NO_ERROR;
+}
+
+/**
+ * @brief Checks if the ring has any records waiting for the consumer
+ *
+ * @param ring Pointer to producer or consumer handle
+ * @return True if the ring is empty
+ */
+bool ipc_ring_empty(ipc_ring_t *ring){
+    return __atomic_load_n(&ring->shm->head, __ATOMIC_ACQUIRE) == __atomic_load_n(&ring->shm->tail, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Consumer: Blocks until the ring has a record or the timeout expires. Wakes as soon as the
+ *        producer commits, without polling.
+ *
+ * @param ring Pointer to consumer handle
+ * @param timeoutMs Max time to block in milli-seconds
+ * @return True if the ring has a record waiting
+ */
+bool ipc_ring_wait(ipc_ring_t *ring, uint32_t timeoutMs){
+
+    ipc_ring_shm_t *shm = ring->shm;
+    struct timespec timeout;
+    uint32_t seq = __atomic_load_n(&shm->seq, __ATOMIC_SEQ_CST);
+
+    if (!ipc_ring_empty(ring)){
+        return true;
+    }
+
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = (long)(timeoutMs % 1000) * 1000000L;
+
+    // A commit after 'seq' was read changes the futex word, so the wait returns immediately
+    // instead of missing the wake up
+    __atomic_fetch_add(&shm->waiters, 1, __ATOMIC_SEQ_CST);
+    if (ipc_ring_empty(ring)){
+        syscall(SYS_futex, &shm->seq, FUTEX_WAIT, seq, &timeout, NULL, 0);
+    }
+    __atomic_fetch_sub(&shm->waiters, 1, __ATOMIC_SEQ_CST);
+
+    return !ipc_ring_empty(ring);
+}
+
+/**
+ * @brief Consumer: Registers the caller as waiting for a record without blocking on the futex, for a
+ *        consumer that also waits on other events (e.g. poll on the CS line). The producer sees it
+ *        with 'ipc_ring_has_waiters' and must wake the consumer by other means (See 'ipc_fd_doorbell_ring').
+ *        The ring must be checked again after this call, a record committed before it is not signalled.
+ *
+ * @param ring Pointer to consumer handle
+ */
+void ipc_ring_wait_begin(ipc_ring_t *ring){
+    __atomic_fetch_add(&ring->shm->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Consumer: Ends a wait started with 'ipc_ring_wait_begin'
+ *
+ * @param ring Pointer to consumer handle
+ */
+void ipc_ring_wait_end(ipc_ring_t *ring){
+    __atomic_fetch_sub(&ring->shm->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Producer: Checks if the consumer is waiting for a record, call after 'ipc_ring_commit'
+ *
+ * @param ring Pointer to producer handle
+ * @return True if the consumer is blocked in 'ipc_ring_wait' or between 'ipc_ring_wait_begin' and 'ipc_ring_wait_end'
+ */
+bool ipc_ring_has_waiters(ipc_ring_t *ring){
+    return __atomic_load_n(&ring->shm->waiters, __ATOMIC_SEQ_CST) != 0;
+}
@@ -0,0 +1,419 @@
+/**
+ * @file job_engine.c
+ * @author agent
+ * @brief Asynchronous Job Engine for Theia CM4
+ *        Provides functions to...
+ *         - Run long running commands (Image capture, file transfer, sensor resets) on a worker pool
+ *         - Return a job ID immediately so the SPI command thread stays responsive
+ *         - Report the status / progress / result of a job when polled by the OBC
+ *         - Cancel queued jobs, and request running jobs to stop early
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "cmd_controller.h"
+#include "error_handler.h"
+#include "job_engine.h"
+#include "logger.h"
+#include "metrics.h"
+#include "timing.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static job_t jobTable[JOB_TABLE_SIZE];
+static uint8_t jobQueue[JOB_QUEUE_DEPTH];     // Indices into jobTable, in submit order
+static uint8_t jobQueueHead = 0;
+static uint8_t jobQueueCount = 0;
+static uint16_t jobNextId = 1;
+static bool jobEngineRunning = false;
+
+static pthread_t jobWorkers[JOB_NUM_WORKERS];
+static pthread_mutex_t jobLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobReady = PTHREAD_COND_INITIALIZER;
+
+// Job being executed by the calling worker thread, NULL outside of a worker
+static __thread job_t *jobCurrent = NULL;
+
+
+/**
+ * @brief Finds the table slot of a job, caller must hold jobLock
+ *
+ * @param jobId Job ID returned by 'job_submit'
+ * @return Pointer to job, NULL if the ID is unknown
+ */
+static job_t *job_find(uint16_t jobId){
+
+    if (jobId == JOB_ID_INVALID){
+        return NULL;
+    }
+    for (int index = 0; index < JOB_TABLE_SIZE; index++){
+        if ((jobTable[index].state != JOB_FREE) && (jobTable[index].id == jobId)){
+            return &jobTable[index];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Finds a free table slot, evicting the oldest finished job that was never collected.
+ *        Caller must hold jobLock.
+ *
+ * @return Index of slot, -1 if every slot is queued or running
+ */
+static int job_alloc(void){
+
+    int oldest = -1;
+
+    for (int index = 0; index < JOB_TABLE_SIZE; index++){
+        if (jobTable[index].state == JOB_FREE){
+            return index;
+        }
+        if (((jobTable[index].state == JOB_DONE) || (jobTable[index].state == JOB_CANCELLED)) &&
+            ((oldest < 0) || (jobTable[index].finishedMs < jobTable[oldest].finishedMs))){
+            oldest = index;
+        }
+    }
+    return oldest;
+}
+
+/**
+ * @brief Removes a job from the queue, jobs queued after it keep their order. Caller must hold jobLock.
+ *
+ * @param slot Index of the job in jobTable
+ */
+static void job_dequeue(uint8_t slot){
+
+    uint8_t kept = 0;
+
+    for (uint8_t index = 0; index < jobQueueCount; index++){
+        uint8_t entry = jobQueue[(jobQueueHead + index) % JOB_QUEUE_DEPTH];
+        if (entry != slot){
+            jobQueue[(jobQueueHead + kept) % JOB_QUEUE_DEPTH] = entry;
+            kept++;
+        }
+    }
+    jobQueueCount = kept;
+    metric_set(METRIC_JOB_QUEUE_DEPTH, jobQueueCount);
+}
+
+/**
+ * @brief Marks a job as finished with the given response frame, caller must hold jobLock
+ *
+ * @param job Pointer to job
+ * @param state JOB_DONE or JOB_CANCELLED
+ */
+static void job_finish(job_t *job, enum JOB_STATE state){
+    job->state = state;
+    job->progress = 100;
+    job->finishedMs = get_time_monotonic_ms();
+}
+
+/**
+ * @brief Worker thread, takes jobs from the queue in submit order and runs them through the
+ *        command table without the async redirect.
+ *
+ * @param arg Unused
+ * @return NULL
+ */
+static void *job_worker(void *arg){
+
+    job_t *job = NULL;
+    uint8_t response[CMD_RESPONSE_MAX_LEN];
+    uint16_t responseLen = 0;
+
+    (void)arg;
+
+    while (true){
+
+        pthread_mutex_lock(&jobLock);
+        while (jobEngineRunning && (jobQueueCount == 0)){
+            pthread_cond_wait(&jobReady, &jobLock);
+        }
+        if (!jobEngineRunning){
+            pthread_mutex_unlock(&jobLock);
+            return NULL;
+        }
+        job = &jobTable[jobQueue[jobQueueHead]];
+        jobQueueHead = (jobQueueHead + 1) % JOB_QUEUE_DEPTH;
+        jobQueueCount--;
+        metric_set(METRIC_JOB_QUEUE_DEPTH, jobQueueCount);
+
+        // Cancelled jobs are taken out of the queue, so every entry is still JOB_QUEUED
+        job->state = JOB_RUNNING;
+        job->progress = 0;
+        pthread_mutex_unlock(&jobLock);
+
+        jobCurrent = job;
+        cmd_dispatch(job->cmd, job->args, job->nargs, 0, NULL, response, &responseLen);
+        jobCurrent = NULL;
+
+        pthread_mutex_lock(&jobLock);
+        memcpy(job->response, response, responseLen);
+        job->responseLen = responseLen;
+        job_finish(job, job->cancelRequested ? JOB_CANCELLED : JOB_DONE);
+        pthread_mutex_unlock(&jobLock);
+    }
+}
+
+/**
+ * @brief Starts the worker pool, must be called once before jobs are submitted
+ *
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR job_engine_init(void){
+
+
+    pthread_mutex_lock(&jobLock);
+    if (jobEngineRunning){
+        pthread_mutex_unlock(&jobLock);
+        return NO_ERROR;
+    }
+    memset(jobTable, 0, sizeof(jobTable));
+    jobQueueHead = 0;
+    jobQueueCount = 0;
+    jobEngineRunning = true;
+    metric_set(METRIC_JOB_QUEUE_DEPTH, 0);
+    pthread_mutex_unlock(&jobLock);
+
+    for (int index = 0; index < JOB_NUM_WORKERS; index++){
+        if (pthread_create(&jobWorkers[index], NULL, job_worker, NULL) != 0){
+            LOG_ERRORF("JOB-ENGINE: Unable to start worker %d", index);
+            job_engine_shutdown();
+            return JOB_ENGINE_ERROR;
+        }
+    }
+    LOG_INFOF("JOB-ENGINE: Worker pool started");
+    return NO_ERROR;
+}
+
+/**
+ * @brief Stops the worker pool. Running jobs are allowed to finish, queued jobs are dropped.
+ */
+void job_engine_shutdown(void){
+
+    pthread_mutex_lock(&jobLock);
+    if (!jobEngineRunning){
+        pthread_mutex_unlock(&jobLock);
+        return;
+    }
+    jobEngineRunning = false;
+    pthread_cond_broadcast(&jobReady);
+    pthread_mutex_unlock(&jobLock);
+
+    for (int index = 0; index < JOB_NUM_WORKERS; index++){
+        if (jobWorkers[index] != 0){
+            pthread_join(jobWorkers[index], NULL);
+            jobWorkers[index] = 0;
+        }
+    }
+}
+
+/**
+ * @brief Checks if the worker pool is accepting jobs
+ *
+ * @return True if jobs can be submitted
+ */
+bool job_engine_running(void){
+
+    bool running = false;
+
+    pthread_mutex_lock(&jobLock);
+    running = jobEngineRunning;
+    pthread_mutex_unlock(&jobLock);
+    return running;
+}
+
+/**
+ * @brief Queues a command to be run by the worker pool
+ *
+ * @param cmd Command byte
+ * @param args Pointer to array of command arguments
+ * @param nargs Index of the last argument (As returned by 'cmd_extracter')
+ * @param jobId Pointer to variable that will store the ID used to poll the job
+ * @return Iris error code indicating the success or failure of function, JOB_QUEUE_FULL_ERROR
+ *         if the queue depth has been reached
+ */
+enum IRIS_ERROR job_submit(uint8_t cmd, const uint8_t *args, int nargs, uint16_t *jobId){
+
+    job_t *job = NULL;
+    int slot = 0;
+
+    *jobId = JOB_ID_INVALID;
+    if (nargs >= JOB_MAX_ARGS){
+        return CMD_FORMAT_ERROR;
+    }
+
+    pthread_mutex_lock(&jobLock);
+    if (!jobEngineRunning){
+        pthread_mutex_unlock(&jobLock);
+        return JOB_ENGINE_ERROR;
+    }
+    slot = job_alloc();
+    if ((jobQueueCount >= JOB_QUEUE_DEPTH) || (slot < 0)){
+        pthread_mutex_unlock(&jobLock);
+        metric_inc(METRIC_JOBS_REJECTED);
+        return JOB_QUEUE_FULL_ERROR;
+    }
+
+    job = &jobTable[slot];
+    memset(job, 0, sizeof(*job));
+    job->id = jobNextId++;
+    if (jobNextId == JOB_ID_INVALID){
+        jobNextId = 1;
+    }
+    job->state = JOB_QUEUED;
+    job->cmd = cmd;
+    job->nargs = nargs;
+    if (nargs >= 0){
+        memcpy(job->args, args, nargs + 1);
+    }
+
+    jobQueue[(jobQueueHead + jobQueueCount) % JOB_QUEUE_DEPTH] = (uint8_t)slot;
+    jobQueueCount++;
+    *jobId = job->id;
+    metric_inc(METRIC_JOBS_SUBMITTED);
+    metric_set(METRIC_JOB_QUEUE_DEPTH, jobQueueCount);
+
+    pthread_cond_signal(&jobReady);
+    pthread_mutex_unlock(&jobLock);
+    return NO_ERROR;
+}
+
+/**
+ * @brief Reads the state and progress of a job
+ *
+ * @param jobId Job ID returned by 'job_submit'
+ * @param state Pointer to variable that will store the job state
+ * @param progress Pointer to variable that will store the job progress (0 - 100 %)
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR job_status(uint16_t jobId, enum JOB_STATE *state, uint8_t *progress){
+
+    job_t *job = NULL;
+
+    pthread_mutex_lock(&jobLock);
+    job = job_find(jobId);
+    if (job == NULL){
+        pthread_mutex_unlock(&jobLock);
+        return JOB_ID_ERROR;
+    }
+    *state = job->state;
+    *progress = job->progress;
+    pthread_mutex_unlock(&jobLock);
+    return NO_ERROR;
+}
+
+/**
+ * @brief Collects the response frame of a finished job and frees its slot
+ *
+ * @param jobId Job ID returned by 'job_submit'
+ * @param response Pointer to array of CMD_RESPONSE_MAX_LEN bytes that will store the response frame
+ * @param responseLen Pointer to variable that will store the response length
+ * @return Iris error code indicating the success or failure of function, JOB_PENDING_ERROR if the
+ *         job has not finished
+ */
+enum IRIS_ERROR job_result(uint16_t jobId, uint8_t *response, uint16_t *responseLen){
+
+    job_t *job = NULL;
+
+    *responseLen = 0;
+
+    pthread_mutex_lock(&jobLock);
+    job = job_find(jobId);
+    if (job == NULL){
+        pthread_mutex_unlock(&jobLock);
+        return JOB_ID_ERROR;
+    }
+    if ((job->state == JOB_QUEUED) || (job->state == JOB_RUNNING)){
+        pthread_mutex_unlock(&jobLock);
+        return JOB_PENDING_ERROR;
+    }
+    if ((job->state == JOB_CANCELLED) && (job->responseLen == 0)){
+        job->state = JOB_FREE;
+        pthread_mutex_unlock(&jobLock);
+        return JOB_CANCELLED_ERROR;
+    }
+
+    memcpy(response, job->response, job->responseLen);
+    *responseLen = job->responseLen;
+    job->state = JOB_FREE;
+    pthread_mutex_unlock(&jobLock);
+    return NO_ERROR;
+}
+
+/**
+ * @brief Cancels a job. Queued jobs are removed immediately, running jobs are asked to stop
+ *        and finish as JOB_CANCELLED once their handler returns (See 'job_cancel_requested').
+ *
+ * @param jobId Job ID returned by 'job_submit'
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR job_cancel(uint16_t jobId){
+
+    job_t *job = NULL;
+
+    pthread_mutex_lock(&jobLock);
+    job = job_find(jobId);
+    if (job == NULL){
+        pthread_mutex_unlock(&jobLock);
+        return JOB_ID_ERROR;
+    }
+    switch (job->state){
+        case JOB_QUEUED:
+            // Leaves the queue now, the slot may be reused before a worker would have reached it
+            job_dequeue((uint8_t)(job - jobTable));
+            job->responseLen = 0;
+            job_finish(job, JOB_CANCELLED);
+            break;
+        case JOB_RUNNING:
+            job->cancelRequested = true;
+            break;
+        default:
+            break;
+    }
+    pthread_mutex_unlock(&jobLock);
+    return NO_ERROR;
+}
+
+/**
+ * @brief Reports the progress of the job being executed by the calling worker.
+ *        No effect when called outside of a job (Synchronous command).
+ *
+ * @param percent Progress of the job (0 - 100 %)
+ */
+void job_progress(uint8_t percent){
+
+    if (jobCurrent == NULL){
+        return;
+    }
+    pthread_mutex_lock(&jobLock);
+    jobCurrent->progress = (percent > 100) ? 100 : percent;
+    pthread_mutex_unlock(&jobLock);
+}
+
+/**
+ * @brief Checks if the OBC cancelled the job being executed by the calling worker.
+ *        Long running handlers should poll this between steps and return early.
+ *
+ * @return True if the job should stop, always false outside of a job
+ */
+bool job_cancel_requested(void){
+
+    bool cancel = false;
+
+    if (jobCurrent == NULL){
+        return false;
+    }
+    pthread_mutex_lock(&jobLock);
+    cancel = jobCurrent->cancelRequested;
+    pthread_mutex_unlock(&jobLock);
+    return cancel;
+}
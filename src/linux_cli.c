@@ -32,14 +32,12 @@ int test_cli() {
 
 IRIS_ERROR exec_linux_cli_cmd(char* input_cmd, char* output_response){
 
-    char logBuffer[255];
     char tempBuffer[255];
 
     FILE *cliPipe = popen(input_cmd, "r");
 
     if(!cliPipe){
-        snprintf(logBuffer, sizeof(logBuffer), "Unable to open Linux CLI Pipe: %s", strerror(errno));
-        log_write(LOG_ERROR, logBuffer);
+        LOG_ERRORF("Unable to open Linux CLI Pipe: %s", strerror(errno));
         pclose(cliPipe);
         return LINUX_CLI_ERROR;
     }
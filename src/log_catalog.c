@@ -0,0 +1,74 @@
+/**
+ * @file log_catalog.c
+ * @author agent
+ * @brief Binary Log Message Catalog for Theia CM4
+ *        Provides functions to...
+ *         - Look up the level and format of every binary log message ID
+ *         - Format a binary log record back into text (Terminal echo and Decoder tool)
+ *         - Fingerprint the catalog so a decoder can detect logs written by other firmware
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "log_catalog.h"
+#include "logger.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+const log_catalog_entry_t logCatalog[LOG_MSG_COUNT] = {
+#define LOG_CATALOG_ENTRY(id, logLev, format) [id] = {logLev, #id, format},
+    LOG_CATALOG(LOG_CATALOG_ENTRY)
+#undef LOG_CATALOG_ENTRY
+};
+
+
+/**
+ * @brief Formats a binary log record into text using its catalog format
+ *
+ * @param buffer Pointer to character array that will store the text
+ * @param bufferLen Size of buffer
+ * @param msgId Catalog message ID of the record
+ * @param args Pointer to array of raw argument values
+ * @param numArgs Number of arguments in array
+ * @return Number of characters written, negative if the message ID is unknown
+ */
+int log_catalog_format(char *buffer, size_t bufferLen, uint16_t msgId, const uint32_t *args, uint8_t numArgs){
+
+    uint32_t argBuf[LOG_RECORD_MAX_ARGS] = {0};
+
+    if ((msgId >= LOG_MSG_COUNT) || (msgId == LOGID_TEXT)){
+        return -1;
+    }
+    if (numArgs > LOG_RECORD_MAX_ARGS){
+        numArgs = LOG_RECORD_MAX_ARGS;
+    }
+    memcpy(argBuf, args, numArgs * sizeof(uint32_t));
+
+    // Unused arguments are passed as 0, formats only consume the ones they reference
+    return snprintf(buffer, bufferLen, logCatalog[msgId].format, argBuf[0], argBuf[1], argBuf[2], argBuf[3], argBuf[4], argBuf[5]);
+}
+
+/**
+ * @brief Calculates a FNV-1a hash over every catalog format, stored in the binary log header
+ *
+ * @return Catalog hash
+ */
+uint32_t log_catalog_hash(void){
+
+    uint32_t hash = 2166136261u;
+
+    for (int index = 0; index < LOG_MSG_COUNT; index++){
+        for (const char *chr = logCatalog[index].format; *chr != '\0'; chr++){
+            hash = (hash ^ (uint8_t)*chr) * 16777619u;
+        }
+        hash = (hash ^ 0xFF) * 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,269 @@
+/**
+ * @file log_export.c
+ * @author agent
+ * @brief Log Export for Theia CM4
+ *        Provides functions to...
+ *         - Select the log segments covering a time range from the segment index
+ *         - Stream the segments through a gzip compressor in fixed-size chunks
+ *         - Store the compressed export in a sealed memfd ready for a bulk SPI transfer
+ *         - Report the raw and compressed size before anything is downlinked
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include "error_handler.h"
+#include "log_export.h"
+#include "log_segment.h"
+#include "logger.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+typedef struct {
+    z_stream stream;
+    int fd;                     // Compressed output, -1 to only count the compressed size
+    uint64_t rawSize;
+    uint64_t compressedSize;
+    uint8_t outBuffer[LOG_EXPORT_CHUNK_SIZE];
+} log_export_stream_t;
+
+static log_export_stream_t logExport;
+static pthread_mutex_t logExportLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * @brief Compresses a block of export data and writes any finished output to the memfd
+ *
+ * @param export Pointer to export stream
+ * @param data Pointer to array of uncompressed bytes
+ * @param len Number of bytes in data
+ * @param flush Z_NO_FLUSH, or Z_FINISH to complete the gzip stream
+ * @return Iris error code indicating the success or failure of function
+ */
+static enum IRIS_ERROR log_export_deflate(log_export_stream_t *export, const void *data, size_t len, int flush){
+
+    size_t outLen = 0;
+    int status = Z_OK;
+
+    export->stream.next_in = (Bytef *)data;
+    export->stream.avail_in = (uInt)len;
+    export->rawSize += len;
+
+    do{
+        export->stream.next_out = export->outBuffer;
+        export->stream.avail_out = sizeof(export->outBuffer);
+        status = deflate(&export->stream, flush);
+        if (status == Z_STREAM_ERROR){
+            return LOG_EXPORT_ERROR;
+        }
+
+        outLen = sizeof(export->outBuffer) - export->stream.avail_out;
+        if ((export->fd >= 0) && (outLen != 0) && (write(export->fd, export->outBuffer, outLen) != (ssize_t)outLen)){
+            return LOG_EXPORT_ERROR;
+        }
+        export->compressedSize += outLen;
+    }while (export->stream.avail_out == 0);
+
+    return NO_ERROR;
+}
+
+/**
+ * @brief Appends one segment, its header followed by exactly the number of bytes it held when opened
+ *
+ * @param export Pointer to export stream
+ * @param baseName Base name of the log the segment belongs to
+ * @param segment Pointer to index entry of the segment
+ * @return Iris error code indicating the success or failure of function
+ */
+static enum IRIS_ERROR log_export_segment(log_export_stream_t *export, const char *baseName, const log_segment_t *segment){
+
+    char path[LOG_FILE_PATH_LEN];
+    uint8_t inBuffer[LOG_EXPORT_CHUNK_SIZE];
+    log_export_segment_t header = {segment->segmentId, 0, segment->firstNs, segment->lastNs, 0};
+    struct stat fileStat;
+    enum IRIS_ERROR error = NO_ERROR;
+    uint64_t copied = 0;
+    ssize_t numBytes = 0;
+    int fd = -1;
+
+    log_segment_path(baseName, segment->segmentId, path, sizeof(path));
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if ((fd < 0) || (fstat(fd, &fileStat) != 0)){
+        // Dropped between the index lookup and now, it is simply left out
+        if (fd >= 0){
+            close(fd);
+        }
+        return NO_ERROR;
+    }
+
+    // The newest segment may still grow, only what exists now is exported
+    header.size = (uint64_t)fileStat.st_size;
+    error = log_export_deflate(export, &header, sizeof(header), Z_NO_FLUSH);
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    while ((error == NO_ERROR) && (copied < header.size)){
+        numBytes = read(fd, inBuffer, ((header.size - copied) > sizeof(inBuffer)) ? sizeof(inBuffer) : (size_t)(header.size - copied));
+        if (numBytes <= 0){
+            // Keep the stream consistent with the header if the file was cut short
+            numBytes = ((header.size - copied) > sizeof(inBuffer)) ? (ssize_t)sizeof(inBuffer) : (ssize_t)(header.size - copied);
+            memset(inBuffer, 0, (size_t)numBytes);
+        }
+        error = log_export_deflate(export, inBuffer, (size_t)numBytes, Z_NO_FLUSH);
+        copied += (uint64_t)numBytes;
+    }
+    close(fd);
+    return error;
+}
+
+/**
+ * @brief Compresses an export header and the given segments into a gzip stream
+ *
+ * @param export Pointer to export stream, 'fd' must already be set
+ * @param baseName Base name of the log the segments belong to
+ * @param header Pointer to export header
+ * @param segments Pointer to array of segments to export, oldest first
+ * @return Iris error code indicating the success or failure of function
+ */
+static enum IRIS_ERROR log_export_build(log_export_stream_t *export, const char *baseName, const log_export_header_t *header, const log_segment_t *segments){
+
+    enum IRIS_ERROR error = NO_ERROR;
+
+    memset(&export->stream, 0, sizeof(export->stream));
+    export->rawSize = 0;
+    export->compressedSize = 0;
+
+    // windowBits + 16 writes a gzip wrapper, the export can be read with standard tools
+    if (deflateInit2(&export->stream, LOG_EXPORT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK){
+        return LOG_EXPORT_ERROR;
+    }
+
+    error = log_export_deflate(export, header, sizeof(*header), Z_NO_FLUSH);
+    for (int index = 0; (index < header->numSegments) && (error == NO_ERROR); index++){
+        error = log_export_segment(export, baseName, &segments[index]);
+    }
+    if (error == NO_ERROR){
+        error = log_export_deflate(export, NULL, 0, Z_FINISH);
+    }
+    deflateEnd(&export->stream);
+    return error;
+}
+
+/**
+ * @brief Counts the oldest segments that fit in LOG_EXPORT_MAX_RAW_MB, the first segment is always
+ *        counted so an export makes progress even if a single segment is larger than the bound
+ *
+ * @param baseName Base name of the log the segments belong to
+ * @param segments Pointer to array of selected segments, oldest first
+ * @param numSegments Number of segments in the array
+ * @return Number of segments to export
+ */
+static int log_export_bound(const char *baseName, const log_segment_t *segments, int numSegments){
+
+    char path[LOG_FILE_PATH_LEN];
+    struct stat fileStat;
+    uint64_t rawSize = 0;
+    int numExport = 0;
+
+    for (numExport = 0; numExport < numSegments; numExport++){
+        log_segment_path(baseName, segments[numExport].segmentId, path, sizeof(path));
+        if (stat(path, &fileStat) != 0){
+            // Dropped since the lookup, 'log_export_segment' leaves it out
+            continue;
+        }
+        rawSize += (uint64_t)fileStat.st_size;
+        if ((numExport != 0) && (rawSize > ((uint64_t)LOG_EXPORT_MAX_RAW_MB * 1024 * 1024))){
+            break;
+        }
+    }
+    return numExport;
+}
+
+/**
+ * @brief Compresses the log segments holding messages logged between two times, bounded to
+ *        LOG_EXPORT_MAX_RAW_MB per request. The export is built completely before returning so
+ *        its compressed size can be reported up front.
+ *
+ * @param startNs Realtime start of the range in nano-seconds, 0 for no lower bound
+ * @param endNs Realtime end of the range in nano-seconds, UINT64_MAX for no upper bound
+ * @param flags LOG_EXPORT_FLAG_*, with LOG_EXPORT_FLAG_SIZE_ONLY the output is only measured
+ * @param fd Pointer to variable that will store the sealed memfd holding the export (-1 if size
+ *           only or on failure), the caller must close it
+ * @param info Pointer to structure that will store the number of segments and the export sizes
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR log_export(uint64_t startNs, uint64_t endNs, uint8_t flags, int *fd, log_export_info_t *info){
+
+    static log_segment_t segments[LOG_MAX_SEGMENTS];
+    static log_index_t spiIndex;
+    log_export_header_t header = {LOG_EXPORT_MAGIC, LOG_EXPORT_VERSION, 0, startNs, endNs};
+    const char *baseName = (flags & LOG_EXPORT_FLAG_SPI_LOG) ? LOG_SPI_BASENAME : LOG_BASENAME;
+    enum IRIS_ERROR error = NO_ERROR;
+    int numSegments = 0;
+    int numFound = 0;
+
+    *fd = -1;
+    memset(info, 0, sizeof(*info));
+
+    pthread_mutex_lock(&logExportLock);
+    if (flags & LOG_EXPORT_FLAG_SPI_LOG){
+        log_index_open(&spiIndex, baseName);
+        numSegments = log_index_find(&spiIndex, startNs, endNs, segments, LOG_MAX_SEGMENTS);
+        log_index_close(&spiIndex);
+    }else{
+        // Everything logged before the request is part of the export
+        log_flush();
+        numSegments = log_segment_find(startNs, endNs, segments, LOG_MAX_SEGMENTS);
+    }
+    numFound = numSegments;
+    numSegments = log_export_bound(baseName, segments, numFound);
+    header.numSegments = (uint16_t)numSegments;
+
+    logExport.fd = -1;
+    if (!(flags & LOG_EXPORT_FLAG_SIZE_ONLY)){
+        logExport.fd = memfd_create(LOG_EXPORT_MEMFD_NAME, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (logExport.fd < 0){
+            pthread_mutex_unlock(&logExportLock);
+            LOG_ERRORF("LOG-EXPORT: Failed to create memfd for log export");
+            return LOG_EXPORT_ERROR;
+        }
+    }
+
+    error = log_export_build(&logExport, baseName, &header, segments);
+    if (error != NO_ERROR){
+        if (logExport.fd >= 0){
+            close(logExport.fd);
+        }
+        pthread_mutex_unlock(&logExportLock);
+        LOG_ERRORF("LOG-EXPORT: Failed to compress %d log segments", numSegments);
+        return error;
+    }
+
+    if (logExport.fd >= 0){
+        // Sealed so the SPI service can map it without the contents changing underneath the transfer
+        fcntl(logExport.fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+        *fd = logExport.fd;
+    }
+    info->numSegments = (uint16_t)numSegments;
+    info->numRemaining = (uint16_t)(numFound - numSegments);
+    info->rawSize = logExport.rawSize;
+    info->compressedSize = logExport.compressedSize;
+    pthread_mutex_unlock(&logExportLock);
+
+    LOG_INFOF("LOG-EXPORT: %d segments (%d left out), %llu bytes compressed to %llu bytes", numSegments,
+              numFound - numSegments, (unsigned long long)info->rawSize, (unsigned long long)info->compressedSize);
+    return NO_ERROR;
+}
@@ -0,0 +1,281 @@
+/**
+ * @file log_segment.c
+ * @author agent
+ * @brief Log Segment Index for Theia CM4
+ *        Provides functions to...
+ *         - Name the numbered, fixed-size segment files the logger rotates through
+ *         - Keep an index of every segment's time range and size in one small file
+ *         - Update or retire a single segment by rewriting only its index slot
+ *         - Drop the oldest segment once LOG_MAX_SEGMENTS exist, bounding flash usage
+ *         - Find the segments covering a time range without opening any of them
+ *         - Rebuild the index from the log directory if it is missing or corrupt
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "log_segment.h"
+#include "logger.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/**
+ * @brief Builds the path of a segment file, <LOG_DIRECTORY>/<base>_<id>.<bin|txt>
+ *
+ * @param baseName Base name of the log (LOG_BASENAME or LOG_SPI_BASENAME)
+ * @param segmentId Segment number
+ * @param path Pointer to array that will store the path
+ * @param pathLen Size of path array
+ */
+void log_segment_path(const char *baseName, uint32_t segmentId, char *path, size_t pathLen){
+    snprintf(path, pathLen, "%s/%s_%06u.%s", LOG_DIRECTORY, baseName, segmentId, LOG_BINARY ? "bin" : "txt");
+}
+
+/**
+ * @brief Writes one slot of the index to the index file
+ *
+ * @param index Pointer to the open index
+ * @param slot Slot number
+ */
+static void log_index_store(log_index_t *index, uint32_t slot){
+
+    off_t offset = (off_t)sizeof(log_index_header_t) + ((off_t)slot * (off_t)sizeof(log_segment_t));
+
+    if (index->fd >= 0){
+        pwrite(index->fd, &index->slots[slot], sizeof(log_segment_t), offset);
+    }
+}
+
+/**
+ * @brief Recreates the index from the segment files found in the log directory. Time ranges of
+ *        rebuilt segments are unknown, their last time is taken from the file's modification time.
+ *
+ * @param index Pointer to the index being rebuilt, the file must already be open
+ */
+static void log_index_rebuild(log_index_t *index){
+
+    char format[LOG_BASENAME_LEN + 16];
+    char extension[4] = {0};
+    struct dirent *entry = NULL;
+    struct stat fileStat;
+    char path[LOG_FILE_PATH_LEN];
+    uint32_t segmentId = 0;
+    uint32_t slot = 0;
+    log_index_header_t header = {LOG_INDEX_MAGIC, LOG_INDEX_VERSION, LOG_MAX_SEGMENTS, {0, 0}};
+    DIR *dir = NULL;
+
+    memset(index->slots, 0, sizeof(index->slots));
+    snprintf(format, sizeof(format), "%s_%%u.%%3s", index->baseName);
+
+    dir = opendir(LOG_DIRECTORY);
+    while ((dir != NULL) && ((entry = readdir(dir)) != NULL)){
+
+        if ((sscanf(entry->d_name, format, &segmentId, extension) != 2) || (segmentId == LOG_SEGMENT_ID_NONE) ||
+            (strcmp(extension, LOG_BINARY ? "bin" : "txt") != 0)){
+            continue;
+        }
+        log_segment_path(index->baseName, segmentId, path, sizeof(path));
+        if (stat(path, &fileStat) != 0){
+            continue;
+        }
+
+        // Two segments sharing a slot means the older one should already have been dropped
+        slot = segmentId % LOG_MAX_SEGMENTS;
+        if (index->slots[slot].segmentId > segmentId){
+            unlink(path);
+            continue;
+        }
+        if (index->slots[slot].segmentId != LOG_SEGMENT_ID_NONE){
+            log_segment_path(index->baseName, index->slots[slot].segmentId, path, sizeof(path));
+            unlink(path);
+        }
+
+        index->slots[slot].segmentId = segmentId;
+        index->slots[slot].flags = 0;
+        index->slots[slot].firstNs = LOG_SEGMENT_TIME_NONE;
+        index->slots[slot].lastNs = ((uint64_t)fileStat.st_mtim.tv_sec * 1000000000ULL) + (uint64_t)fileStat.st_mtim.tv_nsec;
+        index->slots[slot].size = (uint64_t)fileStat.st_size;
+    }
+    if (dir != NULL){
+        closedir(dir);
+    }
+
+    if (index->fd >= 0){
+        ftruncate(index->fd, 0);
+        pwrite(index->fd, &header, sizeof(header), 0);
+        pwrite(index->fd, index->slots, sizeof(index->slots), sizeof(header));
+    }
+}
+
+/**
+ * @brief Opens (or creates) the segment index of a log and loads it into memory
+ *
+ * @param index Pointer to structure that will store the index
+ * @param baseName Base name of the log (LOG_BASENAME or LOG_SPI_BASENAME)
+ * @return True if the index file could be opened, the in-memory index is valid either way
+ */
+bool log_index_open(log_index_t *index, const char *baseName){
+
+    char path[LOG_FILE_PATH_LEN];
+    log_index_header_t header;
+
+    memset(index, 0, sizeof(*index));
+    strncpy(index->baseName, baseName, LOG_BASENAME_LEN - 1);
+
+    snprintf(path, sizeof(path), "%s/%s.idx", LOG_DIRECTORY, baseName);
+    index->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    if ((index->fd < 0) ||
+        (pread(index->fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) ||
+        (header.magic != LOG_INDEX_MAGIC) || (header.version != LOG_INDEX_VERSION) ||
+        (header.numSlots != LOG_MAX_SEGMENTS) ||
+        (pread(index->fd, index->slots, sizeof(index->slots), sizeof(header)) != (ssize_t)sizeof(index->slots))){
+        log_index_rebuild(index);
+    }
+    return (index->fd >= 0);
+}
+
+/**
+ * @brief Closes the index file
+ *
+ * @param index Pointer to the open index
+ */
+void log_index_close(log_index_t *index){
+
+    if (index->fd >= 0){
+        close(index->fd);
+    }
+    index->fd = -1;
+}
+
+/**
+ * @brief Finds the newest segment of the log
+ *
+ * @param index Pointer to the open index
+ * @return Number of the newest segment, LOG_SEGMENT_ID_NONE if there are none
+ */
+uint32_t log_index_newest(const log_index_t *index){
+
+    uint32_t newest = LOG_SEGMENT_ID_NONE;
+
+    for (uint32_t slot = 0; slot < LOG_MAX_SEGMENTS; slot++){
+        if (index->slots[slot].segmentId > newest){
+            newest = index->slots[slot].segmentId;
+        }
+    }
+    return newest;
+}
+
+/**
+ * @brief Looks up a segment by number
+ *
+ * @param index Pointer to the open index
+ * @param segmentId Segment number
+ * @return Pointer to the segment's index entry, NULL if the segment no longer exists
+ */
+const log_segment_t *log_index_get(const log_index_t *index, uint32_t segmentId){
+
+    const log_segment_t *segment = &index->slots[segmentId % LOG_MAX_SEGMENTS];
+
+    if ((segmentId == LOG_SEGMENT_ID_NONE) || (segment->segmentId != segmentId)){
+        return NULL;
+    }
+    return segment;
+}
+
+/**
+ * @brief Records the start of a new segment. The segment LOG_MAX_SEGMENTS older that used the
+ *        same slot is deleted, nothing else in the index or on disk is touched.
+ *
+ * @param index Pointer to the open index
+ * @param segmentId Number of the new segment
+ * @param firstNs Realtime timestamp of the first message in the segment
+ */
+void log_index_begin(log_index_t *index, uint32_t segmentId, uint64_t firstNs){
+
+    char path[LOG_FILE_PATH_LEN];
+    uint32_t slot = segmentId % LOG_MAX_SEGMENTS;
+    log_segment_t *segment = &index->slots[slot];
+
+    if ((segment->segmentId != LOG_SEGMENT_ID_NONE) && (segment->segmentId != segmentId)){
+        log_segment_path(index->baseName, segment->segmentId, path, sizeof(path));
+        unlink(path);
+    }
+
+    segment->segmentId = segmentId;
+    segment->flags = 0;
+    segment->firstNs = firstNs;
+    segment->lastNs = firstNs;
+    segment->size = 0;
+    log_index_store(index, slot);
+}
+
+/**
+ * @brief Updates the time range and size of a segment after data is flushed to it
+ *
+ * @param index Pointer to the open index
+ * @param segmentId Segment number
+ * @param lastNs Realtime timestamp of the last message flushed to the segment
+ * @param size Bytes flushed to the segment
+ */
+void log_index_update(log_index_t *index, uint32_t segmentId, uint64_t lastNs, uint64_t size){
+
+    uint32_t slot = segmentId % LOG_MAX_SEGMENTS;
+    log_segment_t *segment = &index->slots[slot];
+
+    if ((segmentId == LOG_SEGMENT_ID_NONE) || (segment->segmentId != segmentId) ||
+        ((segment->lastNs == lastNs) && (segment->size == size))){
+        return;
+    }
+    if (segment->firstNs == LOG_SEGMENT_TIME_NONE){
+        segment->firstNs = lastNs;
+    }
+    segment->lastNs = lastNs;
+    segment->size = size;
+    log_index_store(index, slot);
+}
+
+/**
+ * @brief Finds the segments holding messages logged between two times, from the index alone
+ *
+ * @param index Pointer to the open index
+ * @param startNs Realtime start of the range in nano-seconds, 0 for no lower bound
+ * @param endNs Realtime end of the range in nano-seconds, UINT64_MAX for no upper bound
+ * @param segments Pointer to array that will store the matching segments, oldest first
+ * @param maxSegments Size of segments array
+ * @return Number of segments stored in 'segments'
+ */
+int log_index_find(const log_index_t *index, uint64_t startNs, uint64_t endNs, log_segment_t *segments, int maxSegments){
+
+    uint32_t newest = log_index_newest(index);
+    uint32_t oldest = (newest > LOG_MAX_SEGMENTS) ? (newest - LOG_MAX_SEGMENTS + 1) : 1;
+    const log_segment_t *segment = NULL;
+    int numFound = 0;
+
+    if (newest == LOG_SEGMENT_ID_NONE){
+        return 0;
+    }
+
+    // Segments are numbered in time order, walking them by number keeps the result sorted
+    for (uint32_t segmentId = oldest; (segmentId <= newest) && (numFound < maxSegments); segmentId++){
+        segment = log_index_get(index, segmentId);
+        if ((segment == NULL) || (segment->lastNs < startNs) ||
+            ((segment->firstNs != LOG_SEGMENT_TIME_NONE) && (segment->firstNs > endNs))){
+            continue;
+        }
+        segments[numFound++] = *segment;
+    }
+    return numFound;
+}
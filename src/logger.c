@@ -1,33 +1,82 @@
-
 /**
  * @file logger.c
  * @author Noah Klager
- * @brief Logger for Theia CM4 
+ * @brief Logger for Theia CM4
  *        Provides functions to...
  *         - Log Information / Errors to terminal
  *         - Log Information / Errors to a file
- * 
+ *         - Queue messages from any thread into a lock-free ring without blocking the caller
+ *         - Write queued messages from a background thread through a persistent file handle
+ *         - Flush / sync the log file according to a configurable policy
+ *         - Store catalog messages as binary records (ID, timestamp, raw arguments) that are only
+ *           formatted when a human reads them
+ *         - Rotate through numbered, fixed-size log segments within a total size cap
+ *
  * @version 0.1
  * @date 2024-11-09
- * 
+ *
  * @copyright Copyright (c) 2024
- * 
+ *
  */
 
+#include "log_catalog.h"
+#include "log_segment.h"
 #include "logger.h"
+#include "metrics.h"
 
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
 #include <time.h>
+#include <unistd.h>
+
+// Message Ring: Multi producer / single consumer, every slot carries a sequence number so
+// producers claim slots with a single CAS and the writer knows when a slot has been filled
+typedef struct {
+    uint32_t seq;
+    enum LOG_LEVEL logLev;
+    struct timespec timestamp;
+    uint16_t msgId;                         // Catalog message, LOGID_TEXT if 'msg' holds the text
+    uint8_t numArgs;
+    uint32_t args[LOG_RECORD_MAX_ARGS];
+    char msg[LOG_BUFFER_SIZE];
+} log_slot_t;
 
-//* GLOBAL VARIABLE: Tracks number of times Log File has looped over.
-int LOG_FILE_LOOPS = 0; 
+static log_slot_t logRing[LOG_RING_SLOTS];
+static uint32_t logEnqueuePos;              // Next slot claimed by a producer
+static uint32_t logDequeuePos;              // Next slot read by the writer, writer only
+static uint32_t logWrittenPos;              // Every message before this has been flushed to the file
+static uint32_t logDropped;                 // Messages lost because the ring was full
+static uint32_t logWakeSeq;                 // Futex word, bumped on every message
+static uint32_t logWaiters;                 // Writer is sleeping on 'logWakeSeq'
+static uint32_t logFlushRequest;            // 'log_flush' is waiting for the file to be synced
+
+static log_policy_t logPolicy = {LOG_FLUSH_INTERVAL_MS, LOG_FSYNC_INTERVAL_MS, LOG_FLUSH_LEVEL};
+static FILE *logFile = NULL;
+static long logFileSize = 0;
+static char logBaseName[LOG_BASENAME_LEN] = LOG_BASENAME;
+static log_index_t logIndex;
+static bool logIndexOpen = false;
+static uint32_t logSegmentId = LOG_SEGMENT_ID_NONE;    // Segment 'logFile' writes to
+static uint64_t logLastNs = 0;                          // Timestamp of the last message written
+static pthread_mutex_t logIndexLock = PTHREAD_MUTEX_INITIALIZER;
+static bool logStarted = false;
+static bool logThreadRunning = false;
+static pthread_t logThread;
+static pthread_mutex_t logStartLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t logDirectLock = PTHREAD_MUTEX_INITIALIZER;
 
 
 /**
  * @brief Checks if the Log File Size is larger than the Limit Set
- * 
+ *
  * @param filePtr Log File instance
  * @return Boolean variable indicating if the file size has been surpassed (True = File Size Reached | False = File Size NOT Reached)
  */
@@ -36,112 +85,660 @@ bool check_log_file_size(FILE *filePtr){
     fseek(filePtr, 0, SEEK_END);
     long file_size = ftell(filePtr);
 
-    if (file_size > (long)(MAX_FILE_SIZE_MB * 1e6)){
+    if (file_size >= (long)(LOG_SEGMENT_SIZE_MB * 1e6)){
         return true;
     }
     return false;
 }
 
+static uint64_t log_now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000) + ((uint64_t)ts.tv_nsec / 1000000);
+}
+
+static uint64_t log_timespec_ns(const struct timespec *ts){
+    return ((uint64_t)ts->tv_sec * 1000000000ULL) + (uint64_t)ts->tv_nsec;
+}
 
 /**
- * @brief Write a message to the terminal and log file to record any information or events
- * 
- * @param logLev The level indicating what type of log to record (Error, Info, Warning, Debug)
- * @param msg Pointer to character array containing message that will be logged
+ * @brief Opens the persistent log file handle on the newest segment, the handle is kept open until
+ *        the segment is full. In binary mode a new segment starts with a header identifying the
+ *        catalog it was written with.
+ *
+ * @param newSegment True to always start a new segment, false to continue the newest one if it has room
+ * @param firstNs Realtime timestamp of the first message that will be written
  */
-void log_write(enum LOG_LEVEL logLev, const char *msg){
+static void log_file_open(bool newSegment, uint64_t firstNs){
 
-    FILE *filePtr = NULL;
     char filepath[LOG_FILE_PATH_LEN];
-    bool openedFile = true;
-    snprintf(filepath, sizeof(filepath), "%s/%s", LOG_DIRECTORY, LOG_FILENAME);
+    log_bin_header_t header = {LOG_BIN_MAGIC, LOG_BIN_VERSION, sizeof(log_bin_header_t), 0, 0};
+    const log_segment_t *segment = NULL;
+    const char *mode = "a";
 
-    //Check if any Logging is Active
-    if(!(INFO_ACTIVE || DEBUG_ACTIVE || ERROR_ACTIVE ))
+    pthread_mutex_lock(&logIndexLock);
+    if (!logIndexOpen){
+        log_index_open(&logIndex, logBaseName);
+        logIndexOpen = true;
+    }
+
+    if (logFile != NULL){
+        fclose(logFile);
+        logFile = NULL;
+        log_index_update(&logIndex, logSegmentId, logLastNs, (uint64_t)logFileSize);
+    }
+
+    logSegmentId = log_index_newest(&logIndex);
+    segment = log_index_get(&logIndex, logSegmentId);
+    if (newSegment || (segment == NULL) || (segment->size >= (uint64_t)(LOG_SEGMENT_SIZE_MB * 1e6))){
+        logSegmentId++;
+        if (logSegmentId == LOG_SEGMENT_ID_NONE){
+            logSegmentId++;
+        }
+        log_index_begin(&logIndex, logSegmentId, firstNs);
+        mode = "w";
+    }
+    logLastNs = firstNs;
+    log_segment_path(logBaseName, logSegmentId, filepath, sizeof(filepath));
+    pthread_mutex_unlock(&logIndexLock);
+
+    logFile = fopen(filepath, mode);
+    if (logFile == NULL){
+        printf("ERROR: UNABLE TO OPEN LOG FILE.\n");
         return;
+    }
+    setvbuf(logFile, NULL, _IOFBF, LOG_FILE_BUFFER_SIZE);
 
-    //Grab Time stamp
-    time_t curr_time = time(NULL);
-    struct tm tmStruct = *localtime(&curr_time);
+    fseek(logFile, 0, SEEK_END);
+    logFileSize = ftell(logFile);
 
-    //Check if we are logging to a file
-    if(LOG_TO_FILE){
-        filePtr = fopen(filepath, "a");
+    if (LOG_BINARY && (logFileSize == 0)){
+        header.catalogHash = log_catalog_hash();
+        logFileSize += (long)fwrite(&header, 1, sizeof(header), logFile);
+    }
+}
 
-        if(filePtr == NULL){
-            printf("ERROR: UNABLE TO OPEN LOG FILE.\n");
-            openedFile = false;
-        }else{
+/**
+ * @brief Appends a binary record to the log file, see 'log_bin_record_t' for the layout
+ *
+ * @param slot Pointer to the message being written
+ * @return Number of bytes written
+ */
+static long log_emit_binary(const log_slot_t *slot){
 
-            //Checks that if Log Size is to LARGE
-            if(check_log_file_size(filePtr)){
+    log_bin_record_t record;
+    uint16_t textLen = 0;
+    long written = 0;
 
-                fclose(filePtr);
-                filePtr = fopen(filepath, "w");
+    record.timestampNs = log_timespec_ns(&slot->timestamp);
+    record.msgId = slot->msgId;
+    record.logLev = (uint8_t)slot->logLev;
+    record.numArgs = (slot->msgId == LOGID_TEXT) ? 0 : slot->numArgs;
 
-                if(filePtr == NULL){
-                    printf("ERROR: UNABLE TO OPEN LOG FILE.\n");
-                    openedFile = false;
-                }else{
-                    LOG_FILE_LOOPS++;
-                    printf("%d-%02d-%02d %02d:%02d:%02d | " KMAG "ERROR: LOG FILE OVERFLOWED #%d\n" KNRM, tmStruct.tm_year + 1900, tmStruct.tm_mon + 1, tmStruct.tm_mday, tmStruct.tm_hour, tmStruct.tm_min, tmStruct.tm_sec, LOG_FILE_LOOPS + 1);
-                    fprintf(filePtr, "%d-%02d-%02d %02d:%02d:%02d | " "ERROR: LOG FILE OVERFLOWED #%d\n", tmStruct.tm_year + 1900, tmStruct.tm_mon + 1, tmStruct.tm_mday, tmStruct.tm_hour, tmStruct.tm_min, tmStruct.tm_sec, LOG_FILE_LOOPS + 1);
-                }
-            }
-        }
+    written += (long)fwrite(&record, 1, sizeof(record), logFile);
+    written += (long)fwrite(slot->args, sizeof(uint32_t), record.numArgs, logFile) * (long)sizeof(uint32_t);
+
+    // Free-form messages carry their text, length prefixed
+    if (slot->msgId == LOGID_TEXT){
+        textLen = (uint16_t)strnlen(slot->msg, LOG_BUFFER_SIZE);
+        written += (long)fwrite(&textLen, 1, sizeof(textLen), logFile);
+        written += (long)fwrite(slot->msg, 1, textLen, logFile);
     }
+    return written;
+}
 
-    //Log to terminal or file
-    switch (logLev){
+/**
+ * @brief Writes one message to the terminal and log file. Only called by the writer thread, or
+ *        with 'logDirectLock' held if the writer thread could not be started.
+ *
+ * @param slot Pointer to the message being written
+ */
+static void log_emit(const log_slot_t *slot){
+
+    struct tm tmStruct;
+    char msgBuffer[LOG_BUFFER_SIZE];
+    const char *msg = slot->msg;
+    const char *colour = KWHT;
+    const char *label = "INFO ";
+    bool echo = !LOG_BINARY || LOG_BIN_ECHO || (slot->msgId == LOGID_TEXT) || (slot->logLev == LOG_ERROR);
+    int written = 0;
+
+    localtime_r(&slot->timestamp.tv_sec, &tmStruct);
+
+    switch (slot->logLev){
     case LOG_ERROR:
-        if (ERROR_ACTIVE){
-            printf("%d-%02d-%02d %02d:%02d:%02d | " KRED "ERROR: %s\n" KNRM, tmStruct.tm_year + 1900, tmStruct.tm_mon + 1, tmStruct.tm_mday, tmStruct.tm_hour, tmStruct.tm_min, tmStruct.tm_sec, msg);
-            if (LOG_TO_FILE && openedFile){
-                fprintf(filePtr, "%d-%02d-%02d %02d:%02d:%02d | " "ERROR: %s\n", tmStruct.tm_year + 1900, tmStruct.tm_mon + 1, tmStruct.tm_mday, tmStruct.tm_hour, tmStruct.tm_min, tmStruct.tm_sec, msg);
-            }
-        }
+        colour = KRED;
+        label = "ERROR";
         break;
     case LOG_WARNING:
-        if (ERROR_ACTIVE){
-            printf("%d-%02d-%02d %02d:%02d:%02d | " KYEL "WARN : %s\n" KNRM, tmStruct.tm_year + 1900, tmStruct.tm_mon + 1, tmStruct.tm_mday, tmStruct.tm_hour, tmStruct.tm_min, tmStruct.tm_sec, msg);
-            if (LOG_TO_FILE  && openedFile){
-                fprintf(filePtr, "%d-%02d-%02d %02d:%02d:%02d | " "WARN : %s\n", tmStruct.tm_year + 1900, tmStruct.tm_mon + 1, tmStruct.tm_mday, tmStruct.tm_hour, tmStruct.tm_min, tmStruct.tm_sec, msg);
-            }
-        }
+        colour = KYEL;
+        label = "WARN ";
         break;
     case LOG_DEBUG:
-        if (DEBUG_ACTIVE){
-            printf("%d-%02d-%02d %02d:%02d:%02d | " KGRN "DEBUG: %s\n" KNRM, tmStruct.tm_year + 1900, tmStruct.tm_mon + 1, tmStruct.tm_mday, tmStruct.tm_hour, tmStruct.tm_min, tmStruct.tm_sec, msg);
-            if (LOG_TO_FILE && openedFile){
-                fprintf(filePtr, "%d-%02d-%02d %02d:%02d:%02d | " "DEBUG: %s\n", tmStruct.tm_year + 1900, tmStruct.tm_mon + 1, tmStruct.tm_mday, tmStruct.tm_hour, tmStruct.tm_min, tmStruct.tm_sec, msg);
-            }
-        }
+        colour = KGRN;
+        label = "DEBUG";
         break;
     default:
-        if (INFO_ACTIVE){
-            printf("%d-%02d-%02d %02d:%02d:%02d | " KWHT "INFO : %s\n" KNRM, tmStruct.tm_year + 1900, tmStruct.tm_mon + 1, tmStruct.tm_mday, tmStruct.tm_hour, tmStruct.tm_min, tmStruct.tm_sec, msg);
-            if (LOG_TO_FILE && openedFile){
-                fprintf(filePtr, "%d-%02d-%02d %02d:%02d:%02d | " "INFO : %s\n", tmStruct.tm_year + 1900, tmStruct.tm_mon + 1, tmStruct.tm_mday, tmStruct.tm_hour, tmStruct.tm_min, tmStruct.tm_sec, msg);
+        break;
+    }
+
+    // Catalog messages are only formatted when someone reads them as text
+    if ((slot->msgId != LOGID_TEXT) && echo){
+        log_catalog_format(msgBuffer, sizeof(msgBuffer), slot->msgId, slot->args, slot->numArgs);
+        msg = msgBuffer;
+    }
+    if (echo){
+        printf("%d-%02d-%02d %02d:%02d:%02d | %s%s: %s\n" KNRM, tmStruct.tm_year + 1900, tmStruct.tm_mon + 1, tmStruct.tm_mday, tmStruct.tm_hour, tmStruct.tm_min, tmStruct.tm_sec, colour, label, msg);
+    }
+
+    //Check if we are logging to a file
+    if (!LOG_TO_FILE){
+        return;
+    }
+
+    //Start the next segment once the current one is full, the oldest segment is dropped by the index
+    if ((logFile == NULL) || (logFileSize >= (long)(LOG_SEGMENT_SIZE_MB * 1e6))){
+        log_file_open(logFile != NULL, log_timespec_ns(&slot->timestamp));
+        if (logFile == NULL){
+            return;
+        }
+    }
+    logLastNs = log_timespec_ns(&slot->timestamp);
+
+    if (LOG_BINARY){
+        logFileSize += log_emit_binary(slot);
+        return;
+    }
+    written = fprintf(logFile, "%d-%02d-%02d %02d:%02d:%02d | %s: %s\n", tmStruct.tm_year + 1900, tmStruct.tm_mon + 1, tmStruct.tm_mday, tmStruct.tm_hour, tmStruct.tm_min, tmStruct.tm_sec, label, msg);
+    logFileSize += (written > 0) ? written : 0;
+}
+
+/**
+ * @brief Pushes buffered lines to the kernel, records the segment's new time range and size in the
+ *        index and optionally syncs the file to storage
+ *
+ * @param sync True to fsync the file after flushing
+ */
+static void log_file_flush(bool sync){
+
+    fflush(stdout);
+    if (logFile != NULL){
+        fflush(logFile);
+        pthread_mutex_lock(&logIndexLock);
+        log_index_update(&logIndex, logSegmentId, logLastNs, (uint64_t)logFileSize);
+        pthread_mutex_unlock(&logIndexLock);
+        if (sync){
+            fsync(fileno(logFile));
+        }
+    }
+}
+
+/**
+ * @brief Writer thread, drains the message ring in batches and applies the flush / sync policy.
+ *        Sleeps on a futex while the ring is empty, so an idle logger costs nothing.
+ *
+ * @param arg Unused
+ * @return NULL
+ */
+static void *log_writer(void *arg){
+
+    (void)arg;
+    log_slot_t dropSlot = {.logLev = LOG_WARNING, .msgId = LOGID_TEXT};
+    struct timespec timeout;
+    uint64_t lastFlush = log_now_ms();
+    uint64_t lastSync = lastFlush;
+    uint64_t nowMs = 0;
+    uint32_t dropped = 0;
+    uint32_t wakeSeq = 0;
+    bool dirty = false;
+    bool unsynced = false;
+    bool flushNow = false;
+    bool syncNow = false;
+
+    while (true){
+
+        wakeSeq = __atomic_load_n(&logWakeSeq, __ATOMIC_ACQUIRE);
+
+        // Drain every message published so far
+        while (true){
+            log_slot_t *slot = &logRing[logDequeuePos & (LOG_RING_SLOTS - 1)];
+            if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != (logDequeuePos + 1)){
+                break;
             }
+            log_emit(slot);
+            if (slot->logLev >= logPolicy.flushLevel){
+                flushNow = true;
+                syncNow = true;
+            }
+            __atomic_store_n(&slot->seq, logDequeuePos + LOG_RING_SLOTS, __ATOMIC_RELEASE);
+            logDequeuePos++;
+            dirty = true;
+        }
+
+        dropped = __atomic_exchange_n(&logDropped, 0, __ATOMIC_ACQ_REL);
+        if (dropped != 0){
+            clock_gettime(CLOCK_REALTIME, &dropSlot.timestamp);
+            snprintf(dropSlot.msg, sizeof(dropSlot.msg), "LOGGER: %u messages dropped, log ring full", dropped);
+            log_emit(&dropSlot);
+            dirty = true;
+        }
+
+        nowMs = log_now_ms();
+        if (__atomic_load_n(&logFlushRequest, __ATOMIC_ACQUIRE) != 0){
+            flushNow = true;
+            syncNow = true;
+        }
+        if (dirty && ((nowMs - lastFlush) >= logPolicy.flushIntervalMs)){
+            flushNow = true;
+        }
+        if (unsynced && (logPolicy.fsyncIntervalMs != 0) && ((nowMs - lastSync) >= logPolicy.fsyncIntervalMs)){
+            syncNow = true;
+        }
+
+        if (flushNow || syncNow){
+            log_file_flush(syncNow);
+            lastFlush = nowMs;
+            unsynced = !syncNow;
+            if (syncNow){
+                lastSync = nowMs;
+            }
+            dirty = false;
+            flushNow = false;
+            syncNow = false;
+            __atomic_store_n(&logWrittenPos, logDequeuePos, __ATOMIC_RELEASE);
+        }
+
+        // Sleep until a new message arrives, or the next flush / sync is due if work is pending
+        timeout.tv_sec = logPolicy.flushIntervalMs / 1000;
+        timeout.tv_nsec = (long)(logPolicy.flushIntervalMs % 1000) * 1000000L;
+
+        __atomic_fetch_add(&logWaiters, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&logWakeSeq, __ATOMIC_SEQ_CST) == wakeSeq){
+            syscall(SYS_futex, &logWakeSeq, FUTEX_WAIT_PRIVATE, wakeSeq, (dirty || unsynced) ? &timeout : NULL, NULL, 0);
+        }
+        __atomic_fetch_sub(&logWaiters, 1, __ATOMIC_SEQ_CST);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Wakes the writer thread if it is sleeping
+ */
+static void log_wake_writer(void){
+
+    __atomic_fetch_add(&logWakeSeq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&logWaiters, __ATOMIC_SEQ_CST) != 0){
+        syscall(SYS_futex, &logWakeSeq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+/**
+ * @brief A forked child does not inherit the writer thread, it starts its own on first use
+ */
+static void log_after_fork(void){
+
+    logStarted = false;
+    logThreadRunning = false;
+    logFile = NULL;
+    logIndexOpen = false;
+    pthread_mutex_init(&logStartLock, NULL);
+    pthread_mutex_init(&logDirectLock, NULL);
+    pthread_mutex_init(&logIndexLock, NULL);
+}
+
+/**
+ * @brief Opens the log file and starts the writer thread, on the first message or 'log_file_init'
+ */
+static void log_start(void){
+
+    struct timespec now;
+
+    pthread_mutex_lock(&logStartLock);
+    if (!__atomic_load_n(&logStarted, __ATOMIC_ACQUIRE)){
+
+        for (uint32_t index = 0; index < LOG_RING_SLOTS; index++){
+            logRing[index].seq = index;
+        }
+        logEnqueuePos = 0;
+        logDequeuePos = 0;
+        logWrittenPos = 0;
+
+        if (LOG_TO_FILE && (logFile == NULL)){
+            clock_gettime(CLOCK_REALTIME, &now);
+            log_file_open(false, log_timespec_ns(&now));
         }
+
+        // Without a writer thread every message is written by the caller, as before
+        logThreadRunning = (pthread_create(&logThread, NULL, log_writer, NULL) == 0);
+        if (logThreadRunning){
+            pthread_detach(logThread);
+        }else{
+            printf("ERROR: UNABLE TO START LOG WRITER THREAD.\n");
+        }
+
+        pthread_atfork(NULL, NULL, log_after_fork);
+        atexit(log_flush);
+        __atomic_store_n(&logStarted, true, __ATOMIC_RELEASE);
     }
+    pthread_mutex_unlock(&logStartLock);
+}
 
-    fclose(filePtr);
+/**
+ * @brief Checks if messages of a level are being logged
+ *
+ * @param logLev The level indicating what type of log to record (Error, Info, Warning, Debug)
+ * @return True if the level is active
+ */
+static bool log_level_active(enum LOG_LEVEL logLev){
+
+    //Check if any Logging is Active
+    if(!(INFO_ACTIVE || DEBUG_ACTIVE || ERROR_ACTIVE ))
+        return false;
+    if (((logLev == LOG_ERROR) || (logLev == LOG_WARNING)) && !ERROR_ACTIVE)
+        return false;
+    if ((logLev == LOG_DEBUG) && !DEBUG_ACTIVE)
+        return false;
+    if ((logLev == LOG_INFO) && !INFO_ACTIVE)
+        return false;
+    return true;
 }
 
 /**
- * @brief Sets up the blank Log File
+ * @brief Claims the next free slot of the message ring. A slot is free when its sequence number
+ *        matches the claim position.
+ *
+ * @param pos Pointer to variable that will store the claim position, passed to 'log_slot_publish'
+ * @return Pointer to the claimed slot, NULL if the ring is full (the message is counted as dropped)
+ */
+static log_slot_t *log_slot_claim(uint32_t *pos){
+
+    log_slot_t *slot = NULL;
+    int32_t diff = 0;
+
+    *pos = __atomic_load_n(&logEnqueuePos, __ATOMIC_RELAXED);
+    while (true){
+        slot = &logRing[*pos & (LOG_RING_SLOTS - 1)];
+        diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - *pos);
+
+        if (diff == 0){
+            if (__atomic_compare_exchange_n(&logEnqueuePos, pos, *pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+                metric_inc(METRIC_LOG_MESSAGES);
+                return slot;
+            }
+        }else if (diff < 0){
+            __atomic_fetch_add(&logDropped, 1, __ATOMIC_RELAXED);
+            metric_inc(METRIC_LOG_DROPPED);
+            return NULL;
+        }else{
+            *pos = __atomic_load_n(&logEnqueuePos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * @brief Hands a filled slot to the writer thread
+ *
+ * @param slot Pointer to the claimed slot
+ * @param pos Claim position returned by 'log_slot_claim'
+ */
+static void log_slot_publish(log_slot_t *slot, uint32_t pos){
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    log_wake_writer();
+}
+
+/**
+ * @brief Writes a message directly from the caller, used when the writer thread could not be started
+ *
+ * @param slot Pointer to the message being written
+ */
+static void log_write_direct(const log_slot_t *slot){
+
+    pthread_mutex_lock(&logDirectLock);
+    log_emit(slot);
+    log_file_flush(slot->logLev >= logPolicy.flushLevel);
+    pthread_mutex_unlock(&logDirectLock);
+}
+
+/**
+ * @brief Timestamps a new message and claims a slot for it, starting the logger on first use
+ *
+ * @param direct Pointer to caller's slot, used if the writer thread is not running
+ * @param pos Pointer to variable that will store the claim position
+ * @return Pointer to the slot to fill, NULL if the ring is full (the message is counted as dropped)
+ */
+static log_slot_t *log_slot_begin(log_slot_t *direct, uint32_t *pos){
+
+    struct timespec timestamp;
+    log_slot_t *slot = direct;
+
+    //Grab Time stamp
+    clock_gettime(CLOCK_REALTIME, &timestamp);
+
+    if (!__atomic_load_n(&logStarted, __ATOMIC_ACQUIRE)){
+        log_start();
+    }
+
+    if (logThreadRunning){
+        slot = log_slot_claim(pos);
+        if (slot == NULL){
+            return NULL;
+        }
+    }
+    slot->timestamp = timestamp;
+    return slot;
+}
+
+/**
+ * @brief Hands a filled message to the writer thread, or writes it directly if the writer is not running
+ *
+ * @param slot Pointer to the slot returned by 'log_slot_begin'
+ * @param direct Pointer to caller's slot passed to 'log_slot_begin'
+ * @param pos Claim position returned by 'log_slot_begin'
+ */
+static void log_slot_end(log_slot_t *slot, const log_slot_t *direct, uint32_t pos){
+
+    if (slot == direct){
+        log_write_direct(slot);
+        return;
+    }
+    log_slot_publish(slot, pos);
+}
+
+/**
+ * @brief Write a message to the terminal and log file to record any information or events.
+ *        The message is copied into the log ring and written by the writer thread, the caller
+ *        never blocks on the file. If the ring is full the message is dropped and counted.
+ *
+ * @param logLev The level indicating what type of log to record (Error, Info, Warning, Debug)
+ * @param msg Pointer to character array containing message that will be logged
+ */
+void log_write(enum LOG_LEVEL logLev, const char *msg){
+
+    log_slot_t direct;
+    log_slot_t *slot = NULL;
+    uint32_t pos = 0;
+
+    if (!log_level_active(logLev)){
+        return;
+    }
+
+    slot = log_slot_begin(&direct, &pos);
+    if (slot == NULL){
+        return;
+    }
+
+    slot->logLev = logLev;
+    slot->msgId = LOGID_TEXT;
+    slot->numArgs = 0;
+    strncpy(slot->msg, msg, LOG_BUFFER_SIZE - 1);
+    slot->msg[LOG_BUFFER_SIZE - 1] = '\0';
+
+    log_slot_end(slot, &direct, pos);
+}
+
+/**
+ * @brief Formats a message straight into the log ring, use through the level macros (LOG_INFOF,
+ *        LOG_ERRORF...) so disabled levels are removed at compile time. Formatting is skipped
+ *        if the level is disabled at runtime.
+ *
+ * @param logLev The level indicating what type of log to record (Error, Info, Warning, Debug)
+ * @param format printf style format of the message
+ */
+void log_printf(enum LOG_LEVEL logLev, const char *format, ...){
+
+    log_slot_t direct;
+    log_slot_t *slot = NULL;
+    uint32_t pos = 0;
+    va_list args;
+
+    if (!log_level_active(logLev)){
+        return;
+    }
+
+    slot = log_slot_begin(&direct, &pos);
+    if (slot == NULL){
+        return;
+    }
+
+    slot->logLev = logLev;
+    slot->msgId = LOGID_TEXT;
+    slot->numArgs = 0;
+    va_start(args, format);
+    vsnprintf(slot->msg, LOG_BUFFER_SIZE, format, args);
+    va_end(args);
+
+    log_slot_end(slot, &direct, pos);
+}
+
+/**
+ * @brief Logs a catalog message (See 'log_catalog.h'). In binary mode only the message ID, the
+ *        timestamp and the raw argument values are stored, nothing is formatted on the caller or
+ *        the writer thread. Use through the LOG_RECORD macro.
+ *
+ * @param msgId Catalog message ID
+ * @param args Pointer to array of raw argument values
+ * @param numArgs Number of arguments in array, at most LOG_RECORD_MAX_ARGS are kept
+ */
+void log_record(enum LOG_MSG_ID msgId, const uint32_t *args, size_t numArgs){
+
+    log_slot_t direct;
+    log_slot_t *slot = NULL;
+    uint32_t pos = 0;
+
+    if ((msgId >= LOG_MSG_COUNT) || (msgId == LOGID_TEXT) || !log_level_active(logCatalog[msgId].logLev)){
+        return;
+    }
+    if (numArgs > LOG_RECORD_MAX_ARGS){
+        numArgs = LOG_RECORD_MAX_ARGS;
+    }
+
+    slot = log_slot_begin(&direct, &pos);
+    if (slot == NULL){
+        return;
+    }
+
+    slot->logLev = logCatalog[msgId].logLev;
+    slot->msgId = (uint16_t)msgId;
+    slot->numArgs = (uint8_t)numArgs;
+    memcpy(slot->args, args, numArgs * sizeof(uint32_t));
+
+    log_slot_end(slot, &direct, pos);
+}
+
+/**
+ * @brief Blocks until every message logged before the call has been written and synced to the
+ *        log file, or LOG_FLUSH_TIMEOUT_MS passes. Use before a reset or shutdown.
+ */
+void log_flush(void){
+
+    uint32_t target = __atomic_load_n(&logEnqueuePos, __ATOMIC_ACQUIRE);
+    uint64_t start = log_now_ms();
+    struct timespec pause = {0, 1000000L};
+
+    if (!__atomic_load_n(&logStarted, __ATOMIC_ACQUIRE) || !logThreadRunning){
+        log_file_flush(true);
+        return;
+    }
+
+    __atomic_fetch_add(&logFlushRequest, 1, __ATOMIC_RELEASE);
+    log_wake_writer();
+    while (((int32_t)(__atomic_load_n(&logWrittenPos, __ATOMIC_ACQUIRE) - target) < 0) &&
+           ((log_now_ms() - start) < LOG_FLUSH_TIMEOUT_MS)){
+        nanosleep(&pause, NULL);
+    }
+    __atomic_fetch_sub(&logFlushRequest, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Changes when the writer thread flushes and syncs the log file
+ *
+ * @param policy Pointer to structure containing the new flush / sync policy
+ */
+void log_set_policy(const log_policy_t *policy){
+
+    logPolicy = *policy;
+    if (logPolicy.flushIntervalMs == 0){
+        logPolicy.flushIntervalMs = 1;
+    }
+    log_wake_writer();
+}
+
+/**
+ * @brief Sets the base name of this process's log segments. Must be called before the first
+ *        message is logged, so two services never write into the same segment.
+ *
+ * @param baseName Base name of the log (LOG_BASENAME or LOG_SPI_BASENAME)
+ */
+void log_set_basename(const char *baseName){
+
+    pthread_mutex_lock(&logIndexLock);
+    strncpy(logBaseName, baseName, LOG_BASENAME_LEN - 1);
+    logBaseName[LOG_BASENAME_LEN - 1] = '\0';
+    pthread_mutex_unlock(&logIndexLock);
+}
+
+/**
+ * @brief Finds the log segments holding messages logged between two times, using the index only.
+ *        Segments are returned oldest first, the newest may still be written to.
+ *
+ * @param startNs Realtime start of the range in nano-seconds, 0 for no lower bound
+ * @param endNs Realtime end of the range in nano-seconds, UINT64_MAX for no upper bound
+ * @param segments Pointer to array that will store the matching segments
+ * @param maxSegments Size of segments array
+ * @return Number of segments stored in 'segments'
+ */
+int log_segment_find(uint64_t startNs, uint64_t endNs, log_segment_t *segments, int maxSegments){
+
+    int numFound = 0;
+
+    pthread_mutex_lock(&logIndexLock);
+    if (!logIndexOpen){
+        log_index_open(&logIndex, logBaseName);
+        logIndexOpen = true;
+    }
+    numFound = log_index_find(&logIndex, startNs, endNs, segments, maxSegments);
+    pthread_mutex_unlock(&logIndexLock);
+    return numFound;
+}
+
+/**
+ * @brief Starts a new Log Segment and starts the writer thread. Previous segments are kept until
+ *        the total size cap is reached. Must be called before any other thread starts logging.
  */
 void log_file_init(void){
 
-    char filepath[LOG_FILE_PATH_LEN];
-    snprintf(filepath, sizeof(filepath), "%s/%s", LOG_DIRECTORY, LOG_FILENAME);
-    FILE *file = fopen(filepath, "w"); // Open file for writing (creates if it doesn't exist)
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    pthread_mutex_lock(&logDirectLock);
+    log_file_open(true, log_timespec_ns(&now));
+    pthread_mutex_unlock(&logDirectLock);
 
-    if (file == NULL) {
+    if (logFile == NULL) {
         printf("ERROR: Unable to create the Log File.\n");
-        return;
     }
 
-    fclose(file);
-}
\ No newline at end of file
+    if (!__atomic_load_n(&logStarted, __ATOMIC_ACQUIRE)){
+        log_start();
+    }
+}
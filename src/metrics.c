@@ -0,0 +1,113 @@
+/**
+ * @file metrics.c
+ * @author agent
+ * @brief Metrics Registry for Theia CM4
+ *        Provides functions to...
+ *         - Map the shared memory metrics segment used by the SPI and Main services
+ *         - Record latencies into fixed bucket histograms without locks
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "error_handler.h"
+#include "logger.h"
+#include "metrics.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+metrics_region_t *metricsRegion = NULL;
+
+
+/**
+ * @brief Maps the metrics segment, creating it if this is the first service to start. Metrics
+ *        updated before this (or after it fails) are not recorded.
+ *
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR metrics_init(void){
+
+    int fileDesc = 0;
+    uint32_t expected = 0;
+    metrics_region_t *region = NULL;
+    void *mapping = NULL;
+
+    if (metricsRegion != NULL){
+        return NO_ERROR;
+    }
+
+    fileDesc = shm_open(METRICS_SHM_NAME, O_CREAT | O_RDWR, 0660);
+    if (fileDesc < 0){
+        LOG_ERRORF("METRICS: Unable to open shared memory %s", METRICS_SHM_NAME);
+        return METRICS_ERROR;
+    }
+
+    // New shared memory is zero filled, which is every metric at 0
+    if (ftruncate(fileDesc, sizeof(metrics_region_t)) != 0){
+        LOG_ERRORF("METRICS: Unable to size shared memory segment");
+        close(fileDesc);
+        return METRICS_ERROR;
+    }
+
+    mapping = mmap(NULL, sizeof(metrics_region_t), PROT_READ | PROT_WRITE, MAP_SHARED, fileDesc, 0);
+    close(fileDesc);
+    if (mapping == MAP_FAILED){
+        LOG_ERRORF("METRICS: Unable to map shared memory segment");
+        return METRICS_ERROR;
+    }
+    region = mapping;
+
+    // The layout description is written before the magic so a reader never sees a stamped segment without it
+    if (__atomic_load_n(&region->magic, __ATOMIC_ACQUIRE) == 0){
+        __atomic_store_n(&region->numMetrics, METRIC_NUM, __ATOMIC_RELAXED);
+        __atomic_store_n(&region->numHists, METRIC_HIST_NUM, __ATOMIC_RELAXED);
+        __atomic_store_n(&region->createdRealtimeS, (uint64_t)time(NULL), __ATOMIC_RELAXED);
+    }
+
+    // First service to map the segment stamps it, a segment left by a different build is rejected
+    if (!__atomic_compare_exchange_n(&region->magic, &expected, METRICS_MAGIC, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) &&
+        (expected != METRICS_MAGIC)){
+        LOG_ERRORF("METRICS: Shared memory layout mismatch (0x%08X), remove /dev/shm%s", expected, METRICS_SHM_NAME);
+        munmap(mapping, sizeof(metrics_region_t));
+        return METRICS_ERROR;
+    }
+
+    metricsRegion = region;
+    LOG_INFOF("METRICS: Shared memory segment mapped");
+    return NO_ERROR;
+}
+
+/**
+ * @brief Records a duration into a latency histogram
+ *
+ * @param id METRIC_HIST_ID of the histogram
+ * @param elapsedNs Duration in nano-seconds
+ */
+void metric_observe_ns(enum METRIC_HIST_ID id, uint64_t elapsedNs){
+
+    metrics_hist_t *hist = NULL;
+    uint64_t us = elapsedNs / 1000ULL;
+    uint64_t maxUs = 0;
+
+    if (metricsRegion == NULL){
+        return;
+    }
+    hist = &metricsRegion->hists[id];
+
+    __atomic_fetch_add(&hist->buckets[metrics_hist_bucket(us)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sumUs, us, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+
+    maxUs = __atomic_load_n(&hist->maxUs, __ATOMIC_RELAXED);
+    while ((us > maxUs) &&
+           !__atomic_compare_exchange_n(&hist->maxUs, &maxUs, us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+    }
+}
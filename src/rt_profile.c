@@ -0,0 +1,175 @@
+/**
+ * @file rt_profile.c
+ * @author agent
+ * @brief Real-Time Profile for Theia CM4
+ *        Provides functions to...
+ *         - Read the real-time profile of the SPI servicing thread from the environment
+ *         - Pin the thread to a core and run it on SCHED_FIFO
+ *         - Lock the service in memory and prefault the stack and heap it runs on
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include "error_handler.h"
+#include "logger.h"
+#include "rt_profile.h"
+
+#include <alloca.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define RT_PROFILE_HEAP_CHUNK   (64 * 1024)     // Below the malloc mmap threshold, so the chunks stay in the heap once freed
+
+
+/**
+ * @brief Reads an integer setting from the environment
+ *
+ * @param name Environment variable
+ * @param defaultValue Value used if the variable is not set or is invalid
+ * @param minValue Smallest valid value
+ * @param maxValue Largest valid value
+ * @return Setting
+ */
+static long rt_profile_env(const char *name, long defaultValue, long minValue, long maxValue){
+
+    const char *value = getenv(name);
+    char *end = NULL;
+    long parsed = 0;
+
+    if ((value == NULL) || (value[0] == '\0')){
+        return defaultValue;
+    }
+    errno = 0;
+    parsed = strtol(value, &end, 10);
+    if ((errno != 0) || (*end != '\0') || (parsed < minValue) || (parsed > maxValue)){
+        LOG_WARNINGF("RT-PROFILE: Ignoring %s=%s, expected %ld to %ld", name, value, minValue, maxValue);
+        return defaultValue;
+    }
+    return parsed;
+}
+
+/**
+ * @brief Reads the real-time profile from the environment (See 'rt_profile.h')
+ *
+ * @param profile Pointer to profile that will store the settings
+ */
+void rt_profile_load(rt_profile_t *profile){
+
+    profile->priority = (int)rt_profile_env(RT_PROFILE_ENV_PRIORITY, RT_PROFILE_DEF_PRIORITY, 0, sched_get_priority_max(SCHED_FIFO));
+    profile->cpu = (int)rt_profile_env(RT_PROFILE_ENV_CPU, RT_PROFILE_DEF_CPU, -1, CPU_SETSIZE - 1);
+    profile->mlock = (rt_profile_env(RT_PROFILE_ENV_MLOCK, RT_PROFILE_DEF_MLOCK, 0, 1) != 0);
+    profile->prefaultKb = (uint32_t)rt_profile_env(RT_PROFILE_ENV_PREFAULT_KB, RT_PROFILE_DEF_PREFAULT_KB, 0, RT_PROFILE_MAX_PREFAULT_KB);
+}
+
+/**
+ * @brief Touches every page of 'prefaultKb' of stack below the caller, so the deepest call the
+ *        loop makes does not fault the stack in
+ *
+ * @param prefaultKb Stack to touch in KB
+ */
+static __attribute__((noinline)) void rt_profile_prefault_stack(uint32_t prefaultKb){
+
+    size_t bytes = (size_t)prefaultKb * 1024;
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    volatile uint8_t *stack = alloca(bytes);
+
+    for (size_t offset = 0; offset < bytes; offset += pageSize){
+        stack[offset] = 0;
+    }
+}
+
+/**
+ * @brief Grows the heap by 'prefaultKb' and keeps it when freed, so buffers allocated by the loop
+ *        (e.g. on SPI re-initialization) come from pages that are already resident
+ *
+ * @param prefaultKb Heap to touch in KB
+ * @return True if the heap was grown
+ */
+static bool rt_profile_prefault_heap(uint32_t prefaultKb){
+
+    uint8_t *chunks[(RT_PROFILE_MAX_PREFAULT_KB * 1024) / RT_PROFILE_HEAP_CHUNK];
+    uint32_t numChunks = (prefaultKb * 1024) / RT_PROFILE_HEAP_CHUNK;
+    uint32_t numAllocated = 0;
+
+    // Freed memory would otherwise be returned to the kernel and faulted in again on the next allocation
+    mallopt(M_TRIM_THRESHOLD, -1);
+
+    for (; numAllocated < numChunks; numAllocated++){
+        chunks[numAllocated] = malloc(RT_PROFILE_HEAP_CHUNK);
+        if (chunks[numAllocated] == NULL){
+            break;
+        }
+        memset(chunks[numAllocated], 0, RT_PROFILE_HEAP_CHUNK);
+    }
+    for (uint32_t index = 0; index < numAllocated; index++){
+        free(chunks[index]);
+    }
+    return (numAllocated == numChunks);
+}
+
+/**
+ * @brief Applies the real-time profile to the calling thread. Call it from the thread servicing the
+ *        SPI bus after the bus and the other threads are set up, threads it creates afterwards
+ *        inherit the core and priority. Forked processes (Linux CLI commands) are reset to SCHED_OTHER.
+ *
+ * @param profile Pointer to profile (See 'rt_profile_load')
+ * @return Iris error code indicating the success or failure of function, every step is attempted
+ */
+enum IRIS_ERROR rt_profile_apply(const rt_profile_t *profile){
+
+    enum IRIS_ERROR error = NO_ERROR;
+    struct sched_param param;
+    cpu_set_t cpuSet;
+    int result = 0;
+
+    if (profile->cpu >= 0){
+        CPU_ZERO(&cpuSet);
+        CPU_SET(profile->cpu, &cpuSet);
+        result = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+        if (result != 0){
+            LOG_ERRORF("RT-PROFILE: Unable to pin thread to CPU %d (%s)", profile->cpu, strerror(result));
+            error = RT_PROFILE_ERROR;
+        }
+    }
+
+    // Pages mapped later (IPC rings, bulk transfer files) are locked as they are mapped
+    if (profile->mlock && (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)){
+        LOG_ERRORF("RT-PROFILE: Unable to lock memory (%s)", strerror(errno));
+        error = RT_PROFILE_ERROR;
+    }
+
+    if (profile->prefaultKb != 0){
+        rt_profile_prefault_stack(profile->prefaultKb);
+        if (!rt_profile_prefault_heap(profile->prefaultKb)){
+            LOG_ERRORF("RT-PROFILE: Unable to prefault %u KB of heap", profile->prefaultKb);
+            error = RT_PROFILE_ERROR;
+        }
+    }
+
+    if (profile->priority > 0){
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = profile->priority;
+        if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) != 0){
+            LOG_ERRORF("RT-PROFILE: Unable to set SCHED_FIFO priority %d (%s)", profile->priority, strerror(errno));
+            error = RT_PROFILE_ERROR;
+        }
+    }
+
+    LOG_INFOF("RT-PROFILE: Priority %d, CPU %d, mlock %d, %u KB prefaulted%s", profile->priority, profile->cpu,
+              profile->mlock, profile->prefaultKb, (error != NO_ERROR) ? " (incomplete)" : "");
+    return error;
+}
@@ -0,0 +1,313 @@
+/**
+ * @file sensor_cache.c
+ * @author agent
+ * @brief Sensor Snapshot Cache for Theia CM4
+ *        Provides functions to...
+ *         - Store timestamped snapshots of every current / temperature sensor channel
+ *         - Fill the cache from the background sampler during housekeeping
+ *         - Serve OBC telemetry commands from memory using a per-command freshness policy
+ *         - Fall back to a live I2C read when the snapshot is stale or a live read is forced
+ *         - Keep a history of valid readings per channel for packed telemetry downlink
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "cmd_controller.h"
+#include "current_sensor.h"
+#include "error_handler.h"
+#include "i2c.h"
+#include "sensor_cache.h"
+#include "temp_read.h"
+#include "timing.h"
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+static sensor_snapshot_t sensorCache[SENSOR_CACHE_NUM_CHANNELS];
+static pthread_mutex_t sensorCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+// History rings, 'sensorHistoryHead' is the next slot written (Protected by 'sensorCacheLock')
+static uint64_t sensorHistoryMs[SENSOR_CACHE_NUM_CHANNELS][SENSOR_HISTORY_LEN];
+static int32_t sensorHistoryValue[SENSOR_CACHE_NUM_CHANNELS][SENSOR_HISTORY_LEN];
+static uint16_t sensorHistoryHead[SENSOR_CACHE_NUM_CHANNELS];
+static uint16_t sensorHistoryCount[SENSOR_CACHE_NUM_CHANNELS];
+
+
+/**
+ * @brief Converts a sensor I2C address and measurement type into a cache channel
+ *
+ * @param kind Type of measurement (Current, Voltage, Power, Peak Power or Temperature)
+ * @param addr I2C Address of the Current or Temperature sensor
+ * @return Cache channel index, SENSOR_CHANNEL_INVALID if the address does not match the kind
+ */
+uint8_t sensor_channel(enum SENSOR_KIND kind, uint8_t addr){
+
+    if (kind == SENSOR_TEMP){
+        switch (addr){
+            case TEMP_SENSOR_1_ADDR:
+                return SENSOR_TEMP_CHANNEL_START;
+            case TEMP_SENSOR_2_ADDR:
+                return SENSOR_TEMP_CHANNEL_START + 1;
+            case TEMP_SENSOR_3_ADDR:
+                return SENSOR_TEMP_CHANNEL_START + 2;
+            case TEMP_SENSOR_4_ADDR:
+                return SENSOR_TEMP_CHANNEL_START + 3;
+            default:
+                return SENSOR_CHANNEL_INVALID;
+        }
+    }
+
+    switch (addr){
+        case CURRENT_SENSOR_ADDR_3V3:
+            return (kind * SENSOR_NUM_RAILS);
+        case CURRENT_SENSOR_ADDR_5V:
+            return (kind * SENSOR_NUM_RAILS) + 1;
+        case CURRENT_SENSOR_ADDR_CAM:
+            return (kind * SENSOR_NUM_RAILS) + 2;
+        default:
+            return SENSOR_CHANNEL_INVALID;
+    }
+}
+
+/**
+ * @brief Freshness policy, returns how old a cached reading may be for the given command
+ *
+ * @param cmd OBC command being serviced
+ * @return Max age of cached reading in milli-seconds, 0 requires a live read
+ */
+uint32_t sensor_cache_max_age_ms(uint8_t cmd){
+
+    switch (cmd){
+        case CURR_SENSOR_READ_CURRENT:
+            return CACHE_MAX_AGE_CURRENT_MS;
+        case CURR_SENSOR_READ_VOLTAGE:
+            return CACHE_MAX_AGE_VOLTAGE_MS;
+        case CURR_SENSOR_READ_POWER:
+            return CACHE_MAX_AGE_POWER_MS;
+        case CURR_SENSOR_READ_PK_POWER:
+            return CACHE_MAX_AGE_PK_POWER_MS;
+        case TEMP_SENSOR_READ:
+            return CACHE_MAX_AGE_TEMP_MS;
+        default:
+            return CACHE_MAX_AGE_LIVE_MS;
+    }
+}
+
+/**
+ * @brief Stores a new reading for a channel, timestamped with the current monotonic time
+ *
+ * @param channel Cache channel index
+ * @param value Value returned by the sensor driver
+ * @param error Error code of the read, NO_ERROR if 'value' is valid
+ */
+void sensor_cache_update(uint8_t channel, uint16_t value, enum IRIS_ERROR error){
+
+    uint64_t nowMs = get_time_monotonic_ms();
+    uint16_t head = 0;
+
+    if (channel >= SENSOR_CACHE_NUM_CHANNELS){
+        return;
+    }
+
+    pthread_mutex_lock(&sensorCacheLock);
+    sensorCache[channel].value = value;
+    sensorCache[channel].error = error;
+    sensorCache[channel].timestampMs = nowMs;
+
+    // Failed reads hold the driver's error value, only real measurements go into the history
+    if (error == NO_ERROR){
+        head = sensorHistoryHead[channel];
+        sensorHistoryMs[channel][head] = nowMs;
+        sensorHistoryValue[channel][head] = (channel >= SENSOR_TEMP_CHANNEL_START) ? (int8_t)value : value;
+        sensorHistoryHead[channel] = (head + 1) % SENSOR_HISTORY_LEN;
+        if (sensorHistoryCount[channel] < SENSOR_HISTORY_LEN){
+            sensorHistoryCount[channel]++;
+        }
+    }
+    pthread_mutex_unlock(&sensorCacheLock);
+}
+
+/**
+ * @brief Copies out the current snapshot of a channel
+ *
+ * @param channel Cache channel index
+ * @param snapshot Pointer to structure that will store the snapshot
+ */
+void sensor_cache_snapshot(uint8_t channel, sensor_snapshot_t *snapshot){
+
+    if (channel >= SENSOR_CACHE_NUM_CHANNELS){
+        snapshot->value = 0;
+        snapshot->error = CMD_FORMAT_ERROR;
+        snapshot->timestampMs = 0;
+        return;
+    }
+
+    pthread_mutex_lock(&sensorCacheLock);
+    *snapshot = sensorCache[channel];
+    pthread_mutex_unlock(&sensorCacheLock);
+}
+
+/**
+ * @brief Copies out the history of a channel, oldest reading first
+ *
+ * @param channel Cache channel index
+ * @param timestampMs Pointer to array that will store the monotonic time of each reading
+ * @param value Pointer to array that will store each reading (Temperatures are signed)
+ * @param maxSamples Number of entries available in 'timestampMs' and 'value'
+ * @return Number of readings copied, the newest 'maxSamples' if the history holds more
+ */
+uint16_t sensor_cache_history(uint8_t channel, uint64_t *timestampMs, int32_t *value, uint16_t maxSamples){
+
+    uint16_t numSamples = 0;
+    uint16_t slot = 0;
+
+    if (channel >= SENSOR_CACHE_NUM_CHANNELS){
+        return 0;
+    }
+
+    pthread_mutex_lock(&sensorCacheLock);
+    numSamples = (sensorHistoryCount[channel] < maxSamples) ? sensorHistoryCount[channel] : maxSamples;
+    slot = (sensorHistoryHead[channel] + SENSOR_HISTORY_LEN - numSamples) % SENSOR_HISTORY_LEN;
+    for (uint16_t index = 0; index < numSamples; index++){
+        timestampMs[index] = sensorHistoryMs[channel][slot];
+        value[index] = sensorHistoryValue[channel][slot];
+        slot = (slot + 1) % SENSOR_HISTORY_LEN;
+    }
+    pthread_mutex_unlock(&sensorCacheLock);
+
+    return numSamples;
+}
+
+/**
+ * @brief Drops the readings of every channel up to a cut-off, newer readings and the snapshots are kept
+ *
+ * @param untilMs Pointer to array of SENSOR_CACHE_NUM_CHANNELS monotonic times, readings taken at or
+ *                before a channel's time are dropped (0 keeps the channel)
+ */
+void sensor_cache_history_drop(const uint64_t *untilMs){
+
+    uint16_t oldest = 0;
+
+    pthread_mutex_lock(&sensorCacheLock);
+    for (uint8_t channel = 0; channel < SENSOR_CACHE_NUM_CHANNELS; channel++){
+        while (sensorHistoryCount[channel] != 0){
+            oldest = (sensorHistoryHead[channel] + SENSOR_HISTORY_LEN - sensorHistoryCount[channel]) % SENSOR_HISTORY_LEN;
+            if (sensorHistoryMs[channel][oldest] > untilMs[channel]){
+                break;
+            }
+            sensorHistoryCount[channel]--;
+        }
+    }
+    pthread_mutex_unlock(&sensorCacheLock);
+}
+
+/**
+ * @brief Reads a channel directly from its sensor over I2C and stores the result in the cache
+ *
+ * @param channel Cache channel index
+ * @param value Pointer to variable that will store the value read
+ * @return Iris error code indicating the success or failure of the read
+ */
+enum IRIS_ERROR sensor_cache_live_read(uint8_t channel, uint16_t *value){
+
+    uint8_t currAddr[SENSOR_NUM_RAILS] = {CURRENT_SENSOR_ADDR_3V3, CURRENT_SENSOR_ADDR_5V, CURRENT_SENSOR_ADDR_CAM};
+    uint8_t tempAddr[SENSOR_NUM_TEMPS] = {TEMP_SENSOR_1_ADDR, TEMP_SENSOR_2_ADDR, TEMP_SENSOR_3_ADDR, TEMP_SENSOR_4_ADDR};
+    enum IRIS_ERROR error = NO_ERROR;
+    uint16_t dataBuf = 0;
+    uint8_t tempBuf = 0;
+
+    if (channel >= SENSOR_CACHE_NUM_CHANNELS){
+        return CMD_FORMAT_ERROR;
+    }
+
+    i2c_bus_lock();
+    if (channel >= SENSOR_TEMP_CHANNEL_START){
+
+        tempBuf = (uint8_t)read_temperature(tempAddr[channel - SENSOR_TEMP_CHANNEL_START]);
+        if ((tempBuf == TEMP1_TEMP_READ_ERROR) ||
+            (tempBuf == TEMP2_TEMP_READ_ERROR) ||
+            (tempBuf == TEMP3_TEMP_READ_ERROR) ||
+            (tempBuf == TEMP4_TEMP_READ_ERROR)){
+            error = tempBuf;
+        }
+        dataBuf = tempBuf;
+
+    }else{
+
+        switch (channel / SENSOR_NUM_RAILS){
+            case SENSOR_CURRENT:
+                dataBuf = read_current(currAddr[channel % SENSOR_NUM_RAILS]);
+                break;
+            case SENSOR_VOLTAGE:
+                dataBuf = read_bus_voltage(currAddr[channel % SENSOR_NUM_RAILS]);
+                break;
+            case SENSOR_POWER:
+                dataBuf = read_power(currAddr[channel % SENSOR_NUM_RAILS]);
+                break;
+            default:
+                dataBuf = read_pk_power(currAddr[channel % SENSOR_NUM_RAILS]);
+                break;
+        }
+        if ((dataBuf == CURR1_VAL_READ_ERROR_16BIT) ||
+            (dataBuf == CURR2_VAL_READ_ERROR_16BIT) ||
+            (dataBuf == CURR3_VAL_READ_ERROR_16BIT)){
+            error = dataBuf;
+        }
+    }
+    i2c_bus_unlock();
+
+    sensor_cache_update(channel, dataBuf, error);
+    *value = dataBuf;
+    return error;
+}
+
+/**
+ * @brief Reads a channel from the cache if the snapshot is fresh enough, otherwise completes a live read
+ *
+ * @param channel Cache channel index
+ * @param maxAgeMs Max age of the cached reading in milli-seconds (See 'sensor_cache_max_age_ms')
+ * @param forceLive True if the OBC requested a live read regardless of the snapshot age
+ * @param value Pointer to variable that will store the value read
+ * @return Iris error code of the reading that was returned
+ */
+enum IRIS_ERROR sensor_cache_read(uint8_t channel, uint32_t maxAgeMs, bool forceLive, uint16_t *value){
+
+    sensor_snapshot_t snapshot;
+
+    if (channel >= SENSOR_CACHE_NUM_CHANNELS){
+        return CMD_FORMAT_ERROR;
+    }
+
+    if (!forceLive && (maxAgeMs != CACHE_MAX_AGE_LIVE_MS)){
+        sensor_cache_snapshot(channel, &snapshot);
+        if ((snapshot.timestampMs != 0) && ((get_time_monotonic_ms() - snapshot.timestampMs) <= maxAgeMs)){
+            *value = snapshot.value;
+            return snapshot.error;
+        }
+    }
+
+    return sensor_cache_live_read(channel, value);
+}
+
+/**
+ * @brief Background sampler, completes a live read of every channel to refresh the cache.
+ *        Called once per housekeeping sweep, the housekeeping limit checks use these readings.
+ *        The bus is held for the whole sweep so every channel is read in one consistent pass.
+ */
+void sensor_sampler_sweep(void){
+
+    uint16_t value = 0;
+    TRACE_SCOPE("sensor_sweep");
+
+    i2c_bus_lock();
+    for (uint8_t channel = 0; channel < SENSOR_CACHE_NUM_CHANNELS; channel++){
+        sensor_cache_live_read(channel, &value);
+    }
+    i2c_bus_unlock();
+}
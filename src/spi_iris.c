@@ -7,7 +7,9 @@
  *         - Configure a SPI Interface on the CM4
  *         - Configure CS to detect any event on the GPIO line
  *         - Write a file to SPI Peripherals
+ *         - Stream a file descriptor passed by the Main service to SPI Peripherals
  *         - Test functionality of the SPI Interface
+ *         - Recover the SPI Interface after failed transfers
  *         - Write 8-bit data packets to SPI Peripherals
  *         - Read 8-bit data packets from SPI Peripherals
  * 
@@ -23,11 +25,16 @@
 #include "error_handler.h"
 #include "gpio.h"
 #include "file_operations.h"
+#include "flight_recorder.h"
 #include "logger.h"
 #include "main.h"
+#include "metrics.h"
 #include "spi_iris.h"
+#include "spi_train.h"
 #include "timing.h"
+#include "trace.h"
 
+#include <errno.h>
 #include <fcntl.h>
 #include <gpiod.h>
 #include <linux/spi/spidev.h>
@@ -37,53 +44,91 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 #include <stdint.h>
 
 
+// Clock rate the interface is configured with, trained by 'spi_train'
+static uint32_t spiSpeedHz = SPI_SPEED;
+
+// Transfer failures since the window started, escalates recovery when a reconfigure does not hold
+static int spiLastErrno = 0;
+static uint64_t spiRecoverWindowMs = 0;
+static uint8_t spiNumReconfigures = 0;
+
+
 /**
- * @brief Configures the selected SPI Interface to communicate with SPI Peripherals
+ * @brief Applies the SPI settings to an open SPI Interface and reads them back
  * 
- * @param device Pointer to character array selecting SPI bus
+ * @param fileDesc Open SPI bus instance
  * @param config 'spi_config_t' structure containing configuration information for the interface
- * @return Either ID of SPI bus instance or Error Code if unsuccessful
+ * @return Iris error code indicating the success or failure of function
  */
-int spi_open(const char *device, spi_config_t config) {
+enum IRIS_ERROR spi_configure(int fileDesc, spi_config_t config) {
 
-    int fileDesc = 0;
-    fileDesc = open(device, O_RDWR);
-    if (fileDesc < 0) {
-        return SPI_SETUP_ERROR;
-    }
+    uint8_t mode = 0;
+    uint8_t bitsPerWord = 0;
+    uint32_t speed = 0;
 
     // Set SPI_POL and SPI_PHA
     if (ioctl(fileDesc, SPI_IOC_WR_MODE, &config.mode) < 0) {
-        log_write(LOG_ERROR, "SPI Bus - Failed to Set WR IOC");
+        LOG_ERRORF("SPI Bus - Failed to Set WR IOC");
         return SPI_SETUP_ERROR;
     }
-    if (ioctl(fileDesc, SPI_IOC_RD_MODE, &config.mode) < 0) {
-        log_write(LOG_ERROR, "SPI Bus - Failed to Set RD IOC");
+    if (ioctl(fileDesc, SPI_IOC_RD_MODE, &mode) < 0) {
+        LOG_ERRORF("SPI Bus - Failed to Set RD IOC");
         return SPI_SETUP_ERROR;
     }
 
     // Set bits per word
     if (ioctl(fileDesc, SPI_IOC_WR_BITS_PER_WORD, &config.bits_per_word) < 0) {
-        log_write(LOG_ERROR, "SPI Bus - Failed to Set WR Bits-per-Word");
+        LOG_ERRORF("SPI Bus - Failed to Set WR Bits-per-Word");
         return SPI_SETUP_ERROR;
     }
-    if (ioctl(fileDesc, SPI_IOC_RD_BITS_PER_WORD, &config.bits_per_word) < 0) {
-        log_write(LOG_ERROR, "SPI Bus - Failed to Set RD Bits-per-Word");
+    if (ioctl(fileDesc, SPI_IOC_RD_BITS_PER_WORD, &bitsPerWord) < 0) {
+        LOG_ERRORF("SPI Bus - Failed to Set RD Bits-per-Word");
         return SPI_SETUP_ERROR;
     }
 
     // Set SPI speed
     if (ioctl(fileDesc, SPI_IOC_WR_MAX_SPEED_HZ, &config.speed) < 0) {
-        log_write(LOG_ERROR, "SPI Bus - Failed to Set WR Speed");
+        LOG_ERRORF("SPI Bus - Failed to Set WR Speed");
+        return SPI_SETUP_ERROR;
+    }
+    if (ioctl(fileDesc, SPI_IOC_RD_MAX_SPEED_HZ, &speed) < 0) {
+        LOG_ERRORF("SPI Bus - Failed to Set RD Speed");
+        return SPI_SETUP_ERROR;
+    }
+
+    // RD ioctls return what the driver holds, which must be what was just written
+    if ((mode != config.mode) || (bitsPerWord != config.bits_per_word) || (speed != config.speed)) {
+        LOG_ERRORF("SPI Bus - Settings did not apply (mode %u, %u bits, %u Hz)", mode, bitsPerWord, speed);
+        return SPI_SETUP_ERROR;
+    }
+    metric_set(METRIC_SPI_CLOCK_HZ, speed);
+    return NO_ERROR;
+}
+
+/**
+ * @brief Configures the selected SPI Interface to communicate with SPI Peripherals
+ * 
+ * @param device Pointer to character array selecting SPI bus
+ * @param config 'spi_config_t' structure containing configuration information for the interface
+ * @return Either ID of SPI bus instance or Error Code if unsuccessful
+ */
+int spi_open(const char *device, spi_config_t config) {
+
+    int fileDesc = 0;
+    fileDesc = open(device, O_RDWR);
+    if (fileDesc < 0) {
         return SPI_SETUP_ERROR;
     }
-    if (ioctl(fileDesc, SPI_IOC_RD_MAX_SPEED_HZ, &config.speed) < 0) {
-        log_write(LOG_ERROR, "SPI Bus - Failed to Set RD Speed");
+
+    if (spi_configure(fileDesc, config) != NO_ERROR) {
+        close(fileDesc);
         return SPI_SETUP_ERROR;
     }
 
@@ -107,7 +152,10 @@ enum IRIS_ERROR spi_init(int *spi_dev, struct gpiod_line_request **spi_cs_reques
     int errorCheck = NO_ERROR;
     int loopCounter = 0;
 
-    log_write(LOG_INFO, "SPI-INIT: Start setup of SPI interface with OBC");
+    LOG_INFOF("SPI-INIT: Start setup of SPI interface with OBC");
+
+    // Clock rate from the last link training
+    spi_train_load();
     
     //! SHOULD I SPLIT EACH ATTEMPT UP INTO SEPARATE LOOPS
     do{
@@ -133,26 +181,69 @@ enum IRIS_ERROR spi_init(int *spi_dev, struct gpiod_line_request **spi_cs_reques
         errorCheck = NO_ERROR;
     }while((errorCheck == SPI_SETUP_ERROR) && (loopCounter < MAX_SPI_INIT_ATTEMPTS));
     
-    loopCounter = 0;
-    // if(errorCheck == NO_ERROR){
-    //     do{
-    //         errorCheck = spi_bus_test(*spi_dev, *spi_cs_request, *event_buffer);
-    //         loopCounter++;
-    //     }while((errorCheck == SPI_TEST_ERROR) && (loopCounter < MAX_SPI_INIT_ATTEMPTS));
-
-    //     if(errorCheck != NO_ERROR){
-    //         spi_close(*spi_dev);
-    //         gpiod_edge_event_buffer_free(*event_buffer);
-    //         gpiod_line_request_release(*spi_cs_request);
-    //     }
-    // }
-
-    log_write(LOG_INFO, "SPI-INIT: Finished setup attempt of SPI interface with OBC");
+    LOG_INFOF("SPI-INIT: Finished setup attempt of SPI interface with OBC");
 
     return errorCheck;
 }
 
 
+/**
+ * @brief Checks if a transfer failed because the device is gone, which neither a retry nor a
+ *        reconfigure of the open fd can fix
+ * 
+ * @param error errno of the failed transfer, 0 for a short count
+ * @return True if only a rebuild can recover
+ */
+static bool spi_errno_fatal(int error){
+    return (error == EBADF) || (error == ENODEV) || (error == ENXIO) || (error == ESHUTDOWN);
+}
+
+/**
+ * @brief Checks if a transfer failed before spidev submitted it, so nothing was clocked out and the
+ *        same transfer can be issued again without the OBC seeing part of it twice
+ *
+ * @param error errno of the failed transfer, 0 for a short count
+ * @return True if the transfer can be retried on the spot
+ */
+static bool spi_errno_retryable(int error){
+    return (error == EAGAIN) || (error == EWOULDBLOCK) || (error == EINTR);
+}
+
+/**
+ * @brief Runs one SPI transfer, retrying it on the spot if it was never submitted (Recovery Tier 1).
+ *        Any other failure, including a short count, may have clocked part of the data out and is
+ *        returned at once so 'spi_recover' escalates to Tier 2.
+ * 
+ * @param fileDesc Configured SPI bus instance
+ * @param spi_msg Pointer to transfer
+ * @param cs_request Pointer to structure that contains the CS instance
+ * @param numRetries Pointer to variable that will store the number of retries used
+ * @return Return value of the last attempt's ioctl
+ */
+static int spi_transfer(int fileDesc, struct spi_ioc_transfer *spi_msg, struct gpiod_line_request *cs_request, uint32_t *numRetries){
+
+    int retVal = 0;
+
+    *numRetries = 0;
+    for (uint32_t attempt = 0; attempt <= SPI_XFER_RETRIES; attempt++){
+
+        cs_request = cs_toggle(cs_request, CS_RW);
+        retVal = ioctl(fileDesc, SPI_IOC_MESSAGE(1), spi_msg);
+        cs_request = cs_toggle(cs_request, CS_MONITOR);
+
+        if (retVal == (int)spi_msg->len){
+            return retVal;
+        }
+        spiLastErrno = (retVal < 0) ? errno : 0;
+        if (!spi_errno_retryable(spiLastErrno) || (attempt == SPI_XFER_RETRIES)){
+            break;
+        }
+        (*numRetries)++;
+        metric_inc(METRIC_SPI_RETRIES);
+    }
+    return retVal;
+}
+
 /**
  * @brief Read data as 8-bit packets from SPI Peripheral
  * 
@@ -165,20 +256,31 @@ enum IRIS_ERROR spi_init(int *spi_dev, struct gpiod_line_request **spi_cs_reques
 enum IRIS_ERROR spi_read(int fileDesc, uint8_t *rx_buffer, uint16_t rx_len, struct gpiod_line_request *cs_request){
 
     int retVal = 0;
+    uint32_t numRetries = 0;
+    enum IRIS_ERROR error = NO_ERROR;
+    uint64_t startNs = get_time_monotonic_ns();
+    uint64_t elapsedNs = 0;
     struct spi_ioc_transfer spi_msg[1];
+    TRACE_SCOPE_ARG("spi_read", rx_len);
     memset(spi_msg, 0, sizeof(spi_msg));
 
     spi_msg[0].rx_buf = (unsigned long)rx_buffer;
     spi_msg[0].len = rx_len;
 
-    cs_request = cs_toggle(cs_request, CS_RW);
-    retVal = ioctl(fileDesc, SPI_IOC_MESSAGE(1), spi_msg);
-    cs_request = cs_toggle(cs_request, CS_MONITOR);
+    retVal = spi_transfer(fileDesc, &spi_msg[0], cs_request, &numRetries);
 
-    if(retVal == rx_len){
-        return NO_ERROR;
+    elapsedNs = get_time_monotonic_ns() - startNs;
+
+    metric_inc(METRIC_SPI_READS);
+    metric_observe_ns(METRIC_HIST_SPI_XFER, elapsedNs);
+    if(retVal != rx_len){
+        error = SPI_READ_ERROR;
+        metric_inc(METRIC_SPI_READ_ERRORS);
+    }else{
+        metric_add(METRIC_SPI_BYTES, rx_len);
     }
-    return SPI_READ_ERROR;
+    flight_record(FLIGHT_SPI_READ, error, rx_len, (uint32_t)retVal, (uint32_t)elapsedNs, numRetries);
+    return error;
 }
 
 /**
@@ -193,20 +295,31 @@ enum IRIS_ERROR spi_read(int fileDesc, uint8_t *rx_buffer, uint16_t rx_len, stru
 enum IRIS_ERROR spi_write(int fileDesc, const uint8_t *tx_buffer, uint16_t tx_len, struct gpiod_line_request *cs_request){
 
     int retVal = 0;
+    uint32_t numRetries = 0;
+    enum IRIS_ERROR error = NO_ERROR;
+    uint64_t startNs = get_time_monotonic_ns();
+    uint64_t elapsedNs = 0;
     struct spi_ioc_transfer spi_msg[1];
+    TRACE_SCOPE_ARG("spi_write", tx_len);
     memset(spi_msg, 0, sizeof(spi_msg));
 
     spi_msg[0].tx_buf = (unsigned long)tx_buffer;
     spi_msg[0].len = tx_len;
 
-    cs_request = cs_toggle(cs_request, CS_RW);
-    retVal = ioctl(fileDesc, SPI_IOC_MESSAGE(1), spi_msg);
-    cs_request = cs_toggle(cs_request, CS_MONITOR);
+    retVal = spi_transfer(fileDesc, &spi_msg[0], cs_request, &numRetries);
 
-    if(retVal == tx_len){
-        return NO_ERROR;
+    elapsedNs = get_time_monotonic_ns() - startNs;
+
+    metric_inc(METRIC_SPI_WRITES);
+    metric_observe_ns(METRIC_HIST_SPI_XFER, elapsedNs);
+    if(retVal != tx_len){
+        error = SPI_WRITE_ERROR;
+        metric_inc(METRIC_SPI_WRITE_ERRORS);
+    }else{
+        metric_add(METRIC_SPI_BYTES, tx_len);
     }
-    return SPI_WRITE_ERROR;
+    flight_record(FLIGHT_SPI_WRITE, error, tx_len, (uint32_t)retVal, (uint32_t)elapsedNs, numRetries);
+    return error;
 
 }
 
@@ -228,6 +341,29 @@ struct gpiod_line_request *spi_cs_setup(void){
 }
 
 
+/**
+ * @brief Fills in the settings the SPI Interface is configured with
+ * 
+ * @param config Pointer to structure that will store the settings
+ */
+void spi_config_get(spi_config_t *config){
+
+    config->mode = SPI_MODE_TYP_0;
+    config->speed = spiSpeedHz;
+    config->delay = SPI_DELAY;
+    config->bits_per_word = SPI_BITS_PER_WORD;
+}
+
+/**
+ * @brief Sets the clock rate used whenever the SPI Interface is configured, does not reconfigure an
+ *        open interface
+ * 
+ * @param speedHz Clock rate in Hz
+ */
+void spi_speed_set(uint32_t speedHz){
+    spiSpeedHz = speedHz;
+}
+
 /**
  * @brief High level function used to configure the SPI Interface
  * 
@@ -238,10 +374,7 @@ int spi_bus_setup(void){
     spi_config_t spi_config_test;
     int spi_dev = 0;
 
-    spi_config_test.mode = SPI_MODE_TYP_0;
-    spi_config_test.speed = SPI_SPEED;
-    spi_config_test.delay = SPI_DELAY;
-    spi_config_test.bits_per_word = SPI_BITS_PER_WORD;
+    spi_config_get(&spi_config_test);
 
     char *spi_device_name = SPI_DEVICE;
 
@@ -267,6 +400,78 @@ enum IRIS_ERROR spi_reinit(int *spi_dev, struct gpiod_line_request **spi_cs_requ
 
 }
 
+/**
+ * @brief Recovers the SPI Interface after a failed transfer (Tier 1 only retries unsubmitted ones), with the
+ *        cheapest tier that can work. Tier 2 reapplies the spidev settings on the open fd, keeping
+ *        the CS request and event buffer. Tier 3 is a full rebuild ('spi_reinit'), used if Tier 2
+ *        fails, the device is gone, or transfers keep failing after SPI_RECOVER_MAX_RECONFIGS
+ *        reconfigures within SPI_RECOVER_WINDOW_MS.
+ * 
+ * @param error Iris error code returned by the failed loop
+ * @param spi_dev Pointer to SPI bus instance, replaced by a rebuild
+ * @param spi_cs_request Pointer to CS request, replaced by a rebuild
+ * @param event_buffer Pointer to CS edge event buffer, replaced by a rebuild
+ * @return Iris error code indicating the success or failure of the recovery
+ */
+enum IRIS_ERROR spi_recover(enum IRIS_ERROR error, int *spi_dev, struct gpiod_line_request **spi_cs_request, struct gpiod_edge_event_buffer **event_buffer){
+
+    enum IRIS_ERROR recoverError = NO_ERROR;
+    spi_config_t config;
+    uint64_t startNs = get_time_monotonic_ns();
+    uint64_t nowMs = startNs / 1000000ULL;
+    uint8_t tier = SPI_RECOVER_REBUILD;
+
+    if ((nowMs - spiRecoverWindowMs) > SPI_RECOVER_WINDOW_MS){
+        spiRecoverWindowMs = nowMs;
+        spiNumReconfigures = 0;
+    }
+
+    switch (error){
+        case SPI_READ_ERROR:
+        case SPI_WRITE_ERROR:
+        case SPI_FILE_WRITE_ERROR:
+            spi_train_error();
+            if (!spi_errno_fatal(spiLastErrno) && (spiNumReconfigures < SPI_RECOVER_MAX_RECONFIGS)){
+                tier = SPI_RECOVER_RECONFIGURE;
+            }
+            break;
+        case SPI_SETUP_ERROR:
+        case SPI_TEST_ERROR:
+            // The configured interface is already known to be bad
+            break;
+        default:
+            // Errors from commands (sensors, files, IPC) say nothing about the bus
+            return NO_ERROR;
+    }
+
+    if (tier == SPI_RECOVER_RECONFIGURE){
+        spiNumReconfigures++;
+        metric_inc(METRIC_SPI_RECONFIGS);
+        spi_config_get(&config);
+
+        // A released or broken CS request cannot be read, it needs the rebuild
+        recoverError = spi_configure(*spi_dev, config);
+        if ((recoverError == NO_ERROR) && (gpiod_line_request_get_value(*spi_cs_request, SPI_CE_N) == GPIOD_LINE_VALUE_ERROR)){
+            recoverError = SPI_SETUP_ERROR;
+        }
+        if (recoverError != NO_ERROR){
+            tier = SPI_RECOVER_REBUILD;
+        }
+    }
+
+    if (tier == SPI_RECOVER_REBUILD){
+        spiNumReconfigures = 0;
+        metric_inc(METRIC_SPI_REBUILDS);
+        recoverError = spi_reinit(spi_dev, spi_cs_request, event_buffer);
+    }
+
+    LOG_WARNINGF("SPI-RECOVER: Tier %u recovery after error %d (errno %d) %s", tier, error, spiLastErrno,
+                 (recoverError == NO_ERROR) ? "succeeded" : "failed");
+    flight_record(FLIGHT_SPI_RECOVER, error, tier, recoverError, (uint32_t)spiLastErrno, (uint32_t)((get_time_monotonic_ns() - startNs) / 1000ULL));
+    spiLastErrno = 0;
+    return recoverError;
+}
+
 
 /**
  * @brief Write a file to SPI Peripheral. Currently only simple files such as binary / text have been verified, 
@@ -282,13 +487,12 @@ enum IRIS_ERROR spi_reinit(int *spi_dev, struct gpiod_line_request **spi_cs_requ
 enum IRIS_ERROR spi_file_write(int spi_dev, struct gpiod_line_request **spi_cs_request, char *file_path, struct gpiod_edge_event_buffer **event_buffer){
 
     uint8_t txBuffer[SPI_FILE_BUFFER_LEN * 3] = {0};
-    char logBuffer[LOG_BUFFER_SIZE];
     int bytesRead = 0;
     IRIS_ERROR error = NO_ERROR;
     uint8_t checksum[SHA256_DIGEST_LENGTH + 1];
     checksum[0] = FILE_TRANSFER;
 
-    log_write(LOG_INFO, "SPI-FILE-WRITE: Begin file write onto SPI bus too OBC");
+    LOG_INFOF("SPI-FILE-WRITE: Begin file write onto SPI bus too OBC");
 
     //! ADD ERROR DETECT FOR CHECKSUM
     sha256_checksum(file_path, checksum + 1);
@@ -298,7 +502,7 @@ enum IRIS_ERROR spi_file_write(int spi_dev, struct gpiod_line_request **spi_cs_r
     if (file) {
         error = spi_write(spi_dev, checksum, sizeof(checksum), *spi_cs_request);
         if (error == SPI_WRITE_ERROR){
-            log_write(LOG_ERROR, "SPI-FILE-WRITE: Failed to write Checksum onto SPI bus due to 'spi_write' FAIL");
+            LOG_ERRORF("SPI-FILE-WRITE: Failed to write Checksum onto SPI bus due to 'spi_write' FAIL");
             return SPI_FILE_WRITE_ERROR;
         }
 
@@ -306,7 +510,7 @@ enum IRIS_ERROR spi_file_write(int spi_dev, struct gpiod_line_request **spi_cs_r
         do {
             error = spi_write(spi_dev, txBuffer, bytesRead, *spi_cs_request);
             if (error == SPI_WRITE_ERROR){
-                log_write(LOG_ERROR, "SPI-FILE-WRITE: Failed to write file onto SPI bus due to 'spi_write' FAIL");
+                LOG_ERRORF("SPI-FILE-WRITE: Failed to write file onto SPI bus due to 'spi_write' FAIL");
                 return SPI_FILE_WRITE_ERROR;
             }
             //usleep(15);
@@ -316,29 +520,110 @@ enum IRIS_ERROR spi_file_write(int spi_dev, struct gpiod_line_request **spi_cs_r
         } while (bytesRead > 0);
         fclose(file);
 
-        log_write(LOG_INFO, "SPI-FILE-WRITE: Completed file write onto SPI bus too OBC");
+        LOG_INFOF("SPI-FILE-WRITE: Completed file write onto SPI bus too OBC");
         return NO_ERROR;
     }
 
-    snprintf(logBuffer, sizeof(logBuffer), "SPI-FILE-WRITE: Failed to open file %s", file_path);
-    log_write(LOG_ERROR, logBuffer);
+    LOG_ERRORF("SPI-FILE-WRITE: Failed to open file %s", file_path);
     return SPI_FILE_WRITE_ERROR;
 }
 
 
+/**
+ * @brief Streams part of an open file to the SPI Peripheral. The file is mapped and written to the
+ *        bus straight from the page cache, falling back to buffered reads if it cannot be mapped.
+ *        Frame is [FILE_TRANSFER, Length (64-bit MSB first)] followed by the data.
+ *
+ * @param spi_dev Configured SPI bus instance
+ * @param spi_cs_request Pointer to structure that contains the CS instance
+ * @param fd File descriptor to stream from (e.g. passed by the Main service, See 'ipc_fd.h')
+ * @param offset First byte of the file to write
+ * @param len Number of bytes to write, clamped to the end of the file
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR spi_fd_write(int spi_dev, struct gpiod_line_request *spi_cs_request, int fd, uint64_t offset, uint64_t len){
+
+    uint8_t header[SPI_FD_HEADER_SIZE] = {FILE_TRANSFER};
+    uint8_t txBuffer[SPI_FILE_BUFFER_LEN];
+    struct stat fileStat;
+    uint64_t pageOffset = 0;
+    uint64_t sent = 0;
+    uint16_t chunkLen = 0;
+    ssize_t bytesRead = 0;
+    uint8_t *mapping = NULL;
+    IRIS_ERROR error = NO_ERROR;
+    TRACE_SCOPE("spi_bulk");
+
+    if ((fstat(fd, &fileStat) != 0) || ((uint64_t)fileStat.st_size < offset)){
+        LOG_ERRORF("SPI-FD-WRITE: Unable to determine size of file to stream");
+        return SPI_FILE_WRITE_ERROR;
+    }
+    if (len > ((uint64_t)fileStat.st_size - offset)){
+        len = (uint64_t)fileStat.st_size - offset;
+    }
+
+    for (int index = 0; index < 8; index++){
+        header[1 + index] = (len >> (56 - (8 * index))) & 0xFF;
+    }
+    error = spi_write(spi_dev, header, sizeof(header), spi_cs_request);
+    if (error != NO_ERROR){
+        LOG_ERRORF("SPI-FD-WRITE: Failed to write header onto SPI bus due to 'spi_write' FAIL");
+        return SPI_FILE_WRITE_ERROR;
+    }
+    if (len == 0){
+        return NO_ERROR;
+    }
+
+    // mmap offsets must be page aligned
+    pageOffset = offset % (uint64_t)sysconf(_SC_PAGESIZE);
+    mapping = mmap(NULL, len + pageOffset, PROT_READ, MAP_SHARED, fd, (off_t)(offset - pageOffset));
+    if (mapping == MAP_FAILED){
+        mapping = NULL;
+    }else{
+        madvise(mapping, len + pageOffset, MADV_SEQUENTIAL);
+    }
+
+    while (sent < len){
+        chunkLen = ((len - sent) > SPI_FILE_BUFFER_LEN) ? SPI_FILE_BUFFER_LEN : (uint16_t)(len - sent);
+
+        if (mapping != NULL){
+            error = spi_write(spi_dev, mapping + pageOffset + sent, chunkLen, spi_cs_request);
+        }else{
+            bytesRead = pread(fd, txBuffer, chunkLen, (off_t)(offset + sent));
+            if (bytesRead <= 0){
+                LOG_ERRORF("SPI-FD-WRITE: File ended before the transfer completed");
+                error = SPI_FILE_WRITE_ERROR;
+                break;
+            }
+            chunkLen = (uint16_t)bytesRead;
+            error = spi_write(spi_dev, txBuffer, chunkLen, spi_cs_request);
+        }
+        if (error != NO_ERROR){
+            LOG_ERRORF("SPI-FD-WRITE: Failed to write file onto SPI bus due to 'spi_write' FAIL");
+            error = SPI_FILE_WRITE_ERROR;
+            break;
+        }
+        sent += chunkLen;
+    }
+
+    if (mapping != NULL){
+        munmap(mapping, len + pageOffset);
+    }
+    return error;
+}
+
 //! NEED TO FIX FUNCTION
 //! NEED IT TO PROPERLY DETECT WHEN THE FILE READ IS DONE
 enum IRIS_ERROR spi_file_read(int spi_dev, struct gpiod_line_request **spi_cs_request, struct gpiod_edge_event_buffer **event_buffer, const char *file_path){
 
     uint8_t rxBuffer[SPI_FILE_BUFFER_LEN];
-    char logBuffer[LOG_BUFFER_SIZE];
     int bytesWrote = 0;
     IRIS_ERROR error = NO_ERROR;
     
     //bool cs_edge = false;
     //uint8_t checksum[SHA256_DIGEST_LENGTH];
 
-    log_write(LOG_INFO, "SPI-FILE-WRITE: Begin file write onto SPI bus too OBC");
+    LOG_INFOF("SPI-FILE-WRITE: Begin file write onto SPI bus too OBC");
 
     FILE *file = fopen(file_path, "wb");
 
@@ -350,7 +635,7 @@ enum IRIS_ERROR spi_file_read(int spi_dev, struct gpiod_line_request **spi_cs_re
                 //checksum = checksum_calc(txBuffer, bytesRead);
                 //txBuffer[0] = checksum;
             if (error != NO_ERROR){
-                log_write(LOG_ERROR, "SPI-FILE-WRITE: Failed to write file onto SPI bus due to 'spi_write' FAIL");
+                LOG_ERRORF("SPI-FILE-WRITE: Failed to write file onto SPI bus due to 'spi_write' FAIL");
                 return SPI_FILE_WRITE_ERROR;
             }
             
@@ -359,35 +644,21 @@ enum IRIS_ERROR spi_file_read(int spi_dev, struct gpiod_line_request **spi_cs_re
         } while (bytesWrote > 0);
         fclose(file);
 
-        log_write(LOG_INFO, "SPI-FILE-WRITE: Completed file write onto SPI bus too OBC");
+        LOG_INFOF("SPI-FILE-WRITE: Completed file write onto SPI bus too OBC");
         return NO_ERROR;
     }
 
     fclose(file);
 
-    snprintf(logBuffer, sizeof(logBuffer), "SPI-FILE-WRITE: Failed to open file %s", file_path);
-    log_write(LOG_ERROR, logBuffer);
+    LOG_ERRORF("SPI-FILE-WRITE: Failed to open file %s", file_path);
 
     return SPI_FILE_WRITE_ERROR;
 }
 
-enum IRIS_ERROR spi_bus_test_compare(const uint8_t *buffer){
-
-    uint8_t reference[SPI_TEST_MSG_SIZE] = SPI_TEST_MSG;
-
-    for (int index = 0; index < sizeof(reference); index++){
-        if(buffer[index] != reference[index]){
-            return SPI_TEST_ERROR;
-        }
-    }
-    return NO_ERROR;
-
-}
-
 /**
  * @brief Test functionality of the SPI Interface.
- *        Sends series of known packets to peripheral, next waits for peripheral to send what it received 
- *        back to Host. Compares packets recieved with the ones sent to confirm successful transfer.
+ *        Sends a link training frame of known data to the peripheral at the configured rate, next waits for
+ *        the peripheral to echo what it received back to Host. The echo must match bit for bit.
  * 
  * @param spi_dev Configured SPI bus instance
  * @param spi_cs_request Pointer to structure that contains the CS instance
@@ -396,38 +667,22 @@ enum IRIS_ERROR spi_bus_test_compare(const uint8_t *buffer){
  */
 enum IRIS_ERROR spi_bus_test(int spi_dev, struct gpiod_line_request *spi_cs_request, struct gpiod_edge_event_buffer *event_buffer){
 
-    uint8_t buffer[SPI_TEST_MSG_SIZE] = SPI_TEST_MSG;
-    uint16_t rwNum = sizeof(buffer);
+    uint32_t bitErrors = 0;
+    uint32_t numBits = 0;
     enum IRIS_ERROR error = NO_ERROR;
 
-    log_write(LOG_INFO, "SPI-BUS-TEST: Begin SPI bus test transfer too OBC");
+    LOG_INFOF("SPI-BUS-TEST: Begin SPI bus test transfer too OBC");
 
-    error = spi_write(spi_dev, buffer, rwNum, spi_cs_request);
-    if (error == SPI_WRITE_ERROR){
-        log_write(LOG_ERROR, "SPI-BUS-TEST: Failed to write test message onto SPI bus");
+    error = spi_train_measure(spi_dev, spi_cs_request, event_buffer, SPI_TRAIN_RATE_CURRENT, 1, 0, &bitErrors, &numBits);
+    if (error != NO_ERROR){
+        LOG_ERRORF("SPI-BUS-TEST: TIMEOUT Failed to read test message from OBC");
+        return SPI_TEST_ERROR;
+    }
+    if (bitErrors != 0){
+        LOG_ERRORF("SPI-BUS-TEST: Test message returned with %u / %u bit errors", bitErrors, numBits);
         return SPI_TEST_ERROR;
     }
 
-    int start_time = get_time_seconds();
-    bool cs_edge = false;
-
-    log_write(LOG_INFO, "SPI-BUS-TEST: Begin SPI bus test read from OBC");
-
-    do{
-        cs_edge = signal_edge_detect(spi_cs_request, event_buffer);
-
-        if(cs_edge == true){
-            error = spi_read(spi_dev, buffer, rwNum, spi_cs_request);
-            if (error == SPI_READ_ERROR){
-                log_write(LOG_ERROR, "SPI-BUS-TEST: Failed to read test message from OBC");
-                return SPI_TEST_ERROR;
-            }
-            log_write(LOG_INFO, "SPI-BUS-TEST: Completed read of test message from OBC");
-            return spi_bus_test_compare(buffer);
-        }
- 
-    }while((get_time_seconds() - start_time) < SPI_TEST_TIMEOUT);
-
-    log_write(LOG_ERROR, "SPI-BUS-TEST: TIMEOUT Failed to read test message from OBC");
-    return SPI_TEST_ERROR;
+    LOG_INFOF("SPI-BUS-TEST: Completed read of test message from OBC");
+    return NO_ERROR;
 }
\ No newline at end of file
@@ -0,0 +1,314 @@
+/**
+ * @file spi_train.c
+ * @author agent
+ * @brief SPI Link Training for Theia CM4
+ *        Provides functions to...
+ *         - Exchange PRBS-15 test frames with the OBC and count the bit errors of the echo
+ *         - Train the SPI clock to the fastest rate with margin
+ *         - Keep the trained rate across restarts and re-train after repeated transfer failures
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "error_handler.h"
+#include "flight_recorder.h"
+#include "logger.h"
+#include "main.h"
+#include "metrics.h"
+#include "spi_iris.h"
+#include "spi_train.h"
+#include "timing.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+static bool spiTrainLoaded = false;
+static bool spiTrainPending = false;
+static uint64_t spiTrainWindowMs = 0;
+static uint32_t spiTrainNumErrors = 0;
+static uint16_t spiTrainPrbs = 0x7FFF;
+
+
+/**
+ * @brief CRC-32 of a rate record, covers everything before 'crc'
+ *
+ * @param record Pointer to record
+ * @return CRC-32
+ */
+static uint32_t spi_train_crc(const spi_train_record_t *record){
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+
+    crc = crc32(crc, (const Bytef *)record, offsetof(spi_train_record_t, crc));
+    return (uint32_t)crc;
+}
+
+/**
+ * @brief Sets the SPI clock to the trained rate kept from the last training, or reports training as
+ *        pending if there is none. Only reads the record once, call it before the bus is set up.
+ */
+void spi_train_load(void){
+
+    spi_train_record_t record;
+    const uint32_t rates[SPI_TRAIN_NUM_RATES] = SPI_TRAIN_RATES;
+    FILE *file = NULL;
+    bool valid = false;
+
+    if (spiTrainLoaded){
+        return;
+    }
+    spiTrainLoaded = true;
+
+    file = fopen(LOG_DIRECTORY "/" SPI_TRAIN_FILENAME, "rb");
+    if (file != NULL){
+        valid = (fread(&record, sizeof(record), 1, file) == 1) && (record.magic == SPI_TRAIN_MAGIC) &&
+                (record.version == SPI_TRAIN_VERSION) && (record.crc == spi_train_crc(&record));
+        fclose(file);
+    }
+
+    // A record from a build with a different rate table is not trusted
+    if (valid){
+        valid = false;
+        for (int index = 0; index < SPI_TRAIN_NUM_RATES; index++){
+            valid |= (rates[index] == record.speedHz);
+        }
+    }
+
+    if (!valid){
+        LOG_WARNINGF("SPI-TRAIN: No trained rate, using %u Hz until trained", (uint32_t)SPI_SPEED);
+        spiTrainPending = true;
+        return;
+    }
+    spi_speed_set(record.speedHz);
+    LOG_INFOF("SPI-TRAIN: Using trained rate %u Hz (fastest %u Hz, trained at %u)", record.speedHz, record.fastestHz, record.trainedS);
+}
+
+/**
+ * @brief Writes the rate record, through a temporary file so a power loss leaves the old or new record
+ *
+ * @param record Pointer to record
+ * @return Iris error code indicating the success or failure of function
+ */
+static enum IRIS_ERROR spi_train_save(spi_train_record_t *record){
+
+    const char *path = LOG_DIRECTORY "/" SPI_TRAIN_FILENAME;
+    const char *tempPath = LOG_DIRECTORY "/" SPI_TRAIN_FILENAME ".tmp";
+    FILE *file = NULL;
+    bool written = false;
+
+    record->magic = SPI_TRAIN_MAGIC;
+    record->version = SPI_TRAIN_VERSION;
+    record->reserved = 0;
+    record->crc = spi_train_crc(record);
+
+    file = fopen(tempPath, "wb");
+    if (file == NULL){
+        LOG_ERRORF("SPI-TRAIN: Unable to open %s", tempPath);
+        return SPI_TEST_ERROR;
+    }
+    written = (fwrite(record, sizeof(*record), 1, file) == 1) && (fflush(file) == 0) && (fsync(fileno(file)) == 0);
+    if ((fclose(file) != 0) || !written || (rename(tempPath, path) != 0)){
+        LOG_ERRORF("SPI-TRAIN: Unable to write %s", path);
+        return SPI_TEST_ERROR;
+    }
+    return NO_ERROR;
+}
+
+/**
+ * @brief Counts a transfer failure, training is reported as pending once SPI_TRAIN_ERROR_LIMIT
+ *        failures happen within SPI_TRAIN_ERROR_WINDOW_S, the OBC decides when to train
+ */
+void spi_train_error(void){
+
+    uint64_t nowMs = get_time_monotonic_ms();
+
+    if ((nowMs - spiTrainWindowMs) > (SPI_TRAIN_ERROR_WINDOW_S * 1000ULL)){
+        spiTrainWindowMs = nowMs;
+        spiTrainNumErrors = 0;
+    }
+    spiTrainNumErrors++;
+    if (spiTrainNumErrors >= SPI_TRAIN_ERROR_LIMIT){
+        LOG_WARNINGF("SPI-TRAIN: %u transfer failures in %u s, training pending", spiTrainNumErrors, SPI_TRAIN_ERROR_WINDOW_S);
+        spiTrainNumErrors = 0;
+        spiTrainPending = true;
+    }
+}
+
+/**
+ * @brief Checks if the link needs to be trained (See 'spi_train')
+ *
+ * @return True if training is pending
+ */
+bool spi_train_pending(void){
+    return spiTrainPending;
+}
+
+/**
+ * @brief Fills a buffer with the next bytes of the PRBS-15 sequence (x^15 + x^14 + 1)
+ *
+ * @param buffer Pointer to buffer
+ * @param len Number of bytes
+ */
+static void spi_train_prbs(uint8_t *buffer, uint16_t len){
+
+    uint16_t state = spiTrainPrbs;
+    uint16_t bit = 0;
+
+    for (uint16_t index = 0; index < len; index++){
+        buffer[index] = 0;
+        for (int count = 0; count < 8; count++){
+            bit = ((state >> 14) ^ (state >> 13)) & 1;
+            state = (uint16_t)(((state << 1) | bit) & 0x7FFF);
+            buffer[index] = (uint8_t)((buffer[index] << 1) | bit);
+        }
+    }
+    spiTrainPrbs = state;
+}
+
+/**
+ * @brief Writes test frames at the configured rate and counts the bit errors of the OBC's echo of
+ *        each one. A frame that is not echoed within SPI_TEST_TIMEOUT, or whose echo does not carry
+ *        the same header, is missed and not compared. The exchange stops after SPI_TRAIN_MAX_MISSED of them.
+ *
+ * @param spi_dev Configured SPI bus instance
+ * @param spi_cs_request Pointer to structure that contains the CS instance
+ * @param event_buffer Pointer to buffer that stores all events detected on CS
+ * @param rateIndex Index of the rate in SPI_TRAIN_RATES, SPI_TRAIN_RATE_CURRENT for a bus test
+ * @param numFrames Number of frames to exchange
+ * @param deadlineMs Monotonic time the exchange is abandoned at, 0 for no limit
+ * @param bitErrors Pointer to variable that will store the number of bit errors in the echoed frames
+ * @param numBits Pointer to variable that will store the number of bits compared
+ * @return Iris error code, SPI_TEST_ERROR if SPI_TRAIN_MAX_MISSED (or every) frame was missed, or the
+ *         deadline passed before every frame was sent
+ */
+enum IRIS_ERROR spi_train_measure(int spi_dev, struct gpiod_line_request *spi_cs_request, struct gpiod_edge_event_buffer *event_buffer,
+                                  uint8_t rateIndex, uint16_t numFrames, uint64_t deadlineMs, uint32_t *bitErrors, uint32_t *numBits){
+
+    uint8_t frame[SPI_TRAIN_FRAME_LEN];
+    uint8_t echo[SPI_TRAIN_FRAME_LEN];
+    uint16_t numMissed = 0;
+    uint64_t startMs = 0;
+    bool cs_edge = false;
+
+    *bitErrors = 0;
+    *numBits = 0;
+
+    for (uint16_t frameIndex = 0; frameIndex < numFrames; frameIndex++){
+
+        if ((numMissed >= SPI_TRAIN_MAX_MISSED) || ((deadlineMs != 0) && (get_time_monotonic_ms() >= deadlineMs))){
+            return SPI_TEST_ERROR;
+        }
+
+        frame[0] = SPI_TEST_CMD;
+        frame[1] = rateIndex;
+        frame[2] = (uint8_t)frameIndex;
+        spi_train_prbs(&frame[SPI_TRAIN_HEADER_SIZE], SPI_TRAIN_PAYLOAD_LEN);
+
+        cs_edge = false;
+        if (spi_write(spi_dev, frame, sizeof(frame), spi_cs_request) == NO_ERROR){
+            startMs = get_time_monotonic_ms();
+            do{
+                cs_edge = signal_edge_detect(spi_cs_request, event_buffer);
+            }while(!cs_edge && ((get_time_monotonic_ms() - startMs) < (SPI_TEST_TIMEOUT * 1000ULL)));
+        }
+
+        // A frame that is not an echo of this one (e.g. an OBC command) says nothing about the bit errors
+        if (!cs_edge || (spi_read(spi_dev, echo, sizeof(echo), spi_cs_request) != NO_ERROR) ||
+            (memcmp(echo, frame, SPI_TRAIN_HEADER_SIZE) != 0)){
+            numMissed++;
+            continue;
+        }
+
+        *numBits += SPI_TRAIN_PAYLOAD_LEN * 8;
+        for (uint16_t index = SPI_TRAIN_HEADER_SIZE; index < SPI_TRAIN_FRAME_LEN; index++){
+            *bitErrors += (uint32_t)__builtin_popcount(frame[index] ^ echo[index]);
+        }
+    }
+    return ((numMissed >= SPI_TRAIN_MAX_MISSED) || (numMissed == numFrames)) ? SPI_TEST_ERROR : NO_ERROR;
+}
+
+/**
+ * @brief Trains the SPI clock (See 'spi_train.h'), only when the OBC entered training with SPI_TRAIN.
+ *        Blocks for at most SPI_TRAIN_BUDGET_MS plus one echo timeout. The selected rate is applied
+ *        and kept, if no rate passes (or the OBC does not echo) the rate in use before training is restored.
+ *
+ * @param spi_dev Configured SPI bus instance
+ * @param spi_cs_request Pointer to structure that contains the CS instance
+ * @param event_buffer Pointer to buffer that stores all events detected on CS
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR spi_train(int spi_dev, struct gpiod_line_request *spi_cs_request, struct gpiod_edge_event_buffer *event_buffer){
+
+    const uint32_t rates[SPI_TRAIN_NUM_RATES] = SPI_TRAIN_RATES;
+    uint32_t bitErrors[SPI_TRAIN_NUM_RATES] = {0};
+    spi_train_record_t record;
+    spi_config_t config;
+    enum IRIS_ERROR error = NO_ERROR;
+    uint64_t startMs = get_time_monotonic_ms();
+    uint32_t previousHz = 0;
+    uint32_t numBits = 0;
+    int fastest = -1;
+    int selected = 0;
+
+    spiTrainPending = false;
+    metric_inc(METRIC_SPI_TRAININGS);
+    spi_config_get(&config);
+    previousHz = config.speed;
+    LOG_INFOF("SPI-TRAIN: Begin link training at %u Hz", previousHz);
+
+    for (int index = 0; index < SPI_TRAIN_NUM_RATES; index++){
+        config.speed = rates[index];
+        if (spi_configure(spi_dev, config) != NO_ERROR){
+            break;
+        }
+        error = spi_train_measure(spi_dev, spi_cs_request, event_buffer, (uint8_t)index, SPI_TRAIN_FRAMES,
+                                  startMs + SPI_TRAIN_BUDGET_MS, &bitErrors[index], &numBits);
+        LOG_INFOF("SPI-TRAIN: %u Hz, %u / %u bit errors%s", rates[index], bitErrors[index], numBits,
+                  (error != NO_ERROR) ? ", echoes missed" : "");
+
+        // Faster rates are not tried once one fails or the training budget is used up
+        if ((error != NO_ERROR) || (bitErrors[index] > SPI_TRAIN_MAX_BIT_ERRORS)){
+            break;
+        }
+        fastest = index;
+    }
+
+    if (fastest < 0){
+        config.speed = previousHz;
+        spi_configure(spi_dev, config);
+        LOG_ERRORF("SPI-TRAIN: No rate passed, keeping %u Hz", previousHz);
+        flight_record(FLIGHT_SPI_TRAIN, SPI_TEST_ERROR, previousHz, 0, 0, (uint32_t)(get_time_monotonic_ms() - startMs));
+        return SPI_TEST_ERROR;
+    }
+
+    selected = (fastest >= SPI_TRAIN_MARGIN_STEPS) ? (fastest - SPI_TRAIN_MARGIN_STEPS) : 0;
+    config.speed = rates[selected];
+    error = spi_configure(spi_dev, config);
+    if (error != NO_ERROR){
+        config.speed = previousHz;
+        spi_configure(spi_dev, config);
+        LOG_ERRORF("SPI-TRAIN: Unable to apply %u Hz, keeping %u Hz", rates[selected], previousHz);
+        return error;
+    }
+    spi_speed_set(rates[selected]);
+
+    memset(&record, 0, sizeof(record));
+    record.speedHz = rates[selected];
+    record.fastestHz = rates[fastest];
+    record.bitErrors = bitErrors[selected];
+    record.trainedS = (uint32_t)get_time_seconds();
+    error = spi_train_save(&record);
+
+    LOG_INFOF("SPI-TRAIN: Selected %u Hz (fastest passing %u Hz)", rates[selected], rates[fastest]);
+    flight_record(FLIGHT_SPI_TRAIN, error, rates[selected], rates[fastest], bitErrors[selected], (uint32_t)(get_time_monotonic_ms() - startMs));
+    return error;
+}
@@ -0,0 +1,249 @@
+/**
+ * @file telemetry_block.c
+ * @author agent
+ * @brief Aggregate Telemetry Block for Theia CM4
+ *        Provides functions to...
+ *         - Pack every rail's current / voltage / power / peak power, every temperature channel,
+ *           sensor health flags and reading ages into one versioned response frame
+ *         - Pack the sensor cache history of every channel for bulk downlink
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include "cmd_controller.h"
+#include "error_handler.h"
+#include "logger.h"
+#include "sensor_cache.h"
+#include "telemetry_block.h"
+#include "telemetry_pack.h"
+#include "timing.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// Newest monotonic time of each channel in the last TELEM_HISTORY_FLAG_CLEAR export, 0 if none
+static uint64_t telemHistoryClearMs[SENSOR_CACHE_NUM_CHANNELS];
+
+
+/**
+ * @brief Converts the age of a snapshot into the block's age units, saturating at TELEM_BLOCK_AGE_MAX
+ *
+ * @param snapshot Pointer to channel snapshot
+ * @param nowMs Current monotonic time in milli-seconds
+ * @return Age of the snapshot in TELEM_BLOCK_AGE_LSB_MS units
+ */
+static uint16_t telemetry_block_age(const sensor_snapshot_t *snapshot, uint64_t nowMs){
+
+    uint64_t age = 0;
+
+    if (snapshot->timestampMs == 0){
+        return TELEM_BLOCK_AGE_MAX;
+    }
+    age = (nowMs - snapshot->timestampMs) / TELEM_BLOCK_AGE_LSB_MS;
+    if (age > TELEM_BLOCK_AGE_MAX){
+        return TELEM_BLOCK_AGE_MAX;
+    }
+    return (uint16_t)age;
+}
+
+/**
+ * @brief Builds the response frame for the TELEMETRY_BLOCK command from the sensor snapshot cache
+ *
+ * @param buffer Pointer to array that will store the response frame
+ * @param bufferLen Size of buffer, must be at least TELEM_BLOCK_SIZE
+ * @param forceLive True to refresh every channel with a live read before building the block
+ * @param blockLen Pointer to variable that will store the number of bytes written
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR telemetry_block_build(uint8_t *buffer, uint16_t bufferLen, bool forceLive, uint16_t *blockLen){
+
+    sensor_snapshot_t snapshot;
+    uint16_t healthFlags = 0;
+    uint16_t offset = TELEM_BLOCK_HEADER_SIZE;
+    uint16_t value = 0;
+    uint16_t age = 0;
+    uint32_t timestamp = (uint32_t)get_time_seconds();
+    uint64_t nowMs = 0;
+
+    *blockLen = 0;
+    if (bufferLen < TELEM_BLOCK_SIZE){
+        return CMD_FORMAT_ERROR;
+    }
+
+    if (forceLive){
+        sensor_sampler_sweep();
+    }
+    nowMs = get_time_monotonic_ms();
+
+    // Per Rail Values followed by their Ages
+    for (uint8_t rail = 0; rail < SENSOR_NUM_RAILS; rail++){
+        for (uint8_t kind = 0; kind < SENSOR_NUM_RAIL_KINDS; kind++){
+
+            uint8_t channel = (kind * SENSOR_NUM_RAILS) + rail;
+            sensor_cache_snapshot(channel, &snapshot);
+
+            value = snapshot.value;
+            if ((snapshot.timestampMs == 0) || (snapshot.error != NO_ERROR)){
+                healthFlags |= (1 << channel);
+                value = 0;
+            }
+            age = telemetry_block_age(&snapshot, nowMs);
+
+            buffer[offset + (2 * kind)]         = (value >> 8) & 0xFF;  // MSB
+            buffer[offset + (2 * kind) + 1]     =  value & 0xFF;        // LSB
+            buffer[offset + (2 * kind) + 8]     = (age >> 8) & 0xFF;    // MSB
+            buffer[offset + (2 * kind) + 9]     =  age & 0xFF;          // LSB
+        }
+        offset += TELEM_BLOCK_RAIL_SIZE;
+    }
+
+    // Temperature Values and Ages
+    for (uint8_t temp = 0; temp < SENSOR_NUM_TEMPS; temp++){
+
+        uint8_t channel = SENSOR_TEMP_CHANNEL_START + temp;
+        sensor_cache_snapshot(channel, &snapshot);
+
+        value = snapshot.value;
+        if ((snapshot.timestampMs == 0) || (snapshot.error != NO_ERROR)){
+            healthFlags |= (1 << channel);
+            value = 0;
+        }
+        age = telemetry_block_age(&snapshot, nowMs);
+
+        buffer[offset++] = (uint8_t)value;
+        buffer[offset++] = (age >> 8) & 0xFF;  // MSB
+        buffer[offset++] =  age & 0xFF;        // LSB
+    }
+
+    // Header
+    buffer[0]  = CMD_RETURN;
+    buffer[1]  = NO_ERROR;
+    buffer[2]  = TELEM_BLOCK_VERSION;
+    buffer[3]  = SENSOR_NUM_RAILS;
+    buffer[4]  = SENSOR_NUM_TEMPS;
+    buffer[5]  = (timestamp >> 24) & 0xFF;
+    buffer[6]  = (timestamp >> 16) & 0xFF;
+    buffer[7]  = (timestamp >> 8) & 0xFF;
+    buffer[8]  =  timestamp & 0xFF;
+    buffer[9]  = (healthFlags >> 8) & 0xFF;
+    buffer[10] =  healthFlags & 0xFF;
+
+    *blockLen = offset;
+    return NO_ERROR;
+}
+
+/**
+ * @brief Packs the history of every sensor cache channel into a sealed memfd for the
+ *        TELEMETRY_HISTORY bulk transfer
+ *
+ * @param flags TELEM_HISTORY_FLAG_*, TELEM_HISTORY_FLAG_CLEAR only takes effect once the memfd is
+ *              delivered (See 'telemetry_history_delivered')
+ * @param fd Pointer to variable that will store the memfd, -1 if nothing is transferred. The caller owns it.
+ * @param size Pointer to variable that will store the size of the packed frame
+ * @param numSamples Pointer to variable that will store the number of readings packed
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR telemetry_history_export(uint8_t flags, int *fd, uint32_t *size, uint32_t *numSamples){
+
+    static uint64_t timestampMs[SENSOR_CACHE_NUM_CHANNELS][SENSOR_HISTORY_LEN];
+    static int32_t value[SENSOR_CACHE_NUM_CHANNELS][SENSOR_HISTORY_LEN];
+    uint64_t clearMs[SENSOR_CACHE_NUM_CHANNELS];
+    telemetry_series_t series[SENSOR_CACHE_NUM_CHANNELS];
+    struct timespec realTime;
+    uint8_t *buffer = NULL;
+    uint32_t bufferLen = 0;
+    uint32_t written = 0;
+    ssize_t numBytes = 0;
+    uint64_t offsetMs = 0;
+    int exportFd = -1;
+
+    *fd = -1;
+    *size = 0;
+    *numSamples = 0;
+
+    // History is kept on the monotonic clock, shifted to Unix time as of now so the series stay ordered
+    clock_gettime(CLOCK_REALTIME, &realTime);
+    offsetMs = ((uint64_t)realTime.tv_sec * 1000ULL) + ((uint64_t)realTime.tv_nsec / 1000000ULL) - get_time_monotonic_ms();
+
+    for (uint8_t channel = 0; channel < SENSOR_CACHE_NUM_CHANNELS; channel++){
+        series[channel].channel = channel;
+        series[channel].maxSamples = SENSOR_HISTORY_LEN;
+        series[channel].timestamp = timestampMs[channel];
+        series[channel].value = value[channel];
+        series[channel].numSamples = sensor_cache_history(channel, timestampMs[channel], value[channel], SENSOR_HISTORY_LEN);
+        clearMs[channel] = (series[channel].numSamples != 0) ? timestampMs[channel][series[channel].numSamples - 1] : 0;
+        for (uint16_t sample = 0; sample < series[channel].numSamples; sample++){
+            timestampMs[channel][sample] += offsetMs;
+        }
+        *numSamples += series[channel].numSamples;
+    }
+    bufferLen = telemetry_pack_bound(series, SENSOR_CACHE_NUM_CHANNELS);
+    buffer = malloc(bufferLen);
+    if (buffer == NULL){
+        return TELEM_PACK_ERROR;
+    }
+    if (telemetry_pack(series, SENSOR_CACHE_NUM_CHANNELS, buffer, bufferLen, size) != NO_ERROR){
+        LOG_ERRORF("TELEMETRY-HISTORY: Failed to pack %u readings", *numSamples);
+        free(buffer);
+        return TELEM_PACK_ERROR;
+    }
+    if (flags & TELEM_HISTORY_FLAG_SIZE_ONLY){
+        free(buffer);
+        return NO_ERROR;
+    }
+
+    exportFd = memfd_create(TELEM_HISTORY_MEMFD_NAME, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (exportFd < 0){
+        LOG_ERRORF("TELEMETRY-HISTORY: Failed to create memfd for history export");
+        free(buffer);
+        return TELEM_PACK_ERROR;
+    }
+    while (written < *size){
+        numBytes = write(exportFd, buffer + written, *size - written);
+        if (numBytes <= 0){
+            LOG_ERRORF("TELEMETRY-HISTORY: Failed to write history export");
+            close(exportFd);
+            free(buffer);
+            return TELEM_PACK_ERROR;
+        }
+        written += (uint32_t)numBytes;
+    }
+    free(buffer);
+
+    fcntl(exportFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+    *fd = exportFd;
+
+    // Readings taken after this export are newer than the cut-off and survive the clear
+    if (flags & TELEM_HISTORY_FLAG_CLEAR){
+        memcpy(telemHistoryClearMs, clearMs, sizeof(telemHistoryClearMs));
+    }
+    return NO_ERROR;
+}
+
+/**
+ * @brief Bulk delivery callback of a TELEM_HISTORY_FLAG_CLEAR export (See 'cmd_bulk_on_done'), drops
+ *        the exported readings from the history once the OBC received them. Readings sampled since
+ *        the export are kept, nothing is dropped if the transfer failed.
+ *
+ * @param delivered True if the export reached the OBC
+ */
+void telemetry_history_delivered(bool delivered){
+
+    // A failed transfer keeps the cut-off, a later CLEAR export replaces it with a newer one
+    if (delivered){
+        sensor_cache_history_drop(telemHistoryClearMs);
+        memset(telemHistoryClearMs, 0, sizeof(telemHistoryClearMs));
+    }
+}
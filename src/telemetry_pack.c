@@ -0,0 +1,310 @@
+/**
+ * @file telemetry_pack.c
+ * @author agent
+ * @brief Telemetry Packer for Theia CM4
+ *        Provides functions to...
+ *         - Encode sensor time series as delta-of-delta timestamps and zigzag-varint value deltas
+ *         - Decode packed telemetry frames back into time series (Reference Implementation)
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "error_handler.h"
+#include "telemetry_pack.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/**
+ * @brief Maps a signed value onto an unsigned value so small magnitudes (positive or negative)
+ *        encode into a small number of varint bytes. (0 -> 0, -1 -> 1, 1 -> 2, -2 -> 3, ...)
+ *
+ * @param value Signed value to encode
+ * @return Zigzag encoded value
+ */
+uint64_t zigzag_encode(int64_t value){
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+/**
+ * @brief Reverses 'zigzag_encode'
+ *
+ * @param value Zigzag encoded value
+ * @return Original signed value
+ */
+int64_t zigzag_decode(uint64_t value){
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * @brief Encodes a value as a little endian base-128 varint (7 data bits per byte, MSB set on
+ *        every byte except the last).
+ *
+ * @param value Value to encode
+ * @param buffer Pointer to array that will store the encoded bytes, must hold TELEM_VARINT_MAX_LEN bytes
+ * @return Number of bytes written to buffer
+ */
+uint8_t varint_encode(uint64_t value, uint8_t *buffer){
+
+    uint8_t numBytes = 0;
+
+    while (value >= 0x80){
+        buffer[numBytes++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer[numBytes++] = (uint8_t)value;
+
+    return numBytes;
+}
+
+/**
+ * @brief Decodes a varint created by 'varint_encode'
+ *
+ * @param buffer Pointer to array containing the encoded bytes
+ * @param bufferLen Number of bytes available in buffer
+ * @param value Pointer to variable that will store the decoded value
+ * @return Number of bytes consumed, 0 if the varint is truncated or malformed
+ */
+uint8_t varint_decode(const uint8_t *buffer, uint32_t bufferLen, uint64_t *value){
+
+    uint64_t result = 0;
+
+    for (uint8_t index = 0; (index < bufferLen) && (index < TELEM_VARINT_MAX_LEN); index++){
+        result |= (uint64_t)(buffer[index] & 0x7F) << (7 * index);
+        if ((buffer[index] & 0x80) == 0){
+            *value = result;
+            return index + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Appends a varint to the output buffer while checking the buffer bounds
+ *
+ * @param buffer Pointer to output buffer
+ * @param bufferLen Size of output buffer
+ * @param offset Pointer to current write position, advanced by the number of bytes written
+ * @param value Value to append
+ * @return True if the value fit in the buffer
+ */
+static bool pack_varint(uint8_t *buffer, uint32_t bufferLen, uint32_t *offset, uint64_t value){
+
+    uint8_t tempBuffer[TELEM_VARINT_MAX_LEN];
+    uint8_t numBytes = varint_encode(value, tempBuffer);
+
+    if ((*offset + numBytes) > bufferLen){
+        return false;
+    }
+    for (uint8_t index = 0; index < numBytes; index++){
+        buffer[(*offset)++] = tempBuffer[index];
+    }
+    return true;
+}
+
+/**
+ * @brief Reads a varint from the input buffer while checking the buffer bounds
+ *
+ * @param buffer Pointer to input buffer
+ * @param bufferLen Size of input buffer
+ * @param offset Pointer to current read position, advanced by the number of bytes read
+ * @param value Pointer to variable that will store the decoded value
+ * @return True if a complete varint was read
+ */
+static bool unpack_varint(const uint8_t *buffer, uint32_t bufferLen, uint32_t *offset, uint64_t *value){
+
+    uint8_t numBytes = 0;
+
+    if (*offset >= bufferLen){
+        return false;
+    }
+    numBytes = varint_decode(buffer + *offset, bufferLen - *offset, value);
+    if (numBytes == 0){
+        return false;
+    }
+    *offset += numBytes;
+    return true;
+}
+
+/**
+ * @brief Calculates the worst case size of a packed frame, can be used to size the output buffer
+ *
+ * @param series Pointer to array of time series being packed
+ * @param numSeries Number of time series in array
+ * @return Maximum number of bytes 'telemetry_pack' can produce
+ */
+uint32_t telemetry_pack_bound(const telemetry_series_t *series, uint8_t numSeries){
+
+    uint32_t bound = TELEM_PACK_HEADER_SIZE;
+
+    for (int index = 0; index < numSeries; index++){
+        // Channel ID + Sample Count + 2 varints per sample
+        bound += 1 + TELEM_VARINT_MAX_LEN + (2 * TELEM_VARINT_MAX_LEN * (uint32_t)series[index].numSamples);
+    }
+    return bound;
+}
+
+/**
+ * @brief Packs a group of time series into a compact frame for downlink to the OBC.
+ *        Timestamps are stored as delta-of-delta and values as deltas, both zigzag-varint encoded,
+ *        so a regularly sampled and slowly changing channel costs ~2 bytes per sample.
+ *
+ * @param series Pointer to array of time series to pack, one per channel
+ * @param numSeries Number of time series in array
+ * @param buffer Pointer to array that will store the packed frame
+ * @param bufferLen Size of buffer in bytes
+ * @param packedLen Pointer to variable that will store the number of bytes written
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR telemetry_pack(const telemetry_series_t *series, uint8_t numSeries, uint8_t *buffer, uint32_t bufferLen, uint32_t *packedLen){
+
+    uint32_t offset = 0;
+    int64_t prevDelta = 0;
+    int64_t delta = 0;
+
+    *packedLen = 0;
+
+    if ((numSeries > TELEM_MAX_CHANNELS) || (bufferLen < TELEM_PACK_HEADER_SIZE)){
+        return TELEM_PACK_ERROR;
+    }
+
+    buffer[offset++] = TELEM_PACK_VERSION;
+    buffer[offset++] = numSeries;
+
+    for (int index = 0; index < numSeries; index++){
+
+        const telemetry_series_t *curr = &series[index];
+
+        if (curr->numSamples > TELEM_MAX_SAMPLES){
+            return TELEM_PACK_ERROR;
+        }
+        if (offset >= bufferLen){
+            return TELEM_PACK_ERROR;
+        }
+        buffer[offset++] = curr->channel;
+        if (!pack_varint(buffer, bufferLen, &offset, curr->numSamples)){
+            return TELEM_PACK_ERROR;
+        }
+        if (curr->numSamples == 0){
+            continue;
+        }
+
+        // Timestamp Column
+        if (!pack_varint(buffer, bufferLen, &offset, curr->timestamp[0])){
+            return TELEM_PACK_ERROR;
+        }
+        prevDelta = 0;
+        for (int sample = 1; sample < curr->numSamples; sample++){
+            delta = (int64_t)(curr->timestamp[sample] - curr->timestamp[sample - 1]);
+            if (!pack_varint(buffer, bufferLen, &offset, zigzag_encode(delta - prevDelta))){
+                return TELEM_PACK_ERROR;
+            }
+            prevDelta = delta;
+        }
+
+        // Value Column
+        if (!pack_varint(buffer, bufferLen, &offset, zigzag_encode(curr->value[0]))){
+            return TELEM_PACK_ERROR;
+        }
+        for (int sample = 1; sample < curr->numSamples; sample++){
+            delta = (int64_t)curr->value[sample] - (int64_t)curr->value[sample - 1];
+            if (!pack_varint(buffer, bufferLen, &offset, zigzag_encode(delta))){
+                return TELEM_PACK_ERROR;
+            }
+        }
+    }
+
+    *packedLen = offset;
+    return NO_ERROR;
+}
+
+/**
+ * @brief Reference decoder for frames created by 'telemetry_pack'. Used by ground tools and
+ *        to verify packed frames before downlink.
+ *
+ * @param buffer Pointer to array containing the packed frame
+ * @param packedLen Number of bytes in the packed frame
+ * @param series Pointer to array of time series that will store the decoded data. Each series
+ *               must have 'timestamp', 'value' and 'maxSamples' configured by the caller.
+ * @param maxSeries Number of time series available in array
+ * @param numSeries Pointer to variable that will store the number of decoded time series
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR telemetry_unpack(const uint8_t *buffer, uint32_t packedLen, telemetry_series_t *series, uint8_t maxSeries, uint8_t *numSeries){
+
+    uint32_t offset = 0;
+    uint64_t rawVal = 0;
+    int64_t delta = 0;
+    uint8_t frameSeries = 0;
+
+    *numSeries = 0;
+
+    if (packedLen < TELEM_PACK_HEADER_SIZE){
+        return TELEM_UNPACK_ERROR;
+    }
+    if (buffer[offset++] != TELEM_PACK_VERSION){
+        return TELEM_UNPACK_ERROR;
+    }
+    frameSeries = buffer[offset++];
+    if (frameSeries > maxSeries){
+        return TELEM_UNPACK_ERROR;
+    }
+
+    for (int index = 0; index < frameSeries; index++){
+
+        telemetry_series_t *curr = &series[index];
+
+        if (offset >= packedLen){
+            return TELEM_UNPACK_ERROR;
+        }
+        curr->channel = buffer[offset++];
+        if (!unpack_varint(buffer, packedLen, &offset, &rawVal)){
+            return TELEM_UNPACK_ERROR;
+        }
+        if ((rawVal > curr->maxSamples) || (rawVal > TELEM_MAX_SAMPLES)){
+            return TELEM_UNPACK_ERROR;
+        }
+        curr->numSamples = (uint16_t)rawVal;
+        if (curr->numSamples == 0){
+            continue;
+        }
+
+        // Timestamp Column
+        if (!unpack_varint(buffer, packedLen, &offset, &rawVal)){
+            return TELEM_UNPACK_ERROR;
+        }
+        curr->timestamp[0] = rawVal;
+        delta = 0;
+        for (int sample = 1; sample < curr->numSamples; sample++){
+            if (!unpack_varint(buffer, packedLen, &offset, &rawVal)){
+                return TELEM_UNPACK_ERROR;
+            }
+            delta += zigzag_decode(rawVal);
+            curr->timestamp[sample] = curr->timestamp[sample - 1] + (uint64_t)delta;
+        }
+
+        // Value Column
+        if (!unpack_varint(buffer, packedLen, &offset, &rawVal)){
+            return TELEM_UNPACK_ERROR;
+        }
+        curr->value[0] = (int32_t)zigzag_decode(rawVal);
+        for (int sample = 1; sample < curr->numSamples; sample++){
+            if (!unpack_varint(buffer, packedLen, &offset, &rawVal)){
+                return TELEM_UNPACK_ERROR;
+            }
+            curr->value[sample] = (int32_t)(curr->value[sample - 1] + zigzag_decode(rawVal));
+        }
+    }
+
+    if (offset != packedLen){
+        return TELEM_UNPACK_ERROR;
+    }
+
+    *numSeries = frameSeries;
+    return NO_ERROR;
+}
@@ -17,7 +17,9 @@
  */
 
 #include "error_handler.h"
+#include "flight_recorder.h"
 #include "i2c.h"
+#include "log_catalog.h"
 #include "logger.h"
 #include "main.h"
 #include "temp_read.h"
@@ -50,7 +52,8 @@ enum IRIS_ERROR temp_error_code(uint8_t tempAddr, enum IRIS_ERROR errorType){
                     return TEMP4_SETUP_ERROR;
                 default:
                     // This will only happen if there is a coding error when using this function
-                    log_write(LOG_ERROR, "Invalid Temp Sensor ERROR");
+                    LOG_ERRORF("Invalid Temp Sensor ERROR");
+                    FLIGHT_FATAL();
                     exit(EXIT_FAILURE);
             }
 
@@ -66,7 +69,8 @@ enum IRIS_ERROR temp_error_code(uint8_t tempAddr, enum IRIS_ERROR errorType){
                     return TEMP4_VERIFICATION_ERROR;
                 default:
                     // This will only happen if there is a coding error when using this function
-                    log_write(LOG_ERROR, "Invalid Temp Sensor ERROR");
+                    LOG_ERRORF("Invalid Temp Sensor ERROR");
+                    FLIGHT_FATAL();
                     exit(EXIT_FAILURE);
             }
 
@@ -82,7 +86,8 @@ enum IRIS_ERROR temp_error_code(uint8_t tempAddr, enum IRIS_ERROR errorType){
                     return TEMP4_RESET_ERROR;
                 default:
                     // This will only happen if there is a coding error when using this function
-                    log_write(LOG_ERROR, "Invalid Temp Sensor ERROR");
+                    LOG_ERRORF("Invalid Temp Sensor ERROR");
+                    FLIGHT_FATAL();
                     exit(EXIT_FAILURE);
             }
 
@@ -98,7 +103,8 @@ enum IRIS_ERROR temp_error_code(uint8_t tempAddr, enum IRIS_ERROR errorType){
                     return TEMP4_TEMP_READ_ERROR;
                 default:
                     // This will only happen if there is a coding error when using this function
-                    log_write(LOG_ERROR, "Invalid Temp Sensor ERROR");
+                    LOG_ERRORF("Invalid Temp Sensor ERROR");
+                    FLIGHT_FATAL();
                     exit(EXIT_FAILURE);
             }
 
@@ -114,12 +120,14 @@ enum IRIS_ERROR temp_error_code(uint8_t tempAddr, enum IRIS_ERROR errorType){
                     return TEMP4_LIMIT_ERROR;
                 default:
                     // This will only happen if there is a coding error when using this function
-                    log_write(LOG_ERROR, "Invalid Temp Sensor ERROR");
+                    LOG_ERRORF("Invalid Temp Sensor ERROR");
+                    FLIGHT_FATAL();
                     exit(EXIT_FAILURE);
             }
         default:
             // This will only happen if there is a coding error when using this function
-            log_write(LOG_ERROR, "Invalid Temp Sensor ERROR");
+            LOG_ERRORF("Invalid Temp Sensor ERROR");
+            FLIGHT_FATAL();
             exit(EXIT_FAILURE);
     }
 }
@@ -135,20 +143,17 @@ enum IRIS_ERROR temp_setup(uint8_t tempAddr){
     int bus = 0;
     enum IRIS_ERROR tempErrorCheck = NO_ERROR;
     enum IRIS_ERROR error = NO_ERROR;
-    char logBuffer[LOG_BUFFER_SIZE];
 
     uint8_t regAddr[2] = TEMP_REG_ADDR;
     uint8_t regConfig[2] = TEMP_REG_DEFAULT; 
     uint8_t regData[2] = {0};
 
-    snprintf(logBuffer, sizeof(logBuffer), "TEMP-SETUP: Begin setup of Temperature Sensor 0x%02x",tempAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_TEMP_SETUP_BEGIN, tempAddr);
 
     //Setup I2C Interface with Temp Sensor
     bus = i2c_setup(I2C_BUS_INDEX, tempAddr);
     if (bus == I2C_SETUP_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Temp Sensor 0x%02x - I2C Bus Failed to Open", tempAddr);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_TEMP_I2C_OPEN_FAIL, tempAddr);
         return temp_error_code(tempAddr, TEMP1_SETUP_ERROR);
     }
 
@@ -158,14 +163,12 @@ enum IRIS_ERROR temp_setup(uint8_t tempAddr){
         regData[1] = regConfig[index];
         tempErrorCheck = i2c_write_reg8(bus, 2, regData);
         if (tempErrorCheck == I2C_WRITE_ERROR){
-            snprintf(logBuffer, sizeof(logBuffer), "Temp Sensor 0x%02x - I2C Reg 0x%02x Write Failed", tempAddr, regAddr[index]);
-            log_write(LOG_ERROR, logBuffer);
+            LOG_RECORD(LOGID_TEMP_I2C_WRITE_FAIL, tempAddr, regAddr[index]);
             error = temp_error_code(tempAddr, TEMP1_SETUP_ERROR);
         }
     }
 
-    snprintf(logBuffer, sizeof(logBuffer), "TEMP-SETUP: Completed attempt for setup of Temperature Sensor 0x%02x",tempAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_TEMP_SETUP_DONE, tempAddr);
 
     i2c_close(bus);
     return error;
@@ -184,20 +187,17 @@ enum IRIS_ERROR temp_func_validate(uint8_t tempAddr){
     int bus = 0;
     enum IRIS_ERROR tempErrorCheck = NO_ERROR;
     enum IRIS_ERROR error = NO_ERROR;
-    char logBuffer[LOG_BUFFER_SIZE];
 
     uint8_t regAddr[2] = TEMP_REG_ADDR;
     uint8_t regConfig[2] = TEMP_REG_DEFAULT; 
     uint8_t regData[2] = {0};
 
-    snprintf(logBuffer, sizeof(logBuffer), "TEMP-FUNC-VALIDATE: Begin functional verification of Temperature Sensor 0x%02x",tempAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_TEMP_VALIDATE_BEGIN, tempAddr);
 
     //Setup I2C Interface with Temp Sensor
     bus = i2c_setup(I2C_BUS_INDEX, tempAddr);
     if (bus == I2C_SETUP_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Temp Sensor 0x%02x - I2C Bus Failed to Open", tempAddr);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_TEMP_I2C_OPEN_FAIL, tempAddr);
         return temp_error_code(tempAddr, TEMP1_VERIFICATION_ERROR);
     }
 
@@ -205,13 +205,11 @@ enum IRIS_ERROR temp_func_validate(uint8_t tempAddr){
     for(int index = 0; index < sizeof(regAddr); index++){
         tempErrorCheck = i2c_reg8_write_read(bus, (regAddr + index), 1, regData);
         if (tempErrorCheck == I2C_WR_R_ERROR){
-            snprintf(logBuffer, sizeof(logBuffer), "Temp Sensor 0x%02x - I2C Reg 0x%02x Read Failed", tempAddr, regAddr[index]);
-            log_write(LOG_ERROR, logBuffer);
+            LOG_RECORD(LOGID_TEMP_I2C_READ_FAIL, tempAddr, regAddr[index]);
             error = temp_error_code(tempAddr, TEMP1_VERIFICATION_ERROR);
         }
         if (regData[0] != regConfig[index]){
-            snprintf(logBuffer, sizeof(logBuffer), "Temp Sensor 0x%02x - I2C Reg 0x%02x Value Incorrect 0x%02x", tempAddr, regAddr[index], regData[0]);
-            log_write(LOG_ERROR, logBuffer);
+            LOG_RECORD(LOGID_TEMP_REG_MISMATCH, tempAddr, regAddr[index], regData[0]);
             error = temp_error_code(tempAddr, TEMP1_VERIFICATION_ERROR);
         }
     }
@@ -220,25 +218,21 @@ enum IRIS_ERROR temp_func_validate(uint8_t tempAddr){
     regAddr[0] = TMP_REG_RMT_1_LOW; 
     tempErrorCheck = i2c_reg8_write_read(bus, regAddr, 1, regData);
     if (tempErrorCheck == I2C_WR_R_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Temp Sensor 0x%02x - I2C Reg 0x%02x Read Failed", tempAddr, regAddr[0]);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_TEMP_I2C_READ_FAIL, tempAddr, regAddr[0]);
         error = temp_error_code(tempAddr, TEMP1_VERIFICATION_ERROR);
     }
 
     // Check Bit[0:1] of Register
     if ((regData[0] & (0x01)) == 0x01){
-        snprintf(logBuffer, sizeof(logBuffer), "Temp Sensor 0x%02x - Open Circuit Flag Asserted in Reg 0x%02x", tempAddr, regAddr[0]);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_TEMP_OPEN_CIRCUIT, tempAddr, regAddr[0]);
         error = temp_error_code(tempAddr, TEMP1_VERIFICATION_ERROR);
     }
     if ((regData[0] & (0x02)) == 0x02){
-        snprintf(logBuffer, sizeof(logBuffer), "Temp Sensor 0x%02x - Low Supply Voltage Flag Asserted in Reg 0x%02x", tempAddr, regAddr[0]);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_TEMP_LOW_SUPPLY, tempAddr, regAddr[0]);
         error = temp_error_code(tempAddr, TEMP1_VERIFICATION_ERROR);
     }
 
-    snprintf(logBuffer, sizeof(logBuffer), "TEMP-FUNC-VALIDATE: Completed attempt for functional verification of Temperature Sensor 0x%02x",tempAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_TEMP_VALIDATE_DONE, tempAddr);
 
     i2c_close(bus);
     return error;
@@ -256,31 +250,26 @@ enum IRIS_ERROR temp_reset_trig(uint8_t tempAddr){
 
     int bus = 0;
     enum IRIS_ERROR errorCheck = NO_ERROR;
-    char logBuffer[LOG_BUFFER_SIZE];
     uint8_t regData[2] = {TMP_REG_SW_RST, 0x01};
 
-    snprintf(logBuffer, sizeof(logBuffer), "TEMP-RESET-TRIG: Begin trigger reset of Temperature Sensor 0x%02x",tempAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_TEMP_RESET_TRIG_BEGIN, tempAddr);
 
     //Setup I2C Interface with Temp Sensor
     bus = i2c_setup(I2C_BUS_INDEX, tempAddr);
     if (bus == I2C_SETUP_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Temp Sensor 0x%02x - I2C Bus Failed to Open", tempAddr);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_TEMP_I2C_OPEN_FAIL, tempAddr);
         return temp_error_code(tempAddr, TEMP1_RESET_ERROR);
     }
 
     //Sets Register reset bit in temperature sensor
     errorCheck = i2c_write_reg8(bus, 2, regData);
     if (errorCheck == I2C_WRITE_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Temp Sensor 0x%02x - I2C Reg 0x%02x Write Failed", tempAddr, regData[0]);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_TEMP_I2C_WRITE_FAIL, tempAddr, regData[0]);
         i2c_close(bus);
         return temp_error_code(tempAddr, TEMP1_RESET_ERROR);
     }
 
-    snprintf(logBuffer, sizeof(logBuffer), "TEMP-RESET-TRIG: Successfully triggered reset trigger of Temperature Sensor 0x%02x",tempAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_TEMP_RESET_TRIG_DONE, tempAddr);
 
     i2c_close(bus);
     return NO_ERROR;
@@ -297,10 +286,8 @@ enum IRIS_ERROR temp_reset(uint8_t tempAddr){
 
     int loopCounter = 0;
     enum IRIS_ERROR errorCheck = NO_ERROR;
-    char logBuffer[LOG_BUFFER_SIZE];
 
-    snprintf(logBuffer, sizeof(logBuffer), "TEMP-SENSOR-RESET: Begin reset of Temperature Sensor 0x%02x", tempAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_TEMP_RESET_BEGIN, tempAddr);
 
     errorCheck = NO_ERROR;
 
@@ -325,8 +312,7 @@ enum IRIS_ERROR temp_reset(uint8_t tempAddr){
     }while((errorCheck != NO_ERROR) && (loopCounter < MAX_TEMP_INIT_ATTEMPTS));
 
 
-    snprintf(logBuffer, sizeof(logBuffer), "TEMP-SENSOR-RESET: Finished reset attempt of Temperature Sensor 0x%02x", tempAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_TEMP_RESET_DONE, tempAddr);
 
     return errorCheck;
 }
@@ -334,65 +320,74 @@ enum IRIS_ERROR temp_reset(uint8_t tempAddr){
 /**
  * @brief Checks if temperature limit is reached on any of the sensors 
  * 
- * @param errorBuffer Pointer to Buffer containing any errors that occur during operation
+ * @param limitErrors Pointer to array of one entry per sensor that will store the errors found
+ * @param numLimitErrors Pointer to variable that will store the number of errors found
  */
-void temperature_limit(enum IRIS_ERROR *errorBuffer, uint8_t *errorCount){
+void temperature_limit(enum IRIS_ERROR *limitErrors, uint8_t *numLimitErrors){
 
-    int8_t temp1 = 0;
-    int8_t temp2 = 0;
-    int8_t temp3 = 0;
-    int8_t temp4 = 0;
+    int8_t temp[4] = {0};
 
-    char logBuffer[LOG_BUFFER_SIZE];
+    temp[0] = read_temperature(TEMP_SENSOR_1_ADDR);
+    temp[1] = read_temperature(TEMP_SENSOR_2_ADDR);
+    temp[2] = read_temperature(TEMP_SENSOR_3_ADDR);
+    temp[3] = read_temperature(TEMP_SENSOR_4_ADDR);
 
-    temp1 = read_temperature(TEMP_SENSOR_1_ADDR);
-    temp2 = read_temperature(TEMP_SENSOR_2_ADDR);
-    temp3 = read_temperature(TEMP_SENSOR_3_ADDR);
-    temp4 = read_temperature(TEMP_SENSOR_4_ADDR);
+    temperature_limit_check(temp, limitErrors, numLimitErrors);
+}
+
+/**
+ * @brief Checks temperatures that were already read against the limit of each sensor
+ * 
+ * @param temp Pointer to array of the temperature of sensor 1 - 4 as returned by 'read_temperature'
+ * @param limitErrors Pointer to array of one entry per sensor that will store the errors found
+ * @param numLimitErrors Pointer to variable that will store the number of errors found
+ */
+void temperature_limit_check(const int8_t *temp, enum IRIS_ERROR *limitErrors, uint8_t *numLimitErrors){
+
+    int8_t temp1 = temp[0];
+    int8_t temp2 = temp[1];
+    int8_t temp3 = temp[2];
+    int8_t temp4 = temp[3];
 
     //DETERMINE IF TEMPERATURE LIMIT REACHED
     if(temp1 != TEMP1_TEMP_READ_ERROR){
         if((temp1 > TEMP1_MAX) || (temp1 < TEMP1_MIN)){
-            errorBuffer[(*errorCount)++] = TEMP1_LIMIT_ERROR;
-            snprintf(logBuffer, sizeof(logBuffer), "TEMP-LIMIT: Temperature 1 Limit Reached - Measured %dC", temp1);
-            log_write(LOG_WARNING, logBuffer);
+            limitErrors[(*numLimitErrors)++] = TEMP1_LIMIT_ERROR;
+            LOG_RECORD(LOGID_TEMP_LIMIT, 1, temp1);
         }
     }else{
-        errorBuffer[(*errorCount)++] = TEMP1_TEMP_READ_ERROR;
-        log_write(LOG_WARNING, "Temp Sensor 1 - Failed to Read Temperature");
+        limitErrors[(*numLimitErrors)++] = TEMP1_TEMP_READ_ERROR;
+        LOG_WARNINGF("Temp Sensor 1 - Failed to Read Temperature");
     }
     
     if(temp2 != TEMP2_TEMP_READ_ERROR){
         if((temp2 > TEMP2_MAX) || (temp2 < TEMP2_MIN)){
-            errorBuffer[(*errorCount)++] = TEMP2_LIMIT_ERROR;
-            snprintf(logBuffer, sizeof(logBuffer), "TEMP-LIMIT: Temperature 2 Limit Reached - Measured %dC", temp2);
-            log_write(LOG_WARNING, logBuffer);
+            limitErrors[(*numLimitErrors)++] = TEMP2_LIMIT_ERROR;
+            LOG_RECORD(LOGID_TEMP_LIMIT, 2, temp2);
         }
     }else{
-        errorBuffer[(*errorCount)++] = TEMP2_TEMP_READ_ERROR;
-        log_write(LOG_WARNING, "Temp Sensor 2 - Failed to Read Temperature");
+        limitErrors[(*numLimitErrors)++] = TEMP2_TEMP_READ_ERROR;
+        LOG_WARNINGF("Temp Sensor 2 - Failed to Read Temperature");
     }
     
     if(temp3 != TEMP3_TEMP_READ_ERROR){
         if((temp3 > TEMP3_MAX) || (temp3 < TEMP3_MIN)){
-            errorBuffer[(*errorCount)++] = TEMP3_LIMIT_ERROR;
-            snprintf(logBuffer, sizeof(logBuffer), "TEMP-LIMIT: Temperature 3 Limit Reached - Measured %dC", temp3);
-            log_write(LOG_WARNING, logBuffer);
+            limitErrors[(*numLimitErrors)++] = TEMP3_LIMIT_ERROR;
+            LOG_RECORD(LOGID_TEMP_LIMIT, 3, temp3);
         }
     }else{
-        errorBuffer[(*errorCount)++] = TEMP3_TEMP_READ_ERROR;
-        log_write(LOG_WARNING, "Temp Sensor 3 - Failed to Read Temperature");
+        limitErrors[(*numLimitErrors)++] = TEMP3_TEMP_READ_ERROR;
+        LOG_WARNINGF("Temp Sensor 3 - Failed to Read Temperature");
     }
     
     if(temp4 != TEMP4_TEMP_READ_ERROR){
         if((temp4 > TEMP4_MAX) || (temp4 < TEMP4_MIN)){
-            errorBuffer[(*errorCount)++] = TEMP4_LIMIT_ERROR;
-            snprintf(logBuffer, sizeof(logBuffer), "TEMP-LIMIT: Temperature 4 Limit Reached - Measured %dC", temp4);
-            log_write(LOG_WARNING, logBuffer);
+            limitErrors[(*numLimitErrors)++] = TEMP4_LIMIT_ERROR;
+            LOG_RECORD(LOGID_TEMP_LIMIT, 4, temp4);
         }
     }else{
-        errorBuffer[(*errorCount)++] = TEMP4_TEMP_READ_ERROR;
-        log_write(LOG_WARNING, "Temp Sensor 4 - Failed to Read Temperature");
+        limitErrors[(*numLimitErrors)++] = TEMP4_TEMP_READ_ERROR;
+        LOG_WARNINGF("Temp Sensor 4 - Failed to Read Temperature");
     }
 
 }
@@ -421,7 +416,6 @@ int8_t read_temperature(uint8_t tempAddr){
 
     int bus = 0;
     enum IRIS_ERROR errorCheck = NO_ERROR;
-    char logBuffer[LOG_BUFFER_SIZE];
     int8_t temp = 0;
 
     uint8_t reg = TMP_REG_RMT_1_HIGH;
@@ -430,15 +424,14 @@ int8_t read_temperature(uint8_t tempAddr){
     //Setup I2C Interface with Temp Sensor
     bus = i2c_setup(I2C_BUS_INDEX, tempAddr);
     if (bus == I2C_SETUP_ERROR){
-        log_write(LOG_ERROR, "Temp Sensor - I2C Bus Failed to Open");
+        LOG_ERRORF("Temp Sensor - I2C Bus Failed to Open");
         return temp_error_code(tempAddr, TEMP1_TEMP_READ_ERROR);
     }
 
     //Reads temperature register in sensor
     errorCheck = i2c_reg8_write_read(bus, &reg, 2, regData);
     if (errorCheck == I2C_WR_R_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "Temp Sensor 0x%02x - I2C Temperature Reg 0x%02x Read Failed", tempAddr, regData[0]);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_TEMP_I2C_TEMP_READ_FAIL, tempAddr, regData[0]);
         i2c_close(bus);
         return temp_error_code(tempAddr, TEMP1_TEMP_READ_ERROR);
     }
@@ -446,8 +439,7 @@ int8_t read_temperature(uint8_t tempAddr){
     i2c_close(bus);
 
     temp = convert_temp_read(*regData);
-    snprintf(logBuffer, sizeof(logBuffer), "TEMP-READ: Read Temperature of %dC from Sensor 0x%02x", temp, tempAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_TEMP_READ, temp, tempAddr);
 
     return temp;
 }
\ No newline at end of file
@@ -0,0 +1,287 @@
+/**
+ * @file trace.c
+ * @author agent
+ * @brief Trace Spans for Theia CM4
+ *        Provides functions to...
+ *         - Record completed spans into a per-thread ring without locks
+ *         - Export every thread's ring as Chrome / Perfetto trace JSON into a sealed memfd or a file
+ *         - Request an export from a signal (SPI service, which does not serve commands)
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include "error_handler.h"
+#include "logger.h"
+#include "timing.h"
+#include "trace.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+typedef struct {
+    const char *name;
+    uint32_t arg;
+    uint64_t startNs;
+    uint64_t endNs;
+} trace_record_t;
+
+// One writer (the owning thread), 'head' is published after the record so the exporter can
+// detect records overwritten while it was copying
+typedef struct {
+    uint64_t head;
+    uint64_t clearPos;                  // Records before this were cleared by an export
+    uint32_t tid;
+    char threadName[16];
+    trace_record_t records[TRACE_RING_SIZE];
+} trace_ring_t;
+
+static trace_ring_t *traceRings[TRACE_MAX_THREADS];
+static uint32_t numTraceRings = 0;
+static pthread_mutex_t traceLock = PTHREAD_MUTEX_INITIALIZER;
+static __thread trace_ring_t *traceRing = NULL;
+static __thread bool traceRingFailed = false;
+static volatile sig_atomic_t traceSignalPending = 0;
+
+
+/**
+ * @brief Allocates and registers the calling thread's ring on its first span
+ *
+ * @return Pointer to ring, NULL if TRACE_MAX_THREADS rings already exist
+ */
+static trace_ring_t *trace_ring_get(void){
+
+    trace_ring_t *ring = NULL;
+
+    if ((traceRing != NULL) || traceRingFailed){
+        return traceRing;
+    }
+
+    pthread_mutex_lock(&traceLock);
+    if (numTraceRings < TRACE_MAX_THREADS){
+        ring = calloc(1, sizeof(trace_ring_t));
+    }
+    if (ring != NULL){
+        ring->tid = (uint32_t)syscall(SYS_gettid);
+        pthread_getname_np(pthread_self(), ring->threadName, sizeof(ring->threadName));
+        traceRings[numTraceRings++] = ring;
+    }
+    pthread_mutex_unlock(&traceLock);
+
+    traceRing = ring;
+    traceRingFailed = (ring == NULL);
+    return ring;
+}
+
+/**
+ * @brief Records a span that started with 'trace_begin', called automatically at the end of a
+ *        TRACE_SCOPE block
+ *
+ * @param span Pointer to span
+ */
+void trace_end(trace_span_t *span){
+
+    trace_ring_t *ring = trace_ring_get();
+    trace_record_t *record = NULL;
+    uint64_t head = 0;
+
+    if (ring == NULL){
+        return;
+    }
+
+    head = ring->head;
+    record = &ring->records[head & (TRACE_RING_SIZE - 1)];
+    record->name = span->name;
+    record->arg = span->arg;
+    record->startNs = span->startNs;
+    record->endNs = get_time_monotonic_ns();
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Writes every ring as trace JSON
+ *
+ * @param file Output stream
+ * @param clear True to drop the exported spans from the rings
+ * @param numSpans Pointer to variable that will store the number of spans written
+ * @return Iris error code indicating the success or failure of function
+ */
+static enum IRIS_ERROR trace_write(FILE *file, bool clear, uint32_t *numSpans){
+
+    static trace_record_t copy[TRACE_RING_SIZE];
+    trace_ring_t *ring = NULL;
+    uint64_t head = 0;
+    uint64_t first = 0;
+    uint64_t valid = 0;
+    uint32_t pid = (uint32_t)getpid();
+    bool comma = false;
+
+    *numSpans = 0;
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    // Serialises exports, 'copy' is shared
+    pthread_mutex_lock(&traceLock);
+    for (uint32_t index = 0; index < numTraceRings; index++){
+
+        ring = traceRings[index];
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                comma ? ",\n" : "", pid, ring->tid, (ring->threadName[0] != '\0') ? ring->threadName : "thread");
+        comma = true;
+
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        first = (head > TRACE_RING_SIZE) ? (head - TRACE_RING_SIZE) : 0;
+        first = (first > ring->clearPos) ? first : ring->clearPos;
+        for (uint64_t pos = first; pos < head; pos++){
+            copy[pos - first] = ring->records[pos & (TRACE_RING_SIZE - 1)];
+        }
+
+        // Records the owner overwrote while they were being copied are dropped, including the slot
+        // at the new head which the owner may be writing right now
+        valid = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        valid = (valid >= TRACE_RING_SIZE) ? (valid - TRACE_RING_SIZE + 1) : 0;
+        for (uint64_t pos = (first > valid) ? first : valid; pos < head; pos++){
+            const trace_record_t *record = &copy[pos - first];
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"iris\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%llu.%03llu,\"dur\":%llu.%03llu",
+                    record->name, pid, ring->tid,
+                    (unsigned long long)(record->startNs / 1000ULL), (unsigned long long)(record->startNs % 1000ULL),
+                    (unsigned long long)((record->endNs - record->startNs) / 1000ULL), (unsigned long long)((record->endNs - record->startNs) % 1000ULL));
+            if (record->arg != TRACE_ARG_NONE){
+                fprintf(file, ",\"args\":{\"arg\":%u}", record->arg);
+            }
+            fprintf(file, "}");
+            (*numSpans)++;
+        }
+        if (clear){
+            ring->clearPos = head;
+        }
+    }
+    pthread_mutex_unlock(&traceLock);
+
+    fprintf(file, "\n]}\n");
+    return ferror(file) ? TRACE_ERROR : NO_ERROR;
+}
+
+/**
+ * @brief Exports every thread's spans as trace JSON into a sealed memfd for a bulk SPI transfer
+ *
+ * @param flags TRACE_EXPORT_FLAG_*
+ * @param fd Pointer to variable that will store the sealed memfd (-1 if size only or on failure),
+ *           the caller must close it
+ * @param size Pointer to variable that will store the size of the export in bytes
+ * @param numSpans Pointer to variable that will store the number of spans exported
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR trace_export(uint8_t flags, int *fd, uint32_t *size, uint32_t *numSpans){
+
+    enum IRIS_ERROR error = NO_ERROR;
+    struct stat fileStat;
+    FILE *file = NULL;
+    int exportFd = -1;
+
+    *fd = -1;
+    *size = 0;
+    *numSpans = 0;
+
+    exportFd = memfd_create(TRACE_MEMFD_NAME, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (exportFd < 0){
+        LOG_ERRORF("TRACE: Failed to create memfd for trace export");
+        return TRACE_ERROR;
+    }
+    file = fdopen(dup(exportFd), "w");
+    if (file == NULL){
+        close(exportFd);
+        return TRACE_ERROR;
+    }
+
+    error = trace_write(file, (flags & TRACE_EXPORT_FLAG_CLEAR) != 0, numSpans);
+    if ((fclose(file) != 0) || (error != NO_ERROR) || (fstat(exportFd, &fileStat) != 0)){
+        LOG_ERRORF("TRACE: Failed to write trace export");
+        close(exportFd);
+        return TRACE_ERROR;
+    }
+    *size = (uint32_t)fileStat.st_size;
+
+    // The size is only known once the JSON is written, size only requests discard it
+    if (flags & TRACE_EXPORT_FLAG_SIZE_ONLY){
+        close(exportFd);
+        return NO_ERROR;
+    }
+    fcntl(exportFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+    *fd = exportFd;
+    return NO_ERROR;
+}
+
+/**
+ * @brief Exports every thread's spans as trace JSON to a file
+ *
+ * @param path Path of the output file
+ * @return Iris error code indicating the success or failure of function
+ */
+enum IRIS_ERROR trace_export_file(const char *path){
+
+    enum IRIS_ERROR error = NO_ERROR;
+    uint32_t numSpans = 0;
+    FILE *file = fopen(path, "w");
+
+    if (file == NULL){
+        LOG_ERRORF("TRACE: Failed to open %s", path);
+        return TRACE_ERROR;
+    }
+    error = trace_write(file, false, &numSpans);
+    if ((fclose(file) != 0) || (error != NO_ERROR)){
+        LOG_ERRORF("TRACE: Failed to write %s", path);
+        return TRACE_ERROR;
+    }
+    LOG_INFOF("TRACE: Exported %u spans to %s", numSpans, path);
+    return NO_ERROR;
+}
+
+static void trace_signal_handler(int signum){
+    (void)signum;
+    traceSignalPending = 1;
+}
+
+/**
+ * @brief Installs a handler that requests an export when 'signum' is received (e.g. SIGUSR1)
+ *
+ * @param signum Signal number
+ */
+void trace_signal_setup(int signum){
+
+    struct sigaction action;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = trace_signal_handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(signum, &action, NULL);
+}
+
+/**
+ * @brief Checks for and clears an export requested by the signal from 'trace_signal_setup'
+ *
+ * @return True if an export was requested
+ */
+bool trace_signal_pending(void){
+
+    if (traceSignalPending == 0){
+        return false;
+    }
+    traceSignalPending = 0;
+    return true;
+}
@@ -1,6 +1,7 @@
 #include "i2c.h"
 #include "main.h"
 #include "gpio.h"
+#include "log_catalog.h"
 #include "logger.h"
 #include "error_handler.h"
 #include "usb_hub.h"
@@ -152,7 +153,6 @@
 enum IRIS_ERROR usb_hub_setup(void){
 
     int bus = 0; 
-    char logBuffer[LOG_BUFFER_SIZE];
     enum IRIS_ERROR error = NO_ERROR;
 
     uint8_t hubAddr = USB_HUB_I2C_ADDR;
@@ -161,14 +161,12 @@ enum IRIS_ERROR usb_hub_setup(void){
     uint8_t regConfig[3] = {CFG_DATA_BYTE_1_POR, CFG_DATA_BYTE_2_POR, CFG_DATA_BYTE_3_POR};
     uint8_t regData[2] = {0};
 
-    snprintf(logBuffer, sizeof(logBuffer), "USB-HUB-SETUP: Begin setup of USB Hub 0x%02x", hubAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_USB_SETUP_BEGIN, hubAddr);
 
     //Setup I2C Interface with USB Hub
     bus = i2c_setup(I2C_BUS_INDEX, hubAddr);
     if (bus == I2C_SETUP_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "USB Hub 0x%02x - I2C Bus Failed to Open", hubAddr);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_USB_I2C_OPEN_FAIL, hubAddr);
         return USB_HUB_SETUP_ERROR;
     }
 
@@ -178,14 +176,12 @@ enum IRIS_ERROR usb_hub_setup(void){
         regData[1] = regConfig[index];
         error = i2c_write_reg8(bus, 2, regData);
         if (error == I2C_WRITE_ERROR){
-            snprintf(logBuffer, sizeof(logBuffer), "USB Hub 0x%02x - I2C Reg 0x%02x Write Failed", hubAddr, regAddr[index]);
-            log_write(LOG_ERROR, logBuffer);
+            LOG_RECORD(LOGID_USB_I2C_WRITE_FAIL, hubAddr, regAddr[index]);
             return USB_HUB_SETUP_ERROR;
         }
     }
 
-    snprintf(logBuffer, sizeof(logBuffer), "USB-HUB-SETUP: Completed attempt for setup of USB Hub 0x%02x",hubAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_USB_SETUP_DONE, hubAddr);
 
     i2c_close(bus);
     return error;
@@ -203,7 +199,6 @@ enum IRIS_ERROR usb_hub_func_validate(struct gpiod_line_request *gpio_request){
     int bus = 0;
     int inputVal = 0;
     enum IRIS_ERROR errorCheck = NO_ERROR;
-    char logBuffer[LOG_BUFFER_SIZE];
 
     uint8_t hubAddr = USB_HUB_I2C_ADDR;
 
@@ -211,14 +206,12 @@ enum IRIS_ERROR usb_hub_func_validate(struct gpiod_line_request *gpio_request){
     uint8_t regConfig[3] = {CFG_DATA_BYTE_1_POR, CFG_DATA_BYTE_2_POR, CFG_DATA_BYTE_3_POR};
     uint8_t regData[2] = {0};
 
-    snprintf(logBuffer, sizeof(logBuffer), "USB-HUB-FUNC-VALIDATE: Begin functional verification of USB Hub 0x%02x", hubAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_USB_VALIDATE_BEGIN, hubAddr);
 
     //Setup I2C Interface with USB Hub
     bus = i2c_setup(I2C_BUS_INDEX, hubAddr);
     if (bus == I2C_SETUP_ERROR){
-        snprintf(logBuffer, sizeof(logBuffer), "USB Hub 0x%02x - I2C Bus Failed to Open", hubAddr);
-        log_write(LOG_ERROR, logBuffer);
+        LOG_RECORD(LOGID_USB_I2C_OPEN_FAIL, hubAddr);
         return USB_HUB_VERIFICATION_ERROR;
     }
 
@@ -226,13 +219,11 @@ enum IRIS_ERROR usb_hub_func_validate(struct gpiod_line_request *gpio_request){
     for(int index = 0; index < sizeof(regAddr); index++){
         errorCheck = i2c_reg8_write_read(bus, (regAddr + index), 1, regData);
         if (errorCheck == I2C_WR_R_ERROR){
-            snprintf(logBuffer, sizeof(logBuffer), "USB Hub 0x%02x - I2C Reg 0x%02x Read Failed", hubAddr, regAddr[index]);
-            log_write(LOG_ERROR, logBuffer);
+            LOG_RECORD(LOGID_USB_I2C_READ_FAIL, hubAddr, regAddr[index]);
             return USB_HUB_VERIFICATION_ERROR;
         }
         if (regData[0] != regConfig[index]){
-            snprintf(logBuffer, sizeof(logBuffer), "USB Hub 0x%02x - I2C Reg 0x%02x Value Incorrect 0x%02x", hubAddr, regAddr[index], regData[0]);
-            log_write(LOG_ERROR, logBuffer);
+            LOG_RECORD(LOGID_USB_REG_MISMATCH, hubAddr, regAddr[index], regData[0]);
             return USB_HUB_VERIFICATION_ERROR;
         }
     }
@@ -240,18 +231,17 @@ enum IRIS_ERROR usb_hub_func_validate(struct gpiod_line_request *gpio_request){
     //Check GPIO Indicators for the USB Hub
     inputVal = gpiod_line_request_get_value(gpio_request, HUB_HS_IND);
     if(inputVal !=  HUB_HS_IND_DEF){
-        log_write(LOG_ERROR, "USB-HUB-FUNC-VALIDATE: USB Hub HS Indicator GPIO not outputing correct value");
+        LOG_ERRORF("USB-HUB-FUNC-VALIDATE: USB Hub HS Indicator GPIO not outputing correct value");
         return USB_HUB_VERIFICATION_ERROR;
     }
 
     inputVal = gpiod_line_request_get_value(gpio_request, HUB_SETUP_IND);
     if(inputVal !=  HUB_SETUP_IND_DEF){
-        log_write(LOG_ERROR, "USB-HUB-FUNC-VALIDATE: USB Hub Setup Indicator GPIO not outputing correct value");
+        LOG_ERRORF("USB-HUB-FUNC-VALIDATE: USB Hub Setup Indicator GPIO not outputing correct value");
         return USB_HUB_VERIFICATION_ERROR;
     }
 
-    snprintf(logBuffer, sizeof(logBuffer), "USB-HUB-FUNC-VALIDATE: Completed attempt for functional verification of USB Hub 0x%02x", hubAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_USB_VALIDATE_DONE, hubAddr);
 
     i2c_close(bus);
     return NO_ERROR;
@@ -268,26 +258,23 @@ enum IRIS_ERROR usb_hub_func_validate(struct gpiod_line_request *gpio_request){
 enum IRIS_ERROR usb_hub_reset_trig(struct gpiod_line_request *gpio_request){
 
     enum IRIS_ERROR errorCheck = NO_ERROR;
-    char logBuffer[LOG_BUFFER_SIZE];
 
     uint8_t hubAddr = USB_HUB_I2C_ADDR;
 
-    snprintf(logBuffer, sizeof(logBuffer), "USB-HUB-RESET: Begin reset of USB Hub 0x%02x", hubAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_USB_RESET_BEGIN, hubAddr);
 
     errorCheck = gpiod_line_request_set_value(gpio_request, HUB_RST_L, GPIOD_LINE_VALUE_INACTIVE);
     if (errorCheck == -1){
-        log_write(LOG_ERROR, "USB-HUB-RESET: Failed to assert reset GPIO USB Hub");
+        LOG_ERRORF("USB-HUB-RESET: Failed to assert reset GPIO USB Hub");
         return USB_HUB_RESET_ERROR;
     }
     errorCheck = gpiod_line_request_set_value(gpio_request, HUB_RST_L, GPIOD_LINE_VALUE_ACTIVE);
     if (errorCheck == -1){
-        log_write(LOG_ERROR, "USB-HUB-RESET: Failed to deassert reset GPIO USB Hub");
+        LOG_ERRORF("USB-HUB-RESET: Failed to deassert reset GPIO USB Hub");
         return USB_HUB_RESET_ERROR;
     }
 
-    snprintf(logBuffer, sizeof(logBuffer), "USB-HUB-RESET: Successful reset trigger of USB Hub 0x%02x", hubAddr);
-    log_write(LOG_INFO, logBuffer);
+    LOG_RECORD(LOGID_USB_RESET_DONE, hubAddr);
 
     return NO_ERROR;
 }
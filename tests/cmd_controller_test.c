@@ -0,0 +1,108 @@
+/**
+ * @file cmd_controller_test.c
+ * @author agent
+ * @brief Command Controller Tests for Theia CM4
+ *        Checks the response frames built by the command table byte by byte. Sensor drivers the
+ *        handlers call are replaced at link time (-Wl,--wrap, See 'make test') so no hardware is needed.
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "cmd_controller.h"
+#include "error_handler.h"
+
+#include <gpiod.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static enum IRIS_ERROR fakeLimitErrors[RETURN_CMD_SIZE];
+static uint8_t fakeNumLimitErrors = 0;
+static int numFailures = 0;
+
+// Fake for the current sensor driver, reports the limit errors set by the test
+void __wrap_current_limit(enum IRIS_ERROR *limitErrors, uint8_t *numLimitErrors){
+
+    for (uint8_t index = 0; index < fakeNumLimitErrors; index++){
+        limitErrors[(*numLimitErrors)++] = fakeLimitErrors[index];
+    }
+}
+
+// Provided by the service main, no CS line is used by these tests
+bool signal_edge_detect(struct gpiod_line_request *request, struct gpiod_edge_event_buffer *event_buffer){
+    (void)request;
+    (void)event_buffer;
+    return false;
+}
+
+/**
+ * @brief Runs a command through 'cmd_execute' and compares the response frame with the expected bytes
+ *
+ * @param name Name of the test case
+ * @param cmd Command byte
+ * @param expected Pointer to array of expected response bytes
+ * @param expectedLen Number of expected response bytes
+ * @param expectedError Error code the command must return
+ */
+static void check_response(const char *name, uint8_t cmd, const uint8_t *expected, uint16_t expectedLen, enum IRIS_ERROR expectedError){
+
+    uint8_t response[CMD_RESPONSE_MAX_LEN];
+    uint16_t responseLen = 0;
+    enum IRIS_ERROR error = NO_ERROR;
+    bool passed = true;
+
+    memset(response, 0xA5, sizeof(response));
+    error = cmd_execute(cmd, NULL, -1, -1, NULL, response, &responseLen);
+
+    if ((error != expectedError) || (responseLen != expectedLen)){
+        passed = false;
+    }
+    for (uint16_t index = 0; passed && (index < expectedLen); index++){
+        passed = (response[index] == expected[index]);
+    }
+
+    printf("%s  %s\n", passed ? "PASS" : "FAIL", name);
+    if (!passed){
+        printf("      error %d (expected %d), length %u (expected %u)\n      got     ", error, expectedError, responseLen, expectedLen);
+        for (uint16_t index = 0; index < responseLen; index++){
+            printf(" %02X", response[index]);
+        }
+        printf("\n      expected");
+        for (uint16_t index = 0; index < expectedLen; index++){
+            printf(" %02X", expected[index]);
+        }
+        printf("\n");
+        numFailures++;
+    }
+}
+
+int main(void){
+
+    // CURR_SENSOR_READ_LIMIT: No limit reached answers a single NO_ERROR status byte
+    uint8_t currLimitOk[] = {CMD_RETURN, NO_ERROR};
+    fakeNumLimitErrors = 0;
+    check_response("curr_limit_no_errors", CURR_SENSOR_READ_LIMIT, currLimitOk, sizeof(currLimitOk), NO_ERROR);
+
+    // CURR_SENSOR_READ_LIMIT: One status byte per limit error, in the order the driver found them
+    uint8_t currLimitErrors[] = {CMD_RETURN, CURR1_LIMIT_ERROR & 0xFF, CURR3_VAL_READ_ERROR_16BIT & 0xFF};
+    fakeLimitErrors[0] = CURR1_LIMIT_ERROR;
+    fakeLimitErrors[1] = CURR3_VAL_READ_ERROR_16BIT;
+    fakeNumLimitErrors = 2;
+    check_response("curr_limit_two_errors", CURR_SENSOR_READ_LIMIT, currLimitErrors, sizeof(currLimitErrors), CURR1_LIMIT_ERROR);
+
+    // Unregistered command byte
+    uint8_t unknownCmd[] = {CMD_RETURN, CMD_FORMAT_ERROR};
+    check_response("unregistered_command", 0, unknownCmd, sizeof(unknownCmd), CMD_FORMAT_ERROR);
+
+    // SPI_TRAIN: Never trains without the bus, the Main service of TWO_SERVICE cannot enter training
+    uint8_t spiTrainNoBus[] = {CMD_RETURN, CMD_UNSUPPORTED_ERROR};
+    check_response("spi_train_without_bus", SPI_TRAIN, spiTrainNoBus, sizeof(spiTrainNoBus), CMD_UNSUPPORTED_ERROR);
+
+    printf("%s\n", (numFailures == 0) ? "All tests passed" : "Tests FAILED");
+    return (numFailures == 0) ? 0 : 1;
+}
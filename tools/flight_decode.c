@@ -0,0 +1,172 @@
+/**
+ * @file flight_decode.c
+ * @author agent
+ * @brief Decoder for Flight Recorder Files
+ *        Prints the events of a flight recorder ring (See 'flight_recorder.h') oldest first with
+ *        wall clock timestamps, so the events leading up to a crash can be read on the ground.
+ *
+ *        Usage: flight_decode [file.rec ...]
+ *          With no arguments the Main service's previous and current rings in LOG_DIRECTORY are
+ *          decoded. Files downlinked with FLIGHT_DUMP are decoded the same way.
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "error_handler.h"
+#include "flight_recorder.h"
+#include "logger.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *flightEventNames[FLIGHT_NUM_EVENTS] = {
+    [FLIGHT_EVENT_NONE] = "NONE",
+    [FLIGHT_BOOT]       = "BOOT",
+    [FLIGHT_EXIT]       = "EXIT",
+    [FLIGHT_FATAL]      = "FATAL",
+    [FLIGHT_SIGNAL]     = "SIGNAL",
+    [FLIGHT_CMD_START]  = "CMD_START",
+    [FLIGHT_CMD_DONE]   = "CMD_DONE",
+    [FLIGHT_SPI_READ]   = "SPI_READ",
+    [FLIGHT_SPI_WRITE]  = "SPI_WRITE",
+    [FLIGHT_I2C_ERROR]  = "I2C_ERROR",
+    [FLIGHT_SPI_RECOVER] = "SPI_RECOVER",
+    [FLIGHT_SPI_TRAIN]  = "SPI_TRAIN",
+};
+
+static void decode_entry(const flight_header_t *header, const flight_entry_t *entry){
+
+    char name[13];
+    char timeStr[32];
+    struct tm tmStruct;
+    uint64_t wallNs = header->bootRealtimeNs + (entry->timestampNs - header->bootMonotonicNs);
+    time_t seconds = (time_t)(wallNs / 1000000000ULL);
+
+    localtime_r(&seconds, &tmStruct);
+    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", &tmStruct);
+    printf("%s.%06llu | %-9s ", timeStr, (unsigned long long)((wallNs % 1000000000ULL) / 1000ULL),
+           (entry->event < FLIGHT_NUM_EVENTS) ? flightEventNames[entry->event] : "UNKNOWN");
+
+    switch (entry->event){
+        case FLIGHT_BOOT:
+            printf("version %u, pid %u, session %u\n", entry->code, entry->args[0], entry->args[1]);
+            break;
+        case FLIGHT_EXIT:
+            printf("\n");
+            break;
+        case FLIGHT_FATAL:
+            memcpy(name, entry->args, 12);
+            name[12] = '\0';
+            printf("%s:%u\n", name, entry->args[3]);
+            break;
+        case FLIGHT_SIGNAL:
+            printf("signal %u (%s), code %d, address 0x%llx\n", entry->code, strsignal(entry->code), (int32_t)entry->args[0],
+                   ((unsigned long long)entry->args[2] << 32) | entry->args[1]);
+            break;
+        case FLIGHT_CMD_START:
+            printf("cmd %u, nargs %d, arg0 %u\n", entry->code, (int32_t)entry->args[0], entry->args[1]);
+            break;
+        case FLIGHT_CMD_DONE:
+            printf("cmd %u, error %u, %u us\n", entry->code, entry->args[0], entry->args[1]);
+            break;
+        case FLIGHT_SPI_READ:
+        case FLIGHT_SPI_WRITE:
+            printf("error %u, len %u, ret %d, %u ns, %u retries\n", entry->code, entry->args[0], (int32_t)entry->args[1],
+                   entry->args[2], entry->args[3]);
+            break;
+        case FLIGHT_I2C_ERROR:
+            printf("error %u, op %u, len %u, ret %d, errno %u (%s)\n", entry->code, entry->args[0], entry->args[1],
+                   (int32_t)entry->args[2], entry->args[3], strerror((int)entry->args[3]));
+            break;
+        case FLIGHT_SPI_RECOVER:
+            printf("error %u, tier %u, result %u, errno %u (%s), %u us\n", entry->code, entry->args[0], entry->args[1],
+                   entry->args[2], strerror((int)entry->args[2]), entry->args[3]);
+            break;
+        case FLIGHT_SPI_TRAIN:
+            printf("error %u, selected %u Hz, fastest %u Hz, %u bit errors, %u ms\n", entry->code, entry->args[0], entry->args[1],
+                   entry->args[2], entry->args[3]);
+            break;
+        default:
+            printf("code %u, args %u %u %u %u\n", entry->code, entry->args[0], entry->args[1], entry->args[2], entry->args[3]);
+            break;
+    }
+}
+
+static bool decode_file(const char *path){
+
+    static flight_entry_t entries[FLIGHT_NUM_ENTRIES];
+    flight_header_t header;
+    const flight_entry_t *entry = NULL;
+    uint64_t firstPos = 0;
+    uint64_t numIncomplete = 0;
+    uint64_t numEvents = 0;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL){
+        fprintf(stderr, "ERROR: Unable to open flight recorder %s\n", path);
+        return false;
+    }
+    if ((fread(&header, sizeof(header), 1, file) != 1) || (header.magic != FLIGHT_MAGIC)){
+        fprintf(stderr, "ERROR: %s is not a flight recorder file\n", path);
+        fclose(file);
+        return false;
+    }
+    if ((header.version != FLIGHT_VERSION) || (header.entrySize != sizeof(flight_entry_t)) || (header.numEntries != FLIGHT_NUM_ENTRIES)){
+        fprintf(stderr, "ERROR: Unsupported flight recorder layout in %s (version %u, %u x %u bytes)\n", path,
+                header.version, header.numEntries, header.entrySize);
+        fclose(file);
+        return false;
+    }
+    if (fread(entries, sizeof(flight_entry_t), FLIGHT_NUM_ENTRIES, file) != FLIGHT_NUM_ENTRIES){
+        fprintf(stderr, "ERROR: %s is truncated\n", path);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    printf("==== %s: session %u, pid %u, %llu events ====\n", path, header.session, header.pid, (unsigned long long)header.writePos);
+
+    // The ring holds the last FLIGHT_NUM_ENTRIES positions, a position whose entry does not carry its
+    // sequence number was still being written (or was never written) when the file was captured
+    firstPos = (header.writePos > FLIGHT_NUM_ENTRIES) ? (header.writePos - FLIGHT_NUM_ENTRIES) : 0;
+    for (uint64_t pos = firstPos; pos < header.writePos; pos++){
+        entry = &entries[pos & (FLIGHT_NUM_ENTRIES - 1)];
+        if (entry->seq != (uint32_t)(pos + 1)){
+            numIncomplete++;
+            continue;
+        }
+        decode_entry(&header, entry);
+        numEvents++;
+    }
+
+    fprintf(stderr, "Flight Decode: %s, %llu events shown, %llu overwritten, %llu incomplete\n", path,
+            (unsigned long long)numEvents, (unsigned long long)firstPos, (unsigned long long)numIncomplete);
+    return true;
+}
+
+int main(int argc, char **argv){
+
+    char path[LOG_FILE_PATH_LEN];
+    bool ok = true;
+
+    if (argc > 1){
+        for (int arg = 1; arg < argc; arg++){
+            ok &= decode_file(argv[arg]);
+        }
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s%s.rec", LOG_DIRECTORY, FLIGHT_BASENAME, FLIGHT_PREV_SUFFIX);
+    ok &= decode_file(path);
+    snprintf(path, sizeof(path), "%s/%s.rec", LOG_DIRECTORY, FLIGHT_BASENAME);
+    ok &= decode_file(path);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,452 @@
+/**
+ * @file ipc_bench.c
+ * @author agent
+ * @brief Benchmark for the Main / SPI Service IPC Transports
+ *        Measures round trip latency percentiles and sustained one-way throughput of every
+ *        transport used between the services, so the cost of the TWO_SERVICE split can be
+ *        compared against ONE_SERVICE and regressions caught.
+ *          - inproc : ONE_SERVICE baseline, payload is handed over in the same process
+ *          - sysv   : SysV message queue, payload chopped into MSG_SIZE messages
+ *          - ring   : Shared memory SPSC ring with futex wake ups ('ipc_ring.h')
+ *          - fd     : memfd passed with SCM_RIGHTS, acknowledged over the ring ('ipc_fd.h')
+ *
+ *        Each latency sample sends one payload from the client process to a forked server
+ *        process, the server reads every byte and replies with an 8 byte acknowledgement.
+ *        Throughput streams payloads one-way and only the last one is acknowledged.
+ *
+ *        Usage: ipc_bench [iterations]
+ *          Uses private queues and anonymous shared memory, but the 'fd' transport binds the
+ *          bulk data socket name and is skipped while the SPI service is running.
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "cmd_controller.h"
+#include "error_handler.h"
+#include "ipc_fd.h"
+#include "ipc_iris.h"
+#include "ipc_ring.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/msg.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DEFAULT_ITERATIONS    2000
+#define BENCH_WARMUP_ITERATIONS     100
+#define BENCH_THROUGHPUT_BYTES      (64ULL * 1024 * 1024)   // Streamed per size during throughput run
+#define BENCH_MAX_PAYLOAD           (64 * 1024)
+#define BENCH_ACK_SIZE              8
+#define BENCH_WAIT_MS               1000
+
+// Every payload starts with a header telling the server what to do with it
+enum BENCH_MODE{
+    BENCH_MODE_ACK  = 0,    // Acknowledge this payload
+    BENCH_MODE_SINK = 1,    // Consume without acknowledging (throughput stream)
+    BENCH_MODE_EXIT = 2     // Server exits
+};
+
+typedef struct {
+    uint32_t len;
+    uint32_t mode;
+} bench_header_t;
+
+typedef enum BENCH_TRANSPORT{
+    BENCH_INPROC,
+    BENCH_SYSV,
+    BENCH_RING,
+    BENCH_FD,
+    BENCH_NUM_TRANSPORTS
+} BENCH_TRANSPORT;
+
+static const char *benchTransportName[BENCH_NUM_TRANSPORTS] = {"inproc", "sysv", "ring", "fd"};
+static const uint32_t benchSizes[] = {8, 64, 512, 4096, 16384, 65536};
+
+typedef struct {
+    enum BENCH_TRANSPORT transport;
+    int reqQueue;                   // SysV: Client -> Server
+    int ackQueue;                   // SysV: Server -> Client
+    ipc_ring_region_t *region;      // Ring / fd: Anonymous shared memory shared across the fork
+    ipc_link_t link;                // This process's side of the rings and fd socket
+    uint8_t *payload;
+    uint8_t *scratch;
+    pid_t server;
+} bench_ctx_t;
+
+static volatile uint64_t benchSink;
+
+static uint64_t bench_now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+// Reads every byte of a payload the way the SPI service would before writing it to the bus
+static uint64_t bench_consume(const uint8_t *data, uint32_t len){
+
+    uint64_t sum = 0;
+
+    for (uint32_t index = 0; index < len; index += sizeof(uint64_t)){
+        uint64_t word = 0;
+        memcpy(&word, data + index, ((len - index) < sizeof(word)) ? (len - index) : sizeof(word));
+        sum += word;
+    }
+    return sum;
+}
+
+static int compare_u64(const void *a, const void *b){
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*---- SysV Message Queue ----*/
+
+static void sysv_send(int queue, const uint8_t *data, uint32_t len){
+
+    struct msg_buffer msg;
+    uint32_t offset = 0;
+
+    msg.msg_type = CMD_SPI_TO_MAIN;
+    msg.msg_type_rx = CMD_MAIN_TO_SPI;
+    do {
+        uint32_t chunk = ((len - offset) > MSG_SIZE) ? MSG_SIZE : (len - offset);
+        memcpy(msg.msg_text, data + offset, chunk);
+        while (msgsnd(queue, &msg, sizeof(msg.msg_type_rx) + sizeof(msg.msg_text), 0) == -1){
+            sched_yield();
+        }
+        offset += chunk;
+    } while (offset < len);
+}
+
+static uint32_t sysv_receive(int queue, uint8_t *data){
+
+    struct msg_buffer msg;
+    bench_header_t header;
+    uint32_t offset = 0;
+
+    do {
+        if (msgrcv(queue, &msg, sizeof(msg.msg_type_rx) + sizeof(msg.msg_text), 0, 0) == -1){
+            return 0;
+        }
+        if (offset == 0){
+            memcpy(&header, msg.msg_text, sizeof(header));
+        }
+        uint32_t chunk = ((header.len - offset) > MSG_SIZE) ? MSG_SIZE : (header.len - offset);
+        memcpy(data + offset, msg.msg_text, chunk);
+        offset += chunk;
+    } while (offset < header.len);
+    return header.len;
+}
+
+/*---- Shared Memory Ring ----*/
+
+static void ring_send(ipc_ring_t *ring, const uint8_t *data, uint32_t len){
+
+    uint8_t *record = NULL;
+
+    // Producer has no futex to sleep on, yield until the consumer frees space
+    while ((record = ipc_ring_reserve(ring, CMD_SPI_TO_MAIN, IPC_REQUEST_ID_NONE, len)) == NULL){
+        sched_yield();
+    }
+    memcpy(record, data, len);
+    ipc_ring_commit(ring, len);
+}
+
+static const uint8_t *ring_receive(ipc_ring_t *ring, uint32_t *len){
+
+    uint16_t label = 0;
+    uint32_t requestId = IPC_REQUEST_ID_NONE;
+    const uint8_t *record = NULL;
+
+    while ((record = ipc_ring_peek(ring, &label, &requestId, len)) == NULL){
+        ipc_ring_wait(ring, BENCH_WAIT_MS);
+    }
+    return record;
+}
+
+/*---- Server Process ----*/
+
+static void bench_server_ack(bench_ctx_t *ctx){
+
+    uint8_t ack[BENCH_ACK_SIZE] = {CMD_RETURN, NO_ERROR};
+
+    if (ctx->transport == BENCH_SYSV){
+        struct msg_buffer msg;
+        msg.msg_type = CMD_MAIN_TO_SPI;
+        msg.msg_type_rx = CMD_SPI_TO_MAIN;
+        memcpy(msg.msg_text, ack, sizeof(ack));
+        msgsnd(ctx->ackQueue, &msg, sizeof(ack) + sizeof(msg.msg_type_rx), 0);
+    }else{
+        ring_send(&ctx->link.txRing, ack, sizeof(ack));
+    }
+}
+
+static void bench_server(bench_ctx_t *ctx){
+
+    bench_header_t header;
+    ipc_fd_transfer_t transfer;
+    struct pollfd pfd;
+    const uint8_t *data = NULL;
+    uint8_t *mapping = NULL;
+    uint32_t len = 0;
+
+    while (true){
+        switch (ctx->transport){
+            case BENCH_SYSV:
+                len = sysv_receive(ctx->reqQueue, ctx->scratch);
+                benchSink += bench_consume(ctx->scratch, len);
+                memcpy(&header, ctx->scratch, sizeof(header));
+                break;
+
+            case BENCH_RING:
+                data = ring_receive(&ctx->link.rxRing, &len);
+                benchSink += bench_consume(data, len);
+                memcpy(&header, data, sizeof(header));
+                ipc_ring_release(&ctx->link.rxRing);
+                break;
+
+            default:
+                // Same path as 'spi_fd_write', the payload is read straight from a mapping
+                pfd.fd = ctx->link.fdSocket;
+                pfd.events = POLLIN;
+                poll(&pfd, 1, BENCH_WAIT_MS);
+                if (!ipc_fd_receive(&ctx->link, &transfer)){
+                    continue;
+                }
+                mapping = mmap(NULL, transfer.msg.len, PROT_READ, MAP_SHARED, transfer.fd, 0);
+                if (mapping == MAP_FAILED){
+                    close(transfer.fd);
+                    _exit(EXIT_FAILURE);
+                }
+                benchSink += bench_consume(mapping, (uint32_t)transfer.msg.len);
+                memcpy(&header, mapping, sizeof(header));
+                munmap(mapping, transfer.msg.len);
+                close(transfer.fd);
+                break;
+        }
+
+        if (header.mode == BENCH_MODE_EXIT){
+            _exit(EXIT_SUCCESS);
+        }
+        if (header.mode == BENCH_MODE_ACK){
+            bench_server_ack(ctx);
+        }
+    }
+}
+
+/*---- Client ----*/
+
+// Sends one payload and, if it must be acknowledged, waits for the acknowledgement
+static void bench_transfer(bench_ctx_t *ctx, uint32_t len, uint32_t mode){
+
+    bench_header_t header = {.len = len, .mode = mode};
+    uint32_t ackLen = 0;
+
+    memcpy(ctx->payload, &header, sizeof(header));
+
+    switch (ctx->transport){
+        case BENCH_INPROC:
+            // ONE_SERVICE: command handler reads the request and builds its response in place
+            memcpy(ctx->scratch, ctx->payload, len);
+            benchSink += bench_consume(ctx->scratch, len);
+            memset(ctx->scratch, 0, BENCH_ACK_SIZE);
+            return;
+
+        case BENCH_SYSV:
+            sysv_send(ctx->reqQueue, ctx->payload, len);
+            if (mode == BENCH_MODE_ACK){
+                struct msg_buffer msg;
+                msgrcv(ctx->ackQueue, &msg, sizeof(msg.msg_type_rx) + sizeof(msg.msg_text), 0, 0);
+            }
+            return;
+
+        case BENCH_RING:
+            ring_send(&ctx->link.txRing, ctx->payload, len);
+            break;
+
+        default:
+            ipc_fd_send_buffer(&ctx->link, IPC_REQUEST_ID_NONE, ctx->payload, len);
+            break;
+    }
+
+    if (mode == BENCH_MODE_ACK){
+        ring_receive(&ctx->link.rxRing, &ackLen);
+        ipc_ring_release(&ctx->link.rxRing);
+    }
+}
+
+static int bench_start(bench_ctx_t *ctx, enum BENCH_TRANSPORT transport){
+
+    memset(&ctx->link, 0, sizeof(ctx->link));
+    ctx->transport = transport;
+    ctx->server = 0;
+    ctx->link.fdSocket = -1;
+
+    switch (transport){
+        case BENCH_INPROC:
+            return 0;
+
+        case BENCH_SYSV:
+            ctx->reqQueue = msgget(IPC_PRIVATE, 0600 | IPC_CREAT);
+            ctx->ackQueue = msgget(IPC_PRIVATE, 0600 | IPC_CREAT);
+            if ((ctx->reqQueue == -1) || (ctx->ackQueue == -1)){
+                return -1;
+            }
+            break;
+
+        default:
+            memset(ctx->region, 0, sizeof(*ctx->region));
+            if (transport == BENCH_FD){
+                ipc_link_t probe;
+                if (ipc_fd_open(&probe, IPC_SIDE_SPI) != NO_ERROR){
+                    return -1;
+                }
+                ctx->link.fdSocket = probe.fdSocket;
+            }
+            break;
+    }
+
+    ctx->server = fork();
+    if (ctx->server < 0){
+        return -1;
+    }
+    if (ctx->server == 0){
+        // Server plays the SPI service: receives on spiToMain's opposite ring
+        ipc_ring_attach(&ctx->link.txRing, &ctx->region->spiToMain);
+        ipc_ring_attach(&ctx->link.rxRing, &ctx->region->mainToSpi);
+        bench_server(ctx);
+    }
+
+    // Client plays the Main service, its fd socket only sends and may block when the server lags
+    ipc_ring_attach(&ctx->link.txRing, &ctx->region->mainToSpi);
+    ipc_ring_attach(&ctx->link.rxRing, &ctx->region->spiToMain);
+    if (transport == BENCH_FD){
+        close(ctx->link.fdSocket);
+        if (ipc_fd_open(&ctx->link, IPC_SIDE_MAIN) != NO_ERROR){
+            return -1;
+        }
+        fcntl(ctx->link.fdSocket, F_SETFL, fcntl(ctx->link.fdSocket, F_GETFL) & ~O_NONBLOCK);
+    }
+    return 0;
+}
+
+static void bench_stop(bench_ctx_t *ctx){
+
+    if (ctx->server > 0){
+        bench_transfer(ctx, sizeof(bench_header_t), BENCH_MODE_EXIT);
+        waitpid(ctx->server, NULL, 0);
+    }
+    if (ctx->transport == BENCH_SYSV){
+        msgctl(ctx->reqQueue, IPC_RMID, NULL);
+        msgctl(ctx->ackQueue, IPC_RMID, NULL);
+    }
+    ipc_fd_close(&ctx->link);
+}
+
+static void bench_size(bench_ctx_t *ctx, uint32_t len, int iterations, uint64_t *samples){
+
+    uint64_t startTime = 0;
+    uint64_t elapsed = 0;
+    uint64_t numMessages = BENCH_THROUGHPUT_BYTES / len;
+
+    if (len < sizeof(bench_header_t)){
+        len = sizeof(bench_header_t);
+    }
+    if (numMessages > 200000){
+        numMessages = 200000;
+    }
+
+    for (int iter = 0; iter < BENCH_WARMUP_ITERATIONS; iter++){
+        bench_transfer(ctx, len, BENCH_MODE_ACK);
+    }
+    for (int iter = 0; iter < iterations; iter++){
+        startTime = bench_now_ns();
+        bench_transfer(ctx, len, BENCH_MODE_ACK);
+        samples[iter] = bench_now_ns() - startTime;
+    }
+    qsort(samples, (size_t)iterations, sizeof(uint64_t), compare_u64);
+
+    startTime = bench_now_ns();
+    for (uint64_t msg = 1; msg < numMessages; msg++){
+        bench_transfer(ctx, len, BENCH_MODE_SINK);
+    }
+    bench_transfer(ctx, len, BENCH_MODE_ACK);
+    elapsed = bench_now_ns() - startTime;
+
+    printf("  %-6s %6u B | %8.1f %8.1f %8.1f %8.1f %9.1f | %10.0f %9.1f\n",
+           benchTransportName[ctx->transport], len,
+           samples[iterations / 2] / 1e3,
+           samples[(iterations * 90) / 100] / 1e3,
+           samples[(iterations * 99) / 100] / 1e3,
+           samples[(iterations * 999) / 1000] / 1e3,
+           samples[iterations - 1] / 1e3,
+           (double)numMessages / (elapsed / 1e9),
+           ((double)numMessages * len) / (elapsed / 1e9) / 1e6);
+}
+
+int main(int argc, char **argv){
+
+    bench_ctx_t ctx;
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+    uint64_t *samples = NULL;
+
+    if (argc > 1){
+        iterations = atoi(argv[1]);
+        if (iterations < 10){
+            printf("ERROR: Need at least 10 iterations\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.payload = malloc(BENCH_MAX_PAYLOAD);
+    ctx.scratch = malloc(BENCH_MAX_PAYLOAD);
+    samples = malloc(sizeof(uint64_t) * (size_t)iterations);
+    ctx.region = mmap(NULL, sizeof(ipc_ring_region_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if ((ctx.payload == NULL) || (ctx.scratch == NULL) || (samples == NULL) || (ctx.region == MAP_FAILED)){
+        printf("ERROR: Unable to allocate benchmark buffers\n");
+        return EXIT_FAILURE;
+    }
+    for (uint32_t index = 0; index < BENCH_MAX_PAYLOAD; index++){
+        ctx.payload[index] = (uint8_t)(index * 31);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("IPC Bench: %d round trips per size, %llu MB streamed per size\n", iterations, BENCH_THROUGHPUT_BYTES / (1024 * 1024));
+    printf("  %-6s %8s | %8s %8s %8s %8s %9s | %10s %9s\n", "", "", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us", "msg/s", "MB/s");
+
+    for (int transport = 0; transport < BENCH_NUM_TRANSPORTS; transport++){
+        if (bench_start(&ctx, transport) != 0){
+            printf("  %-6s skipped, transport unavailable\n", benchTransportName[transport]);
+            if (ctx.server > 0){
+                kill(ctx.server, SIGKILL);
+                waitpid(ctx.server, NULL, 0);
+            }
+            continue;
+        }
+        for (size_t size = 0; size < (sizeof(benchSizes) / sizeof(benchSizes[0])); size++){
+            bench_size(&ctx, benchSizes[size], iterations, samples);
+        }
+        bench_stop(&ctx);
+    }
+
+    munmap(ctx.region, sizeof(ipc_ring_region_t));
+    free(samples);
+    free(ctx.scratch);
+    free(ctx.payload);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+/**
+ * @file iris_stat.c
+ * @author agent
+ * @brief Live Reader for the Metrics Registry
+ *        Maps the services' shared memory metrics segment (See 'metrics.h') read-only and prints
+ *        every counter, gauge, latency histogram and command count. The services are not signalled
+ *        or slowed down, the segment is only read.
+ *
+ *        Usage: iris-stat [-w seconds] [-a]
+ *          -w  Print again every 'seconds' with the per second rate of each counter
+ *          -a  Also print metrics that are still 0
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "metrics.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    const char *name;
+    const char *description;
+    enum METRIC_TYPE type;
+} metric_info_t;
+
+#define METRICS_INFO(id, type, name, description) [id] = {name, description, type},
+static const metric_info_t metricInfo[METRIC_NUM] = {
+    METRICS_CATALOG(METRICS_INFO)
+};
+#undef METRICS_INFO
+
+#define METRICS_HIST_INFO(id, name, description) [id] = {name, description, METRIC_COUNTER},
+static const metric_info_t metricHistInfo[METRIC_HIST_NUM] = {
+    METRICS_HIST_CATALOG(METRICS_HIST_INFO)
+};
+#undef METRICS_HIST_INFO
+
+// Copy of the segment taken once per print, rates are the difference of two copies
+typedef struct {
+    uint64_t values[METRIC_NUM];
+    metrics_hist_t hists[METRIC_HIST_NUM];
+    uint64_t cmdCounts[METRICS_NUM_CMDS];
+} metrics_snapshot_t;
+
+static void snapshot_take(const metrics_region_t *region, metrics_snapshot_t *snapshot){
+
+    for (int id = 0; id < METRIC_NUM; id++){
+        snapshot->values[id] = __atomic_load_n(&region->values[id], __ATOMIC_RELAXED);
+    }
+    for (int id = 0; id < METRIC_HIST_NUM; id++){
+        snapshot->hists[id].count = __atomic_load_n(&region->hists[id].count, __ATOMIC_RELAXED);
+        snapshot->hists[id].sumUs = __atomic_load_n(&region->hists[id].sumUs, __ATOMIC_RELAXED);
+        snapshot->hists[id].maxUs = __atomic_load_n(&region->hists[id].maxUs, __ATOMIC_RELAXED);
+        for (int bucket = 0; bucket < METRICS_HIST_BUCKETS; bucket++){
+            snapshot->hists[id].buckets[bucket] = __atomic_load_n(&region->hists[id].buckets[bucket], __ATOMIC_RELAXED);
+        }
+    }
+    for (int cmd = 0; cmd < METRICS_NUM_CMDS; cmd++){
+        snapshot->cmdCounts[cmd] = __atomic_load_n(&region->cmdCounts[cmd], __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Estimates a percentile from the histogram buckets, reported as the upper bound of the
+ *        bucket it falls in (never above the largest value seen)
+ *
+ * @param hist Pointer to histogram
+ * @param fraction Percentile as a fraction (0.99 for p99)
+ * @return Percentile in micro-seconds
+ */
+static uint64_t hist_percentile(const metrics_hist_t *hist, double fraction){
+
+    uint64_t target = (uint64_t)((double)hist->count * fraction + 0.5);
+    uint64_t seen = 0;
+    uint64_t upperUs = 0;
+
+    if (target == 0){
+        target = 1;
+    }
+    for (int bucket = 0; bucket < METRICS_HIST_BUCKETS; bucket++){
+        seen += hist->buckets[bucket];
+        if (seen >= target){
+            upperUs = (bucket == (METRICS_HIST_BUCKETS - 1)) ? hist->maxUs : (1ULL << bucket);
+            return (upperUs < hist->maxUs) ? upperUs : hist->maxUs;
+        }
+    }
+    return hist->maxUs;
+}
+
+static void print_snapshot(const metrics_region_t *region, const metrics_snapshot_t *now, const metrics_snapshot_t *prev,
+                           double intervalS, bool showAll){
+
+    const metrics_hist_t *hist = NULL;
+    time_t created = (time_t)region->createdRealtimeS;
+    char timeStr[32];
+    struct tm tmStruct;
+
+    localtime_r(&created, &tmStruct);
+    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", &tmStruct);
+    printf("==== %s (since %s) ====\n", METRICS_SHM_NAME, timeStr);
+
+    printf("%-20s %16s %12s  %s\n", "METRIC", "VALUE", (prev != NULL) ? "RATE/S" : "", "DESCRIPTION");
+    for (int id = 0; id < METRIC_NUM; id++){
+        if (!showAll && (now->values[id] == 0) && ((prev == NULL) || (prev->values[id] == 0))){
+            continue;
+        }
+        printf("%-20s %16llu ", metricInfo[id].name, (unsigned long long)now->values[id]);
+        if ((prev != NULL) && (metricInfo[id].type == METRIC_COUNTER)){
+            printf("%12.1f  ", (double)(now->values[id] - prev->values[id]) / intervalS);
+        }else{
+            printf("%12s  ", (metricInfo[id].type == METRIC_GAUGE) ? "gauge" : "");
+        }
+        printf("%s\n", metricInfo[id].description);
+    }
+
+    printf("\n%-20s %12s %10s %10s %10s %10s %10s\n", "HISTOGRAM", "COUNT", "MEAN_US", "P50_US", "P90_US", "P99_US", "MAX_US");
+    for (int id = 0; id < METRIC_HIST_NUM; id++){
+        hist = &now->hists[id];
+        if (!showAll && (hist->count == 0)){
+            continue;
+        }
+        printf("%-20s %12llu %10llu %10llu %10llu %10llu %10llu\n", metricHistInfo[id].name, (unsigned long long)hist->count,
+               (unsigned long long)((hist->count != 0) ? (hist->sumUs / hist->count) : 0),
+               (unsigned long long)hist_percentile(hist, 0.50), (unsigned long long)hist_percentile(hist, 0.90),
+               (unsigned long long)hist_percentile(hist, 0.99), (unsigned long long)hist->maxUs);
+    }
+
+    printf("\n%-20s %12s\n", "COMMAND", "COUNT");
+    for (int cmd = 0; cmd < METRICS_NUM_CMDS; cmd++){
+        if (now->cmdCounts[cmd] != 0){
+            printf("0x%02X (%3d)           %12llu\n", cmd, cmd, (unsigned long long)now->cmdCounts[cmd]);
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+int main(int argc, char **argv){
+
+    static metrics_snapshot_t snapshots[2];
+    const metrics_region_t *region = NULL;
+    struct stat fileStat;
+    int fileDesc = 0;
+    int opt = 0;
+    int current = 0;
+    double intervalS = 0;
+    bool showAll = false;
+
+    while ((opt = getopt(argc, argv, "w:a")) != -1){
+        switch (opt){
+            case 'w':
+                intervalS = atof(optarg);
+                break;
+            case 'a':
+                showAll = true;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-w seconds] [-a]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    fileDesc = shm_open(METRICS_SHM_NAME, O_RDONLY, 0);
+    if (fileDesc < 0){
+        fprintf(stderr, "ERROR: Unable to open /dev/shm%s, no service has started since boot\n", METRICS_SHM_NAME);
+        return EXIT_FAILURE;
+    }
+    // A segment smaller than this build's layout would fault when read past its end
+    if ((fstat(fileDesc, &fileStat) != 0) || ((size_t)fileStat.st_size < sizeof(metrics_region_t))){
+        fprintf(stderr, "ERROR: /dev/shm%s was created by a different build (%lld bytes)\n", METRICS_SHM_NAME, (long long)fileStat.st_size);
+        close(fileDesc);
+        return EXIT_FAILURE;
+    }
+    region = mmap(NULL, sizeof(metrics_region_t), PROT_READ, MAP_SHARED, fileDesc, 0);
+    close(fileDesc);
+    if (region == MAP_FAILED){
+        fprintf(stderr, "ERROR: Unable to map /dev/shm%s\n", METRICS_SHM_NAME);
+        return EXIT_FAILURE;
+    }
+    if ((region->magic != METRICS_MAGIC) || (region->numMetrics != METRIC_NUM) || (region->numHists != METRIC_HIST_NUM)){
+        fprintf(stderr, "ERROR: /dev/shm%s was created by a different build (0x%08X, %u metrics, %u histograms)\n",
+                METRICS_SHM_NAME, region->magic, region->numMetrics, region->numHists);
+        return EXIT_FAILURE;
+    }
+
+    snapshot_take(region, &snapshots[current]);
+    print_snapshot(region, &snapshots[current], NULL, 0, showAll);
+    while (intervalS > 0){
+        usleep((useconds_t)(intervalS * 1000000.0));
+        current ^= 1;
+        snapshot_take(region, &snapshots[current]);
+        print_snapshot(region, &snapshots[current], &snapshots[current ^ 1], intervalS, showAll);
+    }
+    return EXIT_SUCCESS;
+}
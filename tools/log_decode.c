@@ -0,0 +1,221 @@
+/**
+ * @file log_decode.c
+ * @author agent
+ * @brief Decoder for Binary Log Files
+ *        Formats the binary records written by the logger (LOG_BINARY) back into the same text
+ *        lines the text log uses, using the message catalog compiled into this tool.
+ *
+ *        Usage: log_decode [base name | segment.bin | export.gz ...]
+ *          With no arguments (or a log base name such as Iris_Spi_Log) every segment listed in
+ *          the log's index is decoded, oldest first. Exports downlinked with LOG_EXPORT are
+ *          decoded directly from the gzip file. Decoded text is written to stdout, a summary
+ *          comparing the binary size against the equivalent text log is written to stderr.
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "log_catalog.h"
+#include "log_export.h"
+#include "log_segment.h"
+#include "logger.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+typedef struct {
+    uint64_t numRecords;
+    uint64_t numUnknown;
+    uint64_t binBytes;
+    uint64_t textBytes;
+} decode_stats_t;
+
+static const char *decode_level(uint8_t logLev){
+
+    switch (logLev){
+        case LOG_ERROR:
+            return "ERROR";
+        case LOG_WARNING:
+            return "WARN ";
+        case LOG_DEBUG:
+            return "DEBUG";
+        default:
+            return "INFO ";
+    }
+}
+
+static bool decode_read(gzFile file, void *data, size_t len, uint64_t *remaining){
+
+    if ((len > *remaining) || (gzread(file, data, (unsigned)len) != (int)len)){
+        return false;
+    }
+    *remaining -= len;
+    return true;
+}
+
+static bool decode_segment(gzFile file, uint64_t size, const char *name, decode_stats_t *stats){
+
+    char msg[LOG_BUFFER_SIZE + 1];
+    log_bin_header_t header;
+    log_bin_record_t record;
+    uint32_t args[LOG_RECORD_MAX_ARGS];
+    uint8_t skip[64];
+    uint16_t textLen = 0;
+    uint64_t remaining = size;
+    struct tm tmStruct;
+    time_t seconds = 0;
+    int lineLen = 0;
+    bool ok = true;
+
+    if (!decode_read(file, &header, sizeof(header), &remaining) || (header.magic != LOG_BIN_MAGIC)){
+        fprintf(stderr, "ERROR: %s is not a binary log file\n", name);
+        return false;
+    }
+    if (header.version != LOG_BIN_VERSION){
+        fprintf(stderr, "ERROR: Unsupported binary log version %u\n", header.version);
+        return false;
+    }
+    if (header.catalogHash != log_catalog_hash()){
+        fprintf(stderr, "WARNING: Log was written with a different message catalog (0x%08X, tool 0x%08X), messages may decode incorrectly\n",
+                header.catalogHash, log_catalog_hash());
+    }
+    if ((header.headerSize < sizeof(header)) || (header.headerSize > (sizeof(header) + sizeof(skip))) || !decode_read(file, skip, header.headerSize - sizeof(header), &remaining)){
+        fprintf(stderr, "ERROR: %s has a corrupt header\n", name);
+        return false;
+    }
+    stats->binBytes += header.headerSize;
+
+    while (decode_read(file, &record, sizeof(record), &remaining)){
+
+        if ((record.numArgs > LOG_RECORD_MAX_ARGS) ||
+            !decode_read(file, args, record.numArgs * sizeof(uint32_t), &remaining)){
+            fprintf(stderr, "ERROR: Truncated or corrupt record after %llu records\n", (unsigned long long)stats->numRecords);
+            ok = false;
+            break;
+        }
+        stats->binBytes += sizeof(record) + (record.numArgs * sizeof(uint32_t));
+
+        if (record.msgId == LOGID_TEXT){
+            if (!decode_read(file, &textLen, sizeof(textLen), &remaining) || (textLen > LOG_BUFFER_SIZE) ||
+                !decode_read(file, msg, textLen, &remaining)){
+                fprintf(stderr, "ERROR: Truncated or corrupt record after %llu records\n", (unsigned long long)stats->numRecords);
+                ok = false;
+                break;
+            }
+            msg[textLen] = '\0';
+            stats->binBytes += sizeof(textLen) + textLen;
+        }else if (log_catalog_format(msg, sizeof(msg), record.msgId, args, record.numArgs) < 0){
+            snprintf(msg, sizeof(msg), "<unknown message %u>", record.msgId);
+            stats->numUnknown++;
+        }
+
+        seconds = (time_t)(record.timestampNs / 1000000000ULL);
+        localtime_r(&seconds, &tmStruct);
+        lineLen = printf("%d-%02d-%02d %02d:%02d:%02d | %s: %s\n", tmStruct.tm_year + 1900, tmStruct.tm_mon + 1, tmStruct.tm_mday, tmStruct.tm_hour, tmStruct.tm_min, tmStruct.tm_sec, decode_level(record.logLev), msg);
+        stats->textBytes += (lineLen > 0) ? (uint64_t)lineLen : 0;
+        stats->numRecords++;
+    }
+
+    // A corrupt segment inside an export is skipped, the next segment starts 'size' bytes after this one
+    while ((size != UINT64_MAX) && (remaining != 0) &&
+           decode_read(file, skip, (remaining > sizeof(skip)) ? sizeof(skip) : (size_t)remaining, &remaining)){
+    }
+    return ok;
+}
+
+static bool decode_file(const char *path, decode_stats_t *stats, int *numSegments){
+
+    log_export_header_t exportHeader;
+    log_export_segment_t segment;
+    uint64_t remaining = UINT64_MAX;
+    char name[LOG_FILE_PATH_LEN];
+    bool ok = true;
+
+    // Reads gzip exports and plain segment files alike
+    gzFile file = gzopen(path, "rb");
+    if (file == NULL){
+        fprintf(stderr, "ERROR: Unable to open binary log %s\n", path);
+        return false;
+    }
+
+    if (!decode_read(file, &exportHeader, sizeof(exportHeader), &remaining) || (exportHeader.magic != LOG_EXPORT_MAGIC)){
+        gzrewind(file);
+        ok = decode_segment(file, UINT64_MAX, path, stats);
+        (*numSegments)++;
+        gzclose(file);
+        return ok;
+    }
+
+    if (exportHeader.version != LOG_EXPORT_VERSION){
+        fprintf(stderr, "ERROR: Unsupported log export version %u\n", exportHeader.version);
+        gzclose(file);
+        return false;
+    }
+    for (uint16_t index = 0; index < exportHeader.numSegments; index++){
+        if (!decode_read(file, &segment, sizeof(segment), &remaining)){
+            fprintf(stderr, "ERROR: %s ended after %u of %u segments\n", path, index, exportHeader.numSegments);
+            ok = false;
+            break;
+        }
+        snprintf(name, sizeof(name), "%s segment %u", path, segment.segmentId);
+        ok &= decode_segment(file, segment.size, name, stats);
+        (*numSegments)++;
+    }
+    gzclose(file);
+    return ok;
+}
+
+int main(int argc, char **argv){
+
+    static log_index_t index;
+    log_segment_t segments[LOG_MAX_SEGMENTS];
+    char path[LOG_FILE_PATH_LEN];
+    const char *baseName = LOG_BASENAME;
+    decode_stats_t stats = {0, 0, 0, 0};
+    size_t argLen = 0;
+    int numSegments = 0;
+    int numFiles = 0;
+    bool ok = true;
+
+    // Explicit segment files are decoded in the order given
+    for (int arg = 1; arg < argc; arg++){
+        argLen = strlen(argv[arg]);
+        if (((argLen > 4) && (strcmp(&argv[arg][argLen - 4], ".bin") == 0)) ||
+            ((argLen > 3) && (strcmp(&argv[arg][argLen - 3], ".gz") == 0))){
+            ok &= decode_file(argv[arg], &stats, &numSegments);
+            numFiles++;
+        }else{
+            baseName = argv[arg];
+        }
+    }
+
+    if (numFiles == 0){
+        log_index_open(&index, baseName);
+        numFiles = log_index_find(&index, 0, UINT64_MAX, segments, LOG_MAX_SEGMENTS);
+        log_index_close(&index);
+        if (numFiles == 0){
+            fprintf(stderr, "ERROR: No segments found for log %s in %s\n", baseName, LOG_DIRECTORY);
+            return EXIT_FAILURE;
+        }
+        for (int segment = 0; segment < numFiles; segment++){
+            log_segment_path(baseName, segments[segment].segmentId, path, sizeof(path));
+            ok &= decode_file(path, &stats, &numSegments);
+        }
+    }
+
+    fprintf(stderr, "Log Decode: %llu records (%llu unknown) in %d segments\n", (unsigned long long)stats.numRecords, (unsigned long long)stats.numUnknown, numSegments);
+    fprintf(stderr, "  Binary Size : %llu bytes\n", (unsigned long long)stats.binBytes);
+    fprintf(stderr, "  Text Size   : %llu bytes\n", (unsigned long long)stats.textBytes);
+    if (stats.binBytes != 0){
+        fprintf(stderr, "  Ratio       : %.2fx\n", (double)stats.textBytes / (double)stats.binBytes);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,430 @@
+/**
+ * @file spi_latency.c
+ * @author agent
+ * @brief Latency Test for the SPI Real-Time Profile
+ *        Measures the time from the CS edge timestamp to the point the SPI thread would start the
+ *        transfer (first byte on the bus) while background threads load every core with compute,
+ *        memory copies, heap churn and file writes. The test runs twice, first with default
+ *        scheduling and then with the real-time profile the services apply (See 'rt_profile.h',
+ *        configured with the same IRIS_RT_* environment variables), and prints both distributions.
+ *
+ *        Edges are simulated by a generator thread that timestamps and signals a pipe, the
+ *        measured thread sleeps on it with poll() the same way it sleeps on the CS line. With -g the
+ *        real CS line (SPI_CE_N) is used and gpiod's kernel edge timestamps are measured against, the
+ *        SPI service must be stopped and the OBC (or a signal generator) must be toggling CS.
+ *
+ *        Usage: spi_latency [-n edges] [-p period_us] [-l load_threads] [-g]
+ *          -n  Edges measured per run (Default 2000)
+ *          -p  Mean time between simulated edges in micro-seconds (Default 2000)
+ *          -l  Background load threads (Default 2 per core)
+ *          -g  Use the real CS line
+ *
+ *        Run as root (or with CAP_SYS_NICE / CAP_IPC_LOCK), otherwise the profile is only partly applied.
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include "gpio.h"
+#include "logger.h"
+#include "rt_profile.h"
+#include "timing.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gpiod.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LATENCY_DEFAULT_EDGES       2000
+#define LATENCY_DEFAULT_PERIOD_US   2000
+#define LATENCY_WAIT_MS             100             // Same as SPI_EDGE_WAIT_NS
+#define LATENCY_GPIOCHIP            "/dev/gpiochip0"    // Same as GPIOCHIP, the service headers declare main()
+#define LATENCY_EDGE_BUFF_SIZE      255
+#define LATENCY_MAX_ITERATIONS      100
+#define LATENCY_RX_LEN              255
+#define LATENCY_GEN_PRIORITY        90              // Generator stands in for the GPIO interrupt
+#define LATENCY_LOG_BASENAME        "Iris_Latency_Log"
+#define LATENCY_COPY_BYTES          (8 * 1024 * 1024)   // Larger than the CM4's L2 cache
+#define LATENCY_FILE_BYTES          (256 * 1024)
+
+enum LATENCY_LOAD{
+    LATENCY_LOAD_COMPUTE,   // Housekeeping / compression style integer work
+    LATENCY_LOAD_MEMORY,    // Cache and memory bandwidth pressure
+    LATENCY_LOAD_HEAP,      // malloc / free churn, page faults on fresh pages
+    LATENCY_LOAD_FILE,      // Buffered writes and fsync, like the log writer
+    LATENCY_NUM_LOADS
+};
+
+static const char *latencyLoadName[LATENCY_NUM_LOADS] = {"compute", "memory", "heap", "file"};
+
+typedef struct {
+    int pipeFd[2];
+    uint32_t periodUs;
+    bool realTime;
+} latency_gen_t;
+
+static volatile bool latencyRunning = true;
+static volatile uint64_t latencySink;
+
+static int compare_u64(const void *a, const void *b){
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*---- Background Load ----*/
+
+static void *latency_load(void *arg){
+
+    enum LATENCY_LOAD load = (enum LATENCY_LOAD)(uintptr_t)arg;
+    char path[] = "/tmp/spi_latency_XXXXXX";
+    uint8_t *src = NULL;
+    uint8_t *dst = NULL;
+    uint64_t value = 0x9E3779B97F4A7C15ULL;
+    int fileDesc = -1;
+
+    if (load == LATENCY_LOAD_MEMORY){
+        src = malloc(LATENCY_COPY_BYTES);
+        dst = malloc(LATENCY_COPY_BYTES);
+        if ((src == NULL) || (dst == NULL)){
+            return NULL;
+        }
+        memset(src, 0x5A, LATENCY_COPY_BYTES);
+    }else if (load == LATENCY_LOAD_FILE){
+        src = calloc(1, LATENCY_FILE_BYTES);
+        fileDesc = mkstemp(path);
+        if ((src == NULL) || (fileDesc < 0)){
+            free(src);
+            return NULL;
+        }
+        unlink(path);
+    }
+
+    while (latencyRunning){
+        switch (load){
+            case LATENCY_LOAD_COMPUTE:
+                for (int index = 0; index < 100000; index++){
+                    value ^= value << 13;
+                    value ^= value >> 7;
+                    value ^= value << 17;
+                }
+                latencySink = value;
+                break;
+            case LATENCY_LOAD_MEMORY:
+                memcpy(dst, src, LATENCY_COPY_BYTES);
+                latencySink = dst[value++ % LATENCY_COPY_BYTES];
+                break;
+            case LATENCY_LOAD_HEAP:
+                // Above the mmap threshold, every allocation is new pages from the kernel
+                dst = malloc(LATENCY_FILE_BYTES * 2);
+                if (dst != NULL){
+                    memset(dst, (int)value++, LATENCY_FILE_BYTES * 2);
+                    latencySink = dst[LATENCY_FILE_BYTES];
+                    free(dst);
+                }
+                dst = NULL;
+                break;
+            case LATENCY_LOAD_FILE:
+                if (pwrite(fileDesc, src, LATENCY_FILE_BYTES, 0) > 0){
+                    fsync(fileDesc);
+                }
+                break;
+            default:
+                return NULL;
+        }
+    }
+
+    if (fileDesc >= 0){
+        close(fileDesc);
+    }
+    free(src);
+    free(dst);
+    return NULL;
+}
+
+/*---- Simulated CS Edges ----*/
+
+static void *latency_generator(void *arg){
+
+    latency_gen_t *gen = arg;
+    struct timespec next;
+    uint64_t edgeNs = 0;
+    uint32_t seed = 1;
+    uint64_t delayNs = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (latencyRunning){
+
+        // Edges arrive 0.5 to 1.5 periods apart so they do not lock to the load threads' time slices
+        delayNs = ((uint64_t)gen->periodUs * 500ULL) + ((uint64_t)rand_r(&seed) % ((uint64_t)gen->periodUs * 1000ULL + 1));
+        next.tv_nsec += (long)delayNs;
+        while (next.tv_nsec >= 1000000000L){
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        // Edges are dropped rather than blocking while the pipe is full (between runs)
+        edgeNs = get_time_monotonic_ns();
+        if ((write(gen->pipeFd[1], &edgeNs, sizeof(edgeNs)) < 0) && (errno != EAGAIN)){
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Waits for the next simulated edge
+ *
+ * @param fileDesc Read end of the generator pipe
+ * @param edgeNs Pointer to variable that will store the timestamp of the latest edge
+ * @return True if an edge was received
+ */
+static bool latency_wait_pipe(int fileDesc, uint64_t *edgeNs){
+
+    struct pollfd pollFd = {.fd = fileDesc, .events = POLLIN};
+    uint64_t stamps[16];
+    ssize_t numRead = 0;
+    bool received = false;
+
+    if (poll(&pollFd, 1, LATENCY_WAIT_MS) <= 0){
+        return false;
+    }
+    // Edges that queued up while the thread was late are drained, the latest one is measured
+    while ((numRead = read(fileDesc, stamps, sizeof(stamps))) >= (ssize_t)sizeof(uint64_t)){
+        *edgeNs = stamps[(numRead / sizeof(uint64_t)) - 1];
+        received = true;
+    }
+    return received;
+}
+
+/**
+ * @brief Waits for the next edge on the real CS line, as 'signal_edge_wait' does
+ *
+ * @param request CS line request
+ * @param eventBuffer Edge event buffer of the CS line
+ * @param edgeNs Pointer to variable that will store the kernel timestamp of the latest edge
+ * @return True if an edge was received
+ */
+static bool latency_wait_cs(struct gpiod_line_request *request, struct gpiod_edge_event_buffer *eventBuffer, uint64_t *edgeNs){
+
+    int numEvents = LATENCY_EDGE_BUFF_SIZE;
+    bool received = false;
+
+    if (gpiod_line_request_wait_edge_events(request, LATENCY_WAIT_MS * 1000000LL) <= 0){
+        return false;
+    }
+    for (int index = 0; (index < LATENCY_MAX_ITERATIONS) && (numEvents >= LATENCY_EDGE_BUFF_SIZE); index++){
+        numEvents = gpiod_line_request_read_edge_events(request, eventBuffer, LATENCY_EDGE_BUFF_SIZE);
+        if (numEvents > 0){
+            *edgeNs = gpiod_edge_event_get_timestamp_ns(gpiod_edge_event_buffer_get_event(eventBuffer, numEvents - 1));
+            received = true;
+        }
+    }
+    return received;
+}
+
+/*---- Measurement ----*/
+
+/**
+ * @brief Measures 'numEdges' edges, the stamp is taken where 'spi_read' issues the transfer after the
+ *        receive buffer has been set up, as in 'spi_read_loop'
+ *
+ * @return Number of samples measured
+ */
+static uint32_t latency_run(int pipeFd, struct gpiod_line_request *request, struct gpiod_edge_event_buffer *eventBuffer,
+                            uint64_t *samples, uint32_t numEdges){
+
+    uint8_t rxBuffer[LATENCY_RX_LEN];
+    uint64_t edgeNs = 0;
+    uint32_t numSamples = 0;
+    uint32_t numTimeouts = 0;
+
+    // Edges left over from before the run (e.g. while the profile was applied) are not measured
+    if (request != NULL){
+        while (gpiod_line_request_wait_edge_events(request, 0) > 0){
+            latency_wait_cs(request, eventBuffer, &edgeNs);
+        }
+    }else{
+        while (read(pipeFd, &edgeNs, sizeof(edgeNs)) > 0){
+        }
+    }
+
+    while ((numSamples < numEdges) && (numTimeouts < 50)){
+
+        if ((request != NULL) ? !latency_wait_cs(request, eventBuffer, &edgeNs) : !latency_wait_pipe(pipeFd, &edgeNs)){
+            numTimeouts++;
+            continue;
+        }
+        memset(rxBuffer, 0, sizeof(rxBuffer));
+        latencySink = rxBuffer[edgeNs % LATENCY_RX_LEN];
+        samples[numSamples++] = get_time_monotonic_ns() - edgeNs;
+    }
+    if (numTimeouts >= 50){
+        fprintf(stderr, "WARNING: No CS edges for %d ms, stopped after %u samples\n", 50 * LATENCY_WAIT_MS, numSamples);
+    }
+    return numSamples;
+}
+
+static void latency_print(const char *name, uint64_t *samples, uint32_t numSamples){
+
+    double mean = 0;
+    double variance = 0;
+
+    if (numSamples == 0){
+        printf("%-12s %8s\n", name, "no samples");
+        return;
+    }
+    qsort(samples, numSamples, sizeof(uint64_t), compare_u64);
+    for (uint32_t index = 0; index < numSamples; index++){
+        mean += (double)samples[index];
+    }
+    mean /= numSamples;
+    for (uint32_t index = 0; index < numSamples; index++){
+        variance += ((double)samples[index] - mean) * ((double)samples[index] - mean);
+    }
+    variance /= numSamples;
+
+    printf("%-12s %8u %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", name, numSamples,
+           samples[0] / 1000.0, samples[numSamples / 2] / 1000.0, mean / 1000.0,
+           samples[(uint32_t)(numSamples * 0.99)] / 1000.0, samples[(uint32_t)(numSamples * 0.999)] / 1000.0,
+           samples[numSamples - 1] / 1000.0, sqrt(variance) / 1000.0);
+}
+
+int main(int argc, char **argv){
+
+    pthread_t loadThreads[256];
+    pthread_t genThread;
+    latency_gen_t gen = {.pipeFd = {-1, -1}, .periodUs = LATENCY_DEFAULT_PERIOD_US, .realTime = false};
+    struct sched_param param = {.sched_priority = LATENCY_GEN_PRIORITY};
+    struct gpiod_line_request *request = NULL;
+    struct gpiod_edge_event_buffer *eventBuffer = NULL;
+    rt_profile_t profile;
+    uint64_t *baseSamples = NULL;
+    uint64_t *rtSamples = NULL;
+    uint32_t numBase = 0;
+    uint32_t numRt = 0;
+    uint32_t numEdges = LATENCY_DEFAULT_EDGES;
+    long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t numLoads = (uint32_t)((numCores > 0) ? (numCores * 2) : 2);
+    uint32_t numStarted = 0;
+    bool useCs = false;
+    int opt = 0;
+
+    while ((opt = getopt(argc, argv, "n:p:l:g")) != -1){
+        switch (opt){
+            case 'n':
+                numEdges = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                gen.periodUs = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                numLoads = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'g':
+                useCs = true;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n edges] [-p period_us] [-l load_threads] [-g]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if ((numEdges == 0) || (gen.periodUs == 0)){
+        fprintf(stderr, "ERROR: -n and -p must be above 0\n");
+        return EXIT_FAILURE;
+    }
+    numLoads = (numLoads > 256) ? 256 : numLoads;
+
+    // Log writer must exist before the profile is applied, or it would inherit it
+    log_set_basename(LATENCY_LOG_BASENAME);
+    log_file_init();
+    rt_profile_load(&profile);
+
+    baseSamples = calloc(numEdges, sizeof(uint64_t));
+    rtSamples = calloc(numEdges, sizeof(uint64_t));
+    if ((baseSamples == NULL) || (rtSamples == NULL)){
+        fprintf(stderr, "ERROR: Unable to allocate %u samples\n", numEdges);
+        return EXIT_FAILURE;
+    }
+
+    if (useCs){
+        request = gpio_config_input_detect(LATENCY_GPIOCHIP, SPI_CE_N, EDGE_FALL, "IRIS SPI LATENCY");
+        eventBuffer = gpiod_edge_event_buffer_new(LATENCY_EDGE_BUFF_SIZE);
+        if ((request == NULL) || (eventBuffer == NULL)){
+            fprintf(stderr, "ERROR: Unable to request the CS line, stop the SPI service first\n");
+            return EXIT_FAILURE;
+        }
+    }else{
+        if (pipe2(gen.pipeFd, O_CLOEXEC | O_NONBLOCK) != 0){
+            fprintf(stderr, "ERROR: Unable to create edge pipe (%s)\n", strerror(errno));
+            return EXIT_FAILURE;
+        }
+        if (pthread_create(&genThread, NULL, latency_generator, &gen) != 0){
+            fprintf(stderr, "ERROR: Unable to start edge generator\n");
+            return EXIT_FAILURE;
+        }
+        gen.realTime = (pthread_setschedparam(genThread, SCHED_FIFO, &param) == 0);
+    }
+
+    for (; numStarted < numLoads; numStarted++){
+        if (pthread_create(&loadThreads[numStarted], NULL, latency_load, (void *)(uintptr_t)(numStarted % LATENCY_NUM_LOADS)) != 0){
+            break;
+        }
+    }
+
+    printf("Edges: %s, %u per run%s\n", useCs ? "CS line (kernel timestamps)" : "simulated", numEdges,
+           (useCs || gen.realTime) ? "" : ", generator not real-time (latencies include its own delays)");
+    if (!useCs){
+        printf("Mean period: %u us\n", gen.periodUs);
+    }
+    printf("Load: %u threads on %ld cores (", numStarted, numCores);
+    for (uint32_t load = 0; (load < LATENCY_NUM_LOADS) && (load < numStarted); load++){
+        printf("%s%s", (load == 0) ? "" : ", ", latencyLoadName[load]);
+    }
+    printf(")\n");
+    printf("Profile: priority %d, CPU %d, mlock %d, prefault %u KB\n\n", profile.priority, profile.cpu, profile.mlock, profile.prefaultKb);
+    fflush(stdout);
+
+    numBase = latency_run(gen.pipeFd[0], request, eventBuffer, baseSamples, numEdges);
+    if (rt_profile_apply(&profile) != NO_ERROR){
+        fprintf(stderr, "WARNING: Real-time profile only partly applied, see the log\n");
+    }
+    numRt = latency_run(gen.pipeFd[0], request, eventBuffer, rtSamples, numEdges);
+
+    latencyRunning = false;
+    for (uint32_t index = 0; index < numStarted; index++){
+        pthread_join(loadThreads[index], NULL);
+    }
+    if (!useCs){
+        close(gen.pipeFd[1]);
+        pthread_join(genThread, NULL);
+        close(gen.pipeFd[0]);
+    }else{
+        gpiod_edge_event_buffer_free(eventBuffer);
+        gpiod_line_request_release(request);
+    }
+
+    printf("%-12s %8s %9s %9s %9s %9s %9s %9s %9s\n", "RUN", "SAMPLES", "MIN_US", "P50_US", "MEAN_US", "P99_US", "P999_US", "MAX_US", "JITTER_US");
+    latency_print("default", baseSamples, numBase);
+    latency_print("rt_profile", rtSamples, numRt);
+
+    free(baseSamples);
+    free(rtSamples);
+    return EXIT_SUCCESS;
+}
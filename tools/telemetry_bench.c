@@ -0,0 +1,215 @@
+/**
+ * @file telemetry_bench.c
+ * @author agent
+ * @brief Benchmark for the Telemetry Packer
+ *        Measures compression ratio and packing / unpacking speed of 'telemetry_pack'
+ *        on recorded sensor history, and verifies every frame round-trips through the decoder.
+ *
+ *        Usage: telemetry_bench [recorded_history.csv]
+ *          CSV rows are 'channel,timestamp_ms,value'. If no file is provided a synthetic
+ *          history matching the housekeeping sweep (3 rails x 4 values + 4 temps) is used.
+ *
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "error_handler.h"
+#include "telemetry_pack.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_ITERATIONS        200
+#define BENCH_SYNTH_CHANNELS    16
+#define BENCH_SYNTH_SAMPLES     1024
+#define BENCH_SAMPLE_PERIOD_MS  10000
+#define BENCH_RAW_SAMPLE_SIZE   (sizeof(uint8_t) + sizeof(uint64_t) + sizeof(int32_t))
+#define BENCH_CMD_SAMPLE_SIZE   (255 + 4) // SPI_RX_LEN command frame + CMD_RETURN response per reading
+
+static uint64_t benchTimestamp[TELEM_MAX_CHANNELS][TELEM_MAX_SAMPLES];
+static int32_t  benchValue[TELEM_MAX_CHANNELS][TELEM_MAX_SAMPLES];
+static uint64_t checkTimestamp[TELEM_MAX_CHANNELS][TELEM_MAX_SAMPLES];
+static int32_t  checkValue[TELEM_MAX_CHANNELS][TELEM_MAX_SAMPLES];
+
+static double bench_now_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
+
+static int find_channel(telemetry_series_t *series, uint8_t *numSeries, uint8_t channel){
+
+    for (int index = 0; index < *numSeries; index++){
+        if (series[index].channel == channel){
+            return index;
+        }
+    }
+    if (*numSeries >= TELEM_MAX_CHANNELS){
+        return -1;
+    }
+    series[*numSeries].channel = channel;
+    series[*numSeries].numSamples = 0;
+    return (*numSeries)++;
+}
+
+static int load_recorded(const char *path, telemetry_series_t *series, uint8_t *numSeries){
+
+    unsigned int channel = 0;
+    unsigned long long timestamp = 0;
+    long value = 0;
+    char line[128];
+    int index = 0;
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL){
+        printf("ERROR: Unable to open recorded history %s\n", path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL){
+        if (sscanf(line, "%u,%llu,%ld", &channel, &timestamp, &value) != 3){
+            continue;
+        }
+        index = find_channel(series, numSeries, (uint8_t)channel);
+        if ((index < 0) || (series[index].numSamples >= TELEM_MAX_SAMPLES)){
+            continue;
+        }
+        series[index].timestamp[series[index].numSamples] = timestamp;
+        series[index].value[series[index].numSamples] = (int32_t)value;
+        series[index].numSamples++;
+    }
+
+    fclose(file);
+    return 0;
+}
+
+// Sensor-like history: housekeeping cadence with scheduling jitter, slow drift and ADC noise
+static void load_synthetic(telemetry_series_t *series, uint8_t *numSeries){
+
+    uint64_t startTime = 1735689600000ULL;
+    int32_t base = 0;
+
+    srand(1);
+    for (int channel = 0; channel < BENCH_SYNTH_CHANNELS; channel++){
+        series[channel].channel = (uint8_t)channel;
+        series[channel].numSamples = BENCH_SYNTH_SAMPLES;
+        base = (channel < 12) ? 100 + (channel * 250) : 20 + channel;
+
+        for (int sample = 0; sample < BENCH_SYNTH_SAMPLES; sample++){
+            series[channel].timestamp[sample] = startTime + ((uint64_t)sample * BENCH_SAMPLE_PERIOD_MS) + (uint64_t)(rand() % 40);
+            series[channel].value[sample] = base + ((sample / 64) % 8) + (rand() % 5) - 2;
+        }
+    }
+    *numSeries = BENCH_SYNTH_CHANNELS;
+}
+
+static int verify_round_trip(const telemetry_series_t *series, const telemetry_series_t *check, uint8_t numSeries){
+
+    for (int index = 0; index < numSeries; index++){
+        if ((series[index].channel != check[index].channel) || (series[index].numSamples != check[index].numSamples)){
+            return -1;
+        }
+        for (int sample = 0; sample < series[index].numSamples; sample++){
+            if ((series[index].timestamp[sample] != check[index].timestamp[sample]) ||
+                (series[index].value[sample] != check[index].value[sample])){
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv){
+
+    telemetry_series_t series[TELEM_MAX_CHANNELS];
+    telemetry_series_t check[TELEM_MAX_CHANNELS];
+    uint8_t numSeries = 0;
+    uint8_t numCheck = 0;
+    uint32_t packedLen = 0;
+    uint32_t bound = 0;
+    uint64_t totalSamples = 0;
+    double startTime = 0;
+    double packTime = 0;
+    double unpackTime = 0;
+    uint8_t *buffer = NULL;
+
+    for (int index = 0; index < TELEM_MAX_CHANNELS; index++){
+        series[index].timestamp = benchTimestamp[index];
+        series[index].value = benchValue[index];
+        series[index].maxSamples = TELEM_MAX_SAMPLES;
+        check[index].timestamp = checkTimestamp[index];
+        check[index].value = checkValue[index];
+        check[index].maxSamples = TELEM_MAX_SAMPLES;
+    }
+
+    if (argc > 1){
+        if (load_recorded(argv[1], series, &numSeries) != 0){
+            return EXIT_FAILURE;
+        }
+        printf("Telemetry Bench: Recorded history '%s'\n", argv[1]);
+    }else{
+        load_synthetic(series, &numSeries);
+        printf("Telemetry Bench: Synthetic housekeeping history\n");
+    }
+
+    for (int index = 0; index < numSeries; index++){
+        totalSamples += series[index].numSamples;
+    }
+    if (totalSamples == 0){
+        printf("ERROR: No samples to pack\n");
+        return EXIT_FAILURE;
+    }
+
+    bound = telemetry_pack_bound(series, numSeries);
+    buffer = malloc(bound);
+    if (buffer == NULL){
+        printf("ERROR: Unable to allocate %u byte pack buffer\n", bound);
+        return EXIT_FAILURE;
+    }
+
+    startTime = bench_now_s();
+    for (int iter = 0; iter < BENCH_ITERATIONS; iter++){
+        if (telemetry_pack(series, numSeries, buffer, bound, &packedLen) != NO_ERROR){
+            printf("ERROR: telemetry_pack failed\n");
+            free(buffer);
+            return EXIT_FAILURE;
+        }
+    }
+    packTime = (bench_now_s() - startTime) / BENCH_ITERATIONS;
+
+    startTime = bench_now_s();
+    for (int iter = 0; iter < BENCH_ITERATIONS; iter++){
+        if (telemetry_unpack(buffer, packedLen, check, TELEM_MAX_CHANNELS, &numCheck) != NO_ERROR){
+            printf("ERROR: telemetry_unpack failed\n");
+            free(buffer);
+            return EXIT_FAILURE;
+        }
+    }
+    unpackTime = (bench_now_s() - startTime) / BENCH_ITERATIONS;
+
+    if ((numCheck != numSeries) || (verify_round_trip(series, check, numSeries) != 0)){
+        printf("ERROR: Decoded history does not match input\n");
+        free(buffer);
+        return EXIT_FAILURE;
+    }
+
+    printf("  Channels            : %u\n", numSeries);
+    printf("  Samples             : %llu\n", (unsigned long long)totalSamples);
+    printf("  Raw Record Size     : %llu bytes (%zu B/sample)\n", (unsigned long long)(totalSamples * BENCH_RAW_SAMPLE_SIZE), (size_t)BENCH_RAW_SAMPLE_SIZE);
+    printf("  Per-Command Bus Cost: %llu bytes (%d B/sample)\n", (unsigned long long)(totalSamples * BENCH_CMD_SAMPLE_SIZE), BENCH_CMD_SAMPLE_SIZE);
+    printf("  Packed Size         : %u bytes (%.2f B/sample)\n", packedLen, (double)packedLen / (double)totalSamples);
+    printf("  Ratio vs Raw        : %.2fx\n", (double)(totalSamples * BENCH_RAW_SAMPLE_SIZE) / packedLen);
+    printf("  Ratio vs Commands   : %.2fx\n", (double)(totalSamples * BENCH_CMD_SAMPLE_SIZE) / packedLen);
+    printf("  Pack Speed          : %.2f Msamples/s (%.1f us/frame)\n", (double)totalSamples / packTime / 1e6, packTime * 1e6);
+    printf("  Unpack Speed        : %.2f Msamples/s (%.1f us/frame)\n", (double)totalSamples / unpackTime / 1e6, unpackTime * 1e6);
+    printf("  Round Trip          : OK\n");
+
+    free(buffer);
+    return EXIT_SUCCESS;
+}